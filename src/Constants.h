@@ -3,12 +3,209 @@
 
 #include <ArduinoJson.h>
 
-#define DATE_TIME_ISO_LEN 26
+/**
+ * Buffer size for `ThermiteInternalState`'s ISO 8601 `dateTime`.  Real dates take 25 characters,
+ * but this also holds the 30 that `snprintf()` allows for with every `uint8_t` field at 255.
+ */
+#define DATE_TIME_ISO_LEN 31
+
+/**
+ * Units of time, as unsigned integers: cast at the point of use for signed or float
+ * arithmetic.
+ */
+#define SECONDS_PER_MINUTE 60ul
+#define SECONDS_PER_HOUR 3600ul
+#define SECONDS_PER_DAY 86400ul
+#define MS_PER_HOUR 3600000ul
+
+#define LOOP_INTERVAL 100ul
+
+#define NTP_UPDATE_INTERVAL 60000ul
+
+#define WIFI_STATE_IDLE 0
+#define WIFI_STATE_CONNECTING 1
+#define WIFI_STATE_CONNECTED 2
+#define WIFI_STATE_FAILED 3
+#define WIFI_CONNECT_TIMEOUT 10000ul
+#define WIFI_POLL_INTERVAL 20ul
+#define WIFI_BACKOFF_MIN 500ul
+#define WIFI_BACKOFF_MAX 60000ul
+#ifndef WIFI_CACHE_IP
+#define WIFI_CACHE_IP 0
+#endif
+
+/**
+ * Layout of the ESP8266's RTC user memory, which survives resets (but not power loss).
+ * Offsets and sizes are in bytes, and must be multiples of 4.
+ */
+#define RTC_MEMORY_SIZE 512
+#define RTC_OFFSET_WIFI_CACHE 0
+#define RTC_OFFSET_CLOCK 32
+#define RTC_OFFSET_CHECKPOINT 48
+
+/**
+ * Layout of the emulated EEPROM, a flash sector that survives power loss.  Each zone's
+ * calendar takes `sizeof(ThermiteCalendarRecord)` bytes after `EEPROM_OFFSET_CALENDAR`, and
+ * its thermal model `sizeof(ThermiteThermalRecord)` bytes after `EEPROM_OFFSET_THERMAL_MODEL`.
+ * Offsets and sizes are in bytes.
+ */
+#define EEPROM_SIZE 1024
+#define EEPROM_OFFSET_CALENDAR 0
+#define EEPROM_OFFSET_THERMAL_MODEL 512
+
+#define HEATER_JOURNAL_SIZE 32
+#define HEATER_MAX_CYCLES_PER_HOUR 12
+#define HEATER_RUNTIME_DAYS 7
+
+/**
+ * Zones, each with their own thermometer, relay, settings and state.  Each zone's checkpoint
+ * takes `sizeof(ThermiteCheckpoint)` bytes of RTC memory after `RTC_OFFSET_CHECKPOINT`, but
+ * RAM runs out first: see `RAM_RESERVED_MAX`.
+ */
+#define ZONE_COUNT_MAX 2
+#define ZONE_RELAY_REFRESH_INTERVAL 60000ul
+#define ZONE_CLOCK_CHECKPOINT_INTERVAL 60000ul
+
+/**
+ * Number of zones wired to the board; build with e.g. `-DZONE_COUNT=2` for more.
+ */
+#ifndef ZONE_COUNT
+#define ZONE_COUNT 1
+#endif
+
+/**
+ * Set points and schedules.  Daily schedules, overrides and calendar exceptions all work
+ * in local time; schedules and the calendar in `SCHEDULE_INTERVAL`-second steps.
+ */
+#define SET_POINT_MIN 10
+#define SET_POINT_MAX 30
+#define SCHEDULE_INTERVAL 1800l
+#define CALENDAR_SIZE 16
+
+/**
+ * Each zone's thermal model is fitted to one sample per `THERMAL_MODEL_WINDOW` ms of
+ * readings, and written to flash every `THERMAL_MODEL_SAVE_SAMPLES` samples.
+ */
+#define THERMAL_MODEL_WINDOW 900000ul
+#define THERMAL_MODEL_SAVE_SAMPLES 24
+
+/**
+ * Optimal start: heating for a coming rise in target temperature starts early, by the warm-up
+ * time the thermal model predicts scaled by `PREHEAT_MARGIN_DEFAULT`, but never more than
+ * `PREHEAT_LOOKAHEAD_MAX` seconds early, and not before the model has `PREHEAT_SAMPLES_MIN`
+ * samples.  Larger margins trade energy for comfort; zero, the default, turns preheating off.
+ * Installs can opt in with e.g. `-DPREHEAT_MARGIN_DEFAULT=1.2f`.
+ */
+#ifndef PREHEAT_MARGIN_DEFAULT
+#define PREHEAT_MARGIN_DEFAULT 0.0f
+#endif
+#define PREHEAT_LOOKAHEAD_MAX 14400l
+#define PREHEAT_SAMPLES_MIN 96
+
+#define ROLLUP_MINUTE_SIZE 60
+#define ROLLUP_HOUR_SIZE 168
+#define ROLLUP_DAY_SIZE 90
+
+/**
+ * Each zone's history of samples and heater switches is kept on the flash file system (see
+ * `ThermiteHistory`), in segments of `HISTORY_SEGMENT_BLOCKS` blocks of `HISTORY_BLOCK_SIZE`
+ * bytes: one flash page per block, and just under one 4 KB erase block per segment.  Each zone
+ * keeps its newest `HISTORY_SEGMENT_COUNT` segments, most of a day each at one sample a minute,
+ * which fits the 64 KB file system of `eagle.flash.512k64.ld`.  `GET /history` covers at most
+ * `HISTORY_RANGE_MAX` seconds per response, downsampled to between `HISTORY_POINTS_MIN` and
+ * `HISTORY_POINTS_MAX` samples if asked.
+ */
+#define HISTORY_BLOCK_SIZE 256
+#define HISTORY_SEGMENT_BLOCKS 15
+#ifndef HISTORY_SEGMENT_COUNT
+#define HISTORY_SEGMENT_COUNT (10 / ZONE_COUNT)
+#endif
+#define HISTORY_RANGE_MAX (7l * 86400l)
+#define HISTORY_POINTS_MIN 3
+#define HISTORY_POINTS_MAX 4000
+
+/**
+ * Radio power modes, as used by `ThermitePowerManager`.  Installs that care about current
+ * draw can opt in to a sleep mode with `-DPOWER_MODE_DEFAULT=POWER_MODE_LIGHT_SLEEP`.
+ */
+#define POWER_MODE_AWAKE 0
+#define POWER_MODE_MODEM_SLEEP 1
+#define POWER_MODE_LIGHT_SLEEP 2
+#ifndef POWER_MODE_DEFAULT
+#define POWER_MODE_DEFAULT POWER_MODE_AWAKE
+#endif
+#define POWER_LISTEN_INTERVAL 3
+#define POWER_SESSION_TIMEOUT 10000ul
+#define POWER_SLEEP_MAX 1000ul
+
+/**
+ * Telemetry, off unless built with e.g. `-DTELEMETRY_HOST=\"192.168.1.10\"` (a collector,
+ * or a multicast group such as 239.0.0.1): each zone then pushes a `ThermiteTelemetryPacket`
+ * to UDP port `TELEMETRY_PORT` whenever its state changes, and at least every
+ * `TELEMETRY_HEARTBEAT_INTERVAL` ms.
+ */
+#ifndef TELEMETRY_PORT
+#define TELEMETRY_PORT 4210
+#endif
+#define TELEMETRY_HEARTBEAT_INTERVAL 60000ul
+
+/**
+ * Allocation profiler, off unless built with `-DALLOC_PROFILER=1` (see `env:thing-profile`):
+ * heap use is then recorded for up to `ALLOC_PROFILE_SIZE` routes and loop phases, and
+ * reported by `GET /debug/alloc`.
+ */
+#ifndef ALLOC_PROFILER
+#define ALLOC_PROFILER 0
+#endif
+#define ALLOC_PROFILE_SIZE 16
 
-#define CAPACITY_HTTP_ERROR (JSON_OBJECT_SIZE(2) + JSON_STRING_SIZE(32))
 #define CAPACITY_INTERNAL_STATE (JSON_OBJECT_SIZE(4) + JSON_STRING_SIZE(DATE_TIME_ISO_LEN))
 #define CAPACITY_SET_POINT (JSON_OBJECT_SIZE(2) + JSON_STRING_SIZE(16))
 #define CAPACITY_DAILY_SCHEDULE (JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(12) + JSON_STRING_SIZE(16))
-#define CAPACITY_USER_SETTINGS_MANAGER (JSON_OBJECT_SIZE(6) + CAPACITY_SET_POINT * 4 + CAPACITY_DAILY_SCHEDULE * 4)
+#define CAPACITY_HEATER_SETTINGS (JSON_OBJECT_SIZE(3))
+#define CAPACITY_USER_SETTINGS_MANAGER (JSON_OBJECT_SIZE(7) + CAPACITY_SET_POINT * 4 + CAPACITY_DAILY_SCHEDULE * 4 + CAPACITY_HEATER_SETTINGS)
+#define CAPACITY_CALENDAR (JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(CALENDAR_SIZE) + CALENDAR_SIZE * JSON_OBJECT_SIZE(3))
+#define CAPACITY_USER_SETTINGS_UPDATE (CAPACITY_USER_SETTINGS_MANAGER + CAPACITY_CALENDAR)
+#define CAPACITY_THERMAL_MODEL (JSON_OBJECT_SIZE(7))
+#define CAPACITY_ZONES (JSON_OBJECT_SIZE(4) + 3 * JSON_ARRAY_SIZE(ZONE_COUNT_MAX))
+#define CAPACITY_POWER_MANAGER (JSON_OBJECT_SIZE(9))
+#define CAPACITY_HEATER_RUNTIME (JSON_OBJECT_SIZE(5) + JSON_ARRAY_SIZE(HEATER_JOURNAL_SIZE) + JSON_OBJECT_SIZE(2) * HEATER_JOURNAL_SIZE)
+
+/**
+ * JSON responses are serialized into one of `RESPONSE_POOL_SIZE` buffers reserved at boot
+ * (see `ThermiteResponsePool`): two per zone hold the cached `internalState` and
+ * `userSettings` snapshots, and the rest serve everything else.  `CAPACITY_RESPONSE_MAX` is
+ * the largest `CAPACITY_*` above, and `RESPONSE_BUFFER_SIZE` fits the longest serialized
+ * body, a full heater journal.
+ */
+#define RESPONSE_POOL_SIZE_FOR(zoneCount) (3 + 2 * (zoneCount))
+#define RESPONSE_POOL_SIZE RESPONSE_POOL_SIZE_FOR(ZONE_COUNT)
+#define RESPONSE_BUFFER_SIZE 1280
+#define RESPONSE_HEAD_LEN 48
+#define CAPACITY_RESPONSE_MAX CAPACITY_HEATER_RUNTIME
+
+/**
+ * RAM budget for what is reserved at boot: the response pool, the chunked body slots, and
+ * each zone's settings images and internal state (rollup rings, history blocks, heater
+ * journal and so on).  Of the ESP8266's 80 KB of data RAM, only about `RAM_AVAILABLE` is left
+ * once the SDK and WiFi are up, and `RAM_HEADROOM` of that has to stay free for lwIP,
+ * `ESPAsyncWebServer` and its connections.  At `ZONE_COUNT_MAX` the reservation comes to
+ * about 27 KB (9 KB of response buffers, 2.5 KB of body slots, 8 KB per zone), which is why
+ * a third zone does not fit.  `ThermiteWebController.cpp` checks this at compile time;
+ * `GET /debug/alloc` on `env:thing-profile` reports what is actually free.
+ */
+#define RAM_AVAILABLE 40960
+#define RAM_HEADROOM 12288
+#define RAM_RESERVED_MAX (RAM_AVAILABLE - RAM_HEADROOM)
+
+/**
+ * Sentinel for "no valid temperature", matching `DEVICE_DISCONNECTED_C` in `DallasTemperature`
+ * so that JSON output is unchanged regardless of which thermometer implementation is in use.
+ */
+#define TEMP_DISCONNECTED -127.0f
+
+#define TEMP_RESOLUTION 11
+#define TEMP_REQUEST_DELAY 750ul / (1ul << (12 - TEMP_RESOLUTION))
+#define TEMP_REQUEST_INTERVAL 60000ul
 
 #endif
\ No newline at end of file
@@ -3,21 +3,53 @@
 
 #include <ArduinoJson.h>
 
+/**
+ * Mixin for types that can be updated from JSON.  `T` provides
+ * `bool validateJSON(const JsonObject&) const` and `void updateFromJSON(const JsonObject&)`.
+ *
+ * Calls are resolved at compile time, so neither this nor `JsonWrite` adds a vtable pointer
+ * to `T`; as empty bases they add no size at all.
+ */
+template <typename T>
 struct JsonRead {
-  virtual bool validateJSON(const JsonObject& root) const = 0;
-  virtual void updateFromJSON(const JsonObject& root) = 0;
-
   bool updateFromJSONSafe(const JsonObject& root) {
-    if (!validateJSON(root)) {
+    T& self = static_cast<T&>(*this);
+    if (!self.validateJSON(root)) {
       return false;
     }
-    updateFromJSON(root);
+    self.updateFromJSON(root);
     return true;
   }
 };
 
-struct JsonWrite {
-  virtual bool toJSON(const JsonObject& root) const = 0;
+/**
+ * Mixin for types that can be written to JSON.  `T` provides
+ * `bool toJSON(const JsonObject&) const`.
+ */
+template <typename T>
+struct JsonWrite {};
+
+/**
+ * Non-owning reference to any `JsonWrite`, for the one place that serializes bodies of
+ * different types through the same code (`ThermiteResponsePool::serialize()`).  This costs
+ * an indirect call per response, rather than a vtable pointer per object.
+ */
+class JsonWriteRef {
+private:
+  const void* _body;
+  bool (*_toJSON)(const void* body, const JsonObject& root);
+
+  template <typename T>
+  static bool _toJSONImpl(const void* body, const JsonObject& root) {
+    return static_cast<const T*>(body)->toJSON(root);
+  }
+public:
+  template <typename T>
+  JsonWriteRef(const JsonWrite<T>& body)
+  : _body(static_cast<const T*>(&body)),
+    _toJSON(&JsonWriteRef::_toJSONImpl<T>) {}
+
+  bool toJSON(const JsonObject& root) const { return _toJSON(_body, root); }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ThermiteAllocProfiler.h"
+
+ThermiteAllocProfiler* ThermiteAllocProfiler::_installed = nullptr;
+
+ThermiteAllocProfiler::ThermiteAllocProfiler(const ThermiteSystem& system)
+: _system(system),
+  _count(0),
+  _active(nullptr),
+  _activeAllocations(0ul),
+  _activeBytes(0ul),
+  _activeFreeHeap(0ul),
+  _activeFreeHeapMin(0ul),
+  _activeMaxFreeBlock(0ul),
+  _allocations(0ul),
+  _freeHeapMin(0xfffffffful) {
+  memset(_profiles, 0, sizeof(_profiles));
+}
+
+ThermiteAllocProfiler::~ThermiteAllocProfiler() {
+  uninstall();
+}
+
+ThermiteAllocProfile* ThermiteAllocProfiler::_find(const char* name) {
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_profiles[i].name == name || strcmp(_profiles[i].name, name) == 0) {
+      return &_profiles[i];
+    }
+  }
+  if (_count == ALLOC_PROFILE_SIZE) {
+    return nullptr;
+  }
+  ThermiteAllocProfile* profile = &_profiles[_count++];
+  profile->name = name;
+  return profile;
+}
+
+void ThermiteAllocProfiler::_onAllocation(size_t size) {
+  _allocations++;
+  uint32_t freeHeap = _system.getFreeHeap();
+  if (freeHeap < _freeHeapMin) {
+    _freeHeapMin = freeHeap;
+  }
+  if (_active == nullptr) {
+    return;
+  }
+  _activeAllocations++;
+  _activeBytes += static_cast<uint32_t>(size);
+  if (freeHeap < _activeFreeHeapMin) {
+    _activeFreeHeapMin = freeHeap;
+  }
+}
+
+void ThermiteAllocProfiler::install() {
+  _installed = this;
+}
+
+void ThermiteAllocProfiler::uninstall() {
+  if (_installed == this) {
+    _installed = nullptr;
+  }
+}
+
+void ThermiteAllocProfiler::noteAllocation(size_t size) {
+  if (_installed != nullptr) {
+    _installed->_onAllocation(size);
+  }
+}
+
+bool ThermiteAllocProfiler::begin(const char* name) {
+  if (_active != nullptr) {
+    return false;
+  }
+  _active = _find(name);
+  if (_active == nullptr) {
+    return false;
+  }
+  _activeAllocations = 0ul;
+  _activeBytes = 0ul;
+  _activeFreeHeap = _system.getFreeHeap();
+  _activeFreeHeapMin = _activeFreeHeap;
+  _activeMaxFreeBlock = _system.getMaxFreeBlock();
+  return true;
+}
+
+void ThermiteAllocProfiler::end() {
+  if (_active == nullptr) {
+    return;
+  }
+  ThermiteAllocProfile* profile = _active;
+  _active = nullptr;
+
+  profile->calls++;
+  profile->allocations += _activeAllocations;
+  profile->bytes += _activeBytes;
+  uint32_t peak = _activeFreeHeap - _activeFreeHeapMin;
+  if (peak > profile->peak) {
+    profile->peak = peak;
+  }
+  int32_t maxFreeBlockDelta = static_cast<int32_t>(_system.getMaxFreeBlock())
+    - static_cast<int32_t>(_activeMaxFreeBlock);
+  if (maxFreeBlockDelta < profile->maxFreeBlockDelta) {
+    profile->maxFreeBlockDelta = maxFreeBlockDelta;
+  }
+}
+
+const ThermiteAllocProfile* ThermiteAllocProfiler::getProfile(const char* name) const {
+  for (uint8_t i = 0; i < _count; i++) {
+    if (strcmp(_profiles[i].name, name) == 0) {
+      return &_profiles[i];
+    }
+  }
+  return nullptr;
+}
+
+ThermiteAllocScope::ThermiteAllocScope(ThermiteAllocProfiler* profiler, const char* name)
+: _profiler(nullptr) {
+  if (profiler != nullptr && profiler->begin(name)) {
+    _profiler = profiler;
+  }
+}
+
+ThermiteAllocScope::~ThermiteAllocScope() {
+  if (_profiler != nullptr) {
+    _profiler->end();
+  }
+}
+
+ThermiteAllocProfileBody::ThermiteAllocProfileBody(const ThermiteAllocProfiler& profiler)
+: _profiler(profiler),
+  _stage(ALLOC_PROFILE_BODY_HEADER),
+  _index(0) {}
+
+size_t ThermiteAllocProfileBody::_nextLine(char* line, size_t size) {
+  switch (_stage) {
+    case ALLOC_PROFILE_BODY_HEADER: {
+      _stage = ALLOC_PROFILE_BODY_COLUMNS;
+      const ThermiteSystem& system = _profiler.getSystem();
+      uint32_t freeHeapMin = _profiler.getFreeHeapMin();
+      return snprintf(
+        line,
+        size,
+        "{\"freeHeap\":%lu,\"freeHeapMin\":%lu,\"maxFreeBlock\":%lu,\"allocations\":%lu,",
+        (unsigned long) system.getFreeHeap(),
+        (unsigned long) (freeHeapMin == 0xfffffffful ? system.getFreeHeap() : freeHeapMin),
+        (unsigned long) system.getMaxFreeBlock(),
+        (unsigned long) _profiler.getAllocations()
+      );
+    }
+    case ALLOC_PROFILE_BODY_COLUMNS:
+      _stage = ALLOC_PROFILE_BODY_ROWS;
+      return snprintf(
+        line,
+        size,
+        "\"columns\":[\"name\",\"calls\",\"allocations\",\"bytes\",\"peak\",\"maxFreeBlockDelta\"],"
+        "\"rows\":["
+      );
+    case ALLOC_PROFILE_BODY_ROWS:
+      if (_index < _profiler.getCount()) {
+        break;
+      }
+      _stage = ALLOC_PROFILE_BODY_DONE;
+      return snprintf(line, size, "]}");
+    default:
+      return 0;
+  }
+
+  const ThermiteAllocProfile& profile = _profiler.getProfile(_index);
+  size_t len = snprintf(
+    line,
+    size,
+    "%s[\"%s\",%lu,%lu,%lu,%lu,%ld]",
+    _index == 0 ? "" : ",",
+    profile.name,
+    (unsigned long) profile.calls,
+    (unsigned long) profile.allocations,
+    (unsigned long) profile.bytes,
+    (unsigned long) profile.peak,
+    (long) profile.maxFreeBlockDelta
+  );
+  _index++;
+  return len;
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+#ifndef _THERMITE_ALLOC_PROFILER_H__
+#define _THERMITE_ALLOC_PROFILER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Constants.h"
+#include "ThermiteChunkedBody.h"
+#include "ThermiteHal.h"
+
+/**
+ * Heap use of one route or loop phase, over every time it ran.
+ */
+struct ThermiteAllocProfile {
+  const char* name;
+  uint32_t calls;
+  uint32_t allocations;
+
+  /**
+   * Bytes requested, over all allocations.
+   */
+  uint32_t bytes;
+
+  /**
+   * Most bytes in flight at once during any one call: free heap at the start of the call,
+   * less the lowest free heap seen during it.
+   */
+  uint32_t peak;
+
+  /**
+   * Largest drop of `ThermiteSystem::getMaxFreeBlock()` across any one call (negative), or
+   * zero if it never dropped.  A persistent drop with no matching drop in free heap is
+   * fragmentation.
+   */
+  int32_t maxFreeBlockDelta;
+};
+
+/**
+ * Opt-in heap profiler: records allocations against whichever named scope is running, and
+ * aggregates them per name.  `ThermiteWebController` opens a scope around each route, and
+ * `loop()` around each of its phases.
+ *
+ * Allocations are reported by hooks around the allocator, which call `noteAllocation()`:
+ * `src/device/ThermiteAllocHooks.cpp` wraps the ESP8266's `malloc()` at link time, and
+ * `src/native/ThermiteHostHeap.cpp` replaces glibc's on the host.  Frees are not hooked;
+ * bytes in flight come from the free heap instead, sampled after each allocation.
+ *
+ * Only one profiler is installed at a time, and scopes do not nest: a scope opened while
+ * another runs is folded into that one.
+ */
+class ThermiteAllocProfiler {
+private:
+  static ThermiteAllocProfiler* _installed;
+
+  const ThermiteSystem& _system;
+  ThermiteAllocProfile _profiles[ALLOC_PROFILE_SIZE];
+  uint8_t _count;
+
+  /**
+   * Profile of the running scope, if any, and what it has done so far.
+   */
+  ThermiteAllocProfile* _active;
+  uint32_t _activeAllocations;
+  uint32_t _activeBytes;
+  uint32_t _activeFreeHeap;
+  uint32_t _activeFreeHeapMin;
+  uint32_t _activeMaxFreeBlock;
+
+  /**
+   * Allocations anywhere, in or out of a scope, and the lowest free heap ever seen: the heap
+   * high-water mark.
+   */
+  uint32_t _allocations;
+  uint32_t _freeHeapMin;
+
+  ThermiteAllocProfile* _find(const char* name);
+  void _onAllocation(size_t size);
+public:
+  ThermiteAllocProfiler(const ThermiteSystem& system);
+  ~ThermiteAllocProfiler();
+
+  /**
+   * Makes this the profiler that `noteAllocation()` reports to, or stops it being so.
+   */
+  void install();
+  void uninstall();
+
+  /**
+   * Called by the allocator hooks after every successful allocation of `size` bytes.  Does
+   * nothing unless a profiler is installed.
+   */
+  static void noteAllocation(size_t size);
+
+  /**
+   * Opens a scope recorded under `name`, which must outlive the profiler (e.g. a string
+   * literal).  Returns `false`, and records nothing, if a scope is already open or there are
+   * already `ALLOC_PROFILE_SIZE` names.
+   */
+  bool begin(const char* name);
+  void end();
+
+  uint32_t getAllocations() const { return _allocations; }
+  uint8_t getCount() const { return _count; }
+  uint32_t getFreeHeapMin() const { return _freeHeapMin; }
+
+  /**
+   * Returns the profile recorded under `name`, or `nullptr` if there is none.
+   */
+  const ThermiteAllocProfile* getProfile(const char* name) const;
+  const ThermiteAllocProfile& getProfile(uint8_t i) const { return _profiles[i]; }
+  const ThermiteSystem& getSystem() const { return _system; }
+};
+
+/**
+ * Scope of a `ThermiteAllocProfiler`, closed when this goes out of scope.  Does nothing if
+ * `profiler` is null.
+ */
+class ThermiteAllocScope {
+private:
+  ThermiteAllocProfiler* _profiler;
+public:
+  ThermiteAllocScope(ThermiteAllocProfiler* profiler, const char* name);
+  ~ThermiteAllocScope();
+};
+
+/**
+ * Opens a `ThermiteAllocScope` until the end of the enclosing block, in builds with
+ * `ALLOC_PROFILER`; otherwise compiles to nothing, so that scope names take no RAM.
+ */
+#if ALLOC_PROFILER
+#define ALLOC_SCOPE(profiler, name) ThermiteAllocScope allocScope((profiler), (name))
+#else
+#define ALLOC_SCOPE(profiler, name)
+#endif
+
+#define ALLOC_PROFILE_BODY_HEADER 0
+#define ALLOC_PROFILE_BODY_COLUMNS 1
+#define ALLOC_PROFILE_BODY_ROWS 2
+#define ALLOC_PROFILE_BODY_DONE 3
+
+/**
+ * `GET /debug/alloc`: the heap now, its high-water mark, and every profile as a row.
+ */
+class ThermiteAllocProfileBody : public ThermiteChunkedBody {
+private:
+  const ThermiteAllocProfiler& _profiler;
+  uint8_t _stage;
+  uint8_t _index;
+protected:
+  size_t _nextLine(char* line, size_t size);
+public:
+  ThermiteAllocProfileBody(const ThermiteAllocProfiler& profiler);
+};
+
+#endif
\ No newline at end of file
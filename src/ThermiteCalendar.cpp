@@ -0,0 +1,254 @@
+#include <math.h>
+#include <string.h>
+
+#include "ThermiteCalendar.h"
+#include "ThermiteCrc.h"
+
+#define CALENDAR_LENGTH_MAX 0xffff
+#define CALENDAR_DAILY_SCHEDULE_MAX 3
+
+static_assert(sizeof(ThermiteCalendarException) == 8, "ThermiteCalendarException is not packed");
+static_assert(
+  EEPROM_OFFSET_CALENDAR + ZONE_COUNT_MAX * sizeof(ThermiteCalendarRecord)
+    <= EEPROM_OFFSET_THERMAL_MODEL,
+  "calendars overlap thermal models in EEPROM"
+);
+
+/**
+ * Parses one exception from `root` into `exception`.  Returns `false` if it is not valid.
+ */
+static bool parseCalendarException(
+  const JsonObject& root,
+  ThermiteCalendarException& exception
+) {
+  if (!root["start"].is<time_t>() || !root["end"].is<time_t>()) {
+    return false;
+  }
+  time_t start = root["start"].as<time_t>();
+  time_t end = root["end"].as<time_t>();
+  if (start < 0l || start % SCHEDULE_INTERVAL != 0 || end % SCHEDULE_INTERVAL != 0) {
+    return false;
+  }
+  if (end <= start || (end - start) / SCHEDULE_INTERVAL > CALENDAR_LENGTH_MAX) {
+    return false;
+  }
+  exception.start = static_cast<uint32_t>(start / SCHEDULE_INTERVAL);
+  exception.length = static_cast<uint16_t>((end - start) / SCHEDULE_INTERVAL);
+
+  bool hasTempTarget = root.containsKey("tempTarget");
+  bool hasDailySchedule = root.containsKey("dailySchedule");
+  if (hasTempTarget == hasDailySchedule) {
+    return false;
+  }
+  if (hasTempTarget) {
+    if (!root["tempTarget"].is<float>()) {
+      return false;
+    }
+    float tempTarget = root["tempTarget"].as<float>();
+    if (tempTarget < SET_POINT_MIN || SET_POINT_MAX < tempTarget) {
+      return false;
+    }
+    // stored in quarter degrees: refuse anything in between rather than round it
+    float quarters = tempTarget * 4.0f;
+    if (quarters != roundf(quarters)) {
+      return false;
+    }
+    exception.kind = CALENDAR_EXCEPTION_TEMPERATURE;
+    exception.value = static_cast<uint8_t>(quarters);
+  } else {
+    if (!root["dailySchedule"].is<uint8_t>()) {
+      return false;
+    }
+    uint8_t dailySchedule = root["dailySchedule"].as<uint8_t>();
+    if (dailySchedule > CALENDAR_DAILY_SCHEDULE_MAX) {
+      return false;
+    }
+    exception.kind = CALENDAR_EXCEPTION_SCHEDULE;
+    exception.value = dailySchedule;
+  }
+  return true;
+}
+
+/**
+ * Parses the `"calendar"` array of `root` into `exceptions`, sorted by start.  Returns the
+ * number of exceptions, or -1 if any is not valid or any two overlap.
+ */
+static int parseCalendar(const JsonObject& root, ThermiteCalendarException* exceptions) {
+  if (!root["calendar"].is<JsonArray>()) {
+    return -1;
+  }
+  JsonArray calendar = root["calendar"].as<JsonArray>();
+  if (calendar.size() > CALENDAR_SIZE) {
+    return -1;
+  }
+  int count = 0;
+  for (const JsonVariant& exceptionJson : calendar) {
+    if (!exceptionJson.is<JsonObject>()) {
+      return -1;
+    }
+    ThermiteCalendarException exception;
+    if (!parseCalendarException(exceptionJson.as<JsonObject>(), exception)) {
+      return -1;
+    }
+
+    // insertion sort: there are only `CALENDAR_SIZE` of these, and uploads are usually sorted
+    int i = count;
+    while (i > 0 && exceptions[i - 1].start > exception.start) {
+      exceptions[i] = exceptions[i - 1];
+      i--;
+    }
+    exceptions[i] = exception;
+    count++;
+  }
+  for (int i = 1; i < count; i++) {
+    if (exceptions[i].start < exceptions[i - 1].getEnd()) {
+      return -1;
+    }
+  }
+  return count;
+}
+
+ThermiteCalendar::ThermiteCalendar()
+: _count(0),
+  _version(0ul) {
+  memset(_exceptions, 0, sizeof(_exceptions));
+}
+
+const ThermiteCalendarException* ThermiteCalendar::find(
+  time_t t,
+  ThermiteCalendarCursor& cursor
+) const {
+  uint8_t i = seek(t, cursor);
+  if (i == _count) {
+    return nullptr;
+  }
+  uint32_t interval = static_cast<uint32_t>(t) / SCHEDULE_INTERVAL;
+  if (interval < _exceptions[i].start) {
+    return nullptr;
+  }
+  return &_exceptions[i];
+}
+
+uint8_t ThermiteCalendar::seek(time_t t, ThermiteCalendarCursor& cursor) const {
+  uint32_t interval = static_cast<uint32_t>(t) / SCHEDULE_INTERVAL;
+  uint8_t lo = 0;
+  uint8_t hi = _count;
+  uint8_t i = cursor._index;
+  if (cursor._version == _version && i <= _count) {
+    if (i > 0 && interval < _exceptions[i - 1].getEnd()) {
+      // time went backwards: search everything before the cursor
+      hi = i - 1;
+    } else if (i == _count || interval < _exceptions[i].getEnd()) {
+      return i;
+    } else if (i + 1 == _count || interval < _exceptions[i + 1].getEnd()) {
+      // time moved on by one exception, as it does in normal running
+      cursor._index = i + 1;
+      return i + 1;
+    } else {
+      lo = i + 2;
+    }
+  }
+
+  // binary search for the first exception that ends after `interval`
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) / 2;
+    if (_exceptions[mid].getEnd() <= interval) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  cursor._version = _version;
+  cursor._index = lo;
+  return lo;
+}
+
+uint32_t ThermiteCalendar::getFingerprint(uint32_t crc) const {
+  crc = thermiteCrc32(&_count, sizeof(_count), crc);
+  return thermiteCrc32(_exceptions, _count * sizeof(ThermiteCalendarException), crc);
+}
+
+void ThermiteCalendar::save(ThermiteCalendarRecord& record) const {
+  memset(&record, 0, sizeof(record));
+  record.version = CALENDAR_RECORD_VERSION;
+  record.count = _count;
+  memcpy(record.exceptions, _exceptions, _count * sizeof(ThermiteCalendarException));
+  record.crc = thermiteCrc32(
+    reinterpret_cast<const uint8_t*>(&record) + sizeof(record.crc),
+    sizeof(record) - sizeof(record.crc)
+  );
+}
+
+bool ThermiteCalendar::restore(const ThermiteCalendarRecord& record) {
+  uint32_t crc = thermiteCrc32(
+    reinterpret_cast<const uint8_t*>(&record) + sizeof(record.crc),
+    sizeof(record) - sizeof(record.crc)
+  );
+  if (crc != record.crc || record.version != CALENDAR_RECORD_VERSION) {
+    return false;
+  }
+  if (record.count > CALENDAR_SIZE) {
+    return false;
+  }
+  memset(_exceptions, 0, sizeof(_exceptions));
+  memcpy(_exceptions, record.exceptions, record.count * sizeof(ThermiteCalendarException));
+  _count = record.count;
+  _version++;
+  return true;
+}
+
+bool ThermiteCalendar::toJSON(const JsonObject& root) const {
+  const JsonArray& jsonCalendar = root.createNestedArray("calendar");
+  if (jsonCalendar.isNull()) {
+    return false;
+  }
+  for (uint8_t i = 0; i < _count; i++) {
+    const ThermiteCalendarException& exception = _exceptions[i];
+    const JsonObject& jsonException = jsonCalendar.createNestedObject();
+    if (jsonException.isNull()) {
+      return false;
+    }
+    if (!jsonException["start"].set(static_cast<time_t>(exception.start * SCHEDULE_INTERVAL))) {
+      return false;
+    }
+    if (!jsonException["end"].set(static_cast<time_t>(exception.getEnd() * SCHEDULE_INTERVAL))) {
+      return false;
+    }
+    if (exception.kind == CALENDAR_EXCEPTION_TEMPERATURE) {
+      if (!jsonException["tempTarget"].set(exception.value / 4.0f)) {
+        return false;
+      }
+    } else {
+      if (!jsonException["dailySchedule"].set(exception.value)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool ThermiteCalendar::validateJSON(const JsonObject& root) const {
+  if (!root.containsKey("calendar")) {
+    return true;
+  }
+  ThermiteCalendarException exceptions[CALENDAR_SIZE];
+  return parseCalendar(root, exceptions) >= 0;
+}
+
+void ThermiteCalendar::updateFromJSON(const JsonObject& root) {
+  if (!root.containsKey("calendar")) {
+    return;
+  }
+  ThermiteCalendarException exceptions[CALENDAR_SIZE];
+  memset(exceptions, 0, sizeof(exceptions));
+  int count = parseCalendar(root, exceptions);
+  if (count < 0) {
+    return;
+  }
+  if (count == _count && memcmp(exceptions, _exceptions, sizeof(exceptions)) == 0) {
+    return;
+  }
+  memcpy(_exceptions, exceptions, sizeof(exceptions));
+  _count = static_cast<uint8_t>(count);
+  _version++;
+}
\ No newline at end of file
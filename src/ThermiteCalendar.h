@@ -0,0 +1,130 @@
+#ifndef _THERMITE_CALENDAR_H__
+#define _THERMITE_CALENDAR_H__
+
+#include <ArduinoJson.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "Constants.h"
+#include "JsonIO.h"
+
+#define CALENDAR_EXCEPTION_TEMPERATURE 0
+#define CALENDAR_EXCEPTION_SCHEDULE 1
+
+/**
+ * Bump this whenever `ThermiteCalendarRecord` changes layout, so that a record written by
+ * older firmware is ignored rather than misread.
+ */
+#define CALENDAR_RECORD_VERSION 1
+
+/**
+ * Single dated exception to the weekly schedule, such as a holiday, a vacation or a one-off
+ * event.  This is also the persisted form, at 8 bytes each.
+ */
+struct ThermiteCalendarException {
+  /**
+   * Start, in local time, counted in `SCHEDULE_INTERVAL`s since the epoch.
+   */
+  uint32_t start;
+
+  /**
+   * Length, in `SCHEDULE_INTERVAL`s.  Never zero.
+   */
+  uint16_t length;
+
+  /**
+   * One of the `CALENDAR_EXCEPTION_*` constants.
+   */
+  uint8_t kind;
+
+  /**
+   * For `CALENDAR_EXCEPTION_TEMPERATURE`, the target temperature in quarter degrees Celsius;
+   * for `CALENDAR_EXCEPTION_SCHEDULE`, the daily schedule to follow instead of the weekly one.
+   */
+  uint8_t value;
+
+  uint32_t getEnd() const { return start + length; }
+};
+
+/**
+ * `ThermiteCalendar`, as kept in flash (see `ThermiteEeprom`).
+ */
+struct ThermiteCalendarRecord {
+  /**
+   * CRC-32 of everything after this field.
+   */
+  uint32_t crc;
+  uint32_t version;
+  uint8_t count;
+  uint8_t reserved[3];
+  ThermiteCalendarException exceptions[CALENDAR_SIZE];
+};
+
+/**
+ * Where a reader of a `ThermiteCalendar` last found itself, so that it can pick up from
+ * there next time.  Each reader keeps its own.
+ */
+struct ThermiteCalendarCursor {
+  /**
+   * `ThermiteCalendar::_version` that `_index` belongs to.
+   */
+  uint32_t _version;
+  uint8_t _index;
+
+  ThermiteCalendarCursor() : _version(0ul), _index(0) {}
+};
+
+/**
+ * Up to `CALENDAR_SIZE` dated exceptions, replaced in bulk as the `"calendar"` array of a
+ * user settings update.
+ *
+ * Exceptions are kept sorted by start, and may not overlap, so their ends are sorted too.
+ * `seek()` steps a cursor forward as time advances, which takes O(1) amortized, and only
+ * falls back to binary search when time jumps.
+ *
+ * Exceptions start and end on `SCHEDULE_INTERVAL` boundaries, so they never change the
+ * target temperature between the schedule boundaries that `getNextScheduleBoundary()`
+ * already reports.
+ */
+struct ThermiteCalendar
+: public JsonRead<ThermiteCalendar>,
+  public JsonWrite<ThermiteCalendar> {
+  ThermiteCalendarException _exceptions[CALENDAR_SIZE];
+  uint8_t _count;
+
+  /**
+   * Bumped whenever the exceptions change, so that cursors can tell when they are stale.
+   */
+  uint32_t _version;
+
+  ThermiteCalendar();
+
+  /**
+   * Returns the exception in effect at local time `t`, or `nullptr` if there is none.
+   */
+  const ThermiteCalendarException* find(time_t t, ThermiteCalendarCursor& cursor) const;
+
+  /**
+   * Returns the index of the first exception that ends after local time `t`, or `_count` if
+   * there is none, and leaves `cursor` there.
+   */
+  uint8_t seek(time_t t, ThermiteCalendarCursor& cursor) const;
+
+  /**
+   * Returns a CRC-32 over every exception, continuing from `crc`.
+   */
+  uint32_t getFingerprint(uint32_t crc) const;
+
+  /**
+   * Fills `record` from the calendar, or the calendar from `record`.  `restore()` returns
+   * `false` (and changes nothing) if `record` is not valid.
+   */
+  void save(ThermiteCalendarRecord& record) const;
+  bool restore(const ThermiteCalendarRecord& record);
+
+  bool toJSON(const JsonObject& root) const;
+  bool validateJSON(const JsonObject& root) const;
+  void updateFromJSON(const JsonObject& root);
+};
+
+#endif
\ No newline at end of file
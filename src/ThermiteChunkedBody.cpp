@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ThermiteChunkedBody.h"
+
+alignas(max_align_t) static uint8_t bodySlots[CHUNKED_BODY_SLOTS][CHUNKED_BODY_SLOT_SIZE];
+static bool bodySlotsInUse[CHUNKED_BODY_SLOTS];
+
+ThermiteChunkedBody::ThermiteChunkedBody()
+: _lineLen(0),
+  _lineOffset(0),
+  _done(false) {}
+
+void* ThermiteChunkedBody::operator new(size_t size) noexcept {
+  if (size > CHUNKED_BODY_SLOT_SIZE) {
+    return nullptr;
+  }
+  for (uint8_t i = 0; i < CHUNKED_BODY_SLOTS; i++) {
+    if (!bodySlotsInUse[i]) {
+      bodySlotsInUse[i] = true;
+      return bodySlots[i];
+    }
+  }
+  return nullptr;
+}
+
+void ThermiteChunkedBody::operator delete(void* p) {
+  if (p == nullptr) {
+    return;
+  }
+  uint8_t i = (static_cast<uint8_t*>(p) - bodySlots[0]) / CHUNKED_BODY_SLOT_SIZE;
+  bodySlotsInUse[i] = false;
+}
+
+int ThermiteChunkedBody::_printCenti(char* s, size_t size, int32_t centi) {
+  const char* sign = "";
+  if (centi < 0) {
+    sign = "-";
+    centi = -centi;
+  }
+  return snprintf(s, size, "%s%ld.%02ld", sign, (long) (centi / 100), (long) (centi % 100));
+}
+
+size_t ThermiteChunkedBody::fill(uint8_t* buffer, size_t maxLen) {
+  size_t len = 0;
+  while (len < maxLen && !_done) {
+    if (_lineOffset == _lineLen) {
+      _lineLen = _nextLine(_line, CHUNKED_BODY_LINE_LEN);
+      _lineOffset = 0;
+      if (_lineLen == 0) {
+        _done = true;
+        break;
+      }
+    }
+    size_t n = _lineLen - _lineOffset;
+    if (n > maxLen - len) {
+      n = maxLen - len;
+    }
+    memcpy(buffer + len, _line + _lineOffset, n);
+    _lineOffset += n;
+    len += n;
+  }
+  return len;
+}
\ No newline at end of file
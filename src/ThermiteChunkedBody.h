@@ -0,0 +1,60 @@
+#ifndef _THERMITE_CHUNKED_BODY_H__
+#define _THERMITE_CHUNKED_BODY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHUNKED_BODY_LINE_LEN 128
+
+/**
+ * Bodies come from `CHUNKED_BODY_SLOTS` slots of `CHUNKED_BODY_SLOT_SIZE` bytes reserved at
+ * boot, rather than from the heap.  The largest body, `ThermiteHistoryBody`, holds three
+ * history blocks.
+ */
+#define CHUNKED_BODY_SLOTS 2
+#define CHUNKED_BODY_SLOT_SIZE 1280
+
+/**
+ * Response body generated piece by piece as the transport asks for it, for responses that
+ * are too large to build in RAM as a `JsonDocument`.
+ * 
+ * Subclasses produce the body one short "line" at a time in `_nextLine()`; `fill()` takes
+ * care of splitting lines across however many bytes the transport wants at once.  Only one
+ * line is ever held in memory.
+ * 
+ * `new` hands out one of the `CHUNKED_BODY_SLOTS` slots, and returns `nullptr` once they are
+ * all taken; transports `delete` the body once it has been sent.
+ */
+class ThermiteChunkedBody {
+private:
+  char _line[CHUNKED_BODY_LINE_LEN];
+  size_t _lineLen;
+  size_t _lineOffset;
+  bool _done;
+protected:
+  /**
+   * Writes `centi` (hundredths) as a decimal number, without going through `float`
+   * formatting, and returns its length.
+   */
+  static int _printCenti(char* s, size_t size, int32_t centi);
+
+  /**
+   * Writes the next piece of the body into `line` (at most `size - 1` characters, plus a
+   * null terminator), and returns its length.  Returns zero once the body is complete.
+   */
+  virtual size_t _nextLine(char* line, size_t size) = 0;
+public:
+  ThermiteChunkedBody();
+  virtual ~ThermiteChunkedBody() {}
+
+  static void* operator new(size_t size) noexcept;
+  static void operator delete(void* p);
+
+  /**
+   * Copies up to `maxLen` bytes of the body into `buffer`, and returns the number of bytes
+   * copied.  Returns zero once the body is complete.
+   */
+  size_t fill(uint8_t* buffer, size_t maxLen);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef _THERMITE_CRC_H__
+#define _THERMITE_CRC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * CRC-32 (IEEE 802.3, as used by zlib), computed bitwise to avoid a 1 KB lookup table.  This
+ * is only used on small records, such as those kept in RTC memory across resets.  As with
+ * zlib's `crc32()`, pass the CRC of earlier data as `crc` to continue it over `data`.
+ */
+inline uint32_t thermiteCrc32(const void* data, size_t size, uint32_t crc = 0ul) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= bytes[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xedb88320ul & (0ul - (crc & 1ul)));
+    }
+  }
+  return ~crc;
+}
+
+#endif
\ No newline at end of file
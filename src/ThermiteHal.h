@@ -0,0 +1,288 @@
+#ifndef _THERMITE_HAL_H__
+#define _THERMITE_HAL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "ThermiteChunkedBody.h"
+#include "ThermiteResponsePool.h"
+
+/**
+ * Narrow interfaces to everything `thermite` needs from the outside world.
+ *
+ * The controller logic (`ThermiteInternalState`, `ThermiteUserSettingsManager`,
+ * `ThermiteWebController`) only talks to hardware through these, so that it can be built
+ * both for the ESP8266 (see `src/device/`) and for the host (see `src/native/`).
+ */
+
+/**
+ * Single temperature sensor, read asynchronously: `requestTemperature()` starts a conversion,
+ * and `getTemperature()` reads its result once `TEMP_REQUEST_DELAY` ms have passed.
+ */
+struct ThermiteThermometer {
+  virtual bool init() = 0;
+  virtual void requestTemperature() = 0;
+
+  /**
+   * Returns the last converted temperature in degrees Celsius, or `TEMP_DISCONNECTED` if
+   * no valid reading is available.
+   */
+  virtual float getTemperature() = 0;
+};
+
+/**
+ * Wall clock and timezone.
+ */
+struct ThermiteClock {
+  /**
+   * Monotonic milliseconds since boot.  Like Arduino `millis()`, this wraps around.
+   */
+  virtual unsigned long getMillis() const = 0;
+
+  /**
+   * Gives the clock a chance to resynchronize (e.g. via NTP).  Called once per loop.
+   */
+  virtual void update() = 0;
+
+  /**
+   * Current UTC time, in seconds since the Unix epoch.
+   */
+  virtual time_t getEpochTime() const = 0;
+
+  /**
+   * Sets the current UTC time, e.g. from a checkpoint, until the clock can resynchronize.
+   */
+  virtual void setEpochTime(time_t tUtc) = 0;
+
+  /**
+   * Converts UTC time `tUtc` to local time.  If `offset` is non-null, it receives the UTC
+   * offset in effect at `tUtc`, in minutes.
+   */
+  virtual time_t toLocal(time_t tUtc, int* offset) const = 0;
+
+  /**
+   * Returns how long, in ms after `now`, until `update()` next has work to do.
+   */
+  virtual unsigned long getUpdateDelay(unsigned long now) const = 0;
+};
+
+/**
+ * On / off relay driving the heater.
+ */
+struct ThermiteRelay {
+  virtual bool begin() = 0;
+  virtual void set(bool on) = 0;
+};
+
+/**
+ * WiFi radio power management.
+ */
+struct ThermiteRadio {
+  /**
+   * Sets how the radio may sleep while the CPU is idle: one of the `POWER_MODE_*` constants.
+   * In either sleep mode the station stays associated, and wakes for every `listenInterval`-th
+   * DTIM beacon to receive buffered traffic such as incoming TCP connections.
+   */
+  virtual void setSleepMode(uint8_t mode, uint8_t listenInterval) = 0;
+};
+
+/**
+ * Small memory area that survives resets, such as the ESP8266's RTC user memory.
+ */
+struct ThermiteRtcMemory {
+  /**
+   * Copies `size` bytes at `offset` into / from `data`.  `offset` and `size` must be multiples
+   * of 4.  Returns `false` if the range is out of bounds.
+   */
+  virtual bool read(uint32_t offset, void* data, size_t size) = 0;
+  virtual bool write(uint32_t offset, const void* data, size_t size) = 0;
+
+  /**
+   * Ticks of a timer that, unlike `millis()`, keeps counting across resets (but not power
+   * loss).  It wraps around, after some 8 hours on the ESP8266.
+   */
+  virtual uint32_t getTicks() = 0;
+
+  /**
+   * Converts a number of `getTicks()` ticks to ms.
+   */
+  virtual unsigned long ticksToMillis(uint32_t ticks) = 0;
+};
+
+/**
+ * Small memory area that survives power loss, such as the ESP8266's emulated EEPROM: a RAM
+ * copy of one flash sector.  `write()` only changes the RAM copy; `commit()` erases and
+ * rewrites the sector, which wears the flash and stalls the CPU for tens of ms, so callers
+ * should only commit what changed, and only from the main loop.
+ */
+struct ThermiteEeprom {
+  /**
+   * Copies `size` bytes at `offset` into / from `data`.  Returns `false` if the range is out
+   * of bounds.
+   */
+  virtual bool read(uint32_t offset, void* data, size_t size) = 0;
+  virtual bool write(uint32_t offset, const void* data, size_t size) = 0;
+  virtual bool commit() = 0;
+};
+
+/**
+ * Flash file system, such as LittleFS on the ESP8266.  Files are only ever appended to or
+ * removed, never rewritten in place.  Each call opens and closes the file, so nothing is held
+ * open between calls.  Paths are absolute, e.g. `"/h0-00000001"`.
+ */
+struct ThermiteFileSystem {
+  /**
+   * Returns the size of file `path` in bytes, or -1 if there is no such file.
+   */
+  virtual long getSize(const char* path) = 0;
+
+  /**
+   * Copies up to `size` bytes at `offset` in file `path` into `data`, and returns how many
+   * were copied, or -1 if there is no such file.
+   */
+  virtual long read(const char* path, uint32_t offset, void* data, size_t size) = 0;
+
+  /**
+   * Appends `size` bytes to file `path`, creating it if needed.  Returns `false` if not all
+   * of them were written, e.g. because the file system is full.
+   */
+  virtual bool append(const char* path, const void* data, size_t size) = 0;
+  virtual bool remove(const char* path) = 0;
+
+  /**
+   * Calls `visit` with the name (without the directory) of each file in directory `dir`.
+   */
+  virtual void list(
+    const char* dir,
+    void (*visit)(void* context, const char* name),
+    void* context
+  ) = 0;
+};
+
+/**
+ * What it takes to rejoin the last access point without scanning, and optionally without
+ * DHCP.  Addresses are IPv4 in network byte order; `ip == 0` means "use DHCP".
+ */
+struct ThermiteWifiCache {
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t reserved;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+};
+
+/**
+ * WiFi station interface.  Nothing here blocks: `begin()` starts connecting, and
+ * `getState()` reports progress.
+ */
+struct ThermiteWifi {
+  /**
+   * Starts connecting to the configured network.  If `cache` is non-null, connects straight
+   * to its BSSID and channel rather than scanning.
+   */
+  virtual void begin(const ThermiteWifiCache* cache) = 0;
+
+  /**
+   * Returns one of the `WIFI_STATE_*` constants.
+   */
+  virtual uint8_t getState() const = 0;
+
+  /**
+   * Fills `cache` from the current connection.  Only valid while connected.
+   */
+  virtual void getCache(ThermiteWifiCache& cache) const = 0;
+
+  /**
+   * Returns the signal strength of the current connection, in dBm.  Only valid while
+   * connected.
+   */
+  virtual int8_t getRssi() const = 0;
+
+  virtual void disconnect() = 0;
+};
+
+/**
+ * Connectionless datagram socket with a fixed destination, such as a UDP collector or
+ * multicast group.  Delivery is never confirmed.
+ */
+struct ThermiteDatagramSocket {
+  /**
+   * Sends `size` bytes as one datagram.  Returns `false` if it could not even be queued,
+   * e.g. for lack of buffers.
+   */
+  virtual bool send(const void* data, size_t size) = 0;
+};
+
+/**
+ * Facts about the device itself, as reported in telemetry and by `ThermiteAllocProfiler`.
+ */
+struct ThermiteSystem {
+  /**
+   * Returns an identifier unique to this device, such as the ESP8266 chip ID.
+   */
+  virtual uint32_t getDeviceId() const = 0;
+
+  /**
+   * Returns the free heap, and the largest block of it that could be allocated at once, in
+   * bytes.  The gap between the two is fragmentation.
+   */
+  virtual uint32_t getFreeHeap() const = 0;
+  virtual uint32_t getMaxFreeBlock() const = 0;
+};
+
+/**
+ * Single HTTP request / response exchange, as seen by `ThermiteWebController`.
+ */
+struct ThermiteHttpRequest {
+  /**
+   * Is this a CORS preflight (`OPTIONS`) request?
+   */
+  virtual bool isPreflight() const = 0;
+
+  /**
+   * Returns the request path, without the query string.
+   */
+  virtual const char* getPath() const = 0;
+
+  /**
+   * Returns the value of query parameter `name`, or `nullptr` if it is not present.
+   */
+  virtual const char* getParam(const char* name) const = 0;
+
+  /**
+   * Sends an empty response with status `code`.
+   */
+  virtual void send(uint16_t code) = 0;
+
+  /**
+   * Sends `body`, serialized JSON, with status `code`.  The transport may hold on to its own
+   * copy of `body` until the response is complete, which keeps the buffer out of the pool
+   * but does not copy its contents.
+   * 
+   * If `head` is non-null, it is sent in place of the opening `{` of `body`, e.g. to add a
+   * field that changes too often to be worth reserializing `body` for.  The transport copies
+   * it: it is at most `RESPONSE_HEAD_LEN - 1` characters.
+   */
+  virtual void sendBuffer(
+    uint16_t code,
+    const ThermiteResponseBuffer& body,
+    const char* head
+  ) = 0;
+
+  /**
+   * Sends `body`, pre-serialized JSON held in flash (`PROGMEM`) on the device, with status
+   * `code`.
+   */
+  virtual void sendJsonConstant(uint16_t code, const char* body) = 0;
+
+  /**
+   * Sends `body` as JSON with status `code`, generating it incrementally.  The transport takes
+   * ownership of `body`, and deletes it once the response is complete.
+   */
+  virtual void sendChunked(uint16_t code, ThermiteChunkedBody* body) = 0;
+};
+
+#endif
\ No newline at end of file
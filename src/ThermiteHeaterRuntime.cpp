@@ -0,0 +1,202 @@
+#include <string.h>
+
+#include "ThermiteHeaterRuntime.h"
+
+/**
+ * Elapsed ms from `then` to `now`, as read from `ThermiteClock::getMillis()`.  Truncating to
+ * 32 bits makes this correct across `millis()` wraparound on every platform.
+ */
+static uint32_t elapsedSince(unsigned long then, unsigned long now) {
+  return static_cast<uint32_t>(now - then);
+}
+
+ThermiteHeaterRuntime::ThermiteHeaterRuntime()
+: _accountedAt(0ul),
+  _accounted(false),
+  _runtimeWeek(0ul),
+  _day(0ul),
+  _dayIndex(0),
+  _runtimeLifetime(0ull),
+  _switchCount(0ul),
+  _switchedAt(0ul),
+  _onAtIndex(0),
+  _onAtCount(0),
+  _journalIndex(0),
+  _journalCount(0) {
+  memset(_runtimeDays, 0, sizeof(_runtimeDays));
+  memset(_onAt, 0, sizeof(_onAt));
+  memset(_journal, 0, sizeof(_journal));
+}
+
+void ThermiteHeaterRuntime::_rollDay(uint32_t day) {
+  if (day <= _day) {
+    /*
+     * The clock went backwards (e.g. on first NTP sync after boot, or a manual correction):
+     * keep counting into the current day.
+     */
+    return;
+  }
+  uint32_t days = day - _day;
+  if (days >= HEATER_RUNTIME_DAYS) {
+    memset(_runtimeDays, 0, sizeof(_runtimeDays));
+    _runtimeWeek = 0ul;
+  } else {
+    for (uint32_t i = 0; i < days; i++) {
+      _dayIndex = (_dayIndex + 1) % HEATER_RUNTIME_DAYS;
+      _runtimeWeek -= _runtimeDays[_dayIndex];
+      _runtimeDays[_dayIndex] = 0ul;
+    }
+  }
+  _day = day;
+}
+
+void ThermiteHeaterRuntime::accumulate(bool heater, unsigned long now, time_t tLocal) {
+  if (heater && _accounted) {
+    uint32_t elapsed = elapsedSince(_accountedAt, now);
+    _runtimeDays[_dayIndex] += elapsed;
+    _runtimeWeek += elapsed;
+    _runtimeLifetime += elapsed;
+  }
+  _accountedAt = now;
+  _accounted = true;
+
+  /*
+   * Runtime up to `now` goes to the day we were in before `now`; this is at most one loop
+   * interval off at midnight.
+   */
+  _rollDay(static_cast<uint32_t>(tLocal) / 86400ul);
+}
+
+unsigned long ThermiteHeaterRuntime::getSwitchDelay(
+  bool on,
+  unsigned long now,
+  const ThermiteHeaterSettings& settings
+) const {
+  unsigned long delay = 0ul;
+  if (_switchCount > 0) {
+    uint32_t minTime = (on ? settings._minOffTime : settings._minOnTime) * 1000ul;
+    uint32_t elapsed = elapsedSince(_switchedAt, now);
+    if (elapsed < minTime) {
+      delay = minTime - elapsed;
+    }
+  }
+  uint8_t maxCycles = settings._maxCyclesPerHour;
+  if (on && maxCycles > 0 && _onAtCount >= maxCycles) {
+    /*
+     * Switching on now would be the `maxCycles + 1`-th time within the hour unless the
+     * `maxCycles`-th most recent switch to on is at least an hour old.
+     */
+    uint8_t i = (_onAtIndex + HEATER_MAX_CYCLES_PER_HOUR - maxCycles) % HEATER_MAX_CYCLES_PER_HOUR;
+    uint32_t elapsed = elapsedSince(_onAt[i], now);
+    if (elapsed < MS_PER_HOUR && MS_PER_HOUR - elapsed > delay) {
+      delay = MS_PER_HOUR - elapsed;
+    }
+  }
+  return delay;
+}
+
+void ThermiteHeaterRuntime::recordSwitch(bool on, unsigned long now, time_t tUtc) {
+  _switchCount++;
+  _switchedAt = now;
+
+  if (on) {
+    _onAt[_onAtIndex] = now;
+    _onAtIndex = (_onAtIndex + 1) % HEATER_MAX_CYCLES_PER_HOUR;
+    if (_onAtCount < HEATER_MAX_CYCLES_PER_HOUR) {
+      _onAtCount++;
+    }
+  }
+
+  ThermiteHeaterEdge& edge = _journal[_journalIndex];
+  edge._t = static_cast<uint32_t>(tUtc);
+  edge._on = on;
+  _journalIndex = (_journalIndex + 1) % HEATER_JOURNAL_SIZE;
+  if (_journalCount < HEATER_JOURNAL_SIZE) {
+    _journalCount++;
+  }
+}
+
+void ThermiteHeaterRuntime::save(
+  ThermiteHeaterRuntimeCheckpoint& checkpoint,
+  unsigned long now
+) const {
+  checkpoint.runtimeLifetime = _runtimeLifetime;
+  memcpy(checkpoint.runtimeDays, _runtimeDays, sizeof(_runtimeDays));
+  checkpoint.runtimeWeek = _runtimeWeek;
+  checkpoint.day = _day;
+  checkpoint.switchCount = _switchCount;
+  checkpoint.sinceSwitch = elapsedSince(_switchedAt, now);
+  for (uint8_t i = 0; i < HEATER_MAX_CYCLES_PER_HOUR; i++) {
+    checkpoint.sinceOn[i] = elapsedSince(_onAt[i], now);
+  }
+  checkpoint.dayIndex = _dayIndex;
+  checkpoint.onAtIndex = _onAtIndex;
+  checkpoint.onAtCount = _onAtCount;
+  checkpoint.reserved = 0;
+}
+
+void ThermiteHeaterRuntime::restore(
+  const ThermiteHeaterRuntimeCheckpoint& checkpoint,
+  unsigned long now
+) {
+  /*
+   * Time between the checkpoint and the reset is lost: we can't tell whether it exceeds
+   * one loop.
+   */
+  _accounted = false;
+  _runtimeLifetime = checkpoint.runtimeLifetime;
+  memcpy(_runtimeDays, checkpoint.runtimeDays, sizeof(_runtimeDays));
+  _runtimeWeek = checkpoint.runtimeWeek;
+  _day = checkpoint.day;
+  _dayIndex = checkpoint.dayIndex % HEATER_RUNTIME_DAYS;
+  _switchCount = checkpoint.switchCount;
+  _switchedAt = now - checkpoint.sinceSwitch;
+  for (uint8_t i = 0; i < HEATER_MAX_CYCLES_PER_HOUR; i++) {
+    _onAt[i] = now - checkpoint.sinceOn[i];
+  }
+  _onAtIndex = checkpoint.onAtIndex % HEATER_MAX_CYCLES_PER_HOUR;
+  _onAtCount = checkpoint.onAtCount;
+  if (_onAtCount > HEATER_MAX_CYCLES_PER_HOUR) {
+    _onAtCount = HEATER_MAX_CYCLES_PER_HOUR;
+  }
+}
+
+void ThermiteHeaterRuntime::restoreLifetime(uint64_t runtimeLifetime) {
+  if (runtimeLifetime > _runtimeLifetime) {
+    _runtimeLifetime = runtimeLifetime;
+  }
+}
+
+bool ThermiteHeaterRuntime::toJSON(const JsonObject& root) const {
+  if (!root["switchCount"].set(_switchCount)) {
+    return false;
+  }
+  if (!root["runtimeToday"].set(getRuntimeToday())) {
+    return false;
+  }
+  if (!root["runtime7Days"].set(getRuntimeWeek())) {
+    return false;
+  }
+  if (!root["runtimeLifetime"].set(getRuntimeLifetime())) {
+    return false;
+  }
+  const JsonArray& jsonJournal = root.createNestedArray("journal");
+  if (jsonJournal.isNull()) {
+    return false;
+  }
+  uint8_t start = (_journalIndex + HEATER_JOURNAL_SIZE - _journalCount) % HEATER_JOURNAL_SIZE;
+  for (uint8_t i = 0; i < _journalCount; i++) {
+    const ThermiteHeaterEdge& edge = _journal[(start + i) % HEATER_JOURNAL_SIZE];
+    const JsonObject& jsonEdge = jsonJournal.createNestedObject();
+    if (jsonEdge.isNull()) {
+      return false;
+    }
+    if (!jsonEdge["t"].set(edge._t)) {
+      return false;
+    }
+    if (!jsonEdge["on"].set(edge._on)) {
+      return false;
+    }
+  }
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#ifndef _THERMITE_HEATER_RUNTIME_H__
+#define _THERMITE_HEATER_RUNTIME_H__
+
+#include <ArduinoJson.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "Constants.h"
+#include "JsonIO.h"
+#include "ThermiteUserSettingsManager.h"
+
+/**
+ * Single heater relay switch, as recorded in `ThermiteHeaterRuntime`.
+ */
+struct ThermiteHeaterEdge {
+  /**
+   * UTC time of the switch, in seconds since the Unix epoch.
+   */
+  uint32_t _t;
+  bool _on;
+};
+
+/**
+ * Everything in `ThermiteHeaterRuntime` that should survive a soft reset.  Times measured
+ * with `getMillis()` are stored relative to the checkpoint, since `millis()` restarts at zero.
+ * The journal is not kept.
+ */
+struct ThermiteHeaterRuntimeCheckpoint {
+  uint64_t runtimeLifetime;
+  uint32_t runtimeDays[HEATER_RUNTIME_DAYS];
+  uint32_t runtimeWeek;
+  uint32_t day;
+  uint32_t switchCount;
+  uint32_t sinceSwitch;
+  uint32_t sinceOn[HEATER_MAX_CYCLES_PER_HOUR];
+  uint8_t dayIndex;
+  uint8_t onAtIndex;
+  uint8_t onAtCount;
+  uint8_t reserved;
+};
+
+/**
+ * Tracks how long and how often the heater runs, and enforces `ThermiteHeaterSettings`.
+ * 
+ * All counters are maintained incrementally in `accumulate()` and `recordSwitch()`, so reading
+ * them never requires scanning history.  Times are measured with `ThermiteClock::getMillis()`
+ * and are safe across `millis()` wraparound.
+ */
+class ThermiteHeaterRuntime : public JsonWrite<ThermiteHeaterRuntime> {
+private:
+  /**
+   * `getMillis()` at the last call to `accumulate()`, if `_accounted`.
+   */
+  unsigned long _accountedAt;
+  bool _accounted;
+
+  /**
+   * Runtime per local day, in ms, as a ring buffer: `_runtimeDays[_dayIndex]` is for local
+   * day `_day` (days since the epoch), the entry before it for the day before, and so on.
+   * `_runtimeWeek` is kept equal to the sum of `_runtimeDays`.
+   */
+  uint32_t _runtimeDays[HEATER_RUNTIME_DAYS];
+  uint32_t _runtimeWeek;
+  uint32_t _day;
+  uint8_t _dayIndex;
+
+  /**
+   * Total runtime, in ms.  Written to flash with the thermal model (see `restoreLifetime()`),
+   * so a power cycle loses only what ran since the last write.
+   */
+  uint64_t _runtimeLifetime;
+
+  /**
+   * Number of times the heater has switched, in either direction.
+   */
+  uint32_t _switchCount;
+
+  /**
+   * `getMillis()` at the last switch, if `_switchCount > 0`.
+   */
+  unsigned long _switchedAt;
+
+  /**
+   * `getMillis()` at the last `HEATER_MAX_CYCLES_PER_HOUR` switches to on, as a ring buffer;
+   * used to enforce `ThermiteHeaterSettings::_maxCyclesPerHour`.
+   */
+  unsigned long _onAt[HEATER_MAX_CYCLES_PER_HOUR];
+  uint8_t _onAtIndex;
+  uint8_t _onAtCount;
+
+  /**
+   * The last `HEATER_JOURNAL_SIZE` switches, as a ring buffer.
+   */
+  ThermiteHeaterEdge _journal[HEATER_JOURNAL_SIZE];
+  uint8_t _journalIndex;
+  uint8_t _journalCount;
+
+  void _rollDay(uint32_t day);
+public:
+  ThermiteHeaterRuntime();
+
+  /**
+   * Adds the time since the last call to the runtime counters if `heater` was on, and rolls
+   * the per-day counters over at local midnight.  Call this before any switch.
+   */
+  void accumulate(bool heater, unsigned long now, time_t tLocal);
+
+  /**
+   * Returns how long, in ms after `now`, until the heater may switch to `on` under `settings`:
+   * zero if it may switch now.
+   */
+  unsigned long getSwitchDelay(bool on, unsigned long now, const ThermiteHeaterSettings& settings) const;
+
+  void recordSwitch(bool on, unsigned long now, time_t tUtc);
+
+  void save(ThermiteHeaterRuntimeCheckpoint& checkpoint, unsigned long now) const;
+  void restore(const ThermiteHeaterRuntimeCheckpoint& checkpoint, unsigned long now);
+
+  /**
+   * Restores the lifetime runtime from flash, unless a checkpoint already restored a later
+   * one.
+   */
+  void restoreLifetime(uint64_t runtimeLifetime);
+
+  uint32_t getRuntimeToday() const { return _runtimeDays[_dayIndex] / 1000ul; }
+  uint32_t getRuntimeWeek() const { return _runtimeWeek / 1000ul; }
+  uint32_t getRuntimeLifetime() const { return static_cast<uint32_t>(_runtimeLifetime / 1000ull); }
+  uint64_t getRuntimeLifetimeMillis() const { return _runtimeLifetime; }
+  uint32_t getSwitchCount() const { return _switchCount; }
+
+  bool toJSON(const JsonObject& root) const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,786 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ThermiteCrc.h"
+#include "ThermiteHistory.h"
+
+static_assert(
+  sizeof(ThermiteHistoryBlock) == HISTORY_BLOCK_SIZE,
+  "ThermiteHistoryBlock is not packed"
+);
+static_assert(
+  sizeof(ThermiteHistoryIndex) < HISTORY_BLOCK_SIZE,
+  "ThermiteHistoryIndex could be mistaken for a block"
+);
+
+#define HISTORY_BLOCK_HEADER_SIZE 8
+
+/**
+ * Record times are stored as `zigzag(dod) << 2`, in a varint of at most 32 bits.  Larger jumps
+ * start a new block instead.
+ */
+#define HISTORY_DOD_ZIGZAG_MAX 0x3ffffffful
+
+static int16_t toCentiClamped(float temp) {
+  float centi = roundf(temp * 100.0f);
+  if (centi > INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (centi < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return static_cast<int16_t>(centi);
+}
+
+static uint32_t zigzag(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+  return static_cast<int32_t>((value >> 1) ^ (0ul - (value & 1ul)));
+}
+
+static uint8_t writeVarint(uint32_t value, uint8_t* data) {
+  uint8_t n = 0;
+  while (value >= 0x80ul) {
+    data[n++] = static_cast<uint8_t>(value | 0x80ul);
+    value >>= 7;
+  }
+  data[n++] = static_cast<uint8_t>(value);
+  return n;
+}
+
+void ThermiteHistoryBlock::seal() {
+  crc = thermiteCrc32(
+    reinterpret_cast<const uint8_t*>(this) + sizeof(crc),
+    sizeof(*this) - sizeof(crc)
+  );
+}
+
+bool ThermiteHistoryBlock::isValid() const {
+  if (version != HISTORY_VERSION || length > sizeof(data)) {
+    return false;
+  }
+  return crc == thermiteCrc32(
+    reinterpret_cast<const uint8_t*>(this) + sizeof(crc),
+    sizeof(*this) - sizeof(crc)
+  );
+}
+
+ThermiteHistoryDecoder::ThermiteHistoryDecoder()
+: _block(nullptr),
+  _i(0),
+  _offset(0),
+  _dt(0l) {
+  memset(&_record, 0, sizeof(_record));
+}
+
+bool ThermiteHistoryDecoder::_readVarint(uint32_t& value) {
+  value = 0ul;
+  for (uint8_t shift = 0; shift < 35 && _offset < _block->length; shift += 7) {
+    uint8_t b = _block->data[_offset++];
+    value |= static_cast<uint32_t>(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThermiteHistoryDecoder::reset(const ThermiteHistoryBlock* block) {
+  _block = block;
+  _i = 0;
+  _offset = 0;
+  _dt = 0l;
+  memset(&_record, 0, sizeof(_record));
+  _record.t = block->t;
+}
+
+bool ThermiteHistoryDecoder::next(ThermiteHistoryRecord& record) {
+  if (_block == nullptr || _i >= _block->count) {
+    return false;
+  }
+  uint32_t head;
+  if (!_readVarint(head)) {
+    return false;
+  }
+  _dt += unzigzag(head >> 2);
+  _record.t += static_cast<uint32_t>(_dt);
+  _record.kind = (head & 1ul) ? HISTORY_RECORD_SWITCH : HISTORY_RECORD_SAMPLE;
+  _record.heater = (head & 2ul) != 0ul;
+  if (_record.kind == HISTORY_RECORD_SAMPLE) {
+    uint32_t temp;
+    uint32_t tempTarget;
+    if (!_readVarint(temp) || !_readVarint(tempTarget)) {
+      return false;
+    }
+    _record.temp = static_cast<int16_t>(_record.temp + unzigzag(temp));
+    _record.tempTarget = static_cast<int16_t>(_record.tempTarget + unzigzag(tempTarget));
+  }
+  _i++;
+  record = _record;
+  return true;
+}
+
+ThermiteHistory::ThermiteHistory()
+: _fileSystem(nullptr),
+  _zone(0),
+  _segmentFirst(0ul),
+  _segmentCount(0),
+  _segmentOpen(false),
+  _tLast(0ul),
+  _dtLast(0l),
+  _tempLast(0),
+  _tempTargetLast(0),
+  _pendingFull(false),
+  _blocksWritten(0ul),
+  _blocksDropped(0ul),
+  _recordsDropped(0ul) {
+  memset(_segmentStarts, 0, sizeof(_segmentStarts));
+  memset(&_index, 0, sizeof(_index));
+  memset(&_block, 0, sizeof(_block));
+  memset(&_pending, 0, sizeof(_pending));
+}
+
+uint8_t ThermiteHistory::_encode(const ThermiteHistoryRecord& record, uint8_t* data) const {
+  int32_t dt = static_cast<int32_t>(record.t - _tLast);
+  uint32_t dod = zigzag(dt - _dtLast);
+  if (dod > HISTORY_DOD_ZIGZAG_MAX) {
+    return 0;
+  }
+  uint32_t head = (dod << 2) | (record.heater ? 2ul : 0ul) | record.kind;
+  uint8_t n = writeVarint(head, data);
+  if (record.kind == HISTORY_RECORD_SAMPLE) {
+    n += writeVarint(zigzag(static_cast<int32_t>(record.temp) - _tempLast), data + n);
+    n += writeVarint(zigzag(static_cast<int32_t>(record.tempTarget) - _tempTargetLast), data + n);
+  }
+  return n;
+}
+
+void ThermiteHistory::_resetBlock() {
+  memset(&_block, 0, sizeof(_block));
+  _block.version = HISTORY_VERSION;
+  _dtLast = 0l;
+  _tempLast = 0;
+  _tempTargetLast = 0;
+}
+
+void ThermiteHistory::_seal() {
+  _block.seal();
+  if (_pendingFull) {
+    _blocksDropped++;
+  }
+  _pending = _block;
+  _pendingFull = true;
+  _block.count = 0;
+}
+
+void ThermiteHistory::_append(const ThermiteHistoryRecord& record) {
+  if (record.t < _tLast) {
+    _recordsDropped++;
+    return;
+  }
+  uint8_t data[HISTORY_RECORD_SIZE_MAX];
+  uint8_t n = 0;
+  if (_block.count > 0) {
+    n = _encode(record, data);
+    if (n == 0 || _block.length + n > sizeof(_block.data)) {
+      _seal();
+    }
+  }
+  if (_block.count == 0) {
+    _resetBlock();
+    _block.t = record.t;
+    _tLast = record.t;
+    n = _encode(record, data);
+  }
+  memcpy(_block.data + _block.length, data, n);
+  _block.length += n;
+  _block.count++;
+  _dtLast = static_cast<int32_t>(record.t - _tLast);
+  _tLast = record.t;
+  if (record.kind == HISTORY_RECORD_SAMPLE) {
+    _tempLast = record.temp;
+    _tempTargetLast = record.tempTarget;
+  }
+}
+
+void ThermiteHistory::addSample(time_t tUtc, float temp, float tempTarget, bool heater) {
+  ThermiteHistoryRecord record;
+  record.t = static_cast<uint32_t>(tUtc);
+  record.kind = HISTORY_RECORD_SAMPLE;
+  record.heater = heater;
+  record.temp = toCentiClamped(temp);
+  record.tempTarget = toCentiClamped(tempTarget);
+  _append(record);
+}
+
+void ThermiteHistory::addSwitch(time_t tUtc, bool heater) {
+  ThermiteHistoryRecord record;
+  record.t = static_cast<uint32_t>(tUtc);
+  record.kind = HISTORY_RECORD_SWITCH;
+  record.heater = heater;
+  record.temp = 0;
+  record.tempTarget = 0;
+  _append(record);
+}
+
+void ThermiteHistory::_openSegment(uint32_t t) {
+  if (_segmentCount >= HISTORY_SEGMENT_COUNT) {
+    _removeOldestSegment();
+  }
+  uint32_t seq = _segmentFirst + _segmentCount;
+  _segmentStarts[seq % HISTORY_SEGMENT_COUNT] = t;
+  _segmentCount++;
+  _segmentOpen = true;
+  memset(&_index, 0, sizeof(_index));
+  _index.version = HISTORY_VERSION;
+}
+
+void ThermiteHistory::_removeOldestSegment() {
+  char path[HISTORY_PATH_LEN];
+  getSegmentPath(_segmentFirst, path);
+  _fileSystem->remove(path);
+  _segmentFirst++;
+  _segmentCount--;
+  if (_segmentCount == 0) {
+    _segmentOpen = false;
+  }
+}
+
+void ThermiteHistory::flush() {
+  if (!_pendingFull || _fileSystem == nullptr) {
+    return;
+  }
+  if (!_segmentOpen) {
+    _openSegment(_pending.t);
+  }
+  char path[HISTORY_PATH_LEN];
+  getSegmentPath(_segmentFirst + _segmentCount - 1, path);
+  _pendingFull = false;
+  if (!_fileSystem->append(path, &_pending, sizeof(_pending))) {
+    /*
+     * Most likely the file system is full.  Make room for next time, and start a new segment
+     * rather than append after what may be a partial block.
+     */
+    _blocksDropped++;
+    _segmentOpen = false;
+    if (_index.count == 0) {
+      _fileSystem->remove(path);
+      _segmentCount--;
+    }
+    if (_segmentCount > 1) {
+      _removeOldestSegment();
+    }
+    return;
+  }
+  _blocksWritten++;
+  _index.t[_index.count++] = _pending.t;
+  if (_index.count == HISTORY_SEGMENT_BLOCKS) {
+    _index.crc = thermiteCrc32(
+      reinterpret_cast<const uint8_t*>(&_index) + sizeof(_index.crc),
+      sizeof(_index) - sizeof(_index.crc)
+    );
+    _fileSystem->append(path, &_index, sizeof(_index));
+    _segmentOpen = false;
+  }
+}
+
+/**
+ * What `ThermiteHistory::restore()` found on flash.
+ */
+struct ThermiteHistoryScan {
+  char prefix[HISTORY_PATH_LEN];
+  size_t prefixLen;
+  bool found;
+  uint32_t first;
+  uint32_t last;
+};
+
+static void scanSegment(void* context, const char* name) {
+  ThermiteHistoryScan& scan = *static_cast<ThermiteHistoryScan*>(context);
+  if (strncmp(name, scan.prefix, scan.prefixLen) != 0) {
+    return;
+  }
+  const char* s = name + scan.prefixLen;
+  if (*s == '\0') {
+    return;
+  }
+  char* end;
+  uint32_t seq = strtoul(s, &end, 16);
+  if (*end != '\0') {
+    return;
+  }
+  if (!scan.found || seq < scan.first) {
+    scan.first = seq;
+  }
+  if (!scan.found || seq > scan.last) {
+    scan.last = seq;
+  }
+  scan.found = true;
+}
+
+bool ThermiteHistory::restore() {
+  if (_fileSystem == nullptr) {
+    return false;
+  }
+  ThermiteHistoryScan scan;
+  snprintf(scan.prefix, sizeof(scan.prefix), "h%u-", (unsigned) _zone);
+  scan.prefixLen = strlen(scan.prefix);
+  scan.found = false;
+  scan.first = 0ul;
+  scan.last = 0ul;
+  _fileSystem->list("/", scanSegment, &scan);
+  if (!scan.found) {
+    return false;
+  }
+
+  // in case this firmware keeps fewer segments than the one that wrote them
+  _segmentFirst = scan.first;
+  _segmentCount = 0;
+  while (scan.last - _segmentFirst >= HISTORY_SEGMENT_COUNT) {
+    char path[HISTORY_PATH_LEN];
+    getSegmentPath(_segmentFirst++, path);
+    _fileSystem->remove(path);
+  }
+  _segmentCount = static_cast<uint8_t>(scan.last - _segmentFirst + 1);
+
+  ThermiteHistoryBlock block;
+  for (uint32_t seq = _segmentFirst; seq <= scan.last; seq++) {
+    uint32_t t = 0ul;
+    if (readBlock(seq, 0, block)) {
+      t = block.t;
+    }
+    _segmentStarts[seq % HISTORY_SEGMENT_COUNT] = t;
+  }
+
+  /*
+   * Pick up appending to the newest segment, unless it is full or ends in something other
+   * than a whole block.
+   */
+  char path[HISTORY_PATH_LEN];
+  getSegmentPath(scan.last, path);
+  long size = _fileSystem->getSize(path);
+  uint16_t blocks = size > 0l ? static_cast<uint16_t>(size / HISTORY_BLOCK_SIZE) : 0;
+  if (blocks > HISTORY_SEGMENT_BLOCKS) {
+    blocks = HISTORY_SEGMENT_BLOCKS;
+  }
+  memset(&_index, 0, sizeof(_index));
+  _index.version = HISTORY_VERSION;
+  _segmentOpen = blocks > 0 && blocks < HISTORY_SEGMENT_BLOCKS && size % HISTORY_BLOCK_SIZE == 0;
+  for (uint16_t i = 0; i < blocks; i++) {
+    if (!readBlock(scan.last, i, block)) {
+      _segmentOpen = false;
+      continue;
+    }
+    _index.t[i] = block.t;
+
+    // new records must not go before the last one on flash
+    ThermiteHistoryDecoder decoder;
+    ThermiteHistoryRecord record;
+    decoder.reset(&block);
+    while (decoder.next(record)) {
+      if (record.t > _tLast) {
+        _tLast = record.t;
+      }
+    }
+  }
+  _index.count = blocks;
+  return true;
+}
+
+void ThermiteHistory::getSegmentPath(uint32_t seq, char* path) const {
+  snprintf(path, HISTORY_PATH_LEN, "/h%u-%08lx", (unsigned) _zone, (unsigned long) seq);
+}
+
+bool ThermiteHistory::readBlock(uint32_t seq, uint8_t i, ThermiteHistoryBlock& block) const {
+  if (_fileSystem == nullptr) {
+    return false;
+  }
+  char path[HISTORY_PATH_LEN];
+  getSegmentPath(seq, path);
+  long n = _fileSystem->read(path, i * HISTORY_BLOCK_SIZE, &block, sizeof(block));
+  return n == static_cast<long>(sizeof(block)) && block.isValid();
+}
+
+uint8_t ThermiteHistory::seekBlock(uint32_t seq, uint32_t t) const {
+  if (_fileSystem == nullptr) {
+    return 0;
+  }
+  ThermiteHistoryIndex index;
+  if (_segmentOpen && seq == _segmentFirst + _segmentCount - 1) {
+    index = _index;
+  } else {
+    char path[HISTORY_PATH_LEN];
+    getSegmentPath(seq, path);
+    long size = _fileSystem->getSize(path);
+    uint32_t indexOffset = HISTORY_SEGMENT_BLOCKS * HISTORY_BLOCK_SIZE;
+    bool indexed = size == static_cast<long>(indexOffset + sizeof(index))
+      && _fileSystem->read(path, indexOffset, &index, sizeof(index))
+        == static_cast<long>(sizeof(index))
+      && index.version == HISTORY_VERSION
+      && index.count <= HISTORY_SEGMENT_BLOCKS
+      && index.crc == thermiteCrc32(
+        reinterpret_cast<const uint8_t*>(&index) + sizeof(index.crc),
+        sizeof(index) - sizeof(index.crc)
+      );
+    if (!indexed) {
+      // no index yet: read the start time from each block's header instead
+      uint16_t blocks = size > 0l ? static_cast<uint16_t>(size / HISTORY_BLOCK_SIZE) : 0;
+      if (blocks > HISTORY_SEGMENT_BLOCKS) {
+        blocks = HISTORY_SEGMENT_BLOCKS;
+      }
+      index.count = blocks;
+      for (uint16_t i = 0; i < blocks; i++) {
+        uint32_t header[HISTORY_BLOCK_HEADER_SIZE / 4];
+        if (_fileSystem->read(path, i * HISTORY_BLOCK_SIZE, header, sizeof(header))
+          != static_cast<long>(sizeof(header))) {
+          index.count = i;
+          break;
+        }
+        index.t[i] = header[1];
+      }
+    }
+  }
+  uint8_t block = 0;
+  for (uint8_t i = 1; i < index.count && index.t[i] <= t; i++) {
+    block = i;
+  }
+  return block;
+}
+
+uint32_t ThermiteHistory::seekSegment(uint32_t t) const {
+  for (uint32_t seq = _segmentFirst + _segmentCount; seq-- > _segmentFirst;) {
+    if (_segmentStarts[seq % HISTORY_SEGMENT_COUNT] <= t) {
+      return seq;
+    }
+  }
+  return _segmentFirst;
+}
+
+ThermiteHistoryDownsampler::ThermiteHistoryDownsampler() {
+  reset(0l, 0l, 3);
+}
+
+void ThermiteHistoryDownsampler::reset(time_t from, time_t to, uint16_t points) {
+  _from = static_cast<uint32_t>(from);
+  _span = static_cast<uint32_t>(to - from) + 1ul;
+  _points = points;
+  _hasPrevious = false;
+  _previousSelected = false;
+  _hasPending = false;
+  _hasCurrent = false;
+  _queueHead = 0;
+  _queueCount = 0;
+}
+
+void ThermiteHistoryDownsampler::_choose(const ThermiteHistoryRecord& sample) {
+  _queue[(_queueHead + _queueCount) % 4] = sample;
+  _queueCount++;
+  _selected = sample;
+}
+
+void ThermiteHistoryDownsampler::_select(
+  const ThermiteHistoryBucket& bucket,
+  int64_t sumT,
+  int64_t sumTemp,
+  int64_t count
+) {
+  /*
+   * Twice the area of the triangle from the last chosen sample A, through candidate B, to the
+   * average C = sum / count of what follows, scaled by `count` so that it stays in integers.
+   * `count` is the same for every candidate, so the largest is still the largest.
+   */
+  int64_t at = static_cast<int64_t>(_selected.t - _from);
+  int64_t atemp = _selected.temp;
+  const ThermiteHistoryRecord* candidates[2] = { &bucket.min, &bucket.max };
+  const ThermiteHistoryRecord* best = candidates[0];
+  int64_t areaBest = -1;
+  for (uint8_t i = 0; i < 2; i++) {
+    const ThermiteHistoryRecord* candidate = candidates[i];
+    int64_t dt = static_cast<int64_t>(candidate->t - _from) - at;
+    int64_t dtemp = candidate->temp - atemp;
+    int64_t area = dt * (sumTemp - count * atemp) - dtemp * (sumT - count * at);
+    if (area < 0) {
+      area = -area;
+    }
+    if (area > areaBest) {
+      areaBest = area;
+      best = candidate;
+    }
+  }
+  _choose(*best);
+}
+
+void ThermiteHistoryDownsampler::_addToBucket(const ThermiteHistoryRecord& sample) {
+  uint32_t dt = sample.t - _from;
+  uint32_t index = static_cast<uint32_t>(
+    static_cast<uint64_t>(dt) * (_points - 2u) / _span
+  );
+  if (_hasCurrent && index != _current.index) {
+    if (_hasPending) {
+      _select(_pending, _current.sumT, _current.sumTemp, _current.count);
+    }
+    _pending = _current;
+    _hasPending = true;
+    _hasCurrent = false;
+  }
+  if (!_hasCurrent) {
+    _current.index = index;
+    _current.count = 0ul;
+    _current.sumT = 0;
+    _current.sumTemp = 0;
+    _current.min = sample;
+    _current.max = sample;
+    _hasCurrent = true;
+  }
+  _current.count++;
+  _current.sumT += dt;
+  _current.sumTemp += sample.temp;
+  if (sample.temp < _current.min.temp) {
+    _current.min = sample;
+  }
+  if (sample.temp > _current.max.temp) {
+    _current.max = sample;
+  }
+}
+
+void ThermiteHistoryDownsampler::_closeRun() {
+  // the last sample of the run stands in for the bucket after the last one
+  int64_t t = static_cast<int64_t>(_previous.t - _from);
+  if (_hasPending) {
+    if (_hasCurrent) {
+      _select(_pending, _current.sumT, _current.sumTemp, _current.count);
+    } else {
+      _select(_pending, t, _previous.temp, 1);
+    }
+  }
+  if (_hasCurrent) {
+    _select(_current, t, _previous.temp, 1);
+  }
+  _hasPending = false;
+  _hasCurrent = false;
+  if (!_previousSelected) {
+    _choose(_previous);
+  }
+}
+
+void ThermiteHistoryDownsampler::add(const ThermiteHistoryRecord& sample) {
+  if (_hasPrevious && sample.heater == _previous.heater) {
+    if (!_previousSelected) {
+      _addToBucket(_previous);
+    }
+    _previous = sample;
+    _previousSelected = false;
+    return;
+  }
+
+  // first sample, or first after a heater edge
+  if (_hasPrevious) {
+    _closeRun();
+  }
+  _choose(sample);
+  _previous = sample;
+  _hasPrevious = true;
+  _previousSelected = true;
+}
+
+void ThermiteHistoryDownsampler::finish() {
+  if (_hasPrevious) {
+    _closeRun();
+    _hasPrevious = false;
+  }
+}
+
+bool ThermiteHistoryDownsampler::next(ThermiteHistoryRecord& sample) {
+  if (_queueCount == 0) {
+    return false;
+  }
+  sample = _queue[_queueHead];
+  _queueHead = (_queueHead + 1) % 4;
+  _queueCount--;
+  return true;
+}
+
+ThermiteHistoryBody::ThermiteHistoryBody(
+  const ThermiteHistory& history,
+  time_t from,
+  time_t to,
+  uint16_t points
+) : _history(history),
+    _from(static_cast<uint32_t>(from)),
+    _to(static_cast<uint32_t>(to)),
+    _points(points),
+    _samplesDone(false),
+    _segmentEnd(history.getSegmentFirst() + history.getSegmentCount()),
+    _lastSegmentBlocks(
+      history.isSegmentOpen() ? history.getSegmentOpenBlocks() : HISTORY_SEGMENT_BLOCKS
+    ),
+    _memoryCount(0),
+    _segment(0ul),
+    _blockIndex(0),
+    _blockLoaded(false),
+    _first(true),
+    _stage(HISTORY_BODY_HEADER) {
+  if (_points > 0) {
+    _downsampler.reset(from, to, _points);
+  }
+  if (history.getPending() != nullptr) {
+    _memoryBlocks[_memoryCount++] = *history.getPending();
+  }
+  if (history.getBlock() != nullptr) {
+    _memoryBlocks[_memoryCount++] = *history.getBlock();
+  }
+
+  /*
+   * Recent ranges can usually be served from RAM alone.  Otherwise, blocks in RAM only hold
+   * records after those on flash, so start from flash.
+   */
+  int8_t memoryStart = -1;
+  for (uint8_t i = 0; i < _memoryCount; i++) {
+    if (_memoryBlocks[i].t <= _from) {
+      memoryStart = i;
+    }
+  }
+  if (memoryStart >= 0 || history.getSegmentCount() == 0) {
+    _segmentStart = _segmentEnd;
+    _blockStart = memoryStart >= 0 ? memoryStart : 0;
+  } else {
+    _segmentStart = history.seekSegment(_from);
+    _blockStart = history.seekBlock(_segmentStart, _from);
+  }
+}
+
+void ThermiteHistoryBody::_rewind() {
+  _segment = _segmentStart;
+  _blockIndex = _blockStart;
+  _blockLoaded = false;
+  _first = true;
+}
+
+bool ThermiteHistoryBody::_loadNextBlock() {
+  if (_segment < _history.getSegmentFirst()) {
+    // removed since the response started
+    _segment = _history.getSegmentFirst();
+    _blockIndex = 0;
+  }
+  while (_segment < _segmentEnd) {
+    uint8_t blocks = _segment + 1 == _segmentEnd ? _lastSegmentBlocks : HISTORY_SEGMENT_BLOCKS;
+    while (_blockIndex < blocks) {
+      if (_history.readBlock(_segment, _blockIndex++, _block)) {
+        _decoder.reset(&_block);
+        return true;
+      }
+    }
+    _segment++;
+    _blockIndex = 0;
+  }
+  if (_blockIndex < _memoryCount) {
+    _decoder.reset(&_memoryBlocks[_blockIndex++]);
+    return true;
+  }
+  return false;
+}
+
+bool ThermiteHistoryBody::_nextRecord(ThermiteHistoryRecord& record) {
+  while (true) {
+    if (_blockLoaded && _decoder.next(record)) {
+      return true;
+    }
+    _blockLoaded = _loadNextBlock();
+    if (!_blockLoaded) {
+      return false;
+    }
+  }
+}
+
+bool ThermiteHistoryBody::_nextSample(ThermiteHistoryRecord& sample) {
+  while (true) {
+    if (_points > 0 && _downsampler.next(sample)) {
+      return true;
+    }
+    if (_samplesDone) {
+      return false;
+    }
+    if (!_nextRecord(sample) || sample.t > _to) {
+      _samplesDone = true;
+      if (_points > 0) {
+        _downsampler.finish();
+      }
+      continue;
+    }
+    if (sample.kind != HISTORY_RECORD_SAMPLE || sample.t < _from) {
+      continue;
+    }
+    if (_points == 0) {
+      return true;
+    }
+    _downsampler.add(sample);
+  }
+}
+
+size_t ThermiteHistoryBody::_nextLine(char* line, size_t size) {
+  ThermiteHistoryRecord record;
+  size_t len;
+  switch (_stage) {
+    case HISTORY_BODY_HEADER:
+      _stage = HISTORY_BODY_SAMPLES;
+      _rewind();
+      len = snprintf(
+        line,
+        size,
+        "{\"from\":%lu,\"to\":%lu,",
+        (unsigned long) _from,
+        (unsigned long) _to
+      );
+      if (_points > 0) {
+        len += snprintf(line + len, size - len, "\"points\":%u,", (unsigned) _points);
+      }
+      return len + snprintf(
+        line + len,
+        size - len,
+        "\"samples\":{\"columns\":[\"t\",\"temp\",\"tempTarget\",\"heater\"],\"rows\":["
+      );
+    case HISTORY_BODY_SAMPLES:
+      if (_nextSample(record)) {
+        len = snprintf(
+          line,
+          size,
+          "%s[%lu,",
+          _first ? "" : ",",
+          (unsigned long) record.t
+        );
+        len += _printCenti(line + len, size - len, record.temp);
+        line[len++] = ',';
+        len += _printCenti(line + len, size - len, record.tempTarget);
+        len += snprintf(line + len, size - len, ",%u]", record.heater ? 1u : 0u);
+        _first = false;
+        return len;
+      }
+      _stage = HISTORY_BODY_SWITCHES;
+      _rewind();
+      return snprintf(line, size, "]},\"switches\":{\"columns\":[\"t\",\"heater\"],\"rows\":[");
+    case HISTORY_BODY_SWITCHES:
+      while (_nextRecord(record) && record.t <= _to) {
+        if (record.kind != HISTORY_RECORD_SWITCH || record.t < _from) {
+          continue;
+        }
+        len = snprintf(
+          line,
+          size,
+          "%s[%lu,%u]",
+          _first ? "" : ",",
+          (unsigned long) record.t,
+          record.heater ? 1u : 0u
+        );
+        _first = false;
+        return len;
+      }
+      _stage = HISTORY_BODY_DONE;
+      return snprintf(line, size, "]}}");
+    default:
+      return 0;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,422 @@
+#ifndef _THERMITE_HISTORY_H__
+#define _THERMITE_HISTORY_H__
+
+#include <stdint.h>
+#include <time.h>
+
+#include "Constants.h"
+#include "ThermiteChunkedBody.h"
+#include "ThermiteHal.h"
+
+/**
+ * Bump this whenever the layout of `ThermiteHistoryBlock` or `ThermiteHistoryIndex`, or the
+ * record encoding, changes, so that history written by older firmware is ignored rather than
+ * misread.
+ */
+#define HISTORY_VERSION 1
+
+#define HISTORY_RECORD_SAMPLE 0
+#define HISTORY_RECORD_SWITCH 1
+
+/**
+ * Longest a record can take once encoded: a 5-byte varint for the time and flags, and two
+ * 3-byte varints for the temperatures.
+ */
+#define HISTORY_RECORD_SIZE_MAX 11
+
+#define HISTORY_PATH_LEN 16
+
+/**
+ * One decoded history record: either a temperature sample, or a heater switch.
+ */
+struct ThermiteHistoryRecord {
+  /**
+   * UTC time, in seconds since the Unix epoch.
+   */
+  uint32_t t;
+
+  /**
+   * One of the `HISTORY_RECORD_*` constants.
+   */
+  uint8_t kind;
+
+  /**
+   * Heater state: during the sample, or after the switch.
+   */
+  bool heater;
+
+  /**
+   * Temperature and target temperature, in hundredths of a degree Celsius.  Samples only.
+   */
+  int16_t temp;
+  int16_t tempTarget;
+};
+
+/**
+ * Compressed run of history records, written to flash as one page.  Each block can be decoded
+ * on its own: the first record's time is `t`, and every record after it stores its time as a
+ * delta-of-delta from the two before, and its temperatures as deltas from the previous sample,
+ * all as zigzag varints.  At one sample a minute, most samples take 3 bytes.
+ */
+struct ThermiteHistoryBlock {
+  /**
+   * CRC-32 of everything after this field, up to the end of `data`.
+   */
+  uint32_t crc;
+
+  /**
+   * UTC time of the first record.
+   */
+  uint32_t t;
+  uint16_t count;
+  uint8_t length;
+  uint8_t version;
+  uint8_t data[HISTORY_BLOCK_SIZE - 12];
+
+  /**
+   * Sets `crc`.  Bytes past `length` must be zero.
+   */
+  void seal();
+
+  /**
+   * Does `crc` match, and was this written by this firmware?
+   */
+  bool isValid() const;
+};
+
+/**
+ * Written after the last block of a full segment: the time of each block's first record, so
+ * that a reader can seek straight to the block it needs.  A segment is therefore either
+ * `n * HISTORY_BLOCK_SIZE` bytes long, while it is still being appended to, or
+ * `HISTORY_SEGMENT_BLOCKS * HISTORY_BLOCK_SIZE + sizeof(ThermiteHistoryIndex)` bytes.
+ */
+struct ThermiteHistoryIndex {
+  /**
+   * CRC-32 of everything after this field.
+   */
+  uint32_t crc;
+  uint16_t count;
+  uint8_t version;
+  uint8_t reserved;
+  uint32_t t[HISTORY_SEGMENT_BLOCKS];
+};
+
+/**
+ * Steps through the records of a `ThermiteHistoryBlock`.
+ */
+class ThermiteHistoryDecoder {
+private:
+  const ThermiteHistoryBlock* _block;
+  uint16_t _i;
+  uint8_t _offset;
+  ThermiteHistoryRecord _record;
+  int32_t _dt;
+
+  bool _readVarint(uint32_t& value);
+public:
+  ThermiteHistoryDecoder();
+
+  /**
+   * Starts over from the first record of `block`, which must outlive the decoder.
+   */
+  void reset(const ThermiteHistoryBlock* block);
+
+  /**
+   * Decodes the next record into `record`.  Returns `false` once there are no more, or if the
+   * block is malformed.
+   */
+  bool next(ThermiteHistoryRecord& record);
+};
+
+/**
+ * Persistent history of one zone's temperature samples and heater switches, as an
+ * append-only log on the flash file system.
+ *
+ * Records are compressed into `ThermiteHistoryBlock`s in RAM.  A full block waits until
+ * `flush()`, which the control loop calls once the relays have been driven, and is then
+ * appended to the newest segment file: so flash is only ever written a whole page at a time,
+ * about once an hour, and never while a control decision is pending.  Each segment holds
+ * `HISTORY_SEGMENT_BLOCKS` blocks, about one flash erase block, followed by its
+ * `ThermiteHistoryIndex`.  Retention is by segment: once there are `HISTORY_SEGMENT_COUNT`,
+ * the oldest file is removed whole, which leaves wear leveling to the file system.
+ *
+ * Segments are named `/h{zone}-{seq}`, with `seq` in hex, counting up.  The start time of
+ * every segment is kept in RAM, which together with each segment's index lets
+ * `ThermiteHistoryBody` find the block a range starts in with two small reads.
+ *
+ * Records that arrive with an earlier time than the last one (e.g. after the clock is set
+ * back) are dropped, so that blocks and segments stay sorted by time.  Whatever is still in
+ * RAM is lost on reset.
+ */
+class ThermiteHistory {
+private:
+  ThermiteFileSystem* _fileSystem;
+  uint8_t _zone;
+
+  /**
+   * Segments on flash are `_segmentFirst` to `_segmentFirst + _segmentCount - 1`.  The start
+   * time of segment `seq` is `_segmentStarts[seq % HISTORY_SEGMENT_COUNT]`.
+   */
+  uint32_t _segmentFirst;
+  uint8_t _segmentCount;
+  uint32_t _segmentStarts[HISTORY_SEGMENT_COUNT];
+
+  /**
+   * Is the newest segment still being appended to?  If so, `_index` holds the start times of
+   * its blocks so far.
+   */
+  bool _segmentOpen;
+  ThermiteHistoryIndex _index;
+
+  /**
+   * Block being filled, and what its next record is encoded against.
+   */
+  ThermiteHistoryBlock _block;
+  uint32_t _tLast;
+  int32_t _dtLast;
+  int16_t _tempLast;
+  int16_t _tempTargetLast;
+
+  /**
+   * Full block waiting for `flush()`, if `_pendingFull`.
+   */
+  ThermiteHistoryBlock _pending;
+  bool _pendingFull;
+
+  unsigned long _blocksWritten;
+  unsigned long _blocksDropped;
+  unsigned long _recordsDropped;
+
+  void _append(const ThermiteHistoryRecord& record);
+  uint8_t _encode(const ThermiteHistoryRecord& record, uint8_t* data) const;
+  void _resetBlock();
+  void _seal();
+
+  void _openSegment(uint32_t t);
+  void _removeOldestSegment();
+public:
+  ThermiteHistory();
+
+  ThermiteHistory(const ThermiteHistory&) = delete;
+  ThermiteHistory& operator=(const ThermiteHistory&) = delete;
+
+  void addSample(time_t tUtc, float temp, float tempTarget, bool heater);
+  void addSwitch(time_t tUtc, bool heater);
+
+  /**
+   * Writes the full block, if there is one, to flash.  Call from the main loop.
+   */
+  void flush();
+
+  /**
+   * Finds the segments already on flash, and picks up appending to the newest one.  Returns
+   * `false` if there are none, e.g. on first boot.
+   */
+  bool restore();
+  void setFileSystem(ThermiteFileSystem* fileSystem, uint8_t zone) {
+    _fileSystem = fileSystem;
+    _zone = zone;
+  }
+
+  /**
+   * Writes the path of segment `seq` into `path`, which must have room for
+   * `HISTORY_PATH_LEN` characters.
+   */
+  void getSegmentPath(uint32_t seq, char* path) const;
+
+  /**
+   * Reads block `i` of segment `seq` into `block`.  Returns `false` if it is missing or not
+   * valid, e.g. because the segment has since been removed.
+   */
+  bool readBlock(uint32_t seq, uint8_t i, ThermiteHistoryBlock& block) const;
+
+  /**
+   * Returns the index of the last block of segment `seq` that starts at or before `t`, or 0
+   * if there is none.
+   */
+  uint8_t seekBlock(uint32_t seq, uint32_t t) const;
+
+  /**
+   * Returns the oldest segment that could hold records at or after `t`.
+   */
+  uint32_t seekSegment(uint32_t t) const;
+
+  ThermiteFileSystem* getFileSystem() const { return _fileSystem; }
+  uint32_t getSegmentFirst() const { return _segmentFirst; }
+  uint8_t getSegmentCount() const { return _segmentCount; }
+
+  /**
+   * Number of blocks of the newest segment that are on flash.  Only valid if
+   * `isSegmentOpen()`.
+   */
+  uint16_t getSegmentOpenBlocks() const { return _index.count; }
+  bool isSegmentOpen() const { return _segmentOpen; }
+  const ThermiteHistoryBlock* getBlock() const { return _block.count > 0 ? &_block : nullptr; }
+  const ThermiteHistoryBlock* getPending() const { return _pendingFull ? &_pending : nullptr; }
+
+  unsigned long getBlocksWritten() const { return _blocksWritten; }
+  unsigned long getBlocksDropped() const { return _blocksDropped; }
+  unsigned long getRecordsDropped() const { return _recordsDropped; }
+};
+
+/**
+ * Samples falling in one time bucket of a `ThermiteHistoryDownsampler`: their sums, for the
+ * bucket's average, and the coldest and warmest of them, as candidates to represent it.
+ * Times are relative to the start of the range.
+ */
+struct ThermiteHistoryBucket {
+  uint32_t index;
+  uint32_t count;
+  int64_t sumT;
+  int64_t sumTemp;
+  ThermiteHistoryRecord min;
+  ThermiteHistoryRecord max;
+};
+
+/**
+ * Downsamples a stream of samples to about `points` by Largest-Triangle-Three-Buckets, in one
+ * pass and in constant memory, for charts that need no more than one sample per pixel.
+ *
+ * The range is divided into `points - 2` buckets of equal time, and each bucket is
+ * represented by the sample that makes the largest triangle with the one chosen for the bucket
+ * before and the average of the bucket after.  Classic LTTB weighs every sample of a bucket;
+ * to stay in constant memory, this only weighs its coldest and warmest (as MinMaxLTTB does),
+ * which keeps peaks and troughs, and holds back only one bucket while the next one fills.
+ *
+ * Heater edges are kept exactly: buckets never span a change of `heater`, and the samples
+ * either side of each change are always kept.  A bucket an edge falls in is split in two, so
+ * a response has at most `points` samples plus three per edge.  The first and last samples are
+ * always kept too.
+ *
+ * Feed samples in time order with `add()`, then call `finish()`; after each call, take the
+ * samples it chose with `next()` until there are none left.
+ */
+class ThermiteHistoryDownsampler {
+private:
+  uint32_t _from;
+  uint32_t _span;
+  uint16_t _points;
+
+  /**
+   * Last sample chosen, which each bucket's triangle starts from.
+   */
+  ThermiteHistoryRecord _selected;
+
+  /**
+   * Last sample added, held back until the next one shows whether it ends a run of the same
+   * heater state.  `_previousSelected` if it has already been chosen, as the first of a run.
+   */
+  ThermiteHistoryRecord _previous;
+  bool _hasPrevious;
+  bool _previousSelected;
+
+  /**
+   * Full bucket waiting for the average of the next, and the bucket being filled.
+   */
+  ThermiteHistoryBucket _pending;
+  bool _hasPending;
+  ThermiteHistoryBucket _current;
+  bool _hasCurrent;
+
+  /**
+   * Chosen samples not yet taken by `next()`.  At most four are chosen per call.
+   */
+  ThermiteHistoryRecord _queue[4];
+  uint8_t _queueHead;
+  uint8_t _queueCount;
+
+  void _addToBucket(const ThermiteHistoryRecord& sample);
+  void _closeRun();
+  void _select(const ThermiteHistoryBucket& bucket, int64_t sumT, int64_t sumTemp, int64_t count);
+  void _choose(const ThermiteHistoryRecord& sample);
+public:
+  ThermiteHistoryDownsampler();
+
+  /**
+   * Starts over, for samples between UTC times `from` and `to` (inclusive).  `points` must be
+   * at least 3.
+   */
+  void reset(time_t from, time_t to, uint16_t points);
+
+  void add(const ThermiteHistoryRecord& sample);
+  void finish();
+
+  /**
+   * Takes the next chosen sample into `sample`.  Returns `false` if there is none yet.
+   */
+  bool next(ThermiteHistoryRecord& sample);
+};
+
+#define HISTORY_BODY_HEADER 0
+#define HISTORY_BODY_SAMPLES 1
+#define HISTORY_BODY_SWITCHES 2
+#define HISTORY_BODY_DONE 3
+
+/**
+ * Streams the records of a `ThermiteHistory` between UTC times `from` and `to` (inclusive) as
+ * JSON: first the samples, then the heater switches.  As in `ThermiteRollupsBody`, each is an
+ * array of values in the order given by its `"columns"`.
+ *
+ * With `points`, samples are downsampled by a `ThermiteHistoryDownsampler` as they are read,
+ * while switches are still streamed in full.
+ *
+ * The body reads one block at a time from flash, starting at the block `from` falls in.
+ * Blocks still in RAM are copied when the body is created, since the response may outlive
+ * them; segments removed in the meantime are skipped.
+ */
+class ThermiteHistoryBody : public ThermiteChunkedBody {
+private:
+  const ThermiteHistory& _history;
+  uint32_t _from;
+  uint32_t _to;
+  uint16_t _points;
+  ThermiteHistoryDownsampler _downsampler;
+  bool _samplesDone;
+
+  /**
+   * Where each pass starts, and where the last segment on flash ends: `_segmentEnd` is one
+   * past the last segment, and `_lastSegmentBlocks` how many of its blocks to read.
+   */
+  uint32_t _segmentStart;
+  uint8_t _blockStart;
+  uint32_t _segmentEnd;
+  uint8_t _lastSegmentBlocks;
+
+  /**
+   * Blocks that were in RAM when the body was created: `_memoryBlocks[0]` is the full block
+   * waiting for `flush()`, if any.
+   */
+  ThermiteHistoryBlock _memoryBlocks[2];
+  uint8_t _memoryCount;
+
+  /**
+   * Current position: segment `_segment`, block `_blockIndex`, or memory block
+   * `_blockIndex` once `_segment == _segmentEnd`.
+   */
+  uint32_t _segment;
+  uint8_t _blockIndex;
+  ThermiteHistoryBlock _block;
+  ThermiteHistoryDecoder _decoder;
+  bool _blockLoaded;
+  bool _first;
+  uint8_t _stage;
+
+  bool _loadNextBlock();
+  bool _nextRecord(ThermiteHistoryRecord& record);
+  bool _nextSample(ThermiteHistoryRecord& sample);
+  void _rewind();
+protected:
+  size_t _nextLine(char* line, size_t size);
+public:
+  /**
+   * `points` is 0 for every sample, or at least 3 to downsample them.
+   */
+  ThermiteHistoryBody(
+    const ThermiteHistory& history,
+    time_t from,
+    time_t to,
+    uint16_t points = 0
+  );
+};
+
+#endif
\ No newline at end of file
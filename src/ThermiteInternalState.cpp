@@ -1,46 +1,141 @@
-#include <AsyncJson.h>
-#include <DallasTemperature.h>
-#include <OneWire.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "ThermiteCrc.h"
 #include "ThermiteInternalState.h"
+#include "ThermiteTime.h"
+
+static_assert(
+  RTC_OFFSET_CHECKPOINT + ZONE_COUNT_MAX * sizeof(ThermiteCheckpoint) <= RTC_MEMORY_SIZE,
+  "RTC_MEMORY_SIZE too small for ZONE_COUNT_MAX checkpoints"
+);
 
 ThermiteInternalState::ThermiteInternalState(
-  const ThermiteUserSettingsManager& userSettingsManager,
-  DallasTemperature& thermometerManager,
-  NTPClient& ntpClient,
-  Timezone& timezone
-) : _userSettingsManager(userSettingsManager),
-    _thermometerManager(thermometerManager),
-    _ntpClient(ntpClient),
-    _timezone(timezone),
+  const ThermiteUserSettingsStore& userSettingsStore,
+  ThermiteThermometer& thermometer,
+  ThermiteClock& clock
+) : _userSettingsStore(userSettingsStore),
+    _thermometer(thermometer),
+    _clock(clock),
+    _rtcMemory(nullptr),
+    _rtcOffset(RTC_OFFSET_CHECKPOINT),
+    _eeprom(nullptr),
+    _eepromOffset(EEPROM_OFFSET_THERMAL_MODEL),
+    _telemetry(nullptr),
+    _telemetryZone(0),
+    _telemetryPending(true),
+    _telemetrySent(false),
+    _telemetrySentAt(0ul),
+    _dateTimeIsoAt(-1l),
+    _version(0ul),
+    _calendarCursor(),
     _heater(false),
-    _temp(DEVICE_DISCONNECTED_C),
+    _thermalModelSavedSamples(0ul),
+    _temp(TEMP_DISCONNECTED),
     _tempLastRequestedAt(0ul),
-    _tempTarget(DEVICE_DISCONNECTED_C),
+    _tempRead(false),
+    _tempRequestInterval(TEMP_REQUEST_INTERVAL),
+    _tempTarget(TEMP_DISCONNECTED),
+    _preheatMargin(PREHEAT_MARGIN_DEFAULT),
     _tempHysteresis(1.0f) {}
 
-void ThermiteInternalState::_updateHeater() {
-  if (_tempTarget == DEVICE_DISCONNECTED_C) {
+void ThermiteInternalState::_saveCheckpoint(unsigned long now) const {
+  ThermiteCheckpoint checkpoint;
+  memset(&checkpoint, 0, sizeof(checkpoint));
+  checkpoint.version = CHECKPOINT_VERSION;
+  checkpoint.temp = _temp;
+  checkpoint.tempTarget = _tempTarget;
+  checkpoint.heater = _heater ? 1 : 0;
+  _heaterRuntime.save(checkpoint.heaterRuntime, now);
+  checkpoint.crc = thermiteCrc32(
+    reinterpret_cast<const uint8_t*>(&checkpoint) + sizeof(checkpoint.crc),
+    sizeof(checkpoint) - sizeof(checkpoint.crc)
+  );
+  _rtcMemory->write(_rtcOffset, &checkpoint, sizeof(checkpoint));
+}
+
+void ThermiteInternalState::_saveThermalModel() {
+  ThermiteThermalRecord record;
+  _thermalModel.save(record, _heaterRuntime.getRuntimeLifetimeMillis());
+  if (_eeprom->write(_eepromOffset, &record, sizeof(record)) && _eeprom->commit()) {
+    _thermalModelSavedSamples = _thermalModel.getSamples();
+  }
+}
+
+float ThermiteInternalState::_getPreheatTarget(
+  const ThermiteUserSettingsManager& userSettings,
+  time_t tLocal
+) const {
+  ThermiteCalendarCursor cursor = _calendarCursor;
+  time_t t = userSettings.getNextScheduleBoundary(tLocal);
+  while (t - tLocal <= PREHEAT_LOOKAHEAD_MAX) {
+    float tempTarget = userSettings.getTargetTemperature(t, cursor);
+    if (tempTarget > _tempTarget) {
+      long warmUp = _thermalModel.getWarmUpTime(_temp, tempTarget, tLocal);
+      if (warmUp < 0l) {
+        return _tempTarget;
+      }
+      if (t - tLocal <= warmUp * _preheatMargin) {
+        return tempTarget;
+      }
+    }
+    t = userSettings.getNextScheduleBoundary(t);
+  }
+  return _tempTarget;
+}
+
+bool ThermiteInternalState::_updateHeater(
+  const ThermiteUserSettingsManager& userSettings,
+  unsigned long updateAt,
+  time_t tUtc,
+  time_t tLocal
+) {
+  _heaterRuntime.accumulate(_heater, updateAt, tLocal);
+
+  if (_tempTarget == TEMP_DISCONNECTED || _temp == TEMP_DISCONNECTED) {
     /*
-     * Wait until we have a valid target temperature; this should be called after
-     * `_updateTargetTemperature()`.
+     * Wait until we have both a valid target temperature and a valid reading; this should
+     * be called after `_updateTargetTemperature()`.
      */
-    return;
+    return false;
   }
+  bool heater = _heater;
   if (_temp <= _tempTarget - _tempHysteresis) {
-    _heater = true;
+    heater = true;
   } else if (_temp >= _tempTarget + _tempHysteresis) {
-    _heater = false;
+    heater = false;
+  }
+  if (heater == _heater) {
+    return false;
+  }
+
+  if (_heaterRuntime.getSwitchDelay(heater, updateAt, userSettings._heaterSettings) > 0ul) {
+    return false;
   }
+  _heater = heater;
+  _heaterRuntime.recordSwitch(heater, updateAt, tUtc);
+  return true;
 }
 
-void ThermiteInternalState::_updateTargetTemperature() {
-  time_t tUtc = _ntpClient.getEpochTime();
-  time_t tLocal = _timezone.toLocal(tUtc);
-  _tempTarget = _userSettingsManager.getTargetTemperature(tLocal);
+void ThermiteInternalState::_updateTargetTemperature(
+  const ThermiteUserSettingsManager& userSettings,
+  time_t tLocal
+) {
+  _tempTarget = userSettings.getTargetTemperature(tLocal, _calendarCursor);
+
+  /*
+   * Until the model has seen enough, or without a reading to start from, the target just
+   * follows the schedule.
+   */
+  if (_preheatMargin > 0.0f
+    && _temp != TEMP_DISCONNECTED
+    && _thermalModel.getSamples() >= PREHEAT_SAMPLES_MIN) {
+    _tempTarget = _getPreheatTarget(userSettings, tLocal);
+  }
 }
 
-void ThermiteInternalState::_updateTemperature(unsigned long updateAt) {
+bool ThermiteInternalState::_updateTemperature(unsigned long updateAt) {
   if (updateAt < _tempLastRequestedAt) {
     /*
      * Underflow condition: `millis()` wraps around to zero every 50 days or so.  To
@@ -49,35 +144,130 @@ void ThermiteInternalState::_updateTemperature(unsigned long updateAt) {
      */
     _tempLastRequestedAt = updateAt;
   } else if (_tempLastRequestedAt == 0ul
-    || (updateAt - _tempLastRequestedAt > TEMP_REQUEST_INTERVAL)) {
+    || (updateAt - _tempLastRequestedAt > _tempRequestInterval)) {
     /*
      * We've either never requested a temperature (`lastRequestedAt == 0ul`), or the
      * request interval has elapsed.  Either way, request a new temperature reading.
      */
-    _thermometerManager.requestTemperatures();
+    _thermometer.requestTemperature();
     _tempLastRequestedAt = updateAt;
-  } else if (updateAt - _tempLastRequestedAt > TEMP_REQUEST_DELAY) {
+    _tempRead = false;
+  } else if (!_tempRead && updateAt - _tempLastRequestedAt > TEMP_REQUEST_DELAY) {
     /*
      * To read the DS18B20, you have to wait at least `TEMP_REQUEST_DELAY` ms after
-     * the previous temperature reading request.
+     * the previous temperature reading request.  Disconnected readings are retried on
+     * the next update.
      */
-    float tempNew = _thermometerManager.getTempC(_thermometer);
-    if (tempNew != DEVICE_DISCONNECTED_C) {
+    float tempNew = _thermometer.getTemperature();
+    if (tempNew != TEMP_DISCONNECTED) {
       _temp = tempNew;
+      _tempRead = true;
+      return true;
     }
   }
+  return false;
+}
+
+void ThermiteInternalState::_updateTelemetry(unsigned long updateAt, time_t tUtc) {
+  bool heartbeatDue = !_telemetrySent
+    || updateAt - _telemetrySentAt >= TELEMETRY_HEARTBEAT_INTERVAL;
+  if (!(_telemetryPending || heartbeatDue) || !_telemetry->isOnline()) {
+    return;
+  }
+  _telemetry->send(_telemetryZone, tUtc, _temp, _tempTarget, _heater, !_telemetryPending);
+  _telemetryPending = false;
+  _telemetrySent = true;
+  _telemetrySentAt = updateAt;
+}
+
+unsigned long ThermiteInternalState::getUpdateDelay(unsigned long now) const {
+  if (now < _tempLastRequestedAt || _tempLastRequestedAt == 0ul) {
+    return 0ul;
+  }
+  unsigned long elapsed = now - _tempLastRequestedAt;
+  if (elapsed <= TEMP_REQUEST_DELAY) {
+    return TEMP_REQUEST_DELAY + 1 - elapsed;
+  }
+  if (elapsed > _tempRequestInterval) {
+    return 0ul;
+  }
+  unsigned long delay = _tempRequestInterval + 1 - elapsed;
+
+  const ThermiteHeaterSettings& heaterSettings = _userSettingsStore.read()._heaterSettings;
+  unsigned long delaySwitch = _heaterRuntime.getSwitchDelay(!_heater, now, heaterSettings);
+  if (delaySwitch > 0ul && delaySwitch < delay) {
+    delay = delaySwitch;
+  }
+  return delay;
+}
+
+unsigned long ThermiteInternalState::getSleepDelay(unsigned long now) const {
+  unsigned long delay = getUpdateDelay(now);
+  unsigned long delayClock = _clock.getUpdateDelay(now);
+  if (delayClock < delay) {
+    delay = delayClock;
+  }
+
+  time_t tLocal = _clock.toLocal(_clock.getEpochTime(), nullptr);
+  time_t boundary = _userSettingsStore.read().getNextScheduleBoundary(tLocal);
+  if (boundary - tLocal < static_cast<time_t>(delay / 1000ul)) {
+    delay = (boundary - tLocal) * 1000ul;
+  }
+
+  /*
+   * An overdue heartbeat is left to the next update rather than allowed to spin the loop: it
+   * is only overdue while offline, and then there is nothing to do until WiFi is back.
+   */
+  if (_telemetry != nullptr && _telemetrySent) {
+    unsigned long elapsed = now - _telemetrySentAt;
+    if (elapsed < TELEMETRY_HEARTBEAT_INTERVAL && TELEMETRY_HEARTBEAT_INTERVAL - elapsed < delay) {
+      delay = TELEMETRY_HEARTBEAT_INTERVAL - elapsed;
+    }
+  }
+  return delay;
 }
 
 bool ThermiteInternalState::init() {
-  if (!_thermometerManager.getAddress(_thermometer, 0)) {
-    return false;  
+  return _thermometer.init();
+}
+
+bool ThermiteInternalState::restoreCheckpoint(unsigned long now) {
+  if (_rtcMemory == nullptr) {
+    return false;
+  }
+  ThermiteCheckpoint checkpoint;
+  if (!_rtcMemory->read(_rtcOffset, &checkpoint, sizeof(checkpoint))) {
+    return false;
   }
-  if (OneWire::crc8(_thermometer, 7) != _thermometer[7]) {
+  uint32_t crc = thermiteCrc32(
+    reinterpret_cast<const uint8_t*>(&checkpoint) + sizeof(checkpoint.crc),
+    sizeof(checkpoint) - sizeof(checkpoint.crc)
+  );
+  if (crc != checkpoint.crc || checkpoint.version != CHECKPOINT_VERSION) {
     return false;
   }
 
-  _thermometerManager.setResolution(_thermometer, TEMP_RESOLUTION);
-  _thermometerManager.setWaitForConversion(false);
+  _temp = checkpoint.temp;
+  _tempTarget = checkpoint.tempTarget;
+  _heater = checkpoint.heater != 0;
+  _heaterRuntime.restore(checkpoint.heaterRuntime, now);
+  _version++;
+  return true;
+}
+
+bool ThermiteInternalState::restoreThermalModel() {
+  if (_eeprom == nullptr) {
+    return false;
+  }
+  ThermiteThermalRecord record;
+  if (!_eeprom->read(_eepromOffset, &record, sizeof(record))) {
+    return false;
+  }
+  if (!_thermalModel.restore(record)) {
+    return false;
+  }
+  _heaterRuntime.restoreLifetime(record.runtimeLifetime);
+  _thermalModelSavedSamples = _thermalModel.getSamples();
   return true;
 }
 
@@ -85,6 +275,10 @@ bool ThermiteInternalState::toJSON(const JsonObject& root) const {
   if (!root["dateTime"].set(_dateTimeIso)) {
     return false;
   }
+  return toJSONValues(root);
+}
+
+bool ThermiteInternalState::toJSONValues(const JsonObject& root) const {
   if (!root["heater"].set(_heater)) {
     return false;
   }
@@ -98,29 +292,78 @@ bool ThermiteInternalState::toJSON(const JsonObject& root) const {
 }
 
 void ThermiteInternalState::update(unsigned long updateAt) {
-  _ntpClient.update();
-  _updateTemperature(updateAt);
-  _updateTargetTemperature();
-  _updateHeater();
+  float temp = _temp;
+  float tempTarget = _tempTarget;
+  bool heater = _heater;
+
+  _clock.update();
+  bool tempNew = _updateTemperature(updateAt);
+
+  time_t tUtc = _clock.getEpochTime();
+  time_t tLocal = _clock.toLocal(tUtc, nullptr);
+
+  /*
+   * Read one consistent image of the settings for the whole pass, however `PUT` requests
+   * interleave with it.
+   */
+  const ThermiteUserSettingsManager& userSettings = _userSettingsStore.read();
+  _updateTargetTemperature(userSettings, tLocal);
+  bool heaterSwitched = _updateHeater(userSettings, updateAt, tUtc, tLocal);
+  if (heaterSwitched) {
+    _history.addSwitch(tUtc, _heater);
+  }
+  if (tempNew && _tempTarget != TEMP_DISCONNECTED) {
+    _rollups.addSample(tUtc, tLocal, _temp, _tempTarget, _heater);
+    _history.addSample(tUtc, _temp, _tempTarget, _heater);
+  }
+  if (tempNew) {
+    _thermalModel.addReading(
+      updateAt,
+      tLocal,
+      _temp,
+      _heaterRuntime.getRuntimeLifetimeMillis()
+    );
+    uint32_t samplesUnsaved = _thermalModel.getSamples() - _thermalModelSavedSamples;
+    if (_eeprom != nullptr && samplesUnsaved >= THERMAL_MODEL_SAVE_SAMPLES) {
+      _saveThermalModel();
+    }
+  }
+  if (_rtcMemory != nullptr && (tempNew || heaterSwitched)) {
+    _saveCheckpoint(updateAt);
+  }
+  if (_temp != temp || _tempTarget != tempTarget || _heater != heater) {
+    _version++;
+    _telemetryPending = true;
+  }
+  if (_telemetry != nullptr) {
+    _updateTelemetry(updateAt, tUtc);
+  }
 }
 
 void ThermiteInternalState::updateDateTimeIso() {
-  time_t tUtc = _ntpClient.getEpochTime();
-  TimeChangeRule *tcr;
-  time_t tLocal = _timezone.toLocal(tUtc, &tcr);
+  time_t tUtc = _clock.getEpochTime();
+  if (tUtc == _dateTimeIsoAt) {
+    return;
+  }
+  _dateTimeIsoAt = tUtc;
+
+  int offset;
+  time_t tLocal = _clock.toLocal(tUtc, &offset);
+  ThermiteTimeElements tm;
+  thermiteBreakTime(tLocal, tm);
 
   snprintf(
     _dateTimeIso,
     DATE_TIME_ISO_LEN,
     "%04d-%02d-%02dT%02d:%02d:%02d%c%02d:%02d",
-    year(tLocal),
-    month(tLocal),
-    day(tLocal),
-    hour(tLocal),
-    minute(tLocal),
-    second(tLocal),
-    tcr->offset >= 0 ? '+' : '-',
-    abs(tcr->offset) / 60,
-    abs(tcr->offset) % 60
+    tm.year % 10000,
+    tm.month,
+    tm.day,
+    tm.hour,
+    tm.minute,
+    tm.second,
+    offset >= 0 ? '+' : '-',
+    (abs(offset) / 60) % 100,
+    abs(offset) % 60
   );
 }
\ No newline at end of file
@@ -1,38 +1,126 @@
 #ifndef _THERMITE_INTERNAL_STATE_H__
 #define _THERMITE_INTERNAL_STATE_H__
 
-#include <Arduino.h>
-#include <DallasTemperature.h>
-#include <NTPClient.h>
-#include <Timezone.h>
-
 #include "Constants.h"
 #include "JsonIO.h"
-#include "ThermiteUserSettingsManager.h"
+#include "ThermiteHal.h"
+#include "ThermiteHeaterRuntime.h"
+#include "ThermiteHistory.h"
+#include "ThermiteRollups.h"
+#include "ThermiteTelemetry.h"
+#include "ThermiteThermalEstimator.h"
+#include "ThermiteUserSettingsStore.h"
+
+/**
+ * Bump this whenever `ThermiteCheckpoint` changes layout, so that a checkpoint written by
+ * older firmware is ignored rather than misread.
+ */
+#define CHECKPOINT_VERSION 2
 
-#define TEMP_RESOLUTION 11
-#define TEMP_REQUEST_DELAY 750ul / (1ul << (12 - TEMP_RESOLUTION))
-#define TEMP_REQUEST_INTERVAL 60000ul
+/**
+ * Hot state of `ThermiteInternalState`, as kept in RTC memory so that control can continue
+ * straight after a soft reset (watchdog, exception or `ESP.restart()`).  The clock, shared by
+ * all zones, is checkpointed separately by `ThermiteZones`.
+ */
+struct ThermiteCheckpoint {
+  /**
+   * CRC-32 of everything after this field.
+   */
+  uint32_t crc;
+  uint32_t version;
+  float temp;
+  float tempTarget;
+  uint8_t heater;
+  uint8_t reserved[7];
+  ThermiteHeaterRuntimeCheckpoint heaterRuntime;
+};
 
-class ThermiteInternalState : public JsonWrite {
+class ThermiteInternalState : public JsonWrite<ThermiteInternalState> {
 private:
-  const ThermiteUserSettingsManager& _userSettingsManager;
-  DallasTemperature& _thermometerManager;
-  NTPClient& _ntpClient;
-  Timezone& _timezone;
+  const ThermiteUserSettingsStore& _userSettingsStore;
+  ThermiteThermometer& _thermometer;
+  ThermiteClock& _clock;
 
-  DeviceAddress _thermometer;
+  /**
+   * Where checkpoints are written, if anywhere.  Checkpoints are taken on every new
+   * temperature reading and every heater switch.
+   */
+  ThermiteRtcMemory* _rtcMemory;
+  uint32_t _rtcOffset;
+
+  /**
+   * Where `_thermalModel` is written, if anywhere, every `THERMAL_MODEL_SAVE_SAMPLES` samples.
+   */
+  ThermiteEeprom* _eeprom;
+  uint32_t _eepromOffset;
+
+  /**
+   * Where this zone's state is pushed, if anywhere: whenever `_temp`, `_tempTarget` or
+   * `_heater` change, and otherwise every `TELEMETRY_HEARTBEAT_INTERVAL` ms.  Changes made
+   * while offline are held until `_telemetry` is back online.
+   */
+  ThermiteTelemetry* _telemetry;
+  uint8_t _telemetryZone;
+  bool _telemetryPending;
+  bool _telemetrySent;
+  unsigned long _telemetrySentAt;
 
   /**
    * Used to store date and time in the ISO 8601-compliant format `"2020-05-09T10:58:27-04:00"`.
    */
   char _dateTimeIso[DATE_TIME_ISO_LEN];
+
+  /**
+   * UTC time that `_dateTimeIso` was last formatted for.
+   */
+  time_t _dateTimeIsoAt;
+
+  /**
+   * Bumped whenever anything in `toJSONValues()` changes, so that readers can tell when a copy
+   * they hold (e.g. a serialized response) is stale.  `dateTime` changes every second, and is
+   * left out.
+   */
+  uint32_t _version;
+
+  /**
+   * Where `_updateTargetTemperature()` last found itself in the user settings' calendar.
+   */
+  ThermiteCalendarCursor _calendarCursor;
   
   /**
    * Should the heater be on?
    */
   bool _heater;
 
+  /**
+   * Runtime counters and switch history for `_heater`, also used to enforce
+   * `ThermiteHeaterSettings`.
+   */
+  ThermiteHeaterRuntime _heaterRuntime;
+
+  /**
+   * Minute, hour and day summaries of `_temp`, `_tempTarget` and `_heater`, fed once per
+   * temperature reading.
+   */
+  ThermiteRollups _rollups;
+
+  /**
+   * Every sample that goes into `_rollups`, and every heater switch, kept on flash if there
+   * is a file system.
+   */
+  ThermiteHistory _history;
+
+  /**
+   * Heating rate, heat loss and equilibrium temperature, learned from `_temp` and
+   * `_heaterRuntime` once per temperature reading.
+   */
+  ThermiteThermalEstimator _thermalModel;
+
+  /**
+   * `_thermalModel.getSamples()` when it was last written to `_eeprom`.
+   */
+  uint32_t _thermalModelSavedSamples;
+
   /**
    * Last measured temperature, in degrees Celsius.
    * 
@@ -45,10 +133,21 @@ private:
    * Timestamp at which the last temperature reading was measured.
    * 
    * To keep these regularly scheduled regardless of NTP reachability, clock drift, etc. we use
-   * `millis()` to record this from the internal clock.
+   * `ThermiteClock::getMillis()` to record this from the internal clock.
    */
   unsigned long _tempLastRequestedAt;
 
+  /**
+   * Has the measurement requested at `_tempLastRequestedAt` been read yet?  Each request is
+   * read once, so that every reading is a fresh sample.
+   */
+  bool _tempRead;
+
+  /**
+   * Interval between temperature requests, in ms.  Defaults to `TEMP_REQUEST_INTERVAL`.
+   */
+  unsigned long _tempRequestInterval;
+
   /**
    * Last measured target temperature, in degrees Celsius.
    * 
@@ -56,30 +155,128 @@ private:
    */
   float _tempTarget;
 
+  /**
+   * How early to start heating for a coming rise in target temperature, as a multiple of
+   * the warm-up time `_thermalModel` predicts; zero turns preheating off.  Defaults to
+   * `PREHEAT_MARGIN_DEFAULT`.
+   */
+  float _preheatMargin;
+
   /**
    * Hysteresis threshold for temperature targets.
    * 
    * When the heater is off and the temperature is below `_tempTarget - _tempHysteresis`, the heater
    * is turned on.  When the heater is on and the temperature is above `_tempTarget + _tempHysteresis`,
    * the heater is turned off.
+   * 
+   * Either switch is held back until `ThermiteHeaterSettings` allows it.
    */
   float _tempHysteresis;
 
-  void _updateHeater();
-  void _updateTargetTemperature();
-  void _updateTemperature(unsigned long updateAt);
+  void _saveCheckpoint(unsigned long now) const;
+  void _saveThermalModel();
+
+  /**
+   * Returns the target temperature of the first rise within `PREHEAT_LOOKAHEAD_MAX` of local
+   * time `tLocal` that heating should already have started for, or `_tempTarget` if there is
+   * none.
+   */
+  float _getPreheatTarget(const ThermiteUserSettingsManager& userSettings, time_t tLocal) const;
+  bool _updateHeater(
+    const ThermiteUserSettingsManager& userSettings,
+    unsigned long updateAt,
+    time_t tUtc,
+    time_t tLocal
+  );
+  void _updateTargetTemperature(const ThermiteUserSettingsManager& userSettings, time_t tLocal);
+  void _updateTelemetry(unsigned long updateAt, time_t tUtc);
+  bool _updateTemperature(unsigned long updateAt);
 public:
   ThermiteInternalState(
-    const ThermiteUserSettingsManager& userSettingsManager,
-    DallasTemperature& thermometerManager,
-    NTPClient& ntpClient,
-    Timezone& timezone
+    const ThermiteUserSettingsStore& userSettingsStore,
+    ThermiteThermometer& thermometer,
+    ThermiteClock& clock
   );
 
   bool getHeater() const { return _heater; }
+  const ThermiteHeaterRuntime& getHeaterRuntime() const { return _heaterRuntime; }
+  const ThermiteHistory& getHistory() const { return _history; }
+  const ThermiteRollups& getRollups() const { return _rollups; }
+  const ThermiteThermalEstimator& getThermalModel() const { return _thermalModel; }
+  float getTemp() const { return _temp; }
+  float getTempTarget() const { return _tempTarget; }
+  const char* getDateTimeIso() const { return _dateTimeIso; }
+  uint32_t getVersion() const { return _version; }
+
+  /**
+   * Returns how long, in ms after `now`, `update()` can next change anything: i.e. the time
+   * until the next temperature request or reading, or until a held-back heater switch is
+   * allowed.  This does not include changes of target temperature; see
+   * `ThermiteUserSettingsManager::getNextScheduleBoundary()` for those.
+   */
+  unsigned long getUpdateDelay(unsigned long now) const;
+
+  /**
+   * Returns how long, in ms after `now`, until anything at all is due: `getUpdateDelay()`,
+   * the next clock synchronization, the next change of target temperature, or the next
+   * telemetry heartbeat.  The device can sleep until then.
+   */
+  unsigned long getSleepDelay(unsigned long now) const;
+
   bool init();
+
+  /**
+   * Writes any full history block to flash.  This may take a few ms, so `ThermiteZones` calls
+   * it once the relays have been driven.
+   */
+  void persistHistory() { _history.flush(); }
+
+  /**
+   * Restores state from the last checkpoint in `_rtcMemory`; `ThermiteZones` restores the
+   * clock.  Returns `false` (and changes nothing) if there is no valid checkpoint, e.g. after
+   * a power cycle.
+   */
+  bool restoreCheckpoint(unsigned long now);
+  /**
+   * Restores the thermal model, and the heater's lifetime runtime, from `_eeprom`.  Returns `false` (and changes nothing) if there
+   * is no valid record, e.g. on first boot.
+   */
+  bool restoreThermalModel();
+
+  /**
+   * Finds this zone's history on the file system.  Returns `false` if there is none.
+   */
+  bool restoreHistory() { return _history.restore(); }
+  void setEeprom(ThermiteEeprom* eeprom, uint32_t eepromOffset = EEPROM_OFFSET_THERMAL_MODEL) {
+    _eeprom = eeprom;
+    _eepromOffset = eepromOffset;
+  }
+  void setRtcMemory(ThermiteRtcMemory* rtcMemory, uint32_t rtcOffset = RTC_OFFSET_CHECKPOINT) {
+    _rtcMemory = rtcMemory;
+    _rtcOffset = rtcOffset;
+  }
+  void setFileSystem(ThermiteFileSystem* fileSystem, uint8_t zone = 0) {
+    _history.setFileSystem(fileSystem, zone);
+  }
+  void setTelemetry(ThermiteTelemetry* telemetry, uint8_t zone = 0) {
+    _telemetry = telemetry;
+    _telemetryZone = zone;
+  }
+  void setPreheatMargin(float preheatMargin) { _preheatMargin = preheatMargin; }
+  void setTempHysteresis(float tempHysteresis) { _tempHysteresis = tempHysteresis; }
+  void setTempRequestInterval(unsigned long tempRequestInterval) { _tempRequestInterval = tempRequestInterval; }
   bool toJSON(const JsonObject& root) const;
+
+  /**
+   * Writes everything `toJSON()` does except `dateTime`: what `_version` covers.
+   */
+  bool toJSONValues(const JsonObject& root) const;
   void update(unsigned long updateAt);
+
+  /**
+   * Formats the current time into `_dateTimeIso`, for `toJSON()`; this is a no-op until the
+   * clock moves on to the next second.
+   */
   void updateDateTimeIso();
 };
 
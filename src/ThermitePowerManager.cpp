@@ -0,0 +1,154 @@
+#include "ThermitePowerManager.h"
+
+ThermitePowerManager::ThermitePowerManager(
+  ThermiteRadio& radio,
+  ThermiteClock& clock,
+  uint8_t mode,
+  uint8_t listenInterval
+) : _radio(radio),
+    _clock(clock),
+    _mode(mode),
+    _listenInterval(listenInterval),
+    _modeActive(POWER_MODE_AWAKE),
+    _requested(false),
+    _requestAt(0ul),
+    _accounted(false),
+    _accountedAt(0ul),
+    _requestCount(0ul),
+    _requestCountAsleep(0ul) {
+  for (uint8_t i = 0; i < 3; i++) {
+    _timeInMode[i] = 0ull;
+  }
+}
+
+void ThermitePowerManager::_account(unsigned long now) {
+  if (!_accounted) {
+    _accounted = true;
+    _accountedAt = now;
+    return;
+  }
+  uint32_t elapsed = static_cast<uint32_t>(now - _accountedAt);
+  _accountedAt = now;
+  if (_modeActive == POWER_MODE_AWAKE) {
+    _timeInMode[POWER_MODE_AWAKE] += elapsed;
+    return;
+  }
+
+  /*
+   * `loop()` wakes the CPU at least once per `POWER_SLEEP_MAX` ms, even when nothing else
+   * is due.
+   */
+  uint32_t wakeCount = (elapsed + POWER_SLEEP_MAX - 1) / POWER_SLEEP_MAX;
+  if (wakeCount == 0) {
+    wakeCount = 1;
+  }
+  uint32_t awake = wakeCount * POWER_WAKE_TIME;
+  if (awake > elapsed) {
+    awake = elapsed;
+  }
+  _timeInMode[POWER_MODE_AWAKE] += awake;
+  _timeInMode[_modeActive] += elapsed - awake;
+}
+
+void ThermitePowerManager::_apply(uint8_t mode) {
+  _modeActive = mode;
+  _radio.setSleepMode(mode, _listenInterval);
+}
+
+bool ThermitePowerManager::_isSessionActive(unsigned long now) const {
+  return _requested && static_cast<uint32_t>(now - _requestAt) < POWER_SESSION_TIMEOUT;
+}
+
+void ThermitePowerManager::noteRequest() {
+  unsigned long now = _clock.getMillis();
+  _account(now);
+  _requestCount++;
+  if (_modeActive != POWER_MODE_AWAKE) {
+    _requestCountAsleep++;
+    _apply(POWER_MODE_AWAKE);
+  }
+  _requested = true;
+  _requestAt = now;
+}
+
+unsigned long ThermitePowerManager::update(unsigned long now, unsigned long deadline) {
+  _account(now);
+  uint8_t mode = _isSessionActive(now) ? POWER_MODE_AWAKE : _mode;
+  if (mode != _modeActive) {
+    _apply(mode);
+  }
+  if (mode == POWER_MODE_AWAKE) {
+    return LOOP_INTERVAL;
+  }
+  return deadline < POWER_SLEEP_MAX ? deadline : POWER_SLEEP_MAX;
+}
+
+float ThermitePowerManager::getCurrentAverage() const {
+  uint64_t total = _timeInMode[POWER_MODE_AWAKE]
+    + _timeInMode[POWER_MODE_MODEM_SLEEP]
+    + _timeInMode[POWER_MODE_LIGHT_SLEEP];
+  if (total == 0ull) {
+    return _mode == POWER_MODE_AWAKE ? POWER_CURRENT_AWAKE : 0.0f;
+  }
+  double charge = _timeInMode[POWER_MODE_AWAKE] * static_cast<double>(POWER_CURRENT_AWAKE)
+    + _timeInMode[POWER_MODE_MODEM_SLEEP] * static_cast<double>(POWER_CURRENT_MODEM_SLEEP)
+    + _timeInMode[POWER_MODE_LIGHT_SLEEP] * static_cast<double>(POWER_CURRENT_LIGHT_SLEEP);
+  return static_cast<float>(charge / total);
+}
+
+unsigned long ThermitePowerManager::getSessionDelay(unsigned long now) const {
+  if (!_isSessionActive(now)) {
+    return 0ul;
+  }
+  return POWER_SESSION_TIMEOUT - static_cast<uint32_t>(now - _requestAt);
+}
+
+uint32_t ThermitePowerManager::getTimeInMode(uint8_t mode) const {
+  return static_cast<uint32_t>(_timeInMode[mode] / 1000ull);
+}
+
+unsigned long ThermitePowerManager::getWakeLatency(unsigned long now) const {
+  if (_modeActive == POWER_MODE_AWAKE) {
+    return 0ul;
+  }
+  unsigned long period = getWakeLatencyMax();
+  return period - now % period;
+}
+
+unsigned long ThermitePowerManager::getWakeLatencyMax() const {
+  if (_mode == POWER_MODE_AWAKE) {
+    return 0ul;
+  }
+  return (_listenInterval * POWER_BEACON_INTERVAL_US + 999ul) / 1000ul;
+}
+
+bool ThermitePowerManager::toJSON(const JsonObject& root) const {
+  if (!root["mode"].set(_mode)) {
+    return false;
+  }
+  if (!root["listenInterval"].set(_listenInterval)) {
+    return false;
+  }
+  if (!root["timeAwake"].set(getTimeInMode(POWER_MODE_AWAKE))) {
+    return false;
+  }
+  if (!root["timeModemSleep"].set(getTimeInMode(POWER_MODE_MODEM_SLEEP))) {
+    return false;
+  }
+  if (!root["timeLightSleep"].set(getTimeInMode(POWER_MODE_LIGHT_SLEEP))) {
+    return false;
+  }
+  if (!root["currentAverage"].set(getCurrentAverage())) {
+    return false;
+  }
+  if (!root["wakeLatencyMax"].set(getWakeLatencyMax())) {
+    return false;
+  }
+  if (!root["requests"].set(_requestCount)) {
+    return false;
+  }
+  if (!root["requestsAsleep"].set(_requestCountAsleep)) {
+    return false;
+  }
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#ifndef _THERMITE_POWER_MANAGER_H__
+#define _THERMITE_POWER_MANAGER_H__
+
+#include <stdint.h>
+
+#include "Constants.h"
+#include "JsonIO.h"
+#include "ThermiteHal.h"
+
+/**
+ * Beacon interval used by almost every access point: 100 TU, i.e. 102.4 ms.
+ */
+#define POWER_BEACON_INTERVAL_US 102400ul
+
+/**
+ * Typical ESP8266 supply current in each power mode, in mA, from the datasheet.  Sleep figures
+ * include the periodic DTIM wake-ups.
+ */
+#define POWER_CURRENT_AWAKE 70.0f
+#define POWER_CURRENT_MODEM_SLEEP 15.0f
+#define POWER_CURRENT_LIGHT_SLEEP 0.9f
+
+/**
+ * Time the CPU and radio spend awake each time `loop()` runs while sleeping, in ms.
+ */
+#define POWER_WAKE_TIME 3ul
+
+/**
+ * Puts the radio to sleep between controller deadlines, and keeps track of how long it spent
+ * in each power mode.
+ * 
+ * In `POWER_MODE_AWAKE` (the default) the radio is left as the SDK configures it, and `loop()`
+ * runs every `LOOP_INTERVAL` ms as it always has.  In either sleep mode, `loop()` only runs
+ * when something is due (capped at `POWER_SLEEP_MAX` ms, so settings changes are still picked
+ * up promptly), and the radio sleeps in between.  Incoming requests are still received at the
+ * next DTIM beacon, which bounds the latency they see; after a request, the radio stays fully
+ * awake for `POWER_SESSION_TIMEOUT` ms so the rest of that session is not slowed down.
+ * 
+ * Current draw cannot be measured from the device itself, so it is estimated from the time
+ * spent in each mode and the datasheet figures above.
+ */
+class ThermitePowerManager : public JsonWrite<ThermitePowerManager> {
+private:
+  ThermiteRadio& _radio;
+  ThermiteClock& _clock;
+  uint8_t _mode;
+  uint8_t _listenInterval;
+
+  /**
+   * Mode the radio is in right now: `_mode`, or `POWER_MODE_AWAKE` during a session.
+   */
+  uint8_t _modeActive;
+
+  bool _requested;
+  unsigned long _requestAt;
+
+  bool _accounted;
+  unsigned long _accountedAt;
+
+  /**
+   * Time spent in each `POWER_MODE_*`, in ms.
+   */
+  uint64_t _timeInMode[3];
+
+  uint32_t _requestCount;
+  uint32_t _requestCountAsleep;
+
+  void _account(unsigned long now);
+  void _apply(uint8_t mode);
+  bool _isSessionActive(unsigned long now) const;
+public:
+  ThermitePowerManager(
+    ThermiteRadio& radio,
+    ThermiteClock& clock,
+    uint8_t mode = POWER_MODE_DEFAULT,
+    uint8_t listenInterval = POWER_LISTEN_INTERVAL
+  );
+
+  /**
+   * Records an incoming HTTP request, and wakes the radio up for the rest of the session.
+   */
+  void noteRequest();
+
+  /**
+   * Puts the radio in the right mode for `now`, given that nothing is due for another
+   * `deadline` ms, and returns how long `loop()` may now wait.
+   */
+  unsigned long update(unsigned long now, unsigned long deadline);
+
+  /**
+   * Returns the estimated mean supply current so far, in mA.
+   */
+  float getCurrentAverage() const;
+  uint8_t getModeActive() const { return _modeActive; }
+
+  /**
+   * Returns how long, in ms after `now`, until the current HTTP session times out (or zero
+   * if there is none).
+   */
+  unsigned long getSessionDelay(unsigned long now) const;
+
+  /**
+   * Returns the time spent in `mode` so far, in seconds.
+   */
+  uint32_t getTimeInMode(uint8_t mode) const;
+
+  /**
+   * Returns how long a request arriving at `now` waits for the radio to wake up, in ms.
+   */
+  unsigned long getWakeLatency(unsigned long now) const;
+
+  /**
+   * Returns the longest wake-up latency a request can see in the configured mode, in ms.
+   */
+  unsigned long getWakeLatencyMax() const;
+
+  bool toJSON(const JsonObject& root) const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include <string.h>
+
+#include "ThermiteResponsePool.h"
+
+static_assert(CAPACITY_CALENDAR <= CAPACITY_RESPONSE_MAX, "CAPACITY_RESPONSE_MAX too small");
+static_assert(CAPACITY_HEATER_RUNTIME <= CAPACITY_RESPONSE_MAX, "CAPACITY_RESPONSE_MAX too small");
+static_assert(CAPACITY_INTERNAL_STATE <= CAPACITY_RESPONSE_MAX, "CAPACITY_RESPONSE_MAX too small");
+static_assert(CAPACITY_POWER_MANAGER <= CAPACITY_RESPONSE_MAX, "CAPACITY_RESPONSE_MAX too small");
+static_assert(CAPACITY_THERMAL_MODEL <= CAPACITY_RESPONSE_MAX, "CAPACITY_RESPONSE_MAX too small");
+static_assert(CAPACITY_USER_SETTINGS_MANAGER <= CAPACITY_RESPONSE_MAX, "CAPACITY_RESPONSE_MAX too small");
+static_assert(CAPACITY_ZONES <= CAPACITY_RESPONSE_MAX, "CAPACITY_RESPONSE_MAX too small");
+
+ThermiteResponseBuffer::ThermiteResponseBuffer()
+: _pool(nullptr),
+  _slot(-1) {}
+
+ThermiteResponseBuffer::ThermiteResponseBuffer(ThermiteResponsePool* pool, int8_t slot)
+: _pool(pool),
+  _slot(slot) {}
+
+ThermiteResponseBuffer::ThermiteResponseBuffer(const ThermiteResponseBuffer& other)
+: _pool(other._pool),
+  _slot(other._slot) {
+  if (_pool != nullptr) {
+    _pool->_retain(_slot);
+  }
+}
+
+ThermiteResponseBuffer::ThermiteResponseBuffer(ThermiteResponseBuffer&& other)
+: _pool(other._pool),
+  _slot(other._slot) {
+  other._pool = nullptr;
+  other._slot = -1;
+}
+
+ThermiteResponseBuffer::~ThermiteResponseBuffer() {
+  release();
+}
+
+ThermiteResponseBuffer& ThermiteResponseBuffer::operator=(const ThermiteResponseBuffer& other) {
+  if (this != &other) {
+    if (other._pool != nullptr) {
+      other._pool->_retain(other._slot);
+    }
+    release();
+    _pool = other._pool;
+    _slot = other._slot;
+  }
+  return *this;
+}
+
+ThermiteResponseBuffer& ThermiteResponseBuffer::operator=(ThermiteResponseBuffer&& other) {
+  if (this != &other) {
+    release();
+    _pool = other._pool;
+    _slot = other._slot;
+    other._pool = nullptr;
+    other._slot = -1;
+  }
+  return *this;
+}
+
+bool ThermiteResponseBuffer::isValid() const {
+  return _pool != nullptr;
+}
+
+const char* ThermiteResponseBuffer::getData() const {
+  if (_pool == nullptr) {
+    return nullptr;
+  }
+  return _pool->_buffers[_slot];
+}
+
+size_t ThermiteResponseBuffer::getLength() const {
+  if (_pool == nullptr) {
+    return 0;
+  }
+  return _pool->_lengths[_slot];
+}
+
+void ThermiteResponseBuffer::release() {
+  if (_pool != nullptr) {
+    _pool->_release(_slot);
+    _pool = nullptr;
+    _slot = -1;
+  }
+}
+
+ThermiteResponsePool::ThermiteResponsePool()
+: _exhaustedCount(0ul),
+  _overflowCount(0ul),
+  _serializeCount(0ul) {
+  memset(_refs, 0, sizeof(_refs));
+}
+
+void ThermiteResponsePool::_release(int8_t slot) {
+  _refs[slot]--;
+}
+
+void ThermiteResponsePool::_retain(int8_t slot) {
+  _refs[slot]++;
+}
+
+ThermiteResponseBuffer ThermiteResponsePool::serialize(JsonWriteRef body) {
+  int8_t slot = -1;
+  for (int8_t i = 0; i < RESPONSE_POOL_SIZE; i++) {
+    if (_refs[i] == 0) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot < 0) {
+    _exhaustedCount++;
+    return ThermiteResponseBuffer();
+  }
+
+  _doc.clear();
+  const JsonObject& root = _doc.to<JsonObject>();
+  if (!body.toJSON(root) || measureJson(_doc) >= RESPONSE_BUFFER_SIZE) {
+    _overflowCount++;
+    return ThermiteResponseBuffer();
+  }
+  _lengths[slot] = serializeJson(_doc, _buffers[slot], RESPONSE_BUFFER_SIZE);
+  _refs[slot] = 1;
+  _serializeCount++;
+  return ThermiteResponseBuffer(this, slot);
+}
+
+uint8_t ThermiteResponsePool::getAvailable() const {
+  uint8_t available = 0;
+  for (uint8_t i = 0; i < RESPONSE_POOL_SIZE; i++) {
+    if (_refs[i] == 0) {
+      available++;
+    }
+  }
+  return available;
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef _THERMITE_RESPONSE_POOL_H__
+#define _THERMITE_RESPONSE_POOL_H__
+
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Constants.h"
+#include "JsonIO.h"
+
+class ThermiteResponsePool;
+
+/**
+ * Serialized response body, shared out of a `ThermiteResponsePool`.  Copies share the same
+ * buffer, which goes back to the pool once the last of them is destroyed (or `release()`d);
+ * a copy can travel with a response that outlives the handler that built it.
+ */
+class ThermiteResponseBuffer {
+private:
+  ThermiteResponsePool* _pool;
+  int8_t _slot;
+
+  ThermiteResponseBuffer(ThermiteResponsePool* pool, int8_t slot);
+  friend class ThermiteResponsePool;
+public:
+  ThermiteResponseBuffer();
+  ThermiteResponseBuffer(const ThermiteResponseBuffer& other);
+  ThermiteResponseBuffer(ThermiteResponseBuffer&& other);
+  ~ThermiteResponseBuffer();
+
+  ThermiteResponseBuffer& operator=(const ThermiteResponseBuffer& other);
+  ThermiteResponseBuffer& operator=(ThermiteResponseBuffer&& other);
+
+  /**
+   * Whether this holds a body at all; `ThermiteResponsePool::serialize()` returns an empty
+   * buffer on failure.
+   */
+  bool isValid() const;
+  const char* getData() const;
+  size_t getLength() const;
+  void release();
+};
+
+/**
+ * Fixed set of response buffers, sized from the `CAPACITY_*` constants and reserved at boot,
+ * so that JSON responses never touch the heap.
+ * 
+ * Handlers run one at a time, so a single `JsonDocument` is shared for building every body;
+ * only the serialized text needs to live on until the client has read it.
+ */
+class ThermiteResponsePool {
+private:
+  StaticJsonDocument<CAPACITY_RESPONSE_MAX> _doc;
+  char _buffers[RESPONSE_POOL_SIZE][RESPONSE_BUFFER_SIZE];
+  size_t _lengths[RESPONSE_POOL_SIZE];
+  uint8_t _refs[RESPONSE_POOL_SIZE];
+  unsigned long _exhaustedCount;
+  unsigned long _overflowCount;
+  unsigned long _serializeCount;
+
+  void _release(int8_t slot);
+  void _retain(int8_t slot);
+  friend class ThermiteResponseBuffer;
+public:
+  ThermiteResponsePool();
+
+  /**
+   * Serializes `body` into a free buffer.  Returns an empty buffer if every buffer is in use,
+   * or if `body` does not fit.
+   */
+  ThermiteResponseBuffer serialize(JsonWriteRef body);
+
+  uint8_t getAvailable() const;
+  unsigned long getExhaustedCount() const { return _exhaustedCount; }
+  unsigned long getOverflowCount() const { return _overflowCount; }
+  unsigned long getSerializeCount() const { return _serializeCount; }
+};
+
+#endif
\ No newline at end of file
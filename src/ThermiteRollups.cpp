@@ -0,0 +1,213 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ThermiteRollups.h"
+
+static int16_t toCenti(float temp) {
+  float centi = roundf(temp * 100.0f);
+  if (centi > INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (centi < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return static_cast<int16_t>(centi);
+}
+
+ThermiteRollupTier::ThermiteRollupTier(
+  const char* name,
+  ThermiteRollupBucket* buckets,
+  uint16_t size,
+  uint32_t width
+)
+: _name(name),
+  _buckets(buckets),
+  _size(size),
+  _index(0),
+  _count(0),
+  _width(width),
+  _closed(0ul),
+  _openT(0ul),
+  _openStartLocal(0ul),
+  _openTempMin(0.0f),
+  _openTempMax(0.0f),
+  _openTempSum(0.0f),
+  _openTempTargetSum(0.0f),
+  _openCount(0),
+  _openHeaterCount(0) {}
+
+ThermiteRollupBucket ThermiteRollupTier::_summarizeOpen() const {
+  ThermiteRollupBucket bucket;
+  bucket._t = _openT;
+  bucket._tempMin = toCenti(_openTempMin);
+  bucket._tempMax = toCenti(_openTempMax);
+  bucket._tempMean = toCenti(_openTempSum / _openCount);
+  bucket._tempTargetMean = toCenti(_openTempTargetSum / _openCount);
+  bucket._heaterDuty = static_cast<uint8_t>(
+    (_openHeaterCount * 100u + _openCount / 2u) / _openCount
+  );
+  return bucket;
+}
+
+void ThermiteRollupTier::_close() {
+  _buckets[_index] = _summarizeOpen();
+  _index = (_index + 1) % _size;
+  if (_count < _size) {
+    _count++;
+  }
+  _closed++;
+  _openCount = 0;
+}
+
+void ThermiteRollupTier::addSample(
+  time_t tUtc,
+  time_t tLocal,
+  float temp,
+  float tempTarget,
+  bool heater
+) {
+  uint32_t offset = static_cast<uint32_t>(tLocal) % _width;
+  uint32_t startLocal = static_cast<uint32_t>(tLocal) - offset;
+  if (_openCount > 0 && startLocal != _openStartLocal) {
+    _close();
+  }
+  if (_openCount == 0) {
+    _openT = static_cast<uint32_t>(tUtc) - offset;
+    _openStartLocal = startLocal;
+    _openTempMin = temp;
+    _openTempMax = temp;
+    _openTempSum = 0.0f;
+    _openTempTargetSum = 0.0f;
+    _openHeaterCount = 0;
+  }
+  if (temp < _openTempMin) {
+    _openTempMin = temp;
+  }
+  if (temp > _openTempMax) {
+    _openTempMax = temp;
+  }
+  _openTempSum += temp;
+  _openTempTargetSum += tempTarget;
+  _openCount++;
+  if (heater) {
+    _openHeaterCount++;
+  }
+}
+
+ThermiteRollupBucket ThermiteRollupTier::getBucket(uint16_t i) const {
+  if (i < _count) {
+    return _buckets[(_index + _size - _count + i) % _size];
+  }
+  return _summarizeOpen();
+}
+
+bool ThermiteRollupTier::getClosedBucket(uint32_t seq, ThermiteRollupBucket& bucket) const {
+  uint32_t age = _closed - seq;
+  if (seq >= _closed || age > _count) {
+    return false;
+  }
+  bucket = _buckets[(_index + _size - age) % _size];
+  return true;
+}
+
+ThermiteRollups::ThermiteRollups()
+: _minutes("minute", _minuteBuckets, ROLLUP_MINUTE_SIZE, SECONDS_PER_MINUTE),
+  _hours("hour", _hourBuckets, ROLLUP_HOUR_SIZE, SECONDS_PER_HOUR),
+  _days("day", _dayBuckets, ROLLUP_DAY_SIZE, SECONDS_PER_DAY) {}
+
+void ThermiteRollups::addSample(
+  time_t tUtc,
+  time_t tLocal,
+  float temp,
+  float tempTarget,
+  bool heater
+) {
+  _minutes.addSample(tUtc, tLocal, temp, tempTarget, heater);
+  _hours.addSample(tUtc, tLocal, temp, tempTarget, heater);
+  _days.addSample(tUtc, tLocal, temp, tempTarget, heater);
+}
+
+const ThermiteRollupTier* ThermiteRollups::getTier(const char* name) const {
+  if (name == nullptr) {
+    return nullptr;
+  }
+  if (strcmp(name, _minutes.getName()) == 0) {
+    return &_minutes;
+  }
+  if (strcmp(name, _hours.getName()) == 0) {
+    return &_hours;
+  }
+  if (strcmp(name, _days.getName()) == 0) {
+    return &_days;
+  }
+  return nullptr;
+}
+
+ThermiteRollupsBody::ThermiteRollupsBody(const ThermiteRollupTier& tier)
+: _tier(tier),
+  _first(tier.getClosed() - tier.getClosedCount()),
+  _end(tier.getClosed()),
+  _hasOpen(tier.isOpen()),
+  _seq(_first),
+  _empty(true),
+  _stage(ROLLUPS_BODY_HEADER) {
+  if (_hasOpen) {
+    _open = tier.getBucket(tier.getClosedCount());
+  }
+}
+
+size_t ThermiteRollupsBody::_nextLine(char* line, size_t size) {
+  ThermiteRollupBucket bucket;
+  switch (_stage) {
+    case ROLLUPS_BODY_HEADER:
+      _stage = ROLLUPS_BODY_COLUMNS;
+      return snprintf(
+        line,
+        size,
+        "{\"tier\":\"%s\",\"width\":%lu,",
+        _tier.getName(),
+        (unsigned long) _tier.getWidth()
+      );
+    case ROLLUPS_BODY_COLUMNS:
+      _stage = ROLLUPS_BODY_BUCKETS;
+      return snprintf(
+        line,
+        size,
+        "\"columns\":[\"t\",\"tempMin\",\"tempMax\",\"tempMean\",\"tempTargetMean\","
+        "\"heaterDuty\"],\"buckets\":["
+      );
+    case ROLLUPS_BODY_BUCKETS:
+      while (_seq < _end) {
+        if (_tier.getClosedBucket(_seq++, bucket)) {
+          return _printBucket(line, size, bucket);
+        }
+      }
+      if (_hasOpen) {
+        _hasOpen = false;
+        return _printBucket(line, size, _open);
+      }
+      _stage = ROLLUPS_BODY_DONE;
+      return snprintf(line, size, "]}");
+    default:
+      return 0;
+  }
+}
+
+size_t ThermiteRollupsBody::_printBucket(
+  char* line,
+  size_t size,
+  const ThermiteRollupBucket& bucket
+) {
+  size_t len = snprintf(line, size, "%s[%lu,", _empty ? "" : ",", (unsigned long) bucket._t);
+  len += _printCenti(line + len, size - len, bucket._tempMin);
+  line[len++] = ',';
+  len += _printCenti(line + len, size - len, bucket._tempMax);
+  line[len++] = ',';
+  len += _printCenti(line + len, size - len, bucket._tempMean);
+  line[len++] = ',';
+  len += _printCenti(line + len, size - len, bucket._tempTargetMean);
+  len += snprintf(line + len, size - len, ",%u]", (unsigned) bucket._heaterDuty);
+  _empty = false;
+  return len;
+}
\ No newline at end of file
@@ -0,0 +1,169 @@
+#ifndef _THERMITE_ROLLUPS_H__
+#define _THERMITE_ROLLUPS_H__
+
+#include <stdint.h>
+#include <time.h>
+
+#include "Constants.h"
+#include "ThermiteChunkedBody.h"
+
+/**
+ * Summary of temperature samples over one fixed-width time interval.
+ * 
+ * Temperatures are stored in hundredths of a degree Celsius to keep buckets small: this is
+ * well below the DS18B20's resolution.
+ */
+struct ThermiteRollupBucket {
+  /**
+   * Start of the interval (UTC), in seconds since the Unix epoch.
+   */
+  uint32_t _t;
+
+  int16_t _tempMin;
+  int16_t _tempMax;
+  int16_t _tempMean;
+  int16_t _tempTargetMean;
+
+  /**
+   * Percentage of samples in the interval for which the heater was on.
+   */
+  uint8_t _heaterDuty;
+};
+
+/**
+ * Fixed-size ring buffer of `ThermiteRollupBucket`s of a given width, plus the bucket
+ * currently being filled.
+ * 
+ * Buckets are aligned to local time, so that e.g. daily buckets run from midnight to midnight.
+ * Intervals without samples get no bucket at all.
+ */
+class ThermiteRollupTier {
+private:
+  const char* _name;
+  ThermiteRollupBucket* _buckets;
+  uint16_t _size;
+  uint16_t _index;
+  uint16_t _count;
+  uint32_t _width;
+
+  /**
+   * Buckets closed so far, ever: the sequence number of the next one to close.
+   */
+  uint32_t _closed;
+
+  /**
+   * Bucket currently being filled.  `_openStartLocal` is its start in local time, and is
+   * used to detect when a sample falls into a new bucket.
+   */
+  uint32_t _openT;
+  uint32_t _openStartLocal;
+  float _openTempMin;
+  float _openTempMax;
+  float _openTempSum;
+  float _openTempTargetSum;
+  uint16_t _openCount;
+  uint16_t _openHeaterCount;
+
+  ThermiteRollupBucket _summarizeOpen() const;
+  void _close();
+public:
+  ThermiteRollupTier(
+    const char* name,
+    ThermiteRollupBucket* buckets,
+    uint16_t size,
+    uint32_t width
+  );
+
+  ThermiteRollupTier(const ThermiteRollupTier&) = delete;
+  ThermiteRollupTier& operator=(const ThermiteRollupTier&) = delete;
+
+  void addSample(time_t tUtc, time_t tLocal, float temp, float tempTarget, bool heater);
+
+  /**
+   * Number of buckets available, including the one currently being filled.
+   */
+  uint16_t getCount() const { return _count + (_openCount > 0 ? 1 : 0); }
+
+  /**
+   * Returns bucket `i`, where 0 is the oldest and `getCount() - 1` is the one currently
+   * being filled.
+   */
+  ThermiteRollupBucket getBucket(uint16_t i) const;
+
+  /**
+   * Reads the closed bucket with sequence number `seq` into `bucket`, which stays put as
+   * later buckets close.  Returns `false` if it has not closed yet, or has since been
+   * overwritten.
+   */
+  bool getClosedBucket(uint32_t seq, ThermiteRollupBucket& bucket) const;
+  uint32_t getClosed() const { return _closed; }
+  uint16_t getClosedCount() const { return _count; }
+  bool isOpen() const { return _openCount > 0; }
+  const char* getName() const { return _name; }
+  uint32_t getWidth() const { return _width; }
+};
+
+/**
+ * Minute, hour and day rollups of temperature, target temperature and heater duty, maintained
+ * with constant work per sample.
+ */
+class ThermiteRollups {
+private:
+  ThermiteRollupBucket _minuteBuckets[ROLLUP_MINUTE_SIZE];
+  ThermiteRollupBucket _hourBuckets[ROLLUP_HOUR_SIZE];
+  ThermiteRollupBucket _dayBuckets[ROLLUP_DAY_SIZE];
+
+  ThermiteRollupTier _minutes;
+  ThermiteRollupTier _hours;
+  ThermiteRollupTier _days;
+public:
+  ThermiteRollups();
+
+  ThermiteRollups(const ThermiteRollups&) = delete;
+  ThermiteRollups& operator=(const ThermiteRollups&) = delete;
+
+  void addSample(time_t tUtc, time_t tLocal, float temp, float tempTarget, bool heater);
+
+  /**
+   * Returns the tier named `name` (`"minute"`, `"hour"` or `"day"`), or `nullptr` if there
+   * is no such tier.
+   */
+  const ThermiteRollupTier* getTier(const char* name) const;
+};
+
+#define ROLLUPS_BODY_HEADER 0
+#define ROLLUPS_BODY_COLUMNS 1
+#define ROLLUPS_BODY_BUCKETS 2
+#define ROLLUPS_BODY_DONE 3
+
+/**
+ * Streams a `ThermiteRollupTier` as JSON.  To keep responses small, each bucket is an array
+ * of values in the order given by `"columns"`.
+ *
+ * The buckets are those there were when the body was created: closed buckets are read by
+ * sequence number, so that buckets closing while the response streams shift nothing, and
+ * the open bucket is copied.  Buckets overwritten in the meantime are skipped.
+ */
+class ThermiteRollupsBody : public ThermiteChunkedBody {
+private:
+  const ThermiteRollupTier& _tier;
+
+  /**
+   * Closed buckets `_first` to `_end - 1`, then `_open` if `_hasOpen`.
+   */
+  uint32_t _first;
+  uint32_t _end;
+  ThermiteRollupBucket _open;
+  bool _hasOpen;
+  uint32_t _seq;
+  bool _empty;
+  uint8_t _stage;
+
+  size_t _printBucket(char* line, size_t size, const ThermiteRollupBucket& bucket);
+protected:
+  size_t _nextLine(char* line, size_t size);
+public:
+  ThermiteRollupsBody(const ThermiteRollupTier& tier);
+};
+
+#endif
\ No newline at end of file
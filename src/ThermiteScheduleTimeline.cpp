@@ -0,0 +1,78 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "ThermiteScheduleTimeline.h"
+
+static const char* const SCHEDULE_SOURCE_NAMES[] = { "weekly", "calendar", "override" };
+
+ThermiteScheduleTimelineBody::ThermiteScheduleTimelineBody(
+  const ThermiteUserSettingsManager& userSettings,
+  time_t from,
+  time_t to
+) : _userSettings(userSettings),
+    _cursor(),
+    _from(from),
+    _to(to),
+    _t(from),
+    _first(true),
+    _stage(SCHEDULE_TIMELINE_BODY_HEADER) {
+  _userSettings.resolve(_t, _cursor, _entry);
+}
+
+size_t ThermiteScheduleTimelineBody::_nextLine(char* line, size_t size) {
+  switch (_stage) {
+    case SCHEDULE_TIMELINE_BODY_HEADER:
+      _stage = SCHEDULE_TIMELINE_BODY_COLUMNS;
+      return snprintf(
+        line,
+        size,
+        "{\"from\":%lu,\"to\":%lu,",
+        (unsigned long) _from,
+        (unsigned long) _to
+      );
+    case SCHEDULE_TIMELINE_BODY_COLUMNS:
+      _stage = SCHEDULE_TIMELINE_BODY_SEGMENTS;
+      return snprintf(
+        line,
+        size,
+        "\"columns\":[\"start\",\"end\",\"setPoint\",\"tempTarget\",\"source\"],\"segments\":["
+      );
+    case SCHEDULE_TIMELINE_BODY_SEGMENTS:
+      if (_t < _to) {
+        break;
+      }
+      _stage = SCHEDULE_TIMELINE_BODY_DONE;
+      return snprintf(line, size, "]}");
+    default:
+      return 0;
+  }
+
+  // extend the segment until whatever is in effect changes, or the range ends
+  time_t start = _t;
+  ThermiteScheduleEntry entry = _entry;
+  while (_t < _to && _entry == entry) {
+    _t = _userSettings.getNextScheduleBoundary(_t);
+    if (_t > _to) {
+      _t = _to;
+    }
+    _userSettings.resolve(_t, _cursor, _entry);
+  }
+
+  size_t len = snprintf(
+    line,
+    size,
+    "%s[%lu,%lu,",
+    _first ? "" : ",",
+    (unsigned long) start,
+    (unsigned long) _t
+  );
+  if (entry._setPoint < 0) {
+    len += snprintf(line + len, size - len, "null,");
+  } else {
+    len += snprintf(line + len, size - len, "%d,", entry._setPoint);
+  }
+  len += _printCenti(line + len, size - len, lroundf(entry._tempTarget * 100.0f));
+  len += snprintf(line + len, size - len, ",\"%s\"]", SCHEDULE_SOURCE_NAMES[entry._source]);
+  _first = false;
+  return len;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef _THERMITE_SCHEDULE_TIMELINE_H__
+#define _THERMITE_SCHEDULE_TIMELINE_H__
+
+#include <time.h>
+
+#include "ThermiteCalendar.h"
+#include "ThermiteChunkedBody.h"
+#include "ThermiteUserSettingsManager.h"
+
+/**
+ * Longest range `GET /schedule/timeline` covers in one response, in seconds.
+ */
+#define SCHEDULE_TIMELINE_RANGE_MAX (31l * 86400l)
+
+#define SCHEDULE_TIMELINE_BODY_HEADER 0
+#define SCHEDULE_TIMELINE_BODY_COLUMNS 1
+#define SCHEDULE_TIMELINE_BODY_SEGMENTS 2
+#define SCHEDULE_TIMELINE_BODY_DONE 3
+
+/**
+ * Streams the effective schedule between local times `from` and `to` as JSON: one segment
+ * per run of time over which the source, set point and target temperature stay the same,
+ * with overrides and calendar exceptions already applied.  As in `ThermiteRollupsBody`, each
+ * segment is an array of values in the order given by `"columns"`.
+ *
+ * Segments are found in one pass from `from` to `to`, stepping from one
+ * `getNextScheduleBoundary()` to the next.  The body works from its own copy of the user
+ * settings, since the response may outlive the image it was asked of.
+ */
+class ThermiteScheduleTimelineBody : public ThermiteChunkedBody {
+private:
+  ThermiteUserSettingsManager _userSettings;
+  ThermiteCalendarCursor _cursor;
+  time_t _from;
+  time_t _to;
+
+  /**
+   * Start of the next segment, and what is in effect there.
+   */
+  time_t _t;
+  ThermiteScheduleEntry _entry;
+  bool _first;
+  uint8_t _stage;
+protected:
+  size_t _nextLine(char* line, size_t size);
+public:
+  ThermiteScheduleTimelineBody(
+    const ThermiteUserSettingsManager& userSettings,
+    time_t from,
+    time_t to
+  );
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include <math.h>
+#include <string.h>
+
+#include "ThermiteTelemetry.h"
+
+static_assert(sizeof(ThermiteTelemetryPacket) == 28, "ThermiteTelemetryPacket is not packed");
+
+/**
+ * Converts `temp` to hundredths of a degree, clamped to what fits in a packet.
+ */
+static int16_t toTelemetryCenti(float temp) {
+  long centi = lroundf(temp * 100.0f);
+  if (centi < INT16_MIN) {
+    return INT16_MIN;
+  }
+  if (centi > INT16_MAX) {
+    return INT16_MAX;
+  }
+  return static_cast<int16_t>(centi);
+}
+
+ThermiteTelemetry::ThermiteTelemetry(
+  ThermiteDatagramSocket& socket,
+  const ThermiteSystem& system,
+  const ThermiteWifi& wifi
+) : _socket(socket),
+    _system(system),
+    _wifi(wifi),
+    _sentCount(0ul),
+    _failedCount(0ul) {
+  memset(_sequences, 0, sizeof(_sequences));
+}
+
+bool ThermiteTelemetry::isOnline() const {
+  return _wifi.getState() == WIFI_STATE_CONNECTED;
+}
+
+bool ThermiteTelemetry::send(
+  uint8_t zone,
+  time_t tUtc,
+  float temp,
+  float tempTarget,
+  bool heater,
+  bool heartbeat
+) {
+  ThermiteTelemetryPacket packet;
+  memset(&packet, 0, sizeof(packet));
+  packet.magic = TELEMETRY_PACKET_MAGIC;
+  packet.version = TELEMETRY_PACKET_VERSION;
+  packet.zone = zone;
+  packet.deviceId = _system.getDeviceId();
+  packet.sequence = _sequences[zone]++;
+  packet.epoch = static_cast<uint32_t>(tUtc);
+  packet.temp = toTelemetryCenti(temp);
+  packet.tempTarget = toTelemetryCenti(tempTarget);
+  packet.freeHeap = _system.getFreeHeap();
+  packet.flags = (heater ? TELEMETRY_FLAG_HEATER : 0) | (heartbeat ? TELEMETRY_FLAG_HEARTBEAT : 0);
+  packet.rssi = _wifi.getRssi();
+  if (!_socket.send(&packet, sizeof(packet))) {
+    _failedCount++;
+    return false;
+  }
+  _sentCount++;
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#ifndef _THERMITE_TELEMETRY_H__
+#define _THERMITE_TELEMETRY_H__
+
+#include <stdint.h>
+#include <time.h>
+
+#include "Constants.h"
+#include "ThermiteHal.h"
+
+/**
+ * `"Th"`, as the first two bytes of every `ThermiteTelemetryPacket`.
+ */
+#define TELEMETRY_PACKET_MAGIC 0x6854
+
+/**
+ * Bump this whenever `ThermiteTelemetryPacket` changes layout, so that receivers can tell
+ * packets from older firmware apart rather than misread them.
+ */
+#define TELEMETRY_PACKET_VERSION 1
+
+#define TELEMETRY_FLAG_HEATER 0x01
+
+/**
+ * Set when a packet was sent only because `TELEMETRY_HEARTBEAT_INTERVAL` had passed, with
+ * nothing changed since the last one.
+ */
+#define TELEMETRY_FLAG_HEARTBEAT 0x02
+
+/**
+ * One zone's state, as pushed by `ThermiteTelemetry` in a single UDP datagram of 28 bytes.
+ * Fields are little-endian (as on both the ESP8266 and x86 hosts), and naturally aligned so
+ * that the struct has no padding.
+ */
+struct ThermiteTelemetryPacket {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t zone;
+  uint32_t deviceId;
+
+  /**
+   * Counts up by one for every packet this zone sends, from zero at boot, so that receivers
+   * can count lost packets from the gaps, and tell a reboot from the sequence restarting.
+   */
+  uint32_t sequence;
+
+  /**
+   * UTC time, in seconds since the Unix epoch.
+   */
+  uint32_t epoch;
+
+  /**
+   * Temperature and target temperature, in hundredths of a degree Celsius.
+   */
+  int16_t temp;
+  int16_t tempTarget;
+  uint32_t freeHeap;
+
+  /**
+   * `TELEMETRY_FLAG_*` bits.
+   */
+  uint8_t flags;
+  int8_t rssi;
+  uint16_t reserved;
+};
+
+/**
+ * Fire-and-forget telemetry: builds `ThermiteTelemetryPacket`s for `ThermiteInternalState`,
+ * which decides when to send them, and sends them through a `ThermiteDatagramSocket`.
+ * 
+ * Compared to polling `/internalState`, this costs the device no TCP connection, HTTP
+ * parsing or JSON serialization, and one packet serves any number of receivers if sent to a
+ * multicast group.  Nothing is retried: receivers see lost packets as sequence gaps.
+ */
+class ThermiteTelemetry {
+private:
+  ThermiteDatagramSocket& _socket;
+  const ThermiteSystem& _system;
+  const ThermiteWifi& _wifi;
+
+  /**
+   * Sequence number of each zone's next packet.
+   */
+  uint32_t _sequences[ZONE_COUNT_MAX];
+
+  uint32_t _sentCount;
+  uint32_t _failedCount;
+public:
+  ThermiteTelemetry(
+    ThermiteDatagramSocket& socket,
+    const ThermiteSystem& system,
+    const ThermiteWifi& wifi
+  );
+
+  uint32_t getFailedCount() const { return _failedCount; }
+  uint32_t getSentCount() const { return _sentCount; }
+  uint32_t getSequence(uint8_t zone) const { return _sequences[zone]; }
+
+  /**
+   * Can packets be sent right now?  While WiFi is down, callers should hold on to their
+   * changes rather than spend sequence numbers on packets that cannot arrive.
+   */
+  bool isOnline() const;
+
+  /**
+   * Sends one packet for `zone`.  The sequence number is spent even if the socket fails, so
+   * that the receiver sees the loss.  Returns `false` if the socket failed.
+   */
+  bool send(
+    uint8_t zone,
+    time_t tUtc,
+    float temp,
+    float tempTarget,
+    bool heater,
+    bool heartbeat
+  );
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include <math.h>
+#include <string.h>
+
+#include "ThermiteCrc.h"
+#include "ThermiteThermalEstimator.h"
+
+/**
+ * `THERMAL_MODEL_TEMP_REF` centres temperatures, which keeps the least-squares problem well
+ * conditioned in single precision.  `THERMAL_MODEL_FORGETTING` weighs each sample against
+ * the next; at one sample per 15 minutes, 0.995 remembers about two days.
+ */
+#define THERMAL_MODEL_TEMP_REF 20.0f
+#define THERMAL_MODEL_FORGETTING 0.995f
+#define THERMAL_MODEL_P_INITIAL 100.0f
+#define THERMAL_MODEL_GAP_MAX (3ul * TEMP_REQUEST_INTERVAL)
+
+static_assert(
+  EEPROM_OFFSET_THERMAL_MODEL + ZONE_COUNT_MAX * sizeof(ThermiteThermalRecord) <= EEPROM_SIZE,
+  "EEPROM_SIZE too small"
+);
+
+/**
+ * Places local time `tLocal` on the daily cycle, as the cosine and sine of its phase.
+ */
+static void getDayPhase(time_t tLocal, float& phaseCos, float& phaseSin) {
+  time_t day = static_cast<time_t>(SECONDS_PER_DAY);
+  float phase = 2.0f * static_cast<float>(M_PI) * (tLocal % day) / day;
+  phaseCos = cosf(phase);
+  phaseSin = sinf(phase);
+}
+
+ThermiteThermalEstimator::ThermiteThermalEstimator()
+: _variance(1.0f),
+  _samples(0ul),
+  _windowOpen(false),
+  _windowStartAt(0ul),
+  _windowLastAt(0ul),
+  _windowTempStart(0.0f),
+  _windowRuntimeStart(0ull),
+  _windowTempSum(0.0f),
+  _windowCosSum(0.0f),
+  _windowSinSum(0.0f),
+  _windowTempCount(0) {
+  memset(_theta, 0, sizeof(_theta));
+  memset(_p, 0, sizeof(_p));
+  for (uint8_t i = 0; i < THERMAL_MODEL_SIZE; i++) {
+    _p[i][i] = THERMAL_MODEL_P_INITIAL;
+  }
+}
+
+void ThermiteThermalEstimator::_addSample(
+  float temp,
+  float duty,
+  float phaseCos,
+  float phaseSin,
+  float rate
+) {
+  const float phi[THERMAL_MODEL_SIZE] = {
+    1.0f,
+    temp - THERMAL_MODEL_TEMP_REF,
+    duty,
+    phaseCos,
+    phaseSin
+  };
+
+  float pPhi[THERMAL_MODEL_SIZE];
+  float denom = THERMAL_MODEL_FORGETTING;
+  float error = rate;
+  for (uint8_t i = 0; i < THERMAL_MODEL_SIZE; i++) {
+    pPhi[i] = 0.0f;
+    for (uint8_t j = 0; j < THERMAL_MODEL_SIZE; j++) {
+      pPhi[i] += _p[i][j] * phi[j];
+    }
+    denom += phi[i] * pPhi[i];
+    error -= _theta[i] * phi[i];
+  }
+
+  for (uint8_t i = 0; i < THERMAL_MODEL_SIZE; i++) {
+    _theta[i] += pPhi[i] / denom * error;
+  }
+
+  /*
+   * Forgetting inflates the covariance in directions the data no longer explores, such as
+   * `heatingRate` all summer.  Only forget while the covariance is no larger than it started
+   * out, so that it cannot wind up.
+   */
+  float trace = 0.0f;
+  for (uint8_t i = 0; i < THERMAL_MODEL_SIZE; i++) {
+    for (uint8_t j = i; j < THERMAL_MODEL_SIZE; j++) {
+      float p = _p[i][j] - pPhi[i] * pPhi[j] / denom;
+      _p[i][j] = p;
+      _p[j][i] = p;
+    }
+    trace += _p[i][i];
+  }
+  if (trace < THERMAL_MODEL_SIZE * THERMAL_MODEL_P_INITIAL) {
+    for (uint8_t i = 0; i < THERMAL_MODEL_SIZE; i++) {
+      for (uint8_t j = 0; j < THERMAL_MODEL_SIZE; j++) {
+        _p[i][j] /= THERMAL_MODEL_FORGETTING;
+      }
+    }
+  }
+
+  // a posteriori error, which is small while the estimate is still settling
+  float errorPost = error * THERMAL_MODEL_FORGETTING / denom;
+  _variance = THERMAL_MODEL_FORGETTING * _variance
+    + (1.0f - THERMAL_MODEL_FORGETTING) * errorPost * errorPost;
+  _samples++;
+}
+
+float ThermiteThermalEstimator::_getError(uint8_t i) const {
+  return sqrtf(_variance * _p[i][i]);
+}
+
+void ThermiteThermalEstimator::addReading(
+  unsigned long now,
+  time_t tLocal,
+  float temp,
+  uint64_t runtime
+) {
+  float phaseCos;
+  float phaseSin;
+  getDayPhase(tLocal, phaseCos, phaseSin);
+  if (_windowOpen && static_cast<uint32_t>(now - _windowLastAt) <= THERMAL_MODEL_GAP_MAX) {
+    _windowLastAt = now;
+    _windowTempSum += temp;
+    _windowCosSum += phaseCos;
+    _windowSinSum += phaseSin;
+    _windowTempCount++;
+
+    uint32_t elapsed = static_cast<uint32_t>(now - _windowStartAt);
+    if (elapsed < THERMAL_MODEL_WINDOW) {
+      return;
+    }
+    float duty = static_cast<float>(runtime - _windowRuntimeStart) / elapsed;
+    if (duty > 1.0f) {
+      duty = 1.0f;
+    }
+    _addSample(
+      _windowTempSum / _windowTempCount,
+      duty,
+      _windowCosSum / _windowTempCount,
+      _windowSinSum / _windowTempCount,
+      (temp - _windowTempStart) / (elapsed / static_cast<float>(MS_PER_HOUR))
+    );
+  }
+
+  // this reading ends one window, and starts the next
+  _windowOpen = true;
+  _windowStartAt = now;
+  _windowLastAt = now;
+  _windowTempStart = temp;
+  _windowRuntimeStart = runtime;
+  _windowTempSum = temp;
+  _windowCosSum = phaseCos;
+  _windowSinSum = phaseSin;
+  _windowTempCount = 1;
+}
+
+float ThermiteThermalEstimator::getTimeConstant() const {
+  if (_theta[1] >= 0.0f) {
+    return 0.0f;
+  }
+  return -1.0f / _theta[1];
+}
+
+float ThermiteThermalEstimator::getTempEquilibrium() const {
+  if (_theta[1] >= 0.0f) {
+    return 0.0f;
+  }
+  return THERMAL_MODEL_TEMP_REF - _theta[0] / _theta[1];
+}
+
+long ThermiteThermalEstimator::getWarmUpTime(float temp, float tempTarget, time_t tLocal) const {
+  if (tempTarget <= temp) {
+    return 0l;
+  }
+  float k = -_theta[1];
+  if (k <= 0.0f || _theta[2] <= 0.0f) {
+    return -1l;
+  }
+
+  // flat out, the room closes in on `tempLimit` exponentially, at rate `k`
+  float phaseCos;
+  float phaseSin;
+  getDayPhase(tLocal, phaseCos, phaseSin);
+  float rate = _theta[0] + _theta[2] + _theta[3] * phaseCos + _theta[4] * phaseSin;
+  float tempLimit = THERMAL_MODEL_TEMP_REF + rate / k;
+  if (tempLimit <= tempTarget) {
+    return THERMAL_WARM_UP_UNREACHABLE;
+  }
+  float seconds = logf((tempLimit - temp) / (tempLimit - tempTarget)) / k * 3600.0f;
+  if (seconds >= static_cast<float>(THERMAL_WARM_UP_UNREACHABLE)) {
+    return THERMAL_WARM_UP_UNREACHABLE;
+  }
+  return lroundf(seconds);
+}
+
+void ThermiteThermalEstimator::save(
+  ThermiteThermalRecord& record,
+  uint64_t runtimeLifetime
+) const {
+  memset(&record, 0, sizeof(record));
+  record.version = THERMAL_RECORD_VERSION;
+  memcpy(record.theta, _theta, sizeof(_theta));
+  memcpy(record.p, _p, sizeof(_p));
+  record.variance = _variance;
+  record.samples = _samples;
+  record.runtimeLifetime = runtimeLifetime;
+  record.crc = thermiteCrc32(
+    reinterpret_cast<const uint8_t*>(&record) + sizeof(record.crc),
+    sizeof(record) - sizeof(record.crc)
+  );
+}
+
+bool ThermiteThermalEstimator::restore(const ThermiteThermalRecord& record) {
+  uint32_t crc = thermiteCrc32(
+    reinterpret_cast<const uint8_t*>(&record) + sizeof(record.crc),
+    sizeof(record) - sizeof(record.crc)
+  );
+  if (crc != record.crc || record.version != THERMAL_RECORD_VERSION) {
+    return false;
+  }
+  memcpy(_theta, record.theta, sizeof(_theta));
+  memcpy(_p, record.p, sizeof(_p));
+  _variance = record.variance;
+  _samples = record.samples;
+  return true;
+}
+
+bool ThermiteThermalEstimator::toJSON(const JsonObject& root) const {
+  if (!root["samples"].set(_samples)) {
+    return false;
+  }
+  if (!root["heatingRate"].set(getHeatingRate())) {
+    return false;
+  }
+  if (!root["heatingRateError"].set(_getError(2))) {
+    return false;
+  }
+  float timeConstant = getTimeConstant();
+  if (timeConstant > 0.0f) {
+    if (!root["timeConstant"].set(timeConstant)) {
+      return false;
+    }
+
+    // by the delta method, since `timeConstant` is `-1 / theta[1]`
+    if (!root["timeConstantError"].set(_getError(1) * timeConstant * timeConstant)) {
+      return false;
+    }
+    if (!root["tempEquilibrium"].set(getTempEquilibrium())) {
+      return false;
+    }
+  }
+  if (!root["residual"].set(sqrtf(_variance))) {
+    return false;
+  }
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#ifndef _THERMITE_THERMAL_ESTIMATOR_H__
+#define _THERMITE_THERMAL_ESTIMATOR_H__
+
+#include <ArduinoJson.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "Constants.h"
+#include "JsonIO.h"
+
+/**
+ * Bump this whenever `ThermiteThermalRecord` changes layout, so that a record written by
+ * older firmware is ignored rather than misread.
+ */
+#define THERMAL_RECORD_VERSION 2
+
+/**
+ * Number of coefficients in `ThermiteThermalEstimator`'s model.
+ */
+#define THERMAL_MODEL_SIZE 5
+
+/**
+ * Returned by `ThermiteThermalEstimator::getWarmUpTime()` when the heater cannot reach the
+ * target at all.
+ */
+#define THERMAL_WARM_UP_UNREACHABLE 0x7fffffffl
+
+/**
+ * Everything `ThermiteThermalEstimator` has learned, as kept in flash (see `ThermiteEeprom`).
+ */
+struct ThermiteThermalRecord {
+  /**
+   * CRC-32 of everything after this field.
+   */
+  uint32_t crc;
+  uint32_t version;
+  float theta[THERMAL_MODEL_SIZE];
+  float p[THERMAL_MODEL_SIZE][THERMAL_MODEL_SIZE];
+  float variance;
+  uint32_t samples;
+
+  /**
+   * `ThermiteHeaterRuntime`'s lifetime runtime, in ms, kept here so that it survives power
+   * loss too.
+   */
+  uint64_t runtimeLifetime;
+};
+
+/**
+ * Learns a room's thermal behaviour from its own readings, by recursive least squares on the
+ * first-order model
+ * 
+ *   dT/dt = heatingRate * duty - (T - tempEquilibrium) / timeConstant
+ * 
+ * where `duty` is the fraction of time the heater was on.  There is no outdoor thermometer, so
+ * `tempEquilibrium`, which follows the weather, is learned too: as a daily mean, plus a daily
+ * cycle that keeps the cold nights (when the heater tends to run) from passing for heat loss.
+ * Written as
+ * 
+ *   dT/dt = theta0 + theta1 * (T - THERMAL_MODEL_TEMP_REF) + theta2 * duty
+ *     + theta3 * cos(dayPhase) + theta4 * sin(dayPhase)
+ * 
+ * this is linear in its coefficients, so each sample costs a fixed handful of 5x5 matrix
+ * operations, and the estimator keeps no history beyond the current window.
+ * 
+ * Readings are gathered into samples of `THERMAL_MODEL_WINDOW` ms: the rate of change over the
+ * window against its mean temperature, heater duty and time of day.  Heater-on samples mostly
+ * pin down `heatingRate`, and heater-off samples `timeConstant`.  Old samples are forgotten
+ * exponentially, so that the seasons can come and go.
+ */
+class ThermiteThermalEstimator : public JsonWrite<ThermiteThermalEstimator> {
+private:
+  /**
+   * Coefficients, with `theta[i]` in degrees Celsius per hour.
+   */
+  float _theta[THERMAL_MODEL_SIZE];
+
+  /**
+   * Covariance of `_theta`, up to a factor of `_variance`.
+   */
+  float _p[THERMAL_MODEL_SIZE][THERMAL_MODEL_SIZE];
+
+  /**
+   * Exponentially weighted variance of the prediction error, in (degrees Celsius per hour)^2.
+   */
+  float _variance;
+  uint32_t _samples;
+
+  /**
+   * The window being gathered: when and at what temperature and heater runtime it started,
+   * and the sums (of temperature and time of day) and count of readings in it.
+   */
+  bool _windowOpen;
+  unsigned long _windowStartAt;
+  unsigned long _windowLastAt;
+  float _windowTempStart;
+  uint64_t _windowRuntimeStart;
+  float _windowTempSum;
+  float _windowCosSum;
+  float _windowSinSum;
+  uint16_t _windowTempCount;
+
+  void _addSample(float temp, float duty, float phaseCos, float phaseSin, float rate);
+
+  /**
+   * Returns the standard error of `_theta[i]`.
+   */
+  float _getError(uint8_t i) const;
+public:
+  ThermiteThermalEstimator();
+
+  /**
+   * Adds a temperature reading taken at `now`, or local time `tLocal`, where `runtime` is the
+   * heater's total runtime so far, in ms.  Readings more than `THERMAL_MODEL_GAP_MAX` ms apart,
+   * e.g. either side of a disconnected thermometer, start a new window.
+   */
+  void addReading(unsigned long now, time_t tLocal, float temp, uint64_t runtime);
+
+  uint32_t getSamples() const { return _samples; }
+
+  /**
+   * Returns the learned coefficients, in degrees Celsius per hour, hours and degrees Celsius
+   * respectively.  `getTimeConstant()` and `getTempEquilibrium()` return zero until the data
+   * shows the room losing heat at all.
+   */
+  float getHeatingRate() const { return _theta[2]; }
+  float getTimeConstant() const;
+  float getTempEquilibrium() const;
+
+  /**
+   * Returns how long, in seconds, the heater running flat out should take to bring the room
+   * from `temp` up to `tempTarget`, starting at local time `tLocal`.  Returns
+   * `THERMAL_WARM_UP_UNREACHABLE` if it never would, and -1 if the model cannot tell yet.
+   */
+  long getWarmUpTime(float temp, float tempTarget, time_t tLocal) const;
+
+  /**
+   * Writes what was learned to `record`, along with the heater's `runtimeLifetime` in ms.
+   */
+  void save(ThermiteThermalRecord& record, uint64_t runtimeLifetime) const;
+
+  /**
+   * Restores what was learned from `record`.  Returns `false` (and changes nothing) if
+   * `record` is not valid, e.g. on first boot.
+   */
+  bool restore(const ThermiteThermalRecord& record);
+  bool toJSON(const JsonObject& root) const;
+};
+
+#endif
\ No newline at end of file
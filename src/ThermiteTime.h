@@ -0,0 +1,87 @@
+#ifndef _THERMITE_TIME_H__
+#define _THERMITE_TIME_H__
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Calendar helpers for Unix timestamps, replacing the subset of `TimeLib` that `thermite`
+ * uses.  Unlike `TimeLib`, these are stateless and pure arithmetic, so they build on the
+ * host as well as on the ESP8266.
+ *
+ * As in `TimeLib`, timestamps are treated as unsigned 32-bit seconds since the epoch.
+ */
+
+struct ThermiteTimeElements {
+  uint16_t year;
+  uint8_t month;
+  uint8_t day;
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t second;
+
+  /**
+   * Day of the week, where 1 is Sunday (as in `TimeLib::weekday()`).
+   */
+  uint8_t weekday;
+};
+
+inline uint8_t thermiteHour(time_t t) {
+  return (static_cast<uint32_t>(t) % 86400ul) / 3600ul;
+}
+
+inline uint8_t thermiteMinute(time_t t) {
+  return (static_cast<uint32_t>(t) % 3600ul) / 60ul;
+}
+
+inline uint8_t thermiteWeekday(time_t t) {
+  // 1970-01-01 was a Thursday.
+  return ((static_cast<uint32_t>(t) / 86400ul + 4ul) % 7ul) + 1;
+}
+
+/**
+ * Breaks `t` down into calendar fields.
+ *
+ * This uses Howard Hinnant's `civil_from_days()`, which runs in constant time rather than
+ * looping over years and months as `TimeLib::breakTime()` does.
+ */
+inline void thermiteBreakTime(time_t t, ThermiteTimeElements& tm) {
+  uint32_t secs = static_cast<uint32_t>(t);
+  uint32_t days = secs / 86400ul;
+  uint32_t secsOfDay = secs % 86400ul;
+
+  tm.hour = secsOfDay / 3600ul;
+  tm.minute = (secsOfDay % 3600ul) / 60ul;
+  tm.second = secsOfDay % 60ul;
+  tm.weekday = ((days + 4ul) % 7ul) + 1;
+
+  uint32_t z = days + 719468ul;
+  uint32_t era = z / 146097ul;
+  uint32_t doe = z - era * 146097ul;
+  uint32_t yoe = (doe - doe / 1460ul + doe / 36524ul - doe / 146096ul) / 365ul;
+  uint32_t doy = doe - (365ul * yoe + yoe / 4ul - yoe / 100ul);
+  uint32_t mp = (5ul * doy + 2ul) / 153ul;
+
+  tm.day = doy - (153ul * mp + 2ul) / 5ul + 1;
+  tm.month = mp < 10 ? mp + 3 : mp - 9;
+  tm.year = yoe + era * 400ul + (tm.month <= 2 ? 1 : 0);
+}
+
+/**
+ * Inverse of `thermiteBreakTime()`, ignoring `tm.weekday`, by Howard Hinnant's
+ * `days_from_civil()`.
+ */
+inline time_t thermiteMakeTime(const ThermiteTimeElements& tm) {
+  uint32_t y = tm.year - (tm.month <= 2 ? 1 : 0);
+  uint32_t era = y / 400ul;
+  uint32_t yoe = y - era * 400ul;
+  uint32_t mp = tm.month > 2 ? tm.month - 3 : tm.month + 9;
+  uint32_t doy = (153ul * mp + 2ul) / 5ul + tm.day - 1;
+  uint32_t doe = yoe * 365ul + yoe / 4ul - yoe / 100ul + doy;
+  uint32_t days = era * 146097ul + doe - 719468ul;
+  return static_cast<time_t>(
+    days * 86400ul + tm.hour * 3600ul + tm.minute * 60ul + tm.second
+  );
+}
+
+#endif
\ No newline at end of file
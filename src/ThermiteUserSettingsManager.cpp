@@ -1,10 +1,16 @@
-#include <TimeLib.h>
+#include <string.h>
 
+#include "Constants.h"
+#include "ThermiteCrc.h"
+#include "ThermiteTime.h"
 #include "ThermiteUserSettingsManager.h"
 
-#define SET_POINT_MIN 10
-#define SET_POINT_MAX 30
 #define WEEKLY_SCHEDULE_MAX 0x3fff
+#define HEATER_MIN_TIME_MAX 3600
+
+static_assert(sizeof(ThermiteSetPoint) == 20, "JsonRead / JsonWrite should add no size");
+static_assert(sizeof(ThermiteDailySchedule) == 28, "JsonRead / JsonWrite should add no size");
+static_assert(sizeof(ThermiteHeaterSettings) == 6, "JsonRead / JsonWrite should add no size");
 
 ThermiteSetPoint::ThermiteSetPoint(const char name[16], float tempTarget)
 : _tempTarget(tempTarget) {
@@ -125,6 +131,67 @@ void ThermiteDailySchedule::updateFromJSON(const JsonObject& root) {
   }
 }
 
+ThermiteHeaterSettings::ThermiteHeaterSettings(
+  uint16_t minOnTime,
+  uint16_t minOffTime,
+  uint8_t maxCyclesPerHour
+) : _minOnTime(minOnTime),
+    _minOffTime(minOffTime),
+    _maxCyclesPerHour(maxCyclesPerHour) {}
+
+bool ThermiteHeaterSettings::toJSON(const JsonObject& root) const {
+  if (!root["minOnTime"].set(_minOnTime)) {
+    return false;
+  }
+  if (!root["minOffTime"].set(_minOffTime)) {
+    return false;
+  }
+  if (!root["maxCyclesPerHour"].set(_maxCyclesPerHour)) {
+    return false;
+  }
+  return true;
+}
+
+bool ThermiteHeaterSettings::validateJSON(const JsonObject& root) const {
+  if (root.containsKey("minOnTime")) {
+    if (!root["minOnTime"].is<uint16_t>()) {
+      return false;
+    }
+    if (root["minOnTime"].as<uint16_t>() > HEATER_MIN_TIME_MAX) {
+      return false;
+    }
+  }
+  if (root.containsKey("minOffTime")) {
+    if (!root["minOffTime"].is<uint16_t>()) {
+      return false;
+    }
+    if (root["minOffTime"].as<uint16_t>() > HEATER_MIN_TIME_MAX) {
+      return false;
+    }
+  }
+  if (root.containsKey("maxCyclesPerHour")) {
+    if (!root["maxCyclesPerHour"].is<uint8_t>()) {
+      return false;
+    }
+    if (root["maxCyclesPerHour"].as<uint8_t>() > HEATER_MAX_CYCLES_PER_HOUR) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ThermiteHeaterSettings::updateFromJSON(const JsonObject& root) {
+  if (root.containsKey("minOnTime")) {
+    _minOnTime = root["minOnTime"].as<uint16_t>();
+  }
+  if (root.containsKey("minOffTime")) {
+    _minOffTime = root["minOffTime"].as<uint16_t>();
+  }
+  if (root.containsKey("maxCyclesPerHour")) {
+    _maxCyclesPerHour = root["maxCyclesPerHour"].as<uint8_t>();
+  }
+}
+
 ThermiteUserSettingsManager::ThermiteUserSettingsManager()
 : _setPoints({
     { "Home Office", 20.0f },
@@ -195,21 +262,94 @@ ThermiteUserSettingsManager::ThermiteUserSettingsManager()
   _weeklySchedule(0x2002),
   _tempOverride(17.0f),
   _overrideStart(0l),
-  _overrideEnd(0l) {}
+  _overrideEnd(0l),
+  _heaterSettings(0, 0, 0),
+  _calendar(),
+  _version(0ul) {}
+
+uint32_t ThermiteUserSettingsManager::getFingerprint() const {
+  uint32_t crc = 0ul;
+  for (int i = 0; i < 4; i++) {
+    crc = thermiteCrc32(_setPoints[i]._name, sizeof(_setPoints[i]._name), crc);
+    crc = thermiteCrc32(&_setPoints[i]._tempTarget, sizeof(_setPoints[i]._tempTarget), crc);
+  }
+  for (int i = 0; i < 4; i++) {
+    crc = thermiteCrc32(_dailySchedules[i]._name, sizeof(_dailySchedules[i]._name), crc);
+    crc = thermiteCrc32(_dailySchedules[i]._schedule, sizeof(_dailySchedules[i]._schedule), crc);
+  }
+  crc = thermiteCrc32(&_weeklySchedule, sizeof(_weeklySchedule), crc);
+  crc = thermiteCrc32(&_tempOverride, sizeof(_tempOverride), crc);
+  crc = thermiteCrc32(&_overrideStart, sizeof(_overrideStart), crc);
+  crc = thermiteCrc32(&_overrideEnd, sizeof(_overrideEnd), crc);
+  crc = thermiteCrc32(&_heaterSettings._minOnTime, sizeof(_heaterSettings._minOnTime), crc);
+  crc = thermiteCrc32(&_heaterSettings._minOffTime, sizeof(_heaterSettings._minOffTime), crc);
+  crc = thermiteCrc32(
+    &_heaterSettings._maxCyclesPerHour,
+    sizeof(_heaterSettings._maxCyclesPerHour),
+    crc
+  );
+  return _calendar.getFingerprint(crc);
+}
+
+time_t ThermiteUserSettingsManager::getNextScheduleBoundary(time_t t) const {
+  // calendar exceptions start and end on these 30-minute boundaries, so need no checks here
+  time_t boundary = (t / SCHEDULE_INTERVAL + 1) * SCHEDULE_INTERVAL;
+  if (t < _overrideStart && _overrideStart < boundary) {
+    boundary = _overrideStart;
+  }
+  if (t < _overrideEnd && _overrideEnd < boundary) {
+    boundary = _overrideEnd;
+  }
+  return boundary;
+}
 
 float ThermiteUserSettingsManager::getTargetTemperature(time_t t) const {
+  ThermiteCalendarCursor cursor;
+  return getTargetTemperature(t, cursor);
+}
+
+float ThermiteUserSettingsManager::getTargetTemperature(
+  time_t t,
+  ThermiteCalendarCursor& cursor
+) const {
+  ThermiteScheduleEntry entry;
+  resolve(t, cursor, entry);
+  return entry._tempTarget;
+}
+
+void ThermiteUserSettingsManager::resolve(
+  time_t t,
+  ThermiteCalendarCursor& cursor,
+  ThermiteScheduleEntry& entry
+) const {
   // resolve temperature override
   if (_overrideStart <= t && t < _overrideEnd) {
-    return _tempOverride;
+    entry._source = SCHEDULE_SOURCE_OVERRIDE;
+    entry._setPoint = -1;
+    entry._tempTarget = _tempOverride;
+    return;
   }
 
-  // resolve weekly schedule
-  int d = weekday(t) - 1;
-  int i = (_weeklySchedule >> (d * 2)) & 0x3;
+  // resolve calendar, then weekly schedule
+  int i;
+  const ThermiteCalendarException* exception = _calendar.find(t, cursor);
+  if (exception == nullptr) {
+    entry._source = SCHEDULE_SOURCE_WEEKLY;
+    int d = thermiteWeekday(t) - 1;
+    i = (_weeklySchedule >> (d * 2)) & 0x3;
+  } else if (exception->kind == CALENDAR_EXCEPTION_TEMPERATURE) {
+    entry._source = SCHEDULE_SOURCE_CALENDAR;
+    entry._setPoint = -1;
+    entry._tempTarget = exception->value / 4.0f;
+    return;
+  } else {
+    entry._source = SCHEDULE_SOURCE_CALENDAR;
+    i = exception->value;
+  }
 
   // resolve daily schedule
-  int h = hour(t);
-  int m = minute(t);
+  int h = thermiteHour(t);
+  int m = thermiteMinute(t);
   m = (m / 30) << 1;
   if (h & 0x1) {
     m += 4;
@@ -217,7 +357,8 @@ float ThermiteUserSettingsManager::getTargetTemperature(time_t t) const {
   h >>= 1;
   i = (_dailySchedules[i]._schedule[h] >> m) & 0x3;
   
-  return _setPoints[i]._tempTarget;
+  entry._setPoint = i;
+  entry._tempTarget = _setPoints[i]._tempTarget;
 }
 
 bool ThermiteUserSettingsManager::toJSON(const JsonObject& root) const {
@@ -261,6 +402,13 @@ bool ThermiteUserSettingsManager::toJSON(const JsonObject& root) const {
   if (!root["overrideEnd"].set(_overrideEnd)) {
     return false;
   }
+  const JsonObject& jsonHeaterSettings = root.createNestedObject("heater");
+  if (jsonHeaterSettings.isNull()) {
+    return false;
+  }
+  if (!_heaterSettings.toJSON(jsonHeaterSettings)) {
+    return false;
+  }
   return true;
 }
 
@@ -339,10 +487,23 @@ bool ThermiteUserSettingsManager::validateJSON(const JsonObject& root) const {
       return false;
     }
   }
+  if (root.containsKey("heater")) {
+    if (!root["heater"].is<JsonObject>()) {
+      return false;
+    }
+    const JsonObject& heaterSettingsRoot = root["heater"].as<JsonObject>();
+    if (!_heaterSettings.validateJSON(heaterSettingsRoot)) {
+      return false;
+    }
+  }
+  if (!_calendar.validateJSON(root)) {
+    return false;
+  }
   return true;
 }
 
 void ThermiteUserSettingsManager::updateFromJSON(const JsonObject& root) {
+  uint32_t fingerprint = getFingerprint();
   if (root.containsKey("setPoints")) {
     JsonArray setPoints = root["setPoints"].as<JsonArray>();
     int i = 0;
@@ -376,4 +537,12 @@ void ThermiteUserSettingsManager::updateFromJSON(const JsonObject& root) {
     time_t overrideEnd = root["overrideEnd"].as<time_t>();
     _overrideEnd = overrideEnd;
   }
+  if (root.containsKey("heater")) {
+    const JsonObject& heaterSettingsRoot = root["heater"].as<JsonObject>();
+    _heaterSettings.updateFromJSON(heaterSettingsRoot);
+  }
+  _calendar.updateFromJSON(root);
+  if (getFingerprint() != fingerprint) {
+    _version++;
+  }
 }
\ No newline at end of file
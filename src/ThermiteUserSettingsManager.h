@@ -2,10 +2,14 @@
 #define _THERMITE_USER_SETTINGS_MANAGER_H__
 
 #include <ArduinoJson.h>
+#include <time.h>
 
 #include "JsonIO.h"
+#include "ThermiteCalendar.h"
 
-struct ThermiteSetPoint : public JsonRead, public JsonWrite {
+struct ThermiteSetPoint
+: public JsonRead<ThermiteSetPoint>,
+  public JsonWrite<ThermiteSetPoint> {
   /**
    * Each set point can be given a name of up to 15 characters in length.
    */
@@ -23,7 +27,9 @@ struct ThermiteSetPoint : public JsonRead, public JsonWrite {
   void updateFromJSON(const JsonObject& root);
 };
 
-struct ThermiteDailySchedule : public JsonRead, public JsonWrite {
+struct ThermiteDailySchedule
+: public JsonRead<ThermiteDailySchedule>,
+  public JsonWrite<ThermiteDailySchedule> {
   /**
    * Each daily schedule can be given a name of up to 15 characters in length.
    */
@@ -43,7 +49,61 @@ struct ThermiteDailySchedule : public JsonRead, public JsonWrite {
   void updateFromJSON(const JsonObject& root);
 };
 
-struct ThermiteUserSettingsManager : public JsonRead, public JsonWrite {
+struct ThermiteHeaterSettings
+: public JsonRead<ThermiteHeaterSettings>,
+  public JsonWrite<ThermiteHeaterSettings> {
+  /**
+   * Once switched on, the heater stays on for at least this long, in seconds.
+   */
+  uint16_t _minOnTime;
+
+  /**
+   * Once switched off, the heater stays off for at least this long, in seconds.
+   */
+  uint16_t _minOffTime;
+
+  /**
+   * The heater is switched on at most this many times in any 60-minute window.  Zero means
+   * no limit.
+   */
+  uint8_t _maxCyclesPerHour;
+
+  ThermiteHeaterSettings(uint16_t minOnTime, uint16_t minOffTime, uint8_t maxCyclesPerHour);
+  bool toJSON(const JsonObject& root) const;
+  bool validateJSON(const JsonObject& root) const;
+  void updateFromJSON(const JsonObject& root);
+};
+
+#define SCHEDULE_SOURCE_WEEKLY 0
+#define SCHEDULE_SOURCE_CALENDAR 1
+#define SCHEDULE_SOURCE_OVERRIDE 2
+
+/**
+ * What sets the target temperature at a given time.
+ */
+struct ThermiteScheduleEntry {
+  /**
+   * One of the `SCHEDULE_SOURCE_*` constants.
+   */
+  uint8_t _source;
+
+  /**
+   * Index into `_setPoints`, or -1 if the temperature is given directly, as by an override.
+   */
+  int8_t _setPoint;
+  float _tempTarget;
+
+  bool operator==(const ThermiteScheduleEntry& other) const {
+    return _source == other._source
+      && _setPoint == other._setPoint
+      && _tempTarget == other._tempTarget;
+  }
+  bool operator!=(const ThermiteScheduleEntry& other) const { return !(*this == other); }
+};
+
+struct ThermiteUserSettingsManager
+: public JsonRead<ThermiteUserSettingsManager>,
+  public JsonWrite<ThermiteUserSettingsManager> {
   /**
    * `thermite` supports four user-configurable temperature set points.
    */
@@ -79,9 +139,55 @@ struct ThermiteUserSettingsManager : public JsonRead, public JsonWrite {
   time_t _overrideStart;
   time_t _overrideEnd;
 
+  /**
+   * Limits on how often the heater relay can switch, to protect the relay and the boiler
+   * from short cycling.  All off by default; installs opt in through `PUT /userSettings`.
+   */
+  ThermiteHeaterSettings _heaterSettings;
+
+  /**
+   * Dated exceptions to `_weeklySchedule`, such as holidays.  An active temperature override
+   * takes precedence over these.
+   * 
+   * The calendar is read and written as the `"calendar"` array of user settings, but left
+   * out of `toJSON()` to keep that within `RESPONSE_BUFFER_SIZE`; `_calendar.toJSON()`
+   * serializes it on its own.
+   */
+  ThermiteCalendar _calendar;
+
+  /**
+   * Bumped whenever `updateFromJSON()` changes any of the above, so that readers can tell
+   * when a copy they hold (e.g. a serialized response) is stale.
+   */
+  uint32_t _version;
+
   ThermiteUserSettingsManager();
 
+  /**
+   * Returns the first time after `t` at which `getTargetTemperature()` may change: the next
+   * 30-minute schedule interval, or the start or end of the temperature override.  Like
+   * `getTargetTemperature()`, this works in local time.
+   */
+  time_t getNextScheduleBoundary(time_t t) const;
   float getTargetTemperature(time_t t) const;
+
+  /**
+   * As above, but looks up `_calendar` from `cursor`, which is faster for a reader that asks
+   * about steadily advancing times.
+   */
+  float getTargetTemperature(time_t t, ThermiteCalendarCursor& cursor) const;
+
+  /**
+   * Resolves what sets the target temperature at local time `t`: the override, then
+   * `_calendar`, then `_weeklySchedule`.
+   */
+  void resolve(time_t t, ThermiteCalendarCursor& cursor, ThermiteScheduleEntry& entry) const;
+  uint32_t getVersion() const { return _version; }
+
+  /**
+   * Returns a CRC-32 over every setting, to detect changes.
+   */
+  uint32_t getFingerprint() const;
   bool toJSON(const JsonObject& root) const;
   bool validateJSON(const JsonObject& root) const;
   void updateFromJSON(const JsonObject& root);
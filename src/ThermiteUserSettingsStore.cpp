@@ -0,0 +1,123 @@
+#include "ThermiteUserSettingsStore.h"
+
+#define SETTINGS_PENDING_NONE 0
+#define SETTINGS_PENDING_WRITING 1
+#define SETTINGS_PENDING_READY 2
+#define SETTINGS_PENDING_PUBLISHING 3
+
+ThermiteUserSettingsStore::ThermiteUserSettingsStore()
+: _current(0),
+  _retiring(false),
+  _pendingState(SETTINGS_PENDING_NONE),
+  _eeprom(nullptr),
+  _eepromOffset(EEPROM_OFFSET_CALENDAR),
+  _persistedCalendarVersion(0ul) {}
+
+void ThermiteUserSettingsStore::persist() {
+  if (_eeprom == nullptr) {
+    return;
+  }
+  const ThermiteCalendar& calendar = read()._calendar;
+  if (calendar._version == _persistedCalendarVersion) {
+    return;
+  }
+  ThermiteCalendarRecord record;
+  calendar.save(record);
+  if (_eeprom->write(_eepromOffset, &record, sizeof(record)) && _eeprom->commit()) {
+    _persistedCalendarVersion = calendar._version;
+  }
+}
+
+bool ThermiteUserSettingsStore::isPending() const {
+  return _pendingState.load(std::memory_order_acquire) != SETTINGS_PENDING_NONE;
+}
+
+void ThermiteUserSettingsStore::quiescent() {
+  uint8_t state = SETTINGS_PENDING_READY;
+  if (_pendingState.compare_exchange_strong(
+    state,
+    SETTINGS_PENDING_PUBLISHING,
+    std::memory_order_acq_rel
+  )) {
+    // the reader holds neither image, so the one not published is free
+    uint8_t next = _current.load(std::memory_order_relaxed) ^ 1;
+    _images[next] = _pending;
+    _current.store(next, std::memory_order_release);
+    _pendingState.store(SETTINGS_PENDING_NONE, std::memory_order_release);
+  }
+  _retiring.store(false, std::memory_order_release);
+}
+
+bool ThermiteUserSettingsStore::restoreCalendar() {
+  if (_eeprom == nullptr) {
+    return false;
+  }
+  ThermiteCalendarRecord record;
+  if (!_eeprom->read(_eepromOffset, &record, sizeof(record))) {
+    return false;
+  }
+  ThermiteUserSettingsManager& userSettings = edit();
+  if (!userSettings._calendar.restore(record)) {
+    return false;
+  }
+  userSettings._version++;
+  _persistedCalendarVersion = userSettings._calendar._version;
+  return true;
+}
+
+bool ThermiteUserSettingsStore::toJSON(const JsonObject& root) const {
+  return read().toJSON(root);
+}
+
+uint8_t ThermiteUserSettingsStore::_updatePending(
+  const JsonObject& root,
+  const ThermiteUserSettingsManager& published
+) {
+  uint8_t state = _pendingState.load(std::memory_order_acquire);
+  if (state == SETTINGS_PENDING_PUBLISHING || !_pendingState.compare_exchange_strong(
+    state,
+    SETTINGS_PENDING_WRITING,
+    std::memory_order_acq_rel
+  )) {
+    return SETTINGS_UPDATE_BUSY;
+  }
+
+  // later updates apply on top of earlier ones that are still pending
+  bool ready = state == SETTINGS_PENDING_READY;
+  if (!(ready ? _pending : published).validateJSON(root)) {
+    _pendingState.store(state, std::memory_order_release);
+    return SETTINGS_UPDATE_INVALID;
+  }
+  if (!ready) {
+    _pending = published;
+  }
+  uint32_t version = _pending.getVersion();
+  _pending.updateFromJSON(root);
+  _pendingState.store(
+    ready || _pending.getVersion() != version ? SETTINGS_PENDING_READY : SETTINGS_PENDING_NONE,
+    std::memory_order_release
+  );
+  return SETTINGS_UPDATE_OK;
+}
+
+uint8_t ThermiteUserSettingsStore::update(const JsonObject& root) {
+  uint8_t current = _current.load(std::memory_order_relaxed);
+  const ThermiteUserSettingsManager& published = _images[current];
+  if (isPending() || _retiring.load(std::memory_order_acquire)) {
+    return _updatePending(root, published);
+  }
+  if (!published.validateJSON(root)) {
+    return SETTINGS_UPDATE_INVALID;
+  }
+
+  uint8_t next = current ^ 1;
+  ThermiteUserSettingsManager& image = _images[next];
+  image = published;
+  image.updateFromJSON(root);
+  if (image.getVersion() == published.getVersion()) {
+    return SETTINGS_UPDATE_OK;
+  }
+  _current.store(next, std::memory_order_release);
+  _retiring.store(true, std::memory_order_release);
+  return SETTINGS_UPDATE_OK;
+}
\ No newline at end of file
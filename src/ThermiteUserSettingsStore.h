@@ -0,0 +1,115 @@
+#ifndef _THERMITE_USER_SETTINGS_STORE_H__
+#define _THERMITE_USER_SETTINGS_STORE_H__
+
+#include <ArduinoJson.h>
+#include <atomic>
+#include <stdint.h>
+
+#include "Constants.h"
+#include "JsonIO.h"
+#include "ThermiteHal.h"
+#include "ThermiteUserSettingsManager.h"
+
+#define SETTINGS_UPDATE_OK 0
+#define SETTINGS_UPDATE_INVALID 1
+#define SETTINGS_UPDATE_BUSY 2
+
+/**
+ * User settings shared between one writer (the web handlers, which run from the AsyncTCP
+ * callback context) and one reader (the control loop), RCU-style.
+ * 
+ * There are two complete images.  The reader takes the published one from `read()`, and
+ * sees it unchanged for as long as it holds it.  The writer builds a new image in the other
+ * one, and publishes it with a single atomic flip of `_current`.  The image it replaced may
+ * still be in the reader's hands, so it is only written to again once the reader has called
+ * `quiescent()`, at a point in the loop where it holds no image.  Updates that arrive before
+ * then are applied to a third, pending image instead, which `quiescent()` publishes: so quick
+ * successive edits are all kept, and only become visible to `read()` one loop later.
+ * Neither side takes a lock or masks interrupts.
+ */
+class ThermiteUserSettingsStore : public JsonWrite<ThermiteUserSettingsStore> {
+private:
+  ThermiteUserSettingsManager _images[2];
+  std::atomic<uint8_t> _current;
+
+  /**
+   * Has an image been replaced since the reader's last quiescent point?
+   */
+  std::atomic<bool> _retiring;
+
+  /**
+   * Update waiting for the reader's next quiescent point, and who has it: one of the
+   * `SETTINGS_PENDING_*` constants in the source.
+   */
+  ThermiteUserSettingsManager _pending;
+  std::atomic<uint8_t> _pendingState;
+
+  /**
+   * Where the calendar is persisted, if anywhere, and the `ThermiteCalendar::_version` last
+   * written there or restored from there.
+   */
+  ThermiteEeprom* _eeprom;
+  uint32_t _eepromOffset;
+  uint32_t _persistedCalendarVersion;
+
+  uint8_t _updatePending(const JsonObject& root, const ThermiteUserSettingsManager& published);
+public:
+  ThermiteUserSettingsStore();
+
+  /**
+   * Returns the published image.  The reader must not hold on to it past `quiescent()`.
+   */
+  const ThermiteUserSettingsManager& read() const {
+    return _images[_current.load(std::memory_order_acquire)];
+  }
+
+  /**
+   * Returns the published image for changes in place, which is only safe before the reader
+   * starts (e.g. while restoring settings at boot, or in tests).
+   */
+  ThermiteUserSettingsManager& edit() {
+    return _images[_current.load(std::memory_order_relaxed)];
+  }
+
+  uint32_t getVersion() const { return read().getVersion(); }
+
+  /**
+   * Is there an update that `quiescent()` has yet to publish?  If so, `readPending()` returns
+   * it.  For the writer only.
+   */
+  bool isPending() const;
+  const ThermiteUserSettingsManager& readPending() const { return _pending; }
+
+  /**
+   * Writes the published calendar to `_eeprom` if it changed since last written.  Flash
+   * writes stall the CPU, so this is left to the reader, just before its quiescent point.
+   */
+  void persist();
+
+  /**
+   * Marks a point at which the reader holds no image, and publishes the pending update, if
+   * there is one.
+   */
+  void quiescent();
+
+  /**
+   * Restores the calendar from `_eeprom`, like `edit()` only before the reader starts.
+   * Returns `false` (and changes nothing) if there is no valid record, e.g. on first boot.
+   */
+  bool restoreCalendar();
+  void setEeprom(ThermiteEeprom* eeprom, uint32_t eepromOffset = EEPROM_OFFSET_CALENDAR) {
+    _eeprom = eeprom;
+    _eepromOffset = eepromOffset;
+  }
+  bool toJSON(const JsonObject& root) const;
+
+  /**
+   * Validates `root`, applies it to a copy of the published image, and publishes the result
+   * if anything changed; or, if the reader may still hold the other image, applies it to the
+   * pending image.  Returns one of the `SETTINGS_UPDATE_*` codes: `SETTINGS_UPDATE_BUSY` only
+   * if `quiescent()` is publishing the pending image at that very moment.
+   */
+  uint8_t update(const JsonObject& root);
+};
+
+#endif
\ No newline at end of file
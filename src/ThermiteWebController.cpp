@@ -1,103 +1,479 @@
-#include <AsyncJson.h>
-#include <functional>
+#include <stdlib.h>
+#include <string.h>
 
 #include "Constants.h"
 #include "ThermiteWebController.h"
 
-HttpError::HttpError(uint16_t code, const char* message)
-: _code(code) {
-  strncpy(_message, message, 31);
-  _message[31] = '\0';
-}
+static_assert(
+  sizeof(ThermiteResponsePool)
+    + (RESPONSE_POOL_SIZE_FOR(ZONE_COUNT_MAX) - RESPONSE_POOL_SIZE) * RESPONSE_BUFFER_SIZE
+    + CHUNKED_BODY_SLOTS * CHUNKED_BODY_SLOT_SIZE
+    + ZONE_COUNT_MAX * (sizeof(ThermiteUserSettingsStore) + sizeof(ThermiteInternalState))
+    <= RAM_RESERVED_MAX,
+  "RAM reserved at boot exceeds RAM_RESERVED_MAX at ZONE_COUNT_MAX"
+);
+static_assert(
+  sizeof(ThermiteAllocProfileBody) <= CHUNKED_BODY_SLOT_SIZE
+    && sizeof(ThermiteHistoryBody) <= CHUNKED_BODY_SLOT_SIZE
+    && sizeof(ThermiteRollupsBody) <= CHUNKED_BODY_SLOT_SIZE
+    && sizeof(ThermiteScheduleTimelineBody) <= CHUNKED_BODY_SLOT_SIZE,
+  "CHUNKED_BODY_SLOT_SIZE too small"
+);
+
+/**
+ * `ThermiteInternalState` without `dateTime`, for its snapshot: `dateTime` changes every
+ * second, so it goes out as the head of each response instead.
+ */
+struct ThermiteInternalStateValues : public JsonWrite<ThermiteInternalStateValues> {
+  const ThermiteInternalState& _internalState;
+
+  ThermiteInternalStateValues(const ThermiteInternalState& internalState)
+  : _internalState(internalState) {}
+
+  bool toJSON(const JsonObject& root) const { return _internalState.toJSONValues(root); }
+};
 
-bool HttpError::toJSON(const JsonObject& root) const {
-  if (!root["code"].set(_code)) {
+static const char HTTP_ERROR_INVALID_CALENDAR_BODY[] PROGMEM =
+  "{\"code\":400,\"message\":\"Invalid calendar\"}";
+static const char HTTP_ERROR_INVALID_POINTS_BODY[] PROGMEM =
+  "{\"code\":400,\"message\":\"Invalid points\"}";
+static const char HTTP_ERROR_INVALID_ROLLUP_TIER_BODY[] PROGMEM =
+  "{\"code\":400,\"message\":\"Invalid rollup tier\"}";
+static const char HTTP_ERROR_INVALID_TIME_RANGE_BODY[] PROGMEM =
+  "{\"code\":400,\"message\":\"Invalid time range\"}";
+static const char HTTP_ERROR_INVALID_USER_SETTINGS_BODY[] PROGMEM =
+  "{\"code\":400,\"message\":\"Invalid user settings\"}";
+static const char HTTP_ERROR_NOT_FOUND_BODY[] PROGMEM =
+  "{\"code\":404,\"message\":\"Not Found\"}";
+static const char HTTP_ERROR_RESPONSE_TOO_LARGE_BODY[] PROGMEM =
+  "{\"code\":500,\"message\":\"Response too large\"}";
+static const char HTTP_ERROR_SERVICE_UNAVAILABLE_BODY[] PROGMEM =
+  "{\"code\":503,\"message\":\"Server busy\"}";
+static const char HTTP_ERROR_ZONE_NOT_FOUND_BODY[] PROGMEM =
+  "{\"code\":404,\"message\":\"Zone not found\"}";
+
+const HttpError HTTP_ERROR_INVALID_CALENDAR = {
+  HTTP_BAD_REQUEST,
+  HTTP_ERROR_INVALID_CALENDAR_BODY
+};
+const HttpError HTTP_ERROR_INVALID_POINTS = {
+  HTTP_BAD_REQUEST,
+  HTTP_ERROR_INVALID_POINTS_BODY
+};
+const HttpError HTTP_ERROR_INVALID_ROLLUP_TIER = {
+  HTTP_BAD_REQUEST,
+  HTTP_ERROR_INVALID_ROLLUP_TIER_BODY
+};
+const HttpError HTTP_ERROR_INVALID_TIME_RANGE = {
+  HTTP_BAD_REQUEST,
+  HTTP_ERROR_INVALID_TIME_RANGE_BODY
+};
+const HttpError HTTP_ERROR_INVALID_USER_SETTINGS = {
+  HTTP_BAD_REQUEST,
+  HTTP_ERROR_INVALID_USER_SETTINGS_BODY
+};
+const HttpError HTTP_ERROR_NOT_FOUND = { HTTP_NOT_FOUND, HTTP_ERROR_NOT_FOUND_BODY };
+const HttpError HTTP_ERROR_RESPONSE_TOO_LARGE = {
+  HTTP_INTERNAL_SERVER_ERROR,
+  HTTP_ERROR_RESPONSE_TOO_LARGE_BODY
+};
+const HttpError HTTP_ERROR_SERVICE_UNAVAILABLE = {
+  HTTP_SERVICE_UNAVAILABLE,
+  HTTP_ERROR_SERVICE_UNAVAILABLE_BODY
+};
+const HttpError HTTP_ERROR_ZONE_NOT_FOUND = { HTTP_NOT_FOUND, HTTP_ERROR_ZONE_NOT_FOUND_BODY };
+
+ThermiteWebController::ThermiteWebController(
+  ThermiteZones& zones,
+  ThermitePowerManager& powerManager
+) : _zones(zones),
+    _powerManager(powerManager),
+    _allocProfiler(nullptr) {}
+
+bool ThermiteWebController::_parseZonePath(
+  const char* path,
+  uint8_t& zone,
+  const char*& resource
+) const {
+  const char* prefix = "/zones/";
+  size_t prefixLen = strlen(prefix);
+  if (strncmp(path, prefix, prefixLen) != 0) {
+    return false;
+  }
+  const char* s = path + prefixLen;
+  if (*s < '0' || *s > '9') {
     return false;
   }
-  if (!root["message"].set(_message)) {
+  unsigned id = 0;
+  while (*s >= '0' && *s <= '9') {
+    id = id * 10 + (*s - '0');
+    if (id > 255) {
+      return false;
+    }
+    s++;
+  }
+  if (*s != '/') {
     return false;
   }
+  zone = static_cast<uint8_t>(id);
+  resource = s + 1;
   return true;
 }
 
-ThermiteWebController::ThermiteWebController(
-  ThermiteUserSettingsManager& userSettingsManager,
-  ThermiteInternalState& internalState
-) : _userSettingsManager(userSettingsManager),
-    _internalState(internalState) {}
+void ThermiteWebController::_getCalendar(ThermiteHttpRequest& request, uint8_t zone) {
+  ALLOC_SCOPE(_allocProfiler, "GET /calendar");
+  _send(request, _zones.getUserSettingsStore(zone).read()._calendar);
+}
+
+void ThermiteWebController::_getHeaterRuntime(ThermiteHttpRequest& request, uint8_t zone) {
+  ALLOC_SCOPE(_allocProfiler, "GET /heater");
+  _send(request, _zones.getInternalState(zone).getHeaterRuntime());
+}
+
+void ThermiteWebController::_getHistory(ThermiteHttpRequest& request, uint8_t zone) {
+  ALLOC_SCOPE(_allocProfiler, "GET /history");
+  time_t from;
+  time_t to;
+  if (!_parseTimeParam(request, "from", from) || !_parseTimeParam(request, "to", to)) {
+    _sendError(request, HTTP_ERROR_INVALID_TIME_RANGE);
+    return;
+  }
+  if (to < from || to - from > HISTORY_RANGE_MAX) {
+    _sendError(request, HTTP_ERROR_INVALID_TIME_RANGE);
+    return;
+  }
+  uint16_t points;
+  if (!_parsePointsParam(request, points)) {
+    _sendError(request, HTTP_ERROR_INVALID_POINTS);
+    return;
+  }
+  const ThermiteHistory& history = _zones.getInternalState(zone).getHistory();
+  _sendChunked(request, new ThermiteHistoryBody(history, from, to, points));
+}
+
+void ThermiteWebController::_getInternalState(ThermiteHttpRequest& request, uint8_t zone) {
+  ALLOC_SCOPE(_allocProfiler, "GET /internalState");
+  ThermiteInternalState& internalState = _zones.getInternalState(zone);
+  internalState.updateDateTimeIso();
+  char head[RESPONSE_HEAD_LEN];
+  snprintf(head, sizeof(head), "{\"dateTime\":\"%s\",", internalState.getDateTimeIso());
+  _sendSnapshot(
+    request,
+    _internalStateSnapshots[zone],
+    ThermiteInternalStateValues(internalState),
+    internalState.getVersion(),
+    head
+  );
+}
+
+void ThermiteWebController::_getRollups(ThermiteHttpRequest& request, uint8_t zone) {
+  ALLOC_SCOPE(_allocProfiler, "GET /rollups");
+  const ThermiteRollups& rollups = _zones.getInternalState(zone).getRollups();
+  const ThermiteRollupTier* tier = rollups.getTier(request.getParam("tier"));
+  if (tier == nullptr) {
+    _sendError(request, HTTP_ERROR_INVALID_ROLLUP_TIER);
+  } else {
+    _sendChunked(request, new ThermiteRollupsBody(*tier));
+  }
+}
 
-void ThermiteWebController::_send(AsyncWebServerRequest* request, const JsonWrite& jsonWrite, size_t maxSize) const {
-  AsyncJsonResponse* response = new AsyncJsonResponse(false, maxSize);
-  const JsonObject& root = response->getRoot();
-  jsonWrite.toJSON(root);
-  response->setLength();
-  request->send(response);
+void ThermiteWebController::_getScheduleTimeline(ThermiteHttpRequest& request, uint8_t zone) {
+  ALLOC_SCOPE(_allocProfiler, "GET /schedule/timeline");
+  time_t from;
+  time_t to;
+  if (!_parseTimeParam(request, "from", from) || !_parseTimeParam(request, "to", to)) {
+    _sendError(request, HTTP_ERROR_INVALID_TIME_RANGE);
+    return;
+  }
+  if (to <= from || to - from > SCHEDULE_TIMELINE_RANGE_MAX) {
+    _sendError(request, HTTP_ERROR_INVALID_TIME_RANGE);
+    return;
+  }
+  const ThermiteUserSettingsManager& userSettings = _zones.getUserSettingsStore(zone).read();
+  _sendChunked(request, new ThermiteScheduleTimelineBody(userSettings, from, to));
 }
 
-void ThermiteWebController::_sendError(AsyncWebServerRequest* request, const HttpError& httpError) const {
-  AsyncJsonResponse* response = new AsyncJsonResponse(false, CAPACITY_HTTP_ERROR);
-  response->setCode(httpError._code);
-  const JsonObject& root = response->getRoot();
-  httpError.toJSON(root);
-  response->setLength();
-  request->send(response);
+void ThermiteWebController::_getThermalModel(ThermiteHttpRequest& request, uint8_t zone) {
+  ALLOC_SCOPE(_allocProfiler, "GET /thermalModel");
+  _send(request, _zones.getInternalState(zone).getThermalModel());
 }
 
-void ThermiteWebController::getInternalState(AsyncWebServerRequest* request) {
-  _internalState.updateDateTimeIso();
-  _send(request, _internalState, CAPACITY_INTERNAL_STATE);
+void ThermiteWebController::_getUserSettings(ThermiteHttpRequest& request, uint8_t zone) {
+  ALLOC_SCOPE(_allocProfiler, "GET /userSettings");
+  const ThermiteUserSettingsStore& userSettingsStore = _zones.getUserSettingsStore(zone);
+  _sendSnapshot(
+    request,
+    _userSettingsSnapshots[zone],
+    userSettingsStore,
+    userSettingsStore.getVersion()
+  );
 }
 
-void ThermiteWebController::getUserSettings(AsyncWebServerRequest* request) {
-  _send(request, _userSettingsManager, CAPACITY_USER_SETTINGS_MANAGER);
+bool ThermiteWebController::_parseTimeParam(
+  ThermiteHttpRequest& request,
+  const char* name,
+  time_t& t
+) const {
+  const char* value = request.getParam(name);
+  if (value == nullptr || *value < '0' || *value > '9') {
+    return false;
+  }
+  char* end;
+  unsigned long parsed = strtoul(value, &end, 10);
+  if (*end != '\0' || parsed > 0x7ffffffful) {
+    return false;
+  }
+  t = static_cast<time_t>(parsed);
+  return true;
 }
 
-void ThermiteWebController::putUserSettings(AsyncWebServerRequest* request, const JsonVariant& json) {
+bool ThermiteWebController::_parsePointsParam(
+  ThermiteHttpRequest& request,
+  uint16_t& points
+) const {
+  const char* value = request.getParam("points");
+  if (value == nullptr) {
+    points = 0;
+    return true;
+  }
+  if (*value < '0' || *value > '9') {
+    return false;
+  }
+  char* end;
+  unsigned long parsed = strtoul(value, &end, 10);
+  if (*end != '\0' || parsed < HISTORY_POINTS_MIN || parsed > HISTORY_POINTS_MAX) {
+    return false;
+  }
+  points = static_cast<uint16_t>(parsed);
+  return true;
+}
+
+void ThermiteWebController::_putCalendar(
+  ThermiteHttpRequest& request,
+  uint8_t zone,
+  const JsonVariant& json
+) {
+  ALLOC_SCOPE(_allocProfiler, "PUT /calendar");
+  ThermiteUserSettingsStore& userSettingsStore = _zones.getUserSettingsStore(zone);
   const JsonObject& root = json.as<JsonObject>();
-  if (!_userSettingsManager.updateFromJSONSafe(root)) {
-    HttpError error = { HTTP_BAD_REQUEST, "Invalid user settings" };
-    _sendError(request, error);
+  if (root.size() != 1 || !root.containsKey("calendar")) {
+    _sendError(request, HTTP_ERROR_INVALID_CALENDAR);
+    return;
+  }
+  uint8_t result = userSettingsStore.update(root);
+  if (result == SETTINGS_UPDATE_INVALID) {
+    _sendError(request, HTTP_ERROR_INVALID_CALENDAR);
+  } else if (result == SETTINGS_UPDATE_BUSY) {
+    _sendError(request, HTTP_ERROR_SERVICE_UNAVAILABLE);
+  } else if (userSettingsStore.isPending()) {
+    // accepted, and published at the control loop's next quiescent point
+    _send(request, userSettingsStore.readPending()._calendar);
   } else {
-    _send(request, _userSettingsManager, CAPACITY_USER_SETTINGS_MANAGER);
+    _getCalendar(request, zone);
   }
 }
 
-void ThermiteWebController::notFound(AsyncWebServerRequest* request) {
-  if (request->method() == HTTP_OPTIONS) {
-    request->send(204);
+void ThermiteWebController::_putUserSettings(
+  ThermiteHttpRequest& request,
+  uint8_t zone,
+  const JsonVariant& json
+) {
+  ALLOC_SCOPE(_allocProfiler, "PUT /userSettings");
+  ThermiteUserSettingsStore& userSettingsStore = _zones.getUserSettingsStore(zone);
+  const JsonObject& root = json.as<JsonObject>();
+  uint8_t result = userSettingsStore.update(root);
+  if (result == SETTINGS_UPDATE_INVALID) {
+    _sendError(request, HTTP_ERROR_INVALID_USER_SETTINGS);
+  } else if (result == SETTINGS_UPDATE_BUSY) {
+    _sendError(request, HTTP_ERROR_SERVICE_UNAVAILABLE);
+  } else if (userSettingsStore.isPending()) {
+    _send(request, userSettingsStore.readPending());
   } else {
-    HttpError error = { HTTP_NOT_FOUND, "Not Found" };
-    _sendError(request, error); 
+    _getUserSettings(request, zone);
   }
 }
 
-void ThermiteWebController::initRoutes(AsyncWebServer& server) {
-  server.on(
-    "/internalState",
-    HTTP_GET,
-    std::bind(&ThermiteWebController::getInternalState, this, std::placeholders::_1)
-  );
+void ThermiteWebController::_send(ThermiteHttpRequest& request, JsonWriteRef jsonWrite) {
+  ThermiteResponseBuffer buffer = _responsePool.serialize(jsonWrite);
+  _sendBuffer(request, buffer);
+}
 
-  server.on(
-    "/userSettings",
-    HTTP_GET,
-    std::bind(&ThermiteWebController::getUserSettings, this, std::placeholders::_1)
-  );
+void ThermiteWebController::_sendBuffer(
+  ThermiteHttpRequest& request,
+  const ThermiteResponseBuffer& buffer,
+  const char* head
+) const {
+  if (buffer.isValid()) {
+    request.sendBuffer(HTTP_OK, buffer, head);
+  } else if (_responsePool.getAvailable() == 0) {
+    _sendError(request, HTTP_ERROR_SERVICE_UNAVAILABLE);
+  } else {
+    _sendError(request, HTTP_ERROR_RESPONSE_TOO_LARGE);
+  }
+}
 
-  AsyncCallbackJsonWebHandler* handlerPutUserSettings = new AsyncCallbackJsonWebHandler(
-    "/userSettings",
-    std::bind(
-      &ThermiteWebController::putUserSettings,
-      this,
-      std::placeholders::_1,
-      std::placeholders::_2
-    ),
-    CAPACITY_USER_SETTINGS_MANAGER
-  );
-  handlerPutUserSettings->setMethod(HTTP_PUT);
-  server.addHandler(handlerPutUserSettings);
+void ThermiteWebController::_sendChunked(
+  ThermiteHttpRequest& request,
+  ThermiteChunkedBody* body
+) const {
+  if (body == nullptr) {
+    _sendError(request, HTTP_ERROR_SERVICE_UNAVAILABLE);
+  } else {
+    request.sendChunked(HTTP_OK, body);
+  }
+}
 
-  server.onNotFound(
-    std::bind(&ThermiteWebController::notFound, this, std::placeholders::_1)
-  );
+void ThermiteWebController::_sendError(ThermiteHttpRequest& request, const HttpError& httpError) const {
+  request.sendJsonConstant(httpError._code, httpError._body);
+}
+
+void ThermiteWebController::_sendNotFound(ThermiteHttpRequest& request) const {
+  _sendError(request, HTTP_ERROR_NOT_FOUND);
+}
+
+void ThermiteWebController::_sendSnapshot(
+  ThermiteHttpRequest& request,
+  ThermiteSnapshot& snapshot,
+  JsonWriteRef jsonWrite,
+  uint32_t version,
+  const char* head
+) {
+  if (!snapshot._buffer.isValid() || snapshot._version != version) {
+    /*
+     * Let go of the stale buffer first: unless a response is still reading it, it can be
+     * reused straight away.
+     */
+    snapshot._buffer.release();
+    snapshot._buffer = _responsePool.serialize(jsonWrite);
+    snapshot._version = version;
+  }
+  _sendBuffer(request, snapshot._buffer, head);
+}
+
+void ThermiteWebController::getAllocProfile(ThermiteHttpRequest& request) {
+  _powerManager.noteRequest();
+  if (_allocProfiler == nullptr) {
+    _sendNotFound(request);
+    return;
+  }
+  _sendChunked(request, new ThermiteAllocProfileBody(*_allocProfiler));
+}
+
+void ThermiteWebController::getCalendar(ThermiteHttpRequest& request) {
+  _powerManager.noteRequest();
+  _getCalendar(request, 0);
+}
+
+void ThermiteWebController::getHeaterRuntime(ThermiteHttpRequest& request) {
+  _powerManager.noteRequest();
+  _getHeaterRuntime(request, 0);
+}
+
+void ThermiteWebController::getHistory(ThermiteHttpRequest& request) {
+  _powerManager.noteRequest();
+  _getHistory(request, 0);
+}
+
+void ThermiteWebController::getInternalState(ThermiteHttpRequest& request) {
+  _powerManager.noteRequest();
+  _getInternalState(request, 0);
+}
+
+void ThermiteWebController::getPower(ThermiteHttpRequest& request) {
+  _powerManager.noteRequest();
+  ALLOC_SCOPE(_allocProfiler, "GET /power");
+  _send(request, _powerManager);
+}
+
+void ThermiteWebController::getRollups(ThermiteHttpRequest& request) {
+  _powerManager.noteRequest();
+  _getRollups(request, 0);
+}
+
+void ThermiteWebController::getScheduleTimeline(ThermiteHttpRequest& request) {
+  _powerManager.noteRequest();
+  _getScheduleTimeline(request, 0);
+}
+
+void ThermiteWebController::getThermalModel(ThermiteHttpRequest& request) {
+  _powerManager.noteRequest();
+  _getThermalModel(request, 0);
+}
+
+void ThermiteWebController::getUserSettings(ThermiteHttpRequest& request) {
+  _powerManager.noteRequest();
+  _getUserSettings(request, 0);
+}
+
+void ThermiteWebController::getZones(ThermiteHttpRequest& request) {
+  _powerManager.noteRequest();
+  const char* path = request.getPath();
+  if (strcmp(path, "/zones") == 0 || strcmp(path, "/zones/") == 0) {
+    ALLOC_SCOPE(_allocProfiler, "GET /zones");
+    _send(request, _zones);
+    return;
+  }
+
+  uint8_t zone;
+  const char* resource;
+  if (!_parseZonePath(path, zone, resource)) {
+    _sendNotFound(request);
+  } else if (zone >= _zones.getCount()) {
+    _sendError(request, HTTP_ERROR_ZONE_NOT_FOUND);
+  } else if (strcmp(resource, "calendar") == 0) {
+    _getCalendar(request, zone);
+  } else if (strcmp(resource, "heater") == 0) {
+    _getHeaterRuntime(request, zone);
+  } else if (strcmp(resource, "history") == 0) {
+    _getHistory(request, zone);
+  } else if (strcmp(resource, "internalState") == 0) {
+    _getInternalState(request, zone);
+  } else if (strcmp(resource, "rollups") == 0) {
+    _getRollups(request, zone);
+  } else if (strcmp(resource, "schedule/timeline") == 0) {
+    _getScheduleTimeline(request, zone);
+  } else if (strcmp(resource, "thermalModel") == 0) {
+    _getThermalModel(request, zone);
+  } else if (strcmp(resource, "userSettings") == 0) {
+    _getUserSettings(request, zone);
+  } else {
+    _sendNotFound(request);
+  }
+}
+
+void ThermiteWebController::putCalendar(ThermiteHttpRequest& request, const JsonVariant& json) {
+  _powerManager.noteRequest();
+  _putCalendar(request, 0, json);
+}
+
+void ThermiteWebController::putUserSettings(ThermiteHttpRequest& request, const JsonVariant& json) {
+  _powerManager.noteRequest();
+  _putUserSettings(request, 0, json);
+}
+
+void ThermiteWebController::putZones(ThermiteHttpRequest& request, const JsonVariant& json) {
+  _powerManager.noteRequest();
+  uint8_t zone;
+  const char* resource;
+  if (!_parseZonePath(request.getPath(), zone, resource)) {
+    _sendNotFound(request);
+  } else if (zone >= _zones.getCount()) {
+    _sendError(request, HTTP_ERROR_ZONE_NOT_FOUND);
+  } else if (strcmp(resource, "calendar") == 0) {
+    _putCalendar(request, zone, json);
+  } else if (strcmp(resource, "userSettings") == 0) {
+    _putUserSettings(request, zone, json);
+  } else {
+    _sendNotFound(request);
+  }
+}
+
+void ThermiteWebController::notFound(ThermiteHttpRequest& request) {
+  _powerManager.noteRequest();
+  ALLOC_SCOPE(_allocProfiler, "notFound");
+  if (request.isPreflight()) {
+    request.send(HTTP_NO_CONTENT);
+  } else {
+    _sendNotFound(request);
+  }
 }
\ No newline at end of file
@@ -2,52 +2,196 @@
 #define _THERMITE_WEB_CONTROLLER_H__
 
 #include <ArduinoJson.h>
-#include <ESPAsyncWebServer.h>
 
 #include "JsonIO.h"
+#include "ThermiteAllocProfiler.h"
+#include "ThermiteHal.h"
+#include "ThermiteHistory.h"
 #include "ThermiteInternalState.h"
+#include "ThermitePowerManager.h"
+#include "ThermiteResponsePool.h"
+#include "ThermiteScheduleTimeline.h"
 #include "ThermiteUserSettingsManager.h"
+#include "ThermiteZones.h"
 
 #define HTTP_OK 200
+#define HTTP_NO_CONTENT 204
 #define HTTP_BAD_REQUEST 400
 #define HTTP_NOT_FOUND 404
+#define HTTP_INTERNAL_SERVER_ERROR 500
+#define HTTP_SERVICE_UNAVAILABLE 503
 
 /**
- * HTTP error message, containing a status code and a human-readable message.
+ * Outside the device, flash is just more memory.
+ */
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+
+/**
+ * HTTP error response: a status code, and a JSON body with that code and a human-readable
+ * message, which helps us handle error conditions in the frontend.
  * 
- * We use this to help send HTTP error responses with JSON payloads, which helps
- * us handle error conditions in the frontend.
+ * Every error we send is known at compile time, so bodies are pre-serialized and kept in
+ * flash rather than built in a `JsonDocument` per request.
  */
-struct HttpError : public JsonWrite {
+struct HttpError {
   uint16_t _code;
-  char _message[32];
+  const char* _body;
+};
 
-  HttpError(uint16_t code, const char* message);
-  uint16_t getCode() const;
-  bool toJSON(const JsonObject& root) const;
+extern const HttpError HTTP_ERROR_INVALID_CALENDAR;
+extern const HttpError HTTP_ERROR_INVALID_POINTS;
+extern const HttpError HTTP_ERROR_INVALID_ROLLUP_TIER;
+extern const HttpError HTTP_ERROR_INVALID_TIME_RANGE;
+extern const HttpError HTTP_ERROR_INVALID_USER_SETTINGS;
+extern const HttpError HTTP_ERROR_NOT_FOUND;
+extern const HttpError HTTP_ERROR_RESPONSE_TOO_LARGE;
+extern const HttpError HTTP_ERROR_SERVICE_UNAVAILABLE;
+extern const HttpError HTTP_ERROR_ZONE_NOT_FOUND;
+
+/**
+ * Serialized copy of a resource, along with the version of it that was serialized.
+ */
+struct ThermiteSnapshot {
+  uint32_t _version;
+  ThermiteResponseBuffer _buffer;
 };
 
+/**
+ * REST API handlers.
+ * 
+ * These only see requests through `ThermiteHttpRequest`; binding them to routes on an actual
+ * HTTP server is left to the transport (see `ThermiteAsyncWebTransport` on the device).
+ * 
+ * Each zone's resources live under `/zones/{id}/`; the top-level `/calendar`, `/heater`,
+ * `/history`, `/internalState`, `/rollups`, `/schedule/timeline`, `/thermalModel` and
+ * `/userSettings` are kept as aliases for zone 0.
+ * 
+ * Responses are serialized into `_responsePool`.  `internalState` and `userSettings`, which
+ * the web UI polls, are kept serialized between requests and only rebuilt once their version
+ * changes; until then, every `GET` sends the same shared buffer.
+ */
 class ThermiteWebController {
 private:
-  ThermiteUserSettingsManager& _userSettingsManager;
-  ThermiteInternalState& _internalState;
+  ThermiteZones& _zones;
+  ThermitePowerManager& _powerManager;
 
-  void _send(AsyncWebServerRequest* request, const JsonWrite& jsonWrite, size_t maxSize) const;
-  void _sendError(AsyncWebServerRequest* request, const HttpError& error) const;
-public:
-  ThermiteWebController(
-    ThermiteUserSettingsManager& scheduleManager,
-    ThermiteInternalState& internalState
+  /**
+   * Profiler that each route's heap use is recorded in, if any (see `ALLOC_PROFILER`).
+   * Routes under `/zones/{id}/` are recorded with their zone 0 aliases.
+   */
+  ThermiteAllocProfiler* _allocProfiler;
+  ThermiteResponsePool _responsePool;
+  ThermiteSnapshot _internalStateSnapshots[ZONE_COUNT_MAX];
+  ThermiteSnapshot _userSettingsSnapshots[ZONE_COUNT_MAX];
+
+  /**
+   * Parses `/zones/{id}/{resource}` into `zone` and `resource`.  Returns `false` if `path`
+   * does not have that form.
+   */
+  bool _parseZonePath(const char* path, uint8_t& zone, const char*& resource) const;
+
+  void _getCalendar(ThermiteHttpRequest& request, uint8_t zone);
+  void _getHeaterRuntime(ThermiteHttpRequest& request, uint8_t zone);
+  void _getHistory(ThermiteHttpRequest& request, uint8_t zone);
+  void _getInternalState(ThermiteHttpRequest& request, uint8_t zone);
+  void _getRollups(ThermiteHttpRequest& request, uint8_t zone);
+  void _getScheduleTimeline(ThermiteHttpRequest& request, uint8_t zone);
+  void _getThermalModel(ThermiteHttpRequest& request, uint8_t zone);
+  void _getUserSettings(ThermiteHttpRequest& request, uint8_t zone);
+  /**
+   * Parses request parameter `name` as a Unix timestamp into `t`.  Returns `false` if it is
+   * missing or not a number.
+   */
+  bool _parseTimeParam(ThermiteHttpRequest& request, const char* name, time_t& t) const;
+
+  /**
+   * Reads the optional `points` parameter of `GET /history` into `points`, or 0 if there is
+   * none.  Returns `false` if it is out of range.
+   */
+  bool _parsePointsParam(ThermiteHttpRequest& request, uint16_t& points) const;
+  void _putCalendar(ThermiteHttpRequest& request, uint8_t zone, const JsonVariant& json);
+  void _putUserSettings(ThermiteHttpRequest& request, uint8_t zone, const JsonVariant& json);
+
+  void _send(ThermiteHttpRequest& request, JsonWriteRef jsonWrite);
+  void _sendBuffer(
+    ThermiteHttpRequest& request,
+    const ThermiteResponseBuffer& buffer,
+    const char* head = nullptr
+  ) const;
+
+  /**
+   * Sends `body`, or a 503 if it is `nullptr` because every chunked body slot is taken.
+   */
+  void _sendChunked(ThermiteHttpRequest& request, ThermiteChunkedBody* body) const;
+  void _sendError(ThermiteHttpRequest& request, const HttpError& error) const;
+  void _sendNotFound(ThermiteHttpRequest& request) const;
+
+  /**
+   * Sends `snapshot`, first reserializing it from `jsonWrite` if it is older than `version`,
+   * with `head` (if any) in place of its opening `{`.
+   */
+  void _sendSnapshot(
+    ThermiteHttpRequest& request,
+    ThermiteSnapshot& snapshot,
+    JsonWriteRef jsonWrite,
+    uint32_t version,
+    const char* head = nullptr
   );
+public:
+  ThermiteWebController(ThermiteZones& zones, ThermitePowerManager& powerManager);
+
+  const ThermiteResponsePool& getResponsePool() const { return _responsePool; }
+  void setAllocProfiler(ThermiteAllocProfiler* allocProfiler) { _allocProfiler = allocProfiler; }
+
+  /**
+   * `GET /debug/alloc`, reporting heap use per route and loop phase (see
+   * `ThermiteAllocProfileBody`), or 404 if there is no profiler.
+   */
+  void getAllocProfile(ThermiteHttpRequest& request);
+  void getCalendar(ThermiteHttpRequest& request);
+  void getHeaterRuntime(ThermiteHttpRequest& request);
+
+  /**
+   * `GET /history?from=&to=`, streaming the samples and heater switches between UTC times
+   * `from` and `to` from flash (see `ThermiteHistoryBody`).
+   */
+  void getHistory(ThermiteHttpRequest& request);
+  void getInternalState(ThermiteHttpRequest& request);
+  void getPower(ThermiteHttpRequest& request);
+  void getRollups(ThermiteHttpRequest& request);
+
+  /**
+   * `GET /schedule/timeline?from=&to=`, streaming the effective schedule between local times
+   * `from` and `to` (see `ThermiteScheduleTimelineBody`).
+   */
+  void getScheduleTimeline(ThermiteHttpRequest& request);
+
+  /**
+   * `GET /thermalModel`, reporting what `ThermiteThermalEstimator` has learned so far.
+   */
+  void getThermalModel(ThermiteHttpRequest& request);
+  void getUserSettings(ThermiteHttpRequest& request);
 
-  void getInternalState(AsyncWebServerRequest* request);
-  void getUserSettings(AsyncWebServerRequest* request);
+  /**
+   * `GET /zones`, summarizing all zones as parallel arrays, and `GET /zones/{id}/...`.
+   */
+  void getZones(ThermiteHttpRequest& request);
 
-  void putUserSettings(AsyncWebServerRequest* request, const JsonVariant& json);
+  /**
+   * `PUT /calendar`, replacing every calendar exception with those in the body's
+   * `"calendar"` array.
+   */
+  void putCalendar(ThermiteHttpRequest& request, const JsonVariant& json);
+  void putUserSettings(ThermiteHttpRequest& request, const JsonVariant& json);
 
-  void notFound(AsyncWebServerRequest* request);
+  /**
+   * `PUT /zones/{id}/calendar` and `PUT /zones/{id}/userSettings`.
+   */
+  void putZones(ThermiteHttpRequest& request, const JsonVariant& json);
 
-  void initRoutes(AsyncWebServer& server);
+  void notFound(ThermiteHttpRequest& request);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include <string.h>
+
+#include "ThermiteCrc.h"
+#include "ThermiteWifiConnector.h"
+
+ThermiteWifiConnector::ThermiteWifiConnector(ThermiteWifi& wifi, ThermiteRtcMemory& rtcMemory)
+: _wifi(wifi),
+  _rtcMemory(rtcMemory),
+  _state(WIFI_STATE_IDLE),
+  _cacheValid(false),
+  _cacheUsed(false),
+  _attemptAt(0ul),
+  _retryAt(0ul),
+  _backoff(WIFI_BACKOFF_MIN),
+  _connectDuration(0ul),
+  _connectCount(0ul) {
+  memset(&_cache, 0, sizeof(_cache));
+}
+
+void ThermiteWifiConnector::_begin(unsigned long now) {
+  _cacheUsed = _cacheValid;
+  _wifi.begin(_cacheValid ? &_cache : nullptr);
+  _state = WIFI_STATE_CONNECTING;
+  _attemptAt = now;
+}
+
+void ThermiteWifiConnector::_fail(unsigned long now) {
+  _wifi.disconnect();
+  _state = WIFI_STATE_IDLE;
+  if (_cacheUsed) {
+    /*
+     * The access point may have moved channel, or been replaced: scan on the next attempt,
+     * without waiting.
+     */
+    _cacheValid = false;
+    _retryAt = now;
+    return;
+  }
+  _retryAt = now + _backoff;
+  _backoff *= 2;
+  if (_backoff > WIFI_BACKOFF_MAX) {
+    _backoff = WIFI_BACKOFF_MAX;
+  }
+}
+
+void ThermiteWifiConnector::_saveCache() {
+  ThermiteWifiCache cache;
+  _wifi.getCache(cache);
+  if (_cacheValid && memcmp(&cache, &_cache, sizeof(cache)) == 0) {
+    return;
+  }
+  _cache = cache;
+  _cacheValid = true;
+
+  ThermiteWifiCacheRecord record;
+  record.cache = cache;
+  record.crc = thermiteCrc32(&record.cache, sizeof(record.cache));
+  _rtcMemory.write(RTC_OFFSET_WIFI_CACHE, &record, sizeof(record));
+}
+
+void ThermiteWifiConnector::init(unsigned long now) {
+  ThermiteWifiCacheRecord record;
+  if (_rtcMemory.read(RTC_OFFSET_WIFI_CACHE, &record, sizeof(record))
+    && record.crc == thermiteCrc32(&record.cache, sizeof(record.cache))) {
+    _cache = record.cache;
+    _cacheValid = true;
+  }
+  _begin(now);
+}
+
+void ThermiteWifiConnector::update(unsigned long now) {
+  if (_state == WIFI_STATE_IDLE) {
+    if (static_cast<int32_t>(now - _retryAt) >= 0) {
+      _begin(now);
+    }
+    return;
+  }
+
+  uint8_t state = _wifi.getState();
+  if (_state == WIFI_STATE_CONNECTED) {
+    if (state != WIFI_STATE_CONNECTED) {
+      _wifi.disconnect();
+      _state = WIFI_STATE_IDLE;
+      _retryAt = now;
+    }
+    return;
+  }
+
+  if (state == WIFI_STATE_CONNECTED) {
+    _state = WIFI_STATE_CONNECTED;
+    _connectDuration = static_cast<uint32_t>(now - _attemptAt);
+    _connectCount++;
+    _backoff = WIFI_BACKOFF_MIN;
+    _saveCache();
+  } else if (state == WIFI_STATE_FAILED
+    || static_cast<uint32_t>(now - _attemptAt) >= WIFI_CONNECT_TIMEOUT) {
+    _fail(now);
+  }
+}
+
+unsigned long ThermiteWifiConnector::getUpdateDelay(unsigned long now) const {
+  if (_state == WIFI_STATE_CONNECTING) {
+    return WIFI_POLL_INTERVAL;
+  }
+  if (_state == WIFI_STATE_IDLE) {
+    int32_t delay = static_cast<int32_t>(_retryAt - now);
+    return delay > 0 ? static_cast<unsigned long>(delay) : 0ul;
+  }
+  return 0xfffffffful;
+}
\ No newline at end of file
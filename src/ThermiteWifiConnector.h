@@ -0,0 +1,77 @@
+#ifndef _THERMITE_WIFI_CONNECTOR_H__
+#define _THERMITE_WIFI_CONNECTOR_H__
+
+#include <stdint.h>
+
+#include "Constants.h"
+#include "ThermiteHal.h"
+
+/**
+ * `ThermiteWifiCache` as stored in RTC memory, with a CRC so that garbage left over from a
+ * power cycle is not mistaken for a cache.
+ */
+struct ThermiteWifiCacheRecord {
+  uint32_t crc;
+  ThermiteWifiCache cache;
+};
+
+/**
+ * Keeps the WiFi connection up in the background, so that nothing else ever waits on it.
+ * 
+ * `update()` is called once per loop, and only ever checks on the connection: it never
+ * blocks.  After each successful connection, the access point's BSSID and channel (and IP
+ * configuration) are cached in RTC memory, so that reconnecting - even after a reset - skips
+ * the scan.  If connecting with the cache fails, the cache is dropped and the next attempt
+ * scans.  Failed attempts are retried with exponential backoff, from `WIFI_BACKOFF_MIN` up to
+ * `WIFI_BACKOFF_MAX` ms; a dropped connection is retried immediately.
+ */
+class ThermiteWifiConnector {
+private:
+  ThermiteWifi& _wifi;
+  ThermiteRtcMemory& _rtcMemory;
+
+  /**
+   * One of `WIFI_STATE_IDLE` (waiting until `_retryAt`), `WIFI_STATE_CONNECTING` or
+   * `WIFI_STATE_CONNECTED`.
+   */
+  uint8_t _state;
+
+  ThermiteWifiCache _cache;
+  bool _cacheValid;
+  bool _cacheUsed;
+
+  unsigned long _attemptAt;
+  unsigned long _retryAt;
+  unsigned long _backoff;
+
+  unsigned long _connectDuration;
+  unsigned long _connectCount;
+
+  void _begin(unsigned long now);
+  void _fail(unsigned long now);
+  void _saveCache();
+public:
+  ThermiteWifiConnector(ThermiteWifi& wifi, ThermiteRtcMemory& rtcMemory);
+
+  /**
+   * Loads the cache from RTC memory, and starts connecting.
+   */
+  void init(unsigned long now);
+  void update(unsigned long now);
+
+  /**
+   * Time taken by the last successful connection attempt, in ms.
+   */
+  unsigned long getConnectDuration() const { return _connectDuration; }
+  unsigned long getConnectCount() const { return _connectCount; }
+  uint8_t getState() const { return _state; }
+
+  /**
+   * Returns how long, in ms after `now`, until `update()` next has work to do.
+   */
+  unsigned long getUpdateDelay(unsigned long now) const;
+  bool isCacheValid() const { return _cacheValid; }
+  bool isConnected() const { return _state == WIFI_STATE_CONNECTED; }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include <string.h>
+
+#include "ThermiteCrc.h"
+#include "ThermiteZones.h"
+
+static_assert(
+  RTC_OFFSET_CLOCK + sizeof(ThermiteClockCheckpoint) <= RTC_OFFSET_CHECKPOINT,
+  "ThermiteClockCheckpoint overlaps the zone checkpoints"
+);
+
+ThermiteZones::ThermiteZones()
+: _count(0),
+  _heaterMask(0),
+  _relaysWritten(false),
+  _relaysWrittenAt(0ul),
+  _rtcMemory(nullptr),
+  _clock(nullptr),
+  _clockSaved(false),
+  _clockSavedAt(0ul) {}
+
+void ThermiteZones::_saveClock(unsigned long now) {
+  ThermiteClockCheckpoint checkpoint;
+  checkpoint.version = CLOCK_CHECKPOINT_VERSION;
+  checkpoint.epoch = static_cast<uint32_t>(_clock->getEpochTime());
+  checkpoint.ticks = _rtcMemory->getTicks();
+  checkpoint.crc = thermiteCrc32(
+    reinterpret_cast<const uint8_t*>(&checkpoint) + sizeof(checkpoint.crc),
+    sizeof(checkpoint) - sizeof(checkpoint.crc)
+  );
+  _rtcMemory->write(RTC_OFFSET_CLOCK, &checkpoint, sizeof(checkpoint));
+  _clockSaved = true;
+  _clockSavedAt = now;
+}
+
+int8_t ThermiteZones::add(
+  ThermiteUserSettingsStore& userSettingsStore,
+  ThermiteInternalState& internalState,
+  ThermiteRelay& relay
+) {
+  if (_count >= ZONE_COUNT_MAX) {
+    return -1;
+  }
+  _userSettingsStores[_count] = &userSettingsStore;
+  _internalStates[_count] = &internalState;
+  _relays[_count] = &relay;
+  return _count++;
+}
+
+unsigned long ThermiteZones::getSleepDelay(unsigned long now) const {
+  unsigned long delay = 0xfffffffful;
+  for (uint8_t i = 0; i < _count; i++) {
+    unsigned long delayZone = _internalStates[i]->getSleepDelay(now);
+    if (delayZone < delay) {
+      delay = delayZone;
+    }
+  }
+  return delay;
+}
+
+bool ThermiteZones::init() {
+  bool ok = true;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (!_internalStates[i]->init()) {
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool ThermiteZones::restoreCheckpoint(unsigned long now) {
+  if (_rtcMemory == nullptr) {
+    return false;
+  }
+  ThermiteClockCheckpoint checkpoint;
+  if (_rtcMemory->read(RTC_OFFSET_CLOCK, &checkpoint, sizeof(checkpoint))) {
+    uint32_t crc = thermiteCrc32(
+      reinterpret_cast<const uint8_t*>(&checkpoint) + sizeof(checkpoint.crc),
+      sizeof(checkpoint) - sizeof(checkpoint.crc)
+    );
+    if (crc == checkpoint.crc && checkpoint.version == CLOCK_CHECKPOINT_VERSION) {
+      uint32_t ticks = _rtcMemory->getTicks() - checkpoint.ticks;
+      unsigned long elapsed = _rtcMemory->ticksToMillis(ticks);
+      _clock->setEpochTime(static_cast<time_t>(checkpoint.epoch + elapsed / 1000ul));
+    }
+  }
+
+  bool restored = false;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_internalStates[i]->restoreCheckpoint(now)) {
+      restored = true;
+    }
+  }
+  return restored;
+}
+
+bool ThermiteZones::toJSON(const JsonObject& root) const {
+  if (!root["count"].set(_count)) {
+    return false;
+  }
+  const JsonArray& jsonTemp = root.createNestedArray("temp");
+  const JsonArray& jsonTempTarget = root.createNestedArray("tempTarget");
+  const JsonArray& jsonHeater = root.createNestedArray("heater");
+  if (jsonTemp.isNull() || jsonTempTarget.isNull() || jsonHeater.isNull()) {
+    return false;
+  }
+  for (uint8_t i = 0; i < _count; i++) {
+    const ThermiteInternalState& internalState = *_internalStates[i];
+    if (!jsonTemp.add(internalState.getTemp())) {
+      return false;
+    }
+    if (!jsonTempTarget.add(internalState.getTempTarget())) {
+      return false;
+    }
+    if (!jsonHeater.add(internalState.getHeater())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ThermiteZones::update(unsigned long now) {
+  for (uint8_t i = 0; i < _count; i++) {
+    _internalStates[i]->update(now);
+  }
+  writeRelays(now);
+
+  if (_rtcMemory != nullptr
+    && (!_clockSaved
+      || static_cast<uint32_t>(now - _clockSavedAt) >= ZONE_CLOCK_CHECKPOINT_INTERVAL)) {
+    _saveClock(now);
+  }
+  for (uint8_t i = 0; i < _count; i++) {
+    _internalStates[i]->persistHistory();
+    _userSettingsStores[i]->persist();
+    _userSettingsStores[i]->quiescent();
+  }
+}
+
+void ThermiteZones::writeRelays(unsigned long now) {
+  uint8_t heaterMask = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_internalStates[i]->getHeater()) {
+      heaterMask |= 1 << i;
+    }
+  }
+
+  uint8_t changed = heaterMask ^ _heaterMask;
+  if (!_relaysWritten
+    || static_cast<uint32_t>(now - _relaysWrittenAt) >= ZONE_RELAY_REFRESH_INTERVAL) {
+    changed = (1 << _count) - 1;
+    _relaysWritten = true;
+    _relaysWrittenAt = now;
+  }
+  for (uint8_t i = 0; changed != 0; i++, changed >>= 1) {
+    if (changed & 1) {
+      _relays[i]->set((heaterMask >> i) & 1);
+    }
+  }
+  _heaterMask = heaterMask;
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#ifndef _THERMITE_ZONES_H__
+#define _THERMITE_ZONES_H__
+
+#include <stdint.h>
+
+#include "Constants.h"
+#include "JsonIO.h"
+#include "ThermiteHal.h"
+#include "ThermiteInternalState.h"
+#include "ThermiteUserSettingsStore.h"
+
+/**
+ * Bump this whenever `ThermiteClockCheckpoint` changes layout.
+ */
+#define CLOCK_CHECKPOINT_VERSION 1
+
+/**
+ * Wall clock time, as kept in RTC memory so that schedules still apply straight after a soft
+ * reset, long before NTP answers.  `ticks` says how long ago `epoch` was, even across the
+ * reset.
+ */
+struct ThermiteClockCheckpoint {
+  /**
+   * CRC-32 of everything after this field.
+   */
+  uint32_t crc;
+  uint32_t version;
+
+  /**
+   * UTC time at the checkpoint, in seconds since the Unix epoch.
+   */
+  uint32_t epoch;
+
+  /**
+   * `ThermiteRtcMemory::getTicks()` at the checkpoint.
+   */
+  uint32_t ticks;
+};
+
+/**
+ * Independently controlled heating zones, each with its own `ThermiteUserSettingsStore`,
+ * `ThermiteInternalState` and relay.
+ * 
+ * Zones are kept in fixed-size arrays, and `update()` runs every zone's controller in one
+ * pass, then drives the relays in a second pass that only touches relays whose state changed
+ * (plus a full refresh every `ZONE_RELAY_REFRESH_INTERVAL` ms, in case a write was lost).
+ * Heater states are kept as a bitmask, so that pass is cheap to skip when nothing changed.
+ * The end of `update()` is the control loop's quiescent point for every zone's settings, and
+ * where changed calendars and full history blocks are written to flash.
+ */
+class ThermiteZones : public JsonWrite<ThermiteZones> {
+private:
+  uint8_t _count;
+  ThermiteUserSettingsStore* _userSettingsStores[ZONE_COUNT_MAX];
+  ThermiteInternalState* _internalStates[ZONE_COUNT_MAX];
+  ThermiteRelay* _relays[ZONE_COUNT_MAX];
+
+  /**
+   * Heater state of zone `i` in bit `i`, as last written to the relays.
+   */
+  uint8_t _heaterMask;
+  bool _relaysWritten;
+  unsigned long _relaysWrittenAt;
+
+  /**
+   * Where the clock shared by all zones is checkpointed, if anywhere, every
+   * `ZONE_CLOCK_CHECKPOINT_INTERVAL` ms.
+   */
+  ThermiteRtcMemory* _rtcMemory;
+  ThermiteClock* _clock;
+  bool _clockSaved;
+  unsigned long _clockSavedAt;
+
+  void _saveClock(unsigned long now);
+public:
+  ThermiteZones();
+
+  /**
+   * Adds a zone, and returns its index, or -1 if there are already `ZONE_COUNT_MAX` zones.
+   */
+  int8_t add(
+    ThermiteUserSettingsStore& userSettingsStore,
+    ThermiteInternalState& internalState,
+    ThermiteRelay& relay
+  );
+
+  uint8_t getCount() const { return _count; }
+  uint8_t getHeaterMask() const { return _heaterMask; }
+  ThermiteInternalState& getInternalState(uint8_t zone) const { return *_internalStates[zone]; }
+  ThermiteRelay& getRelay(uint8_t zone) const { return *_relays[zone]; }
+  ThermiteUserSettingsStore& getUserSettingsStore(uint8_t zone) const {
+    return *_userSettingsStores[zone];
+  }
+
+  /**
+   * Returns the smallest `ThermiteInternalState::getSleepDelay()` over all zones.
+   */
+  unsigned long getSleepDelay(unsigned long now) const;
+
+  /**
+   * Initializes every zone's thermometer, and returns `false` if any of them failed.
+   */
+  bool init();
+
+  /**
+   * Restores the clock, then every zone, from their checkpoints in `_rtcMemory`.  The clock
+   * is set to its checkpoint plus the time since, as measured by the RTC timer.  Returns
+   * `true` if any zone was restored; `writeRelays()` then drives the relays accordingly.
+   */
+  bool restoreCheckpoint(unsigned long now);
+
+  void setRtcMemory(ThermiteRtcMemory* rtcMemory, ThermiteClock* clock) {
+    _rtcMemory = rtcMemory;
+    _clock = clock;
+  }
+  bool toJSON(const JsonObject& root) const;
+  void update(unsigned long now);
+
+  /**
+   * Drives the relays from every zone's current heater state, without running the
+   * controllers: `update()` does this after its controller pass.
+   */
+  void writeRelays(unsigned long now);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include <stddef.h>
+
+#include "Constants.h"
+#include "ThermiteAllocProfiler.h"
+
+#if ALLOC_PROFILER
+
+/**
+ * Allocator wrappers for `ThermiteAllocProfiler`, linked in place of `malloc()`, `calloc()`
+ * and `realloc()` by `-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc` (see
+ * `env:thing-profile`).  `operator new` and everything outside the core's heap code go
+ * through these; the SDK's own `pvPortMalloc()` does not, but still shows up in free heap.
+ */
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  void* ptr = __real_malloc(size);
+  if (ptr != nullptr) {
+    ThermiteAllocProfiler::noteAllocation(size);
+  }
+  return ptr;
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  void* ptr = __real_calloc(count, size);
+  if (ptr != nullptr) {
+    ThermiteAllocProfiler::noteAllocation(count * size);
+  }
+  return ptr;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  void* resized = __real_realloc(ptr, size);
+  if (resized != nullptr) {
+    ThermiteAllocProfiler::noteAllocation(size);
+  }
+  return resized;
+}
+
+}
+
+#endif
\ No newline at end of file
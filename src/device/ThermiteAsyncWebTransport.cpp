@@ -0,0 +1,371 @@
+#include <AsyncJson.h>
+#include <functional>
+
+#include "ThermiteAsyncWebTransport.h"
+
+alignas(ThermitePooledResponse) static uint8_t responseSlots[RESPONSE_SLOTS][sizeof(ThermitePooledResponse)];
+static bool responseSlotsInUse[RESPONSE_SLOTS];
+alignas(ThermiteChunkedResponse) static uint8_t chunkedResponseSlots[RESPONSE_SLOTS][sizeof(ThermiteChunkedResponse)];
+static bool chunkedResponseSlotsInUse[RESPONSE_SLOTS];
+
+ThermitePooledResponse::ThermitePooledResponse(
+  uint16_t code,
+  const ThermiteResponseBuffer& buffer,
+  const char* head
+) : _buffer(buffer),
+    _content(nullptr),
+    _headLen(0),
+    _offset(0) {
+  _code = code;
+  _contentType = "application/json";
+  _contentLength = _buffer.getLength();
+  if (head != nullptr) {
+    _headLen = strlcpy(_head, head, sizeof(_head));
+    if (_headLen >= sizeof(_head)) {
+      _headLen = sizeof(_head) - 1;
+    }
+    _contentLength += _headLen - 1;
+  }
+}
+
+ThermitePooledResponse::ThermitePooledResponse(uint16_t code, PGM_P content)
+: _content(content),
+  _headLen(0),
+  _offset(0) {
+  _code = code;
+  _contentType = "application/json";
+  _contentLength = strlen_P(content);
+}
+
+size_t ThermitePooledResponse::_fillBuffer(uint8_t* data, size_t len) {
+  size_t left = _contentLength - _offset;
+  if (len > left) {
+    len = left;
+  }
+  size_t n = 0;
+  if (_offset < _headLen) {
+    n = _headLen - _offset;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(data, _head + _offset, n);
+  }
+  if (n < len) {
+    // past the head, the body picks up after its own opening `{`
+    size_t offset = _offset + n - _headLen + (_headLen > 0 ? 1 : 0);
+    if (_content != nullptr) {
+      memcpy_P(data + n, _content + offset, len - n);
+    } else {
+      memcpy(data + n, _buffer.getData() + offset, len - n);
+    }
+  }
+  _offset += len;
+  return len;
+}
+
+void* ThermitePooledResponse::operator new(size_t) noexcept {
+  for (uint8_t i = 0; i < RESPONSE_SLOTS; i++) {
+    if (!responseSlotsInUse[i]) {
+      responseSlotsInUse[i] = true;
+      return responseSlots[i];
+    }
+  }
+  return nullptr;
+}
+
+void ThermitePooledResponse::operator delete(void* p) {
+  uint8_t i = (static_cast<uint8_t*>(p) - responseSlots[0]) / sizeof(ThermitePooledResponse);
+  responseSlotsInUse[i] = false;
+}
+
+ThermiteChunkedResponse::ThermiteChunkedResponse(
+  uint16_t code,
+  ThermiteChunkedBody* body,
+  bool chunked
+) : _body(body) {
+  _code = code;
+  _contentType = "application/json";
+  _contentLength = 0;
+  _sendContentLength = false;
+  _chunked = chunked;
+}
+
+ThermiteChunkedResponse::~ThermiteChunkedResponse() {
+  delete _body;
+}
+
+size_t ThermiteChunkedResponse::_fillBuffer(uint8_t* data, size_t len) {
+  return _body->fill(data, len);
+}
+
+void* ThermiteChunkedResponse::operator new(size_t) noexcept {
+  for (uint8_t i = 0; i < RESPONSE_SLOTS; i++) {
+    if (!chunkedResponseSlotsInUse[i]) {
+      chunkedResponseSlotsInUse[i] = true;
+      return chunkedResponseSlots[i];
+    }
+  }
+  return nullptr;
+}
+
+void ThermiteChunkedResponse::operator delete(void* p) {
+  uint8_t i = (static_cast<uint8_t*>(p) - chunkedResponseSlots[0]) / sizeof(ThermiteChunkedResponse);
+  chunkedResponseSlotsInUse[i] = false;
+}
+
+ThermiteAsyncHttpRequest::ThermiteAsyncHttpRequest(AsyncWebServerRequest* request)
+: _request(request) {}
+
+bool ThermiteAsyncHttpRequest::isPreflight() const {
+  return _request->method() == HTTP_OPTIONS;
+}
+
+const char* ThermiteAsyncHttpRequest::getPath() const {
+  return _request->url().c_str();
+}
+
+const char* ThermiteAsyncHttpRequest::getParam(const char* name) const {
+  AsyncWebParameter* param = _request->getParam(name);
+  if (param == nullptr) {
+    return nullptr;
+  }
+  return param->value().c_str();
+}
+
+void ThermiteAsyncHttpRequest::send(uint16_t code) {
+  _request->send(code);
+}
+
+void ThermiteAsyncHttpRequest::sendBuffer(
+  uint16_t code,
+  const ThermiteResponseBuffer& body,
+  const char* head
+) {
+  ThermitePooledResponse* response = new ThermitePooledResponse(code, body, head);
+  if (response == nullptr) {
+    _request->send(HTTP_SERVICE_UNAVAILABLE);
+    return;
+  }
+  _request->send(response);
+}
+
+void ThermiteAsyncHttpRequest::sendJsonConstant(uint16_t code, const char* body) {
+  ThermitePooledResponse* response = new ThermitePooledResponse(code, body);
+  if (response == nullptr) {
+    _request->send(HTTP_SERVICE_UNAVAILABLE);
+    return;
+  }
+  _request->send(response);
+}
+
+void ThermiteAsyncHttpRequest::sendChunked(uint16_t code, ThermiteChunkedBody* body) {
+  /*
+   * `body` outlives this call: `ESPAsyncWebServer` fills the response from the TCP stack as
+   * the client reads it, and deletes it (and with it `body`) when the response is complete or
+   * the connection drops.
+   */
+  ThermiteChunkedResponse* response = new ThermiteChunkedResponse(
+    code,
+    body,
+    _request->version() != 0
+  );
+  if (response == nullptr) {
+    delete body;
+    _request->send(HTTP_SERVICE_UNAVAILABLE);
+    return;
+  }
+  _request->send(response);
+}
+
+ThermiteAsyncWebTransport::ThermiteAsyncWebTransport(ThermiteWebController& webController)
+: _webController(webController) {}
+
+void ThermiteAsyncWebTransport::_getAllocProfile(AsyncWebServerRequest* request) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.getAllocProfile(httpRequest);
+}
+
+void ThermiteAsyncWebTransport::_getCalendar(AsyncWebServerRequest* request) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.getCalendar(httpRequest);
+}
+
+void ThermiteAsyncWebTransport::_getHeaterRuntime(AsyncWebServerRequest* request) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.getHeaterRuntime(httpRequest);
+}
+
+void ThermiteAsyncWebTransport::_getHistory(AsyncWebServerRequest* request) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.getHistory(httpRequest);
+}
+
+void ThermiteAsyncWebTransport::_getInternalState(AsyncWebServerRequest* request) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.getInternalState(httpRequest);
+}
+
+void ThermiteAsyncWebTransport::_getPower(AsyncWebServerRequest* request) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.getPower(httpRequest);
+}
+
+void ThermiteAsyncWebTransport::_getRollups(AsyncWebServerRequest* request) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.getRollups(httpRequest);
+}
+
+void ThermiteAsyncWebTransport::_getScheduleTimeline(AsyncWebServerRequest* request) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.getScheduleTimeline(httpRequest);
+}
+
+void ThermiteAsyncWebTransport::_getThermalModel(AsyncWebServerRequest* request) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.getThermalModel(httpRequest);
+}
+
+void ThermiteAsyncWebTransport::_getUserSettings(AsyncWebServerRequest* request) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.getUserSettings(httpRequest);
+}
+
+void ThermiteAsyncWebTransport::_getZones(AsyncWebServerRequest* request) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.getZones(httpRequest);
+}
+
+void ThermiteAsyncWebTransport::_putZones(AsyncWebServerRequest* request, JsonVariant& json) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.putZones(httpRequest, json);
+}
+
+void ThermiteAsyncWebTransport::_putCalendar(AsyncWebServerRequest* request, JsonVariant& json) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.putCalendar(httpRequest, json);
+}
+
+void ThermiteAsyncWebTransport::_putUserSettings(AsyncWebServerRequest* request, JsonVariant& json) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.putUserSettings(httpRequest, json);
+}
+
+void ThermiteAsyncWebTransport::_notFound(AsyncWebServerRequest* request) {
+  ThermiteAsyncHttpRequest httpRequest(request);
+  _webController.notFound(httpRequest);
+}
+
+void ThermiteAsyncWebTransport::initRoutes(AsyncWebServer& server) {
+  server.on(
+    "/calendar",
+    HTTP_GET,
+    std::bind(&ThermiteAsyncWebTransport::_getCalendar, this, std::placeholders::_1)
+  );
+
+  AsyncCallbackJsonWebHandler* handlerPutCalendar = new AsyncCallbackJsonWebHandler(
+    "/calendar",
+    std::bind(
+      &ThermiteAsyncWebTransport::_putCalendar,
+      this,
+      std::placeholders::_1,
+      std::placeholders::_2
+    ),
+    CAPACITY_USER_SETTINGS_UPDATE
+  );
+  handlerPutCalendar->setMethod(HTTP_PUT);
+  server.addHandler(handlerPutCalendar);
+
+  server.on(
+    "/debug/alloc",
+    HTTP_GET,
+    std::bind(&ThermiteAsyncWebTransport::_getAllocProfile, this, std::placeholders::_1)
+  );
+
+  server.on(
+    "/heater",
+    HTTP_GET,
+    std::bind(&ThermiteAsyncWebTransport::_getHeaterRuntime, this, std::placeholders::_1)
+  );
+
+  server.on(
+    "/history",
+    HTTP_GET,
+    std::bind(&ThermiteAsyncWebTransport::_getHistory, this, std::placeholders::_1)
+  );
+
+  server.on(
+    "/internalState",
+    HTTP_GET,
+    std::bind(&ThermiteAsyncWebTransport::_getInternalState, this, std::placeholders::_1)
+  );
+
+  server.on(
+    "/power",
+    HTTP_GET,
+    std::bind(&ThermiteAsyncWebTransport::_getPower, this, std::placeholders::_1)
+  );
+
+  server.on(
+    "/rollups",
+    HTTP_GET,
+    std::bind(&ThermiteAsyncWebTransport::_getRollups, this, std::placeholders::_1)
+  );
+
+  server.on(
+    "/schedule/timeline",
+    HTTP_GET,
+    std::bind(&ThermiteAsyncWebTransport::_getScheduleTimeline, this, std::placeholders::_1)
+  );
+
+  server.on(
+    "/thermalModel",
+    HTTP_GET,
+    std::bind(&ThermiteAsyncWebTransport::_getThermalModel, this, std::placeholders::_1)
+  );
+
+  server.on(
+    "/userSettings",
+    HTTP_GET,
+    std::bind(&ThermiteAsyncWebTransport::_getUserSettings, this, std::placeholders::_1)
+  );
+
+  AsyncCallbackJsonWebHandler* handlerPutUserSettings = new AsyncCallbackJsonWebHandler(
+    "/userSettings",
+    std::bind(
+      &ThermiteAsyncWebTransport::_putUserSettings,
+      this,
+      std::placeholders::_1,
+      std::placeholders::_2
+    ),
+    CAPACITY_USER_SETTINGS_UPDATE
+  );
+  handlerPutUserSettings->setMethod(HTTP_PUT);
+  server.addHandler(handlerPutUserSettings);
+
+  /*
+   * Handlers for `/zones` also match everything under `/zones/`; `ThermiteWebController`
+   * picks the zone and resource out of the path.
+   */
+  server.on(
+    "/zones",
+    HTTP_GET,
+    std::bind(&ThermiteAsyncWebTransport::_getZones, this, std::placeholders::_1)
+  );
+
+  AsyncCallbackJsonWebHandler* handlerPutZones = new AsyncCallbackJsonWebHandler(
+    "/zones",
+    std::bind(
+      &ThermiteAsyncWebTransport::_putZones,
+      this,
+      std::placeholders::_1,
+      std::placeholders::_2
+    ),
+    CAPACITY_USER_SETTINGS_UPDATE
+  );
+  handlerPutZones->setMethod(HTTP_PUT);
+  server.addHandler(handlerPutZones);
+
+  server.onNotFound(
+    std::bind(&ThermiteAsyncWebTransport::_notFound, this, std::placeholders::_1)
+  );
+}
\ No newline at end of file
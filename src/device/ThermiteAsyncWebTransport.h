@@ -0,0 +1,112 @@
+#ifndef _THERMITE_ASYNC_WEB_TRANSPORT_H__
+#define _THERMITE_ASYNC_WEB_TRANSPORT_H__
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+
+#include "ThermiteHal.h"
+#include "ThermiteResponsePool.h"
+#include "ThermiteWebController.h"
+
+/**
+ * Most `ThermitePooledResponse` objects in flight at once.
+ */
+#define RESPONSE_SLOTS 8
+
+/**
+ * Response that sends a body serialized by `ThermiteResponsePool`, holding its own copy of
+ * the buffer until `ESPAsyncWebServer` deletes it, or a constant body straight from flash.
+ * A buffer may be preceded by a copied head, in place of its opening `{`.
+ * 
+ * The objects themselves come from a fixed set of `RESPONSE_SLOTS` slots rather than the
+ * heap; `new` returns `nullptr` once they are all taken.
+ */
+class ThermitePooledResponse : public AsyncAbstractResponse {
+private:
+  ThermiteResponseBuffer _buffer;
+  PGM_P _content;
+  char _head[RESPONSE_HEAD_LEN];
+  size_t _headLen;
+  size_t _offset;
+public:
+  ThermitePooledResponse(uint16_t code, const ThermiteResponseBuffer& buffer, const char* head);
+  ThermitePooledResponse(uint16_t code, PGM_P content);
+
+  bool _sourceValid() const { return true; }
+  size_t _fillBuffer(uint8_t* data, size_t len);
+
+  static void* operator new(size_t size) noexcept;
+  static void operator delete(void* p);
+};
+
+/**
+ * Response that streams a `ThermiteChunkedBody`, and deletes it (back to its slot) once
+ * `ESPAsyncWebServer` deletes the response.  Chunked over HTTP/1.1; over HTTP/1.0, the body
+ * ends when the connection closes.
+ * 
+ * Like `ThermitePooledResponse`, the objects come from `RESPONSE_SLOTS` slots rather than the
+ * heap.
+ */
+class ThermiteChunkedResponse : public AsyncAbstractResponse {
+private:
+  ThermiteChunkedBody* _body;
+public:
+  ThermiteChunkedResponse(uint16_t code, ThermiteChunkedBody* body, bool chunked);
+  ~ThermiteChunkedResponse();
+
+  bool _sourceValid() const { return true; }
+  size_t _fillBuffer(uint8_t* data, size_t len);
+
+  static void* operator new(size_t size) noexcept;
+  static void operator delete(void* p);
+};
+
+/**
+ * `ThermiteHttpRequest` backed by an `ESPAsyncWebServer` request.  Every response comes from
+ * a slot, but `ESPAsyncWebServer` itself still allocates each request, its URL, parameters and
+ * headers on the heap.
+ */
+class ThermiteAsyncHttpRequest : public ThermiteHttpRequest {
+private:
+  AsyncWebServerRequest* _request;
+public:
+  ThermiteAsyncHttpRequest(AsyncWebServerRequest* request);
+
+  bool isPreflight() const;
+  const char* getPath() const;
+  const char* getParam(const char* name) const;
+  void send(uint16_t code);
+  void sendBuffer(uint16_t code, const ThermiteResponseBuffer& body, const char* head);
+  void sendJsonConstant(uint16_t code, const char* body);
+  void sendChunked(uint16_t code, ThermiteChunkedBody* body);
+};
+
+/**
+ * Binds `ThermiteWebController` handlers to routes on an `AsyncWebServer`.
+ */
+class ThermiteAsyncWebTransport {
+private:
+  ThermiteWebController& _webController;
+
+  void _getAllocProfile(AsyncWebServerRequest* request);
+  void _getCalendar(AsyncWebServerRequest* request);
+  void _getHeaterRuntime(AsyncWebServerRequest* request);
+  void _getHistory(AsyncWebServerRequest* request);
+  void _getInternalState(AsyncWebServerRequest* request);
+  void _getPower(AsyncWebServerRequest* request);
+  void _getRollups(AsyncWebServerRequest* request);
+  void _getScheduleTimeline(AsyncWebServerRequest* request);
+  void _getThermalModel(AsyncWebServerRequest* request);
+  void _getUserSettings(AsyncWebServerRequest* request);
+  void _getZones(AsyncWebServerRequest* request);
+  void _putCalendar(AsyncWebServerRequest* request, JsonVariant& json);
+  void _putUserSettings(AsyncWebServerRequest* request, JsonVariant& json);
+  void _putZones(AsyncWebServerRequest* request, JsonVariant& json);
+  void _notFound(AsyncWebServerRequest* request);
+public:
+  ThermiteAsyncWebTransport(ThermiteWebController& webController);
+
+  void initRoutes(AsyncWebServer& server);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,349 @@
+#include <EEPROM.h>
+#include <ESP8266WiFi.h>
+#include <LittleFS.h>
+#include <OneWire.h>
+#include <string.h>
+
+extern "C" {
+#include <user_interface.h>
+}
+
+#include "Constants.h"
+#include "ThermiteDeviceHal.h"
+
+ThermiteDallasBus::ThermiteDallasBus(DallasTemperature& thermometerManager)
+: _thermometerManager(thermometerManager),
+  _requested(false),
+  _requestedAt(0ul) {}
+
+void ThermiteDallasBus::requestTemperatures() {
+  unsigned long now = millis();
+  if (_requested && static_cast<uint32_t>(now - _requestedAt) < TEMP_REQUEST_DELAY) {
+    return;
+  }
+  _thermometerManager.requestTemperatures();
+  _requested = true;
+  _requestedAt = now;
+}
+
+ThermiteDallasThermometer::ThermiteDallasThermometer(ThermiteDallasBus& bus, uint8_t index)
+: _bus(bus),
+  _index(index) {}
+
+bool ThermiteDallasThermometer::init() {
+  DallasTemperature& thermometerManager = _bus.getThermometerManager();
+  if (!thermometerManager.getAddress(_thermometer, _index)) {
+    return false;  
+  }
+  if (OneWire::crc8(_thermometer, 7) != _thermometer[7]) {
+    return false;
+  }
+
+  thermometerManager.setResolution(_thermometer, TEMP_RESOLUTION);
+  thermometerManager.setWaitForConversion(false);
+  return true;
+}
+
+void ThermiteDallasThermometer::requestTemperature() {
+  _bus.requestTemperatures();
+}
+
+float ThermiteDallasThermometer::getTemperature() {
+  float temp = _bus.getThermometerManager().getTempC(_thermometer);
+  if (temp == DEVICE_DISCONNECTED_C) {
+    return TEMP_DISCONNECTED;
+  }
+  return temp;
+}
+
+ThermiteNtpClock::ThermiteNtpClock(NTPClient& ntpClient, Timezone& timezone)
+: _ntpClient(ntpClient),
+  _timezone(timezone),
+  _online(false),
+  _synced(false),
+  _syncedAt(0ul),
+  _restored(false),
+  _restoredEpoch(0),
+  _restoredAt(0ul) {}
+
+unsigned long ThermiteNtpClock::getMillis() const {
+  return millis();
+}
+
+void ThermiteNtpClock::update() {
+  if (!_online) {
+    return;
+  }
+  /*
+   * `NTPClient::update()` only returns `true` when it actually synchronized.
+   */
+  if (_ntpClient.update()) {
+    _synced = true;
+    _syncedAt = millis();
+  }
+}
+
+time_t ThermiteNtpClock::getEpochTime() const {
+  if (!_synced && _restored) {
+    return _restoredEpoch + static_cast<time_t>((millis() - _restoredAt) / 1000ul);
+  }
+  return _ntpClient.getEpochTime();
+}
+
+void ThermiteNtpClock::setEpochTime(time_t tUtc) {
+  _restored = true;
+  _restoredEpoch = tUtc;
+  _restoredAt = millis();
+}
+
+time_t ThermiteNtpClock::toLocal(time_t tUtc, int* offset) const {
+  TimeChangeRule *tcr;
+  time_t tLocal = _timezone.toLocal(tUtc, &tcr);
+  if (offset != nullptr) {
+    *offset = tcr->offset;
+  }
+  return tLocal;
+}
+
+unsigned long ThermiteNtpClock::getUpdateDelay(unsigned long now) const {
+  if (!_online) {
+    return 0xfffffffful;
+  }
+  if (!_synced) {
+    return 0ul;
+  }
+  uint32_t elapsed = static_cast<uint32_t>(now - _syncedAt);
+  if (elapsed >= NTP_UPDATE_INTERVAL) {
+    return 0ul;
+  }
+  return NTP_UPDATE_INTERVAL - elapsed;
+}
+
+bool ThermiteEspRtcMemory::read(uint32_t offset, void* data, size_t size) {
+  return ESP.rtcUserMemoryRead(offset / 4, static_cast<uint32_t*>(data), size);
+}
+
+bool ThermiteEspRtcMemory::write(uint32_t offset, const void* data, size_t size) {
+  return ESP.rtcUserMemoryWrite(
+    offset / 4,
+    static_cast<uint32_t*>(const_cast<void*>(data)),
+    size
+  );
+}
+
+uint32_t ThermiteEspRtcMemory::getTicks() {
+  return system_get_rtc_time();
+}
+
+unsigned long ThermiteEspRtcMemory::ticksToMillis(uint32_t ticks) {
+  /*
+   * `system_rtc_clock_cali_proc()` is the tick period in µs, in 12-bit fixed point.  It
+   * drifts with temperature, but only by a few percent.
+   */
+  uint64_t micros = (static_cast<uint64_t>(ticks) * system_rtc_clock_cali_proc()) >> 12;
+  return static_cast<unsigned long>(micros / 1000ull);
+}
+
+void ThermiteEspEeprom::begin() {
+  EEPROM.begin(EEPROM_SIZE);
+}
+
+bool ThermiteEspEeprom::read(uint32_t offset, void* data, size_t size) {
+  if (offset + size > EEPROM_SIZE) {
+    return false;
+  }
+  memcpy(data, EEPROM.getConstDataPtr() + offset, size);
+  return true;
+}
+
+bool ThermiteEspEeprom::write(uint32_t offset, const void* data, size_t size) {
+  if (offset + size > EEPROM_SIZE) {
+    return false;
+  }
+  memcpy(EEPROM.getDataPtr() + offset, data, size);
+  return true;
+}
+
+bool ThermiteEspEeprom::commit() {
+  return EEPROM.commit();
+}
+
+bool ThermiteLittleFs::begin() {
+  return LittleFS.begin();
+}
+
+long ThermiteLittleFs::getSize(const char* path) {
+  if (!LittleFS.exists(path)) {
+    return -1l;
+  }
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return -1l;
+  }
+  long size = static_cast<long>(file.size());
+  file.close();
+  return size;
+}
+
+long ThermiteLittleFs::read(const char* path, uint32_t offset, void* data, size_t size) {
+  if (!LittleFS.exists(path)) {
+    return -1l;
+  }
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return -1l;
+  }
+  long n = 0l;
+  if (file.seek(offset, SeekSet)) {
+    n = static_cast<long>(file.read(static_cast<uint8_t*>(data), size));
+  }
+  file.close();
+  return n;
+}
+
+bool ThermiteLittleFs::append(const char* path, const void* data, size_t size) {
+  File file = LittleFS.open(path, "a");
+  if (!file) {
+    return false;
+  }
+  size_t n = file.write(static_cast<const uint8_t*>(data), size);
+  file.close();
+  return n == size;
+}
+
+bool ThermiteLittleFs::remove(const char* path) {
+  return LittleFS.remove(path);
+}
+
+void ThermiteLittleFs::list(
+  const char* dir,
+  void (*visit)(void* context, const char* name),
+  void* context
+) {
+  Dir entries = LittleFS.openDir(dir);
+  while (entries.next()) {
+    if (entries.isFile()) {
+      visit(context, entries.fileName().c_str());
+    }
+  }
+}
+
+ThermiteEspWifi::ThermiteEspWifi(const char* ssid, const char* password)
+: _ssid(ssid),
+  _password(password) {}
+
+void ThermiteEspWifi::begin(const ThermiteWifiCache* cache) {
+  /*
+   * Don't let the SDK write credentials to flash on every `begin()`: we keep our own cache.
+   */
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  if (cache == nullptr) {
+    WiFi.config(0u, 0u, 0u);
+    WiFi.begin(_ssid, _password);
+    return;
+  }
+#if WIFI_CACHE_IP
+  if (cache->ip != 0ul) {
+    WiFi.config(
+      IPAddress(cache->ip),
+      IPAddress(cache->gateway),
+      IPAddress(cache->subnet),
+      IPAddress(cache->dns)
+    );
+  }
+#endif
+  WiFi.begin(_ssid, _password, cache->channel, cache->bssid, true);
+}
+
+uint8_t ThermiteEspWifi::getState() const {
+  switch (WiFi.status()) {
+    case WL_CONNECTED:
+      return WIFI_STATE_CONNECTED;
+    case WL_NO_SSID_AVAIL:
+    case WL_CONNECT_FAILED:
+    case WL_CONNECTION_LOST:
+      return WIFI_STATE_FAILED;
+    default:
+      return WIFI_STATE_CONNECTING;
+  }
+}
+
+void ThermiteEspWifi::getCache(ThermiteWifiCache& cache) const {
+  memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+  cache.reserved = 0;
+  cache.ip = static_cast<uint32_t>(WiFi.localIP());
+  cache.gateway = static_cast<uint32_t>(WiFi.gatewayIP());
+  cache.subnet = static_cast<uint32_t>(WiFi.subnetMask());
+  cache.dns = static_cast<uint32_t>(WiFi.dnsIP());
+}
+
+int8_t ThermiteEspWifi::getRssi() const {
+  return static_cast<int8_t>(WiFi.RSSI());
+}
+
+void ThermiteEspWifi::disconnect() {
+  WiFi.disconnect();
+}
+
+uint32_t ThermiteEspSystem::getDeviceId() const {
+  return ESP.getChipId();
+}
+
+uint32_t ThermiteEspSystem::getFreeHeap() const {
+  return ESP.getFreeHeap();
+}
+
+uint32_t ThermiteEspSystem::getMaxFreeBlock() const {
+  return ESP.getMaxFreeBlockSize();
+}
+
+ThermiteEspUdpSocket::ThermiteEspUdpSocket(const char* host, uint16_t port)
+: _port(port),
+  _valid(_address.fromString(host)),
+  _multicast(_valid && (_address[0] & 0xf0) == 0xe0) {}
+
+bool ThermiteEspUdpSocket::send(const void* data, size_t size) {
+  if (!_valid) {
+    return false;
+  }
+  int began = _multicast
+    ? _udp.beginPacketMulticast(_address, _port, WiFi.localIP())
+    : _udp.beginPacket(_address, _port);
+  if (began != 1) {
+    return false;
+  }
+  _udp.write(static_cast<const uint8_t*>(data), size);
+  return _udp.endPacket() == 1;
+}
+
+void ThermiteEspRadio::setSleepMode(uint8_t mode, uint8_t listenInterval) {
+  WiFiSleepType_t sleepType = WIFI_NONE_SLEEP;
+  if (mode == POWER_MODE_MODEM_SLEEP) {
+    sleepType = WIFI_MODEM_SLEEP;
+  } else if (mode == POWER_MODE_LIGHT_SLEEP) {
+    sleepType = WIFI_LIGHT_SLEEP;
+  }
+  WiFi.setSleepMode(sleepType, listenInterval);
+}
+
+ThermiteQwiicRelay::ThermiteQwiicRelay(Qwiic_Relay& relayManager)
+: _relayManager(relayManager),
+  _connected(false) {}
+
+bool ThermiteQwiicRelay::begin() {
+  _connected = _relayManager.begin();
+  return _connected;
+}
+
+void ThermiteQwiicRelay::set(bool on) {
+  if (!_connected) {
+    return;
+  }
+  if (on) {
+    _relayManager.turnRelayOn();
+  } else {
+    _relayManager.turnRelayOff();
+  }
+}
\ No newline at end of file
@@ -0,0 +1,190 @@
+#ifndef _THERMITE_DEVICE_HAL_H__
+#define _THERMITE_DEVICE_HAL_H__
+
+#include <Arduino.h>
+#include <DallasTemperature.h>
+#include <NTPClient.h>
+#include <SparkFun_Qwiic_Relay.h>
+#include <Timezone.h>
+#include <WiFiUdp.h>
+
+#include "ThermiteHal.h"
+
+/**
+ * `DallasTemperature` bus shared by several DS18B20 thermometers.
+ * 
+ * A conversion request is broadcast to every device on the bus, so repeated requests within
+ * one conversion time are dropped: each zone asks for a reading, but the bus only converts
+ * once.
+ */
+class ThermiteDallasBus {
+private:
+  DallasTemperature& _thermometerManager;
+  bool _requested;
+  unsigned long _requestedAt;
+public:
+  ThermiteDallasBus(DallasTemperature& thermometerManager);
+
+  DallasTemperature& getThermometerManager() { return _thermometerManager; }
+  void requestTemperatures();
+};
+
+/**
+ * DS18B20 thermometer: the device at index `index` on a `ThermiteDallasBus`.
+ */
+class ThermiteDallasThermometer : public ThermiteThermometer {
+private:
+  ThermiteDallasBus& _bus;
+  uint8_t _index;
+  DeviceAddress _thermometer;
+public:
+  ThermiteDallasThermometer(ThermiteDallasBus& bus, uint8_t index = 0);
+
+  bool init();
+  void requestTemperature();
+  float getTemperature();
+};
+
+/**
+ * NTP-synchronized clock, with local time given by a `Timezone`.
+ */
+class ThermiteNtpClock : public ThermiteClock {
+private:
+  NTPClient& _ntpClient;
+  Timezone& _timezone;
+  bool _online;
+  bool _synced;
+  unsigned long _syncedAt;
+
+  /**
+   * Time to use until the first synchronization, as given to `setEpochTime()`.
+   */
+  bool _restored;
+  time_t _restoredEpoch;
+  unsigned long _restoredAt;
+public:
+  ThermiteNtpClock(NTPClient& ntpClient, Timezone& timezone);
+
+  unsigned long getMillis() const;
+  void update();
+  time_t getEpochTime() const;
+  void setEpochTime(time_t tUtc);
+  time_t toLocal(time_t tUtc, int* offset) const;
+  unsigned long getUpdateDelay(unsigned long now) const;
+
+  /**
+   * While offline, `update()` does nothing: `NTPClient` would otherwise block for up to a
+   * second waiting for a reply that cannot arrive.
+   */
+  void setOnline(bool online) { _online = online; }
+};
+
+/**
+ * ESP8266 RTC user memory.
+ */
+class ThermiteEspRtcMemory : public ThermiteRtcMemory {
+public:
+  bool read(uint32_t offset, void* data, size_t size);
+  bool write(uint32_t offset, const void* data, size_t size);
+  uint32_t getTicks();
+  unsigned long ticksToMillis(uint32_t ticks);
+};
+
+/**
+ * ESP8266 emulated EEPROM, `EEPROM_SIZE` bytes at the end of flash.
+ */
+class ThermiteEspEeprom : public ThermiteEeprom {
+public:
+  void begin();
+
+  bool read(uint32_t offset, void* data, size_t size);
+  bool write(uint32_t offset, const void* data, size_t size);
+  bool commit();
+};
+
+/**
+ * LittleFS, on the flash left over by the linker script (64 KB with `eagle.flash.512k64.ld`).
+ */
+class ThermiteLittleFs : public ThermiteFileSystem {
+public:
+  /**
+   * Mounts the file system, formatting it first if it has never been used.
+   */
+  bool begin();
+
+  long getSize(const char* path);
+  long read(const char* path, uint32_t offset, void* data, size_t size);
+  bool append(const char* path, const void* data, size_t size);
+  bool remove(const char* path);
+  void list(const char* dir, void (*visit)(void* context, const char* name), void* context);
+};
+
+/**
+ * ESP8266 WiFi station.  Cached IP configuration is only used if built with
+ * `-DWIFI_CACHE_IP=1`, since it relies on the DHCP server handing out the same lease.
+ */
+class ThermiteEspWifi : public ThermiteWifi {
+private:
+  const char* _ssid;
+  const char* _password;
+public:
+  ThermiteEspWifi(const char* ssid, const char* password);
+
+  void begin(const ThermiteWifiCache* cache);
+  uint8_t getState() const;
+  void getCache(ThermiteWifiCache& cache) const;
+  int8_t getRssi() const;
+  void disconnect();
+};
+
+/**
+ * ESP8266 chip ID and heap.
+ */
+class ThermiteEspSystem : public ThermiteSystem {
+public:
+  uint32_t getDeviceId() const;
+  uint32_t getFreeHeap() const;
+  uint32_t getMaxFreeBlock() const;
+};
+
+/**
+ * UDP socket sending to `host`, a dotted IPv4 address, on `port`.  Multicast groups
+ * (224.0.0.0/4) are sent to from the station interface.  If `host` does not parse, `send()`
+ * always fails.
+ */
+class ThermiteEspUdpSocket : public ThermiteDatagramSocket {
+private:
+  WiFiUDP _udp;
+  IPAddress _address;
+  uint16_t _port;
+  bool _valid;
+  bool _multicast;
+public:
+  ThermiteEspUdpSocket(const char* host, uint16_t port);
+
+  bool send(const void* data, size_t size);
+};
+
+/**
+ * ESP8266 WiFi radio, using the SDK's automatic modem / light sleep.
+ */
+class ThermiteEspRadio : public ThermiteRadio {
+public:
+  void setSleepMode(uint8_t mode, uint8_t listenInterval);
+};
+
+/**
+ * SparkFun Qwiic relay.  If the relay can't be found at `begin()`, `set()` does nothing.
+ */
+class ThermiteQwiicRelay : public ThermiteRelay {
+private:
+  Qwiic_Relay& _relayManager;
+  bool _connected;
+public:
+  ThermiteQwiicRelay(Qwiic_Relay& relayManager);
+
+  bool begin();
+  void set(bool on);
+};
+
+#endif
\ No newline at end of file
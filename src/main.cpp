@@ -10,35 +10,32 @@
 #include <Wire.h>
 
 #include "private.h"
+#include "device/ThermiteAsyncWebTransport.h"
+#include "device/ThermiteDeviceHal.h"
+#include "ThermiteAllocProfiler.h"
 #include "ThermiteInternalState.h"
-#include "ThermiteUserSettingsManager.h"
+#include "ThermitePowerManager.h"
+#include "ThermiteTelemetry.h"
+#include "ThermiteUserSettingsStore.h"
 #include "ThermiteWebController.h"
+#include "ThermiteWifiConnector.h"
+#include "ThermiteZones.h"
 
 #define PIN_ONE_WIRE 0
 #define PIN_LED_INDICATOR 4
 #define RELAY_ADDR_HEATER 0x18
 
-#define LOOP_INTERVAL 100ul
-
 /**
- * OneWire bus for the DS18B20 thermometer.  We only have a single thermometer on the bus,
- * but we could attach more - for instance, some heating / cooling systems take outdoor
- * temperature into account to help save energy.
+ * OneWire bus for the DS18B20 thermometers, one per zone.
  * 
  * `thermometerManager` wraps the OneWire bus `oneWire` to provide functionality specific
  * to DS18B20 thermometers - many other types of devices use the OneWire protocol.
  * 
- * `thermometer` is the device address of our single thermometer, and is used with
- * `thermometerManager` to read the current temperature.
+ * `dallasBus` is shared by all zones' thermometers, so that one conversion serves them all.
  */
 OneWire oneWire(PIN_ONE_WIRE);
 DallasTemperature thermometerManager(&oneWire);
-
-/**
- * Qwiic relay to control the heater.
- */
-Qwiic_Relay heaterManager(RELAY_ADDR_HEATER);
-
+ThermiteDallasBus dallasBus(thermometerManager);
 
 /**
  * NTP client, used so that we can schedule temperature changes according to real-world
@@ -48,7 +45,7 @@ Qwiic_Relay heaterManager(RELAY_ADDR_HEATER);
  * a separate real-time clock (RTC) module.
  */
 WiFiUDP ntpUDP;
-NTPClient ntpClient(ntpUDP, "pool.ntp.org");
+NTPClient ntpClient(ntpUDP, "pool.ntp.org", 0, NTP_UPDATE_INTERVAL);
 
 /**
  * Hardcoded timezone information, currently set to Eastern Time with DST transitions.
@@ -57,15 +54,54 @@ NTPClient ntpClient(ntpUDP, "pool.ntp.org");
 const TimeChangeRule EDT = {"EDT", Second, Sun, Mar, 2, -240};
 const TimeChangeRule EST = {"EST", First, Sun, Nov, 2, -300};
 Timezone timezone(EDT, EST);
+ThermiteNtpClock ntpClock(ntpClient, timezone);
 
 /**
- * Controls the wifi indicator light as follows:
- * 
- * - intermittent flashing: connecting to wifi;
- * - off: wifi connected;
- * - on: wifi connection error.
+ * Radio power management: see `ThermitePowerManager`.  This stays fully awake unless built
+ * with a different `POWER_MODE_DEFAULT`.
+ */
+ThermiteEspRadio radio;
+ThermitePowerManager powerManager(radio, ntpClock);
+
+/**
+ * WiFi connection, kept up in the background by `wifiConnector` so that heating never waits
+ * on it.  While not connected, the indicator light flashes.
+ */
+ThermiteEspRtcMemory rtcMemory;
+ThermiteEspWifi wifi(WIFI_SSID, WIFI_PW);
+ThermiteWifiConnector wifiConnector(wifi, rtcMemory);
+uint8_t wifiState = WIFI_STATE_IDLE;
+
+/**
+ * Each zone's calendar is kept in flash, so that holidays survive power loss.
+ */
+ThermiteEspEeprom eeprom;
+
+/**
+ * Each zone's history of samples and heater switches is kept on LittleFS, so that it
+ * survives resets and power loss alike.
+ */
+ThermiteLittleFs fileSystem;
+
+/**
+ * Device ID and heap figures, for telemetry and the allocation profiler.
  */
-uint8_t wifiIndicator = LOW;
+ThermiteEspSystem espSystem;
+
+#if ALLOC_PROFILER
+/**
+ * Opt-in heap profiling per route and loop phase: see `ThermiteAllocProfiler`.
+ */
+ThermiteAllocProfiler allocProfiler(espSystem);
+#endif
+
+#ifdef TELEMETRY_HOST
+/**
+ * Opt-in UDP telemetry to `TELEMETRY_HOST`: see `ThermiteTelemetry`.
+ */
+ThermiteEspUdpSocket telemetrySocket(TELEMETRY_HOST, TELEMETRY_PORT);
+ThermiteTelemetry telemetry(telemetrySocket, espSystem, wifi);
+#endif
 
 /**
  * Web server, used both to load the thermostat web UI and as a REST API to change settings.
@@ -78,120 +114,182 @@ uint8_t wifiIndicator = LOW;
  * sent to the third-party static resources server.
  */
 AsyncWebServer server(80);
-ThermiteUserSettingsManager userSettingsManager;
-ThermiteInternalState internalState(
-  userSettingsManager,
-  thermometerManager,
-  ntpClient,
-  timezone
-);
-ThermiteWebController webController(userSettingsManager, internalState);
+ThermiteZones zones;
+ThermiteWebController webController(zones, powerManager);
+ThermiteAsyncWebTransport webTransport(webController);
 
 /**
- * Indicates whether thermite is connected to an actual heater.  We set this flag below
- * in `setup()`, and use it in `loop()` to avoid doing work if initialization didn't succeed.
+ * Everything that belongs to a single zone.  Zone `i` uses the `i`-th thermometer found on
+ * the OneWire bus, and the Qwiic relay at `RELAY_ADDR_HEATER + i`.
  */
-bool heaterConnected = false;
+struct ThermiteZone {
+  ThermiteDallasThermometer thermometer;
+  Qwiic_Relay heaterManager;
+  ThermiteQwiicRelay heaterRelay;
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteInternalState internalState;
+
+  ThermiteZone(uint8_t i)
+  : thermometer(dallasBus, i),
+    heaterManager(RELAY_ADDR_HEATER + i),
+    heaterRelay(heaterManager),
+    userSettingsStore(),
+    internalState(userSettingsStore, thermometer, ntpClock) {}
+};
+
+static_assert(ZONE_COUNT <= ZONE_COUNT_MAX, "ZONE_COUNT exceeds ZONE_COUNT_MAX");
+
+ThermiteZone* zoneList[ZONE_COUNT];
+
+bool initZones() {
+  for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+    ThermiteZone* zone = new ThermiteZone(i);
+    zoneList[i] = zone;
+    if (zones.add(zone->userSettingsStore, zone->internalState, zone->heaterRelay) < 0) {
+      return false;
+    }
+    zone->internalState.setRtcMemory(
+      &rtcMemory,
+      RTC_OFFSET_CHECKPOINT + i * sizeof(ThermiteCheckpoint)
+    );
+    zone->userSettingsStore.setEeprom(
+      &eeprom,
+      EEPROM_OFFSET_CALENDAR + i * sizeof(ThermiteCalendarRecord)
+    );
+    zone->internalState.setEeprom(
+      &eeprom,
+      EEPROM_OFFSET_THERMAL_MODEL + i * sizeof(ThermiteThermalRecord)
+    );
+    zone->internalState.setFileSystem(&fileSystem, i);
+#ifdef TELEMETRY_HOST
+    zone->internalState.setTelemetry(&telemetry, i);
+#endif
+  }
+  zones.setRtcMemory(&rtcMemory, &ntpClock);
+  return true;
+}
 
 // HARDWARE
 
-bool initHardware() {
+/**
+ * Returns a mask of the zones whose relay could not be initialized.  If a relay isn't
+ * connected, `heaterRelay` ignores writes; we still run the rest of `thermite` so that the
+ * web UI works.
+ */
+uint8_t initRelays() {
   Wire.begin();
-  Serial.begin(115200);
-  Serial.println();
+  uint8_t failed = 0;
+  for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+    if (!zoneList[i]->heaterRelay.begin()) {
+      failed |= 1 << i;
+    }
+  }
+  return failed;
+}
 
+bool initHardware() {
   pinMode(PIN_LED_INDICATOR, OUTPUT);
   digitalWrite(PIN_LED_INDICATOR, LOW);
 
-  if (!internalState.init()) {
+  if (!zones.init()) {
     Serial.println("Could not initialize thermometer!");
     return false;
   }
-
-  heaterConnected = heaterManager.begin();
-  if (heaterConnected) {
-    Serial.println("Could not initialize heater relay!");
-  }
-
   return true;
 }
 
-void updateHardware() {
-  bool heater = internalState.getHeater();
-  if (heater) {
-    if (heaterConnected) {
-      heaterManager.turnRelayOn();
-    }
-    digitalWrite(PIN_LED_INDICATOR, HIGH);
+/**
+ * Relays are driven by `zones.update()`; this only updates the indicator light, which is on
+ * while any zone is heating.
+ */
+void updateHardware(unsigned long now) {
+  if (wifiConnector.isConnected()) {
+    digitalWrite(PIN_LED_INDICATOR, zones.getHeaterMask() != 0 ? HIGH : LOW);
   } else {
-    if (heaterConnected) {
-      heaterManager.turnRelayOff();
-    }
-    digitalWrite(PIN_LED_INDICATOR, LOW);
+    digitalWrite(PIN_LED_INDICATOR, (now / 200ul) % 2 == 0 ? HIGH : LOW);
   }
 }
 
 // WIFI
 
-uint8_t initWifiConnection() {
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PW);
-
-  Serial.print("Connecting");
-  uint8_t i = 0;
-  while (true) {
-    // check wifi status
-    uint8_t status = WiFi.status();
-    if (status == WL_NO_SSID_AVAIL
-      || status == WL_CONNECTED
-      || status == WL_CONNECT_FAILED) {
-      return status;
-    }
+void updateWifi(unsigned long now) {
+  wifiConnector.update(now);
+  ntpClock.setOnline(wifiConnector.isConnected());
 
-    // blink LED, print to serial
-    wifiIndicator = i % 2 == 0 ? HIGH : LOW;
-    digitalWrite(PIN_LED_INDICATOR, wifiIndicator);
-    delay(100);
-    if (i % 5 == 0) {
-      Serial.print(".");
-    }
-    i++;
+  uint8_t state = wifiConnector.getState();
+  if (state == wifiState) {
+    return;
   }
-}
-
-void notifyWifiStatus(uint8_t status) {
-  if (status == WL_NO_SSID_AVAIL) {
-    Serial.println("Invalid wifi SSID!");
-  } else if (status == WL_CONNECTED) {
-    Serial.print("Connected to wifi, IP address: ");
+  if (state == WIFI_STATE_CONNECTED) {
+    Serial.print("Connected to wifi in ");
+    Serial.print(wifiConnector.getConnectDuration());
+    Serial.print(" ms, IP address: ");
     Serial.println(WiFi.localIP());
-  } else if (status == WL_CONNECT_FAILED) {
-    Serial.println("Invalid wifi password!");
+  } else if (wifiState == WIFI_STATE_CONNECTED) {
+    Serial.println("Wifi connection lost, reconnecting");
   }
+  wifiState = state;
+}
 
-  wifiIndicator = status == WL_CONNECTED ? LOW : HIGH;
-  digitalWrite(PIN_LED_INDICATOR, wifiIndicator);
+bool initAll() {
+  /*
+   * After a soft reset, pick up the clock, heater states, temperatures and runtime counters
+   * from RTC memory, and drive the relays accordingly before anything else: mounting the file
+   * system and scanning the history take far longer.  After a power cycle there is no valid
+   * checkpoint, and we start from scratch, save for the calendars, thermal models and history.
+   */
+#if ALLOC_PROFILER
+  allocProfiler.install();
+  webController.setAllocProfiler(&allocProfiler);
+#endif
+  if (!initZones()) {
+    Serial.begin(115200);
+    Serial.println("Could not add zones!");
+    return false;
+  }
+  bool restored = zones.restoreCheckpoint(millis());
+  uint8_t relaysFailed = initRelays();
+  if (restored) {
+    zones.writeRelays(millis());
+  }
 
+  Serial.begin(115200);
   Serial.println();
-}
-
-uint8_t initWifi() {
-  uint8_t status = initWifiConnection();
-  notifyWifiStatus(status);
-  return status;
-}
+  for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+    if (relaysFailed & (1 << i)) {
+      Serial.print("Could not initialize heater relay for zone ");
+      Serial.println(i);
+    }
+  }
 
-bool initAll() {
-  delay(2000);
+  eeprom.begin();
+  bool fileSystemMounted = fileSystem.begin();
+  for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+    zoneList[i]->userSettingsStore.restoreCalendar();
+    zoneList[i]->internalState.restoreThermalModel();
+    if (fileSystemMounted) {
+      zoneList[i]->internalState.restoreHistory();
+    } else {
+      zoneList[i]->internalState.setFileSystem(nullptr, i);
+    }
+  }
 
   if (!initHardware()) {
     return false;
   }
-  if (initWifi() != WL_CONNECTED) {
-    return false;
+  zones.update(millis());
+  updateHardware(millis());
+  if (restored) {
+    Serial.println("Restored state from checkpoint");
   }
+
+  /*
+   * None of this waits for the connection: `server` and `ntpClient` only bind sockets, and
+   * start working once `wifiConnector` connects.
+   */
+  wifiConnector.init(millis());
   ntpClient.begin();
-  webController.initRoutes(server);
+  webTransport.initRoutes(server);
 
   DefaultHeaders::Instance().addHeader("Access-Control-Allow-Headers", "*");
   DefaultHeaders::Instance().addHeader("Access-Control-Allow-Methods", "PUT,GET,OPTIONS");
@@ -208,25 +306,53 @@ void setup() {
   initAll();
 }
 
-unsigned long getLoopDelay(unsigned long startOfLoop, unsigned long endOfLoop) {
+unsigned long getLoopDelay(
+  unsigned long startOfLoop,
+  unsigned long endOfLoop,
+  unsigned long loopInterval
+) {
   if (endOfLoop < startOfLoop) {
     // Underflow condition: wait for whole interval
-    return LOOP_INTERVAL;
+    return loopInterval;
   }
   unsigned long elapsed = endOfLoop - startOfLoop;
-  if (elapsed > LOOP_INTERVAL) {
+  if (elapsed > loopInterval) {
     return 0;
   }
-  return LOOP_INTERVAL - elapsed;
+  return loopInterval - elapsed;
 }
 
 void loop() {
   unsigned long startOfLoop = millis();
 
-  internalState.update(startOfLoop);
-  updateHardware();
+  {
+    ALLOC_SCOPE(&allocProfiler, "loop wifi");
+    updateWifi(startOfLoop);
+  }
+  {
+    ALLOC_SCOPE(&allocProfiler, "loop zones");
+    zones.update(startOfLoop);
+  }
+  {
+    ALLOC_SCOPE(&allocProfiler, "loop hardware");
+    updateHardware(startOfLoop);
+  }
 
+  /*
+   * In light sleep mode, the SDK puts the CPU and radio to sleep for as much of this
+   * `delay()` as it can.
+   */
+  unsigned long loopInterval;
+  {
+    ALLOC_SCOPE(&allocProfiler, "loop power");
+    unsigned long sleepDelay = zones.getSleepDelay(startOfLoop);
+    unsigned long wifiDelay = wifiConnector.getUpdateDelay(startOfLoop);
+    loopInterval = powerManager.update(
+      startOfLoop,
+      wifiDelay < sleepDelay ? wifiDelay : sleepDelay
+    );
+  }
   unsigned long endOfLoop = millis();
-  unsigned long loopDelay = getLoopDelay(startOfLoop, endOfLoop);
+  unsigned long loopDelay = getLoopDelay(startOfLoop, endOfLoop, loopInterval);
   delay(loopDelay);
 }
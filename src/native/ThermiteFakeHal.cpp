@@ -0,0 +1,268 @@
+#include <string.h>
+
+#include "ThermiteFakeHal.h"
+
+ThermiteFakeThermometer::ThermiteFakeThermometer(float tempAmbient)
+: _connected(true),
+  _tempAmbient(tempAmbient),
+  _tempConverted(TEMP_DISCONNECTED),
+  _requestCount(0ul) {}
+
+void ThermiteFakeThermometer::requestTemperature() {
+  _tempConverted = _connected ? _tempAmbient : TEMP_DISCONNECTED;
+  _requestCount++;
+}
+
+ThermiteFakeClock::ThermiteFakeClock(time_t epochAtBoot, int offset)
+: _elapsedMillis(0ull),
+  _epochAtBoot(epochAtBoot),
+  _offset(offset),
+  _updateCount(0ul) {}
+
+time_t ThermiteFakeClock::getEpochTime() const {
+  return _epochAtBoot + static_cast<time_t>(_elapsedMillis / 1000ull);
+}
+
+time_t ThermiteFakeClock::toLocal(time_t tUtc, int* offset) const {
+  if (offset != nullptr) {
+    *offset = _offset;
+  }
+  return tUtc + _offset * 60;
+}
+
+void ThermiteFakeClock::setEpochTime(time_t tUtc) {
+  _epochAtBoot = tUtc - static_cast<time_t>(_elapsedMillis / 1000ull);
+}
+
+ThermiteFakeRelay::ThermiteFakeRelay()
+: _connected(true),
+  _on(false),
+  _switchCount(0ul),
+  _writeCount(0ul) {}
+
+void ThermiteFakeRelay::set(bool on) {
+  if (!_connected) {
+    return;
+  }
+  _writeCount++;
+  if (on != _on) {
+    _switchCount++;
+  }
+  _on = on;
+}
+
+ThermiteFakeRadio::ThermiteFakeRadio()
+: _mode(POWER_MODE_AWAKE),
+  _listenInterval(0),
+  _modeChangeCount(0ul) {}
+
+void ThermiteFakeRadio::setSleepMode(uint8_t mode, uint8_t listenInterval) {
+  _mode = mode;
+  _listenInterval = listenInterval;
+  _modeChangeCount++;
+}
+
+ThermiteFakeRtcMemory::ThermiteFakeRtcMemory()
+: _ticks(0ul) {
+  memset(_data, 0, sizeof(_data));
+}
+
+bool ThermiteFakeRtcMemory::read(uint32_t offset, void* data, size_t size) {
+  if (offset % 4 != 0 || size % 4 != 0 || offset + size > RTC_MEMORY_SIZE) {
+    return false;
+  }
+  memcpy(data, _data + offset, size);
+  return true;
+}
+
+bool ThermiteFakeRtcMemory::write(uint32_t offset, const void* data, size_t size) {
+  if (offset % 4 != 0 || size % 4 != 0 || offset + size > RTC_MEMORY_SIZE) {
+    return false;
+  }
+  memcpy(_data + offset, data, size);
+  return true;
+}
+
+ThermiteFakeEeprom::ThermiteFakeEeprom()
+: _commitCount(0ul) {
+  memset(_data, 0xff, sizeof(_data));
+  memset(_flash, 0xff, sizeof(_flash));
+}
+
+bool ThermiteFakeEeprom::read(uint32_t offset, void* data, size_t size) {
+  if (offset + size > EEPROM_SIZE) {
+    return false;
+  }
+  memcpy(data, _data + offset, size);
+  return true;
+}
+
+bool ThermiteFakeEeprom::write(uint32_t offset, const void* data, size_t size) {
+  if (offset + size > EEPROM_SIZE) {
+    return false;
+  }
+  memcpy(_data + offset, data, size);
+  return true;
+}
+
+bool ThermiteFakeEeprom::commit() {
+  memcpy(_flash, _data, sizeof(_flash));
+  _commitCount++;
+  return true;
+}
+
+void ThermiteFakeEeprom::powerCycle() {
+  memcpy(_data, _flash, sizeof(_data));
+}
+
+ThermiteFakeFileSystem::ThermiteFakeFileSystem(size_t capacity)
+: _capacity(capacity),
+  _size(0),
+  _appendCount(0ul) {}
+
+long ThermiteFakeFileSystem::getSize(const char* path) {
+  auto it = _files.find(path);
+  if (it == _files.end()) {
+    return -1l;
+  }
+  return static_cast<long>(it->second.size());
+}
+
+long ThermiteFakeFileSystem::read(const char* path, uint32_t offset, void* data, size_t size) {
+  auto it = _files.find(path);
+  if (it == _files.end()) {
+    return -1l;
+  }
+  const std::string& file = it->second;
+  if (offset >= file.size()) {
+    return 0l;
+  }
+  if (size > file.size() - offset) {
+    size = file.size() - offset;
+  }
+  memcpy(data, file.data() + offset, size);
+  return static_cast<long>(size);
+}
+
+bool ThermiteFakeFileSystem::append(const char* path, const void* data, size_t size) {
+  if (_size + size > _capacity) {
+    return false;
+  }
+  _files[path].append(static_cast<const char*>(data), size);
+  _size += size;
+  _appendCount++;
+  return true;
+}
+
+bool ThermiteFakeFileSystem::remove(const char* path) {
+  auto it = _files.find(path);
+  if (it == _files.end()) {
+    return false;
+  }
+  _size -= it->second.size();
+  _files.erase(it);
+  return true;
+}
+
+void ThermiteFakeFileSystem::list(
+  const char* dir,
+  void (*visit)(void* context, const char* name),
+  void* context
+) {
+  std::string prefix(dir);
+  if (prefix.empty() || prefix.back() != '/') {
+    prefix += '/';
+  }
+  for (const auto& file : _files) {
+    const std::string& path = file.first;
+    if (path.compare(0, prefix.size(), prefix) != 0) {
+      continue;
+    }
+    if (path.find('/', prefix.size()) != std::string::npos) {
+      continue;
+    }
+    visit(context, path.c_str() + prefix.size());
+  }
+}
+
+ThermiteFakeWifi::ThermiteFakeWifi()
+: _state(WIFI_STATE_IDLE),
+  _rssi(-60),
+  _beginCount(0ul),
+  _beganWithCache(false) {
+  memset(&_cache, 0, sizeof(_cache));
+}
+
+void ThermiteFakeWifi::begin(const ThermiteWifiCache* cache) {
+  _state = WIFI_STATE_CONNECTING;
+  _beginCount++;
+  _beganWithCache = cache != nullptr;
+}
+
+ThermiteFakeDatagramSocket::ThermiteFakeDatagramSocket()
+: _failing(false) {}
+
+bool ThermiteFakeDatagramSocket::send(const void* data, size_t size) {
+  if (_failing) {
+    return false;
+  }
+  _datagrams.emplace_back(static_cast<const char*>(data), size);
+  return true;
+}
+
+ThermiteFakeSystem::ThermiteFakeSystem(uint32_t deviceId)
+: _deviceId(deviceId),
+  _freeHeap(40000ul),
+  _maxFreeBlock(32000ul) {}
+
+ThermiteFakeHttpRequest::ThermiteFakeHttpRequest(bool preflight)
+: _preflight(preflight),
+  _code(0) {}
+
+const char* ThermiteFakeHttpRequest::getParam(const char* name) const {
+  std::map<std::string, std::string>::const_iterator it = _params.find(name);
+  if (it == _params.end()) {
+    return nullptr;
+  }
+  return it->second.c_str();
+}
+
+void ThermiteFakeHttpRequest::send(uint16_t code) {
+  _code = code;
+  _body.clear();
+}
+
+void ThermiteFakeHttpRequest::sendBuffer(
+  uint16_t code,
+  const ThermiteResponseBuffer& body,
+  const char* head
+) {
+  _code = code;
+  if (head == nullptr) {
+    _body.assign(body.getData(), body.getLength());
+  } else {
+    _body.assign(head);
+    _body.append(body.getData() + 1, body.getLength() - 1);
+  }
+}
+
+void ThermiteFakeHttpRequest::sendJsonConstant(uint16_t code, const char* body) {
+  _code = code;
+  _body = body;
+}
+
+void ThermiteFakeHttpRequest::sendChunked(uint16_t code, ThermiteChunkedBody* body) {
+  _code = code;
+  _body.clear();
+
+  /*
+   * Use an awkwardly small buffer, so that responses are split across lines as they would be
+   * on the device.
+   */
+  uint8_t buffer[13];
+  size_t len;
+  while ((len = body->fill(buffer, sizeof(buffer))) > 0) {
+    _body.append(reinterpret_cast<const char*>(buffer), len);
+  }
+  delete body;
+}
\ No newline at end of file
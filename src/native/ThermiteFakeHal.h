@@ -0,0 +1,281 @@
+#ifndef _THERMITE_FAKE_HAL_H__
+#define _THERMITE_FAKE_HAL_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Constants.h"
+#include "ThermiteHal.h"
+
+/**
+ * Deterministic, host-only implementations of the `ThermiteHal.h` interfaces, for tests,
+ * benchmarks and simulations.  Nothing here reads the real time or touches real I/O.
+ */
+
+/**
+ * Thermometer whose reading is set directly.  As with the DS18B20, a new value is only
+ * visible through `getTemperature()` after `requestTemperature()` has been called.
+ */
+class ThermiteFakeThermometer : public ThermiteThermometer {
+private:
+  bool _connected;
+  float _tempAmbient;
+  float _tempConverted;
+  unsigned long _requestCount;
+public:
+  ThermiteFakeThermometer(float tempAmbient = 20.0f);
+
+  bool init() { return _connected; }
+  void requestTemperature();
+  float getTemperature() { return _tempConverted; }
+
+  unsigned long getRequestCount() const { return _requestCount; }
+  void setConnected(bool connected) { _connected = connected; }
+  void setTemperature(float tempAmbient) { _tempAmbient = tempAmbient; }
+};
+
+/**
+ * Virtual clock, advanced explicitly with `advance()`.
+ * 
+ * `getMillis()` is truncated to 32 bits as on the ESP8266, so that `millis()` wraparound can
+ * be exercised.  Local time is UTC plus a fixed offset.
+ */
+class ThermiteFakeClock : public ThermiteClock {
+private:
+  unsigned long long _elapsedMillis;
+  time_t _epochAtBoot;
+  int _offset;
+  unsigned long _updateCount;
+public:
+  ThermiteFakeClock(time_t epochAtBoot = 0, int offset = 0);
+
+  unsigned long getMillis() const { return static_cast<uint32_t>(_elapsedMillis); }
+  void update() { _updateCount++; }
+  time_t getEpochTime() const;
+  time_t toLocal(time_t tUtc, int* offset) const;
+
+  /**
+   * The fake never needs resynchronizing.
+   */
+  unsigned long getUpdateDelay(unsigned long) const { return 0xfffffffful; }
+
+  void advance(unsigned long long millis) { _elapsedMillis += millis; }
+  unsigned long long getElapsedMillis() const { return _elapsedMillis; }
+  unsigned long getUpdateCount() const { return _updateCount; }
+  void setEpochTime(time_t tUtc);
+  void setOffset(int offset) { _offset = offset; }
+};
+
+/**
+ * Relay that records its state and how often it has switched.
+ */
+class ThermiteFakeRelay : public ThermiteRelay {
+private:
+  bool _connected;
+  bool _on;
+  unsigned long _switchCount;
+  unsigned long _writeCount;
+public:
+  ThermiteFakeRelay();
+
+  bool begin() { return _connected; }
+  void set(bool on);
+
+  bool isOn() const { return _on; }
+  unsigned long getSwitchCount() const { return _switchCount; }
+  unsigned long getWriteCount() const { return _writeCount; }
+  void setConnected(bool connected) { _connected = connected; }
+};
+
+/**
+ * Radio that records the sleep mode it was last put in.
+ */
+class ThermiteFakeRadio : public ThermiteRadio {
+private:
+  uint8_t _mode;
+  uint8_t _listenInterval;
+  unsigned long _modeChangeCount;
+public:
+  ThermiteFakeRadio();
+
+  void setSleepMode(uint8_t mode, uint8_t listenInterval);
+
+  uint8_t getMode() const { return _mode; }
+  uint8_t getListenInterval() const { return _listenInterval; }
+  unsigned long getModeChangeCount() const { return _modeChangeCount; }
+};
+
+/**
+ * RTC memory backed by a plain array.  As on the device, its contents survive for as long
+ * as the object does, e.g. across several `ThermiteWifiConnector`s in a test.  Its timer
+ * ticks once per ms, and only moves with `advance()`.
+ */
+class ThermiteFakeRtcMemory : public ThermiteRtcMemory {
+private:
+  uint8_t _data[RTC_MEMORY_SIZE];
+  uint32_t _ticks;
+public:
+  ThermiteFakeRtcMemory();
+
+  bool read(uint32_t offset, void* data, size_t size);
+  bool write(uint32_t offset, const void* data, size_t size);
+  uint32_t getTicks() { return _ticks; }
+  unsigned long ticksToMillis(uint32_t ticks) { return ticks; }
+
+  void advance(unsigned long millis) { _ticks += millis; }
+
+  /**
+   * Flips bits at `offset`, as a power cycle might.
+   */
+  void corrupt(uint32_t offset) { _data[offset] ^= 0xff; }
+};
+
+/**
+ * EEPROM kept in RAM.  Only committed data survives `powerCycle()`.
+ */
+class ThermiteFakeEeprom : public ThermiteEeprom {
+private:
+  uint8_t _data[EEPROM_SIZE];
+  uint8_t _flash[EEPROM_SIZE];
+  unsigned long _commitCount;
+public:
+  ThermiteFakeEeprom();
+
+  bool read(uint32_t offset, void* data, size_t size);
+  bool write(uint32_t offset, const void* data, size_t size);
+  bool commit();
+
+  unsigned long getCommitCount() const { return _commitCount; }
+
+  /**
+   * Drops uncommitted writes, as a power cycle would.
+   */
+  void powerCycle();
+};
+
+/**
+ * File system kept in RAM, with a fixed capacity in bytes.  As with the EEPROM fake, its
+ * files survive for as long as the object does, e.g. across a simulated reboot in a test.
+ * Appends that do not fit fail without writing anything.
+ */
+class ThermiteFakeFileSystem : public ThermiteFileSystem {
+private:
+  std::map<std::string, std::string> _files;
+  size_t _capacity;
+  size_t _size;
+  unsigned long _appendCount;
+public:
+  ThermiteFakeFileSystem(size_t capacity = 65536);
+
+  long getSize(const char* path);
+  long read(const char* path, uint32_t offset, void* data, size_t size);
+  bool append(const char* path, const void* data, size_t size);
+  bool remove(const char* path);
+  void list(const char* dir, void (*visit)(void* context, const char* name), void* context);
+
+  unsigned long getAppendCount() const { return _appendCount; }
+  size_t getFileCount() const { return _files.size(); }
+  size_t getUsed() const { return _size; }
+  void setCapacity(size_t capacity) { _capacity = capacity; }
+
+  /**
+   * Flips bits at `offset` in file `path`, as a failing flash page might.
+   */
+  void corrupt(const char* path, uint32_t offset) { _files[path][offset] ^= 0xff; }
+};
+
+/**
+ * WiFi station whose state is set directly.  Records how it was asked to connect.
+ */
+class ThermiteFakeWifi : public ThermiteWifi {
+private:
+  uint8_t _state;
+  ThermiteWifiCache _cache;
+  int8_t _rssi;
+  unsigned long _beginCount;
+  bool _beganWithCache;
+public:
+  ThermiteFakeWifi();
+
+  void begin(const ThermiteWifiCache* cache);
+  uint8_t getState() const { return _state; }
+  void getCache(ThermiteWifiCache& cache) const { cache = _cache; }
+  int8_t getRssi() const { return _rssi; }
+  void disconnect() { _state = WIFI_STATE_IDLE; }
+
+  unsigned long getBeginCount() const { return _beginCount; }
+  bool getBeganWithCache() const { return _beganWithCache; }
+  void setCache(const ThermiteWifiCache& cache) { _cache = cache; }
+  void setRssi(int8_t rssi) { _rssi = rssi; }
+  void setState(uint8_t state) { _state = state; }
+};
+
+/**
+ * Datagram socket that records what it sends instead of sending it.
+ */
+class ThermiteFakeDatagramSocket : public ThermiteDatagramSocket {
+private:
+  std::vector<std::string> _datagrams;
+  bool _failing;
+public:
+  ThermiteFakeDatagramSocket();
+
+  bool send(const void* data, size_t size);
+
+  const std::vector<std::string>& getDatagrams() const { return _datagrams; }
+  void clear() { _datagrams.clear(); }
+
+  /**
+   * Makes `send()` fail without recording anything, as when the device is out of buffers.
+   */
+  void setFailing(bool failing) { _failing = failing; }
+};
+
+/**
+ * Device with a fixed ID, and a heap whose state is set directly.
+ */
+class ThermiteFakeSystem : public ThermiteSystem {
+private:
+  uint32_t _deviceId;
+  uint32_t _freeHeap;
+  uint32_t _maxFreeBlock;
+public:
+  ThermiteFakeSystem(uint32_t deviceId = 1ul);
+
+  uint32_t getDeviceId() const { return _deviceId; }
+  uint32_t getFreeHeap() const { return _freeHeap; }
+  uint32_t getMaxFreeBlock() const { return _maxFreeBlock; }
+
+  void setFreeHeap(uint32_t freeHeap) { _freeHeap = freeHeap; }
+  void setMaxFreeBlock(uint32_t maxFreeBlock) { _maxFreeBlock = maxFreeBlock; }
+};
+
+/**
+ * HTTP exchange that records the response instead of sending it.
+ */
+class ThermiteFakeHttpRequest : public ThermiteHttpRequest {
+private:
+  bool _preflight;
+  std::string _path;
+  std::map<std::string, std::string> _params;
+  uint16_t _code;
+  std::string _body;
+public:
+  ThermiteFakeHttpRequest(bool preflight = false);
+
+  bool isPreflight() const { return _preflight; }
+  const char* getPath() const { return _path.c_str(); }
+  const char* getParam(const char* name) const;
+  void send(uint16_t code);
+  void sendBuffer(uint16_t code, const ThermiteResponseBuffer& body, const char* head);
+  void sendJsonConstant(uint16_t code, const char* body);
+  void sendChunked(uint16_t code, ThermiteChunkedBody* body);
+
+  void setParam(const char* name, const char* value) { _params[name] = value; }
+  void setPath(const char* path) { _path = path; }
+  uint16_t getCode() const { return _code; }
+  const std::string& getBody() const { return _body; }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include <atomic>
+#include <stdlib.h>
+
+#include "ThermiteAllocProfiler.h"
+#include "ThermiteHostHeap.h"
+
+#if ALLOC_PROFILER && defined(__GLIBC__)
+
+#include <errno.h>
+#include <malloc.h>
+
+/**
+ * glibc's own allocator, under the names it also exports, so that the replacements below
+ * can hand every call on to it.  Replacing `malloc()` in the executable replaces it for the
+ * whole process, including `operator new` and ArduinoJson.
+ */
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+static std::atomic<size_t> hostHeapInUse(0);
+
+static void* noteHostAllocation(void* ptr, size_t size) {
+  if (ptr != nullptr) {
+    hostHeapInUse.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed);
+    ThermiteAllocProfiler::noteAllocation(size);
+  }
+  return ptr;
+}
+
+extern "C" {
+
+void* malloc(size_t size) __THROW {
+  return noteHostAllocation(__libc_malloc(size), size);
+}
+
+void* calloc(size_t count, size_t size) __THROW {
+  return noteHostAllocation(__libc_calloc(count, size), count * size);
+}
+
+void* realloc(void* ptr, size_t size) __THROW {
+  size_t usable = ptr == nullptr ? 0 : malloc_usable_size(ptr);
+  void* resized = __libc_realloc(ptr, size);
+  if (resized != nullptr || size == 0) {
+    hostHeapInUse.fetch_sub(usable, std::memory_order_relaxed);
+  }
+  return noteHostAllocation(resized, size);
+}
+
+void* memalign(size_t alignment, size_t size) __THROW {
+  return noteHostAllocation(__libc_memalign(alignment, size), size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) __THROW {
+  return noteHostAllocation(__libc_memalign(alignment, size), size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) __THROW {
+  void* aligned = noteHostAllocation(__libc_memalign(alignment, size), size);
+  if (aligned == nullptr) {
+    return ENOMEM;
+  }
+  *ptr = aligned;
+  return 0;
+}
+
+void free(void* ptr) __THROW {
+  if (ptr != nullptr) {
+    hostHeapInUse.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+  }
+  __libc_free(ptr);
+}
+
+}
+
+bool thermiteHostHeapIsHooked() {
+  return true;
+}
+
+size_t thermiteHostHeapInUse() {
+  return hostHeapInUse.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool thermiteHostHeapIsHooked() {
+  return false;
+}
+
+size_t thermiteHostHeapInUse() {
+  return 0;
+}
+
+#endif
+
+ThermiteHostSystem::ThermiteHostSystem(size_t capacity)
+: _capacity(capacity),
+  _inUseAtStart(thermiteHostHeapInUse()) {}
+
+uint32_t ThermiteHostSystem::getFreeHeap() const {
+  size_t inUse = thermiteHostHeapInUse();
+  size_t used = inUse > _inUseAtStart ? inUse - _inUseAtStart : 0;
+  return static_cast<uint32_t>(used < _capacity ? _capacity - used : 0);
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef _THERMITE_HOST_HEAP_H__
+#define _THERMITE_HOST_HEAP_H__
+
+#include <stddef.h>
+
+#include "Constants.h"
+#include "ThermiteHal.h"
+
+/**
+ * Is this process's allocator hooked for `ThermiteAllocProfiler`?  That takes a build with
+ * `-DALLOC_PROFILER=1` against glibc, whose `malloc()` can be replaced.
+ */
+bool thermiteHostHeapIsHooked();
+
+/**
+ * Returns the bytes this process has allocated and not yet freed, as counted by the hooks,
+ * or zero if there are none.
+ */
+size_t thermiteHostHeapInUse();
+
+/**
+ * Device whose heap is this process's, as counted by the hooks: `capacity` bytes, empty when
+ * this is constructed.  There is no fragmentation, so the largest free block is all of the
+ * free heap.
+ */
+class ThermiteHostSystem : public ThermiteSystem {
+private:
+  size_t _capacity;
+  size_t _inUseAtStart;
+public:
+  ThermiteHostSystem(size_t capacity = 40000);
+
+  uint32_t getDeviceId() const { return 1ul; }
+  uint32_t getFreeHeap() const;
+  uint32_t getMaxFreeBlock() const { return getFreeHeap(); }
+};
+
+#endif
\ No newline at end of file
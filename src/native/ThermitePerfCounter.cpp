@@ -0,0 +1,51 @@
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "ThermitePerfCounter.h"
+
+ThermitePerfCounter::ThermitePerfCounter() {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  _fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+ThermitePerfCounter::~ThermitePerfCounter() {
+  if (_fd >= 0) {
+    close(_fd);
+  }
+}
+
+void ThermitePerfCounter::start() {
+  if (_fd < 0) {
+    return;
+  }
+  ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+  ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void ThermitePerfCounter::stop() {
+  if (_fd < 0) {
+    return;
+  }
+  ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+uint64_t ThermitePerfCounter::read() const {
+  if (_fd < 0) {
+    return 0;
+  }
+  uint64_t count = 0;
+  if (::read(_fd, &count, sizeof(count)) != sizeof(count)) {
+    return 0;
+  }
+  return count;
+}
\ No newline at end of file
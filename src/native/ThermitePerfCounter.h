@@ -0,0 +1,30 @@
+#ifndef _THERMITE_PERF_COUNTER_H__
+#define _THERMITE_PERF_COUNTER_H__
+
+#include <stdint.h>
+
+/**
+ * Counts user-space instructions retired by the calling thread, using Linux `perf_event`.
+ * 
+ * Instruction counts are far more stable than wall-clock time across hosts and runs, which
+ * makes them a better proxy for how a change will behave on the ESP8266.  If `perf_event`
+ * is unavailable (e.g. `kernel.perf_event_paranoid` is too strict, or we're in a container
+ * without PMU access), `isAvailable()` returns false and `read()` always returns zero.
+ */
+class ThermitePerfCounter {
+private:
+  int _fd;
+public:
+  ThermitePerfCounter();
+  ~ThermitePerfCounter();
+
+  ThermitePerfCounter(const ThermitePerfCounter&) = delete;
+  ThermitePerfCounter& operator=(const ThermitePerfCounter&) = delete;
+
+  bool isAvailable() const { return _fd >= 0; }
+  void start();
+  void stop();
+  uint64_t read() const;
+};
+
+#endif
\ No newline at end of file
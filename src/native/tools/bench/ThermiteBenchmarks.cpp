@@ -0,0 +1,227 @@
+#include <benchmark/benchmark.h>
+#include <string.h>
+#include <vector>
+
+#include "Constants.h"
+#include "native/ThermiteFakeHal.h"
+#include "native/ThermitePerfCounter.h"
+#include "ThermiteInternalState.h"
+#include "ThermiteUserSettingsManager.h"
+#include "ThermiteUserSettingsStore.h"
+
+/**
+ * Host microbenchmarks for the firmware's hot paths.
+ * 
+ * Results are emitted as JSON by default; each benchmark also reports an `instructions`
+ * counter (user-space instructions per iteration) when `perf_event` is available.
+ * 
+ *   pio run -e bench -t exec
+ */
+
+/*
+ * 2021-02-01T05:00:00Z, i.e. midnight on Monday in Eastern Standard Time.
+ */
+#define T_EPOCH 1612155600l
+#define T_OFFSET -300
+#define T_WEEK (7l * 86400l)
+
+/**
+ * Measures instructions retired over the lifetime of a benchmark's timing loop, and reports
+ * them per iteration.
+ */
+class InstructionCounter {
+private:
+  benchmark::State& _state;
+  ThermitePerfCounter _counter;
+public:
+  InstructionCounter(benchmark::State& state) : _state(state) {
+    _counter.start();
+  }
+
+  ~InstructionCounter() {
+    _counter.stop();
+    if (_counter.isAvailable()) {
+      _state.counters["instructions"] = benchmark::Counter(
+        static_cast<double>(_counter.read()),
+        benchmark::Counter::kAvgIterations
+      );
+    }
+  }
+};
+
+ThermiteSetPoint makeSetPoint() {
+  return ThermiteSetPoint("Home Office", 20.0f);
+}
+
+ThermiteDailySchedule makeDailySchedule() {
+  const uint8_t schedule[] = {
+    0xaa, 0xaa, 0xaa,
+    0x5a, 0x00, 0x00,
+    0x00, 0x00, 0x50,
+    0x55, 0xa5, 0xaa
+  };
+  return ThermiteDailySchedule("Work from Home", schedule);
+}
+
+ThermiteUserSettingsManager makeUserSettingsManager() {
+  return ThermiteUserSettingsManager();
+}
+
+// SCHEDULE LOOKUP
+
+static void BM_GetTargetTemperatureWeek(benchmark::State& state) {
+  ThermiteUserSettingsManager userSettingsManager;
+
+  /*
+   * Every minute of a week, in local time; this covers every weekly and daily schedule slot
+   * as well as the override check.
+   */
+  std::vector<time_t> ts;
+  for (time_t t = T_EPOCH; t < T_EPOCH + T_WEEK; t += 60) {
+    ts.push_back(t + T_OFFSET * 60);
+  }
+
+  size_t i = 0;
+  InstructionCounter counter(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(userSettingsManager.getTargetTemperature(ts[i]));
+    if (++i == ts.size()) {
+      i = 0;
+    }
+  }
+}
+BENCHMARK(BM_GetTargetTemperatureWeek);
+
+// JSON SERIALIZATION / VALIDATION
+
+template <typename T, T (*make)(), size_t capacity>
+static void BM_ToJson(benchmark::State& state) {
+  T jsonWrite = make();
+  StaticJsonDocument<capacity> doc;
+
+  InstructionCounter counter(state);
+  for (auto _ : state) {
+    JsonObject root = doc.template to<JsonObject>();
+    benchmark::DoNotOptimize(jsonWrite.toJSON(root));
+  }
+}
+
+template <typename T, T (*make)(), size_t capacity>
+static void BM_ValidateJson(benchmark::State& state) {
+  T jsonRead = make();
+  StaticJsonDocument<capacity> doc;
+  JsonObject root = doc.template to<JsonObject>();
+  jsonRead.toJSON(root);
+
+  InstructionCounter counter(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(jsonRead.validateJSON(root));
+  }
+}
+
+template <typename T, T (*make)(), size_t capacity>
+static void BM_UpdateFromJson(benchmark::State& state) {
+  T jsonRead = make();
+  StaticJsonDocument<capacity> doc;
+  JsonObject root = doc.template to<JsonObject>();
+  jsonRead.toJSON(root);
+
+  InstructionCounter counter(state);
+  for (auto _ : state) {
+    jsonRead.updateFromJSON(root);
+    benchmark::ClobberMemory();
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_ToJson, ThermiteSetPoint, makeSetPoint, CAPACITY_SET_POINT);
+BENCHMARK_TEMPLATE(BM_ValidateJson, ThermiteSetPoint, makeSetPoint, CAPACITY_SET_POINT);
+BENCHMARK_TEMPLATE(BM_UpdateFromJson, ThermiteSetPoint, makeSetPoint, CAPACITY_SET_POINT);
+
+BENCHMARK_TEMPLATE(BM_ToJson, ThermiteDailySchedule, makeDailySchedule, CAPACITY_DAILY_SCHEDULE);
+BENCHMARK_TEMPLATE(BM_ValidateJson, ThermiteDailySchedule, makeDailySchedule, CAPACITY_DAILY_SCHEDULE);
+BENCHMARK_TEMPLATE(BM_UpdateFromJson, ThermiteDailySchedule, makeDailySchedule, CAPACITY_DAILY_SCHEDULE);
+
+BENCHMARK_TEMPLATE(
+  BM_ToJson,
+  ThermiteUserSettingsManager,
+  makeUserSettingsManager,
+  CAPACITY_USER_SETTINGS_MANAGER
+);
+BENCHMARK_TEMPLATE(
+  BM_ValidateJson,
+  ThermiteUserSettingsManager,
+  makeUserSettingsManager,
+  CAPACITY_USER_SETTINGS_MANAGER
+);
+BENCHMARK_TEMPLATE(
+  BM_UpdateFromJson,
+  ThermiteUserSettingsManager,
+  makeUserSettingsManager,
+  CAPACITY_USER_SETTINGS_MANAGER
+);
+
+// INTERNAL STATE
+
+static void BM_UpdateDateTimeIso(benchmark::State& state) {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+
+  InstructionCounter counter(state);
+  for (auto _ : state) {
+    clock.advance(1000);
+    internalState.updateDateTimeIso();
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_UpdateDateTimeIso);
+
+/**
+ * Steady-state `update()`, as called from `loop()` between temperature requests: this is
+ * dominated by the target temperature lookup and the heater decision in `_updateHeater()`.
+ * The ambient temperature oscillates across the hysteresis band so that both branches of the
+ * heater decision are taken.
+ */
+static void BM_UpdateHeater(benchmark::State& state) {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer(14.0f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+
+  unsigned long i = 0;
+  InstructionCounter counter(state);
+  for (auto _ : state) {
+    if (i % 600 == 0) {
+      thermometer.setTemperature((i / 600) % 2 == 0 ? 14.0f : 22.0f);
+    }
+    clock.advance(100ul);
+    internalState.update(clock.getMillis());
+    benchmark::DoNotOptimize(internalState.getHeater());
+    i++;
+  }
+}
+BENCHMARK(BM_UpdateHeater);
+
+int main(int argc, char** argv) {
+  /*
+   * Default to JSON output, so that results can be tracked over time; any
+   * `--benchmark_format` given on the command line takes precedence.
+   */
+  std::vector<char*> args;
+  args.push_back(argv[0]);
+  char formatJson[] = "--benchmark_format=json";
+  args.push_back(formatJson);
+  for (int i = 1; i < argc; i++) {
+    args.push_back(argv[i]);
+  }
+  int argcBench = static_cast<int>(args.size());
+
+  benchmark::Initialize(&argcBench, args.data());
+  if (benchmark::ReportUnrecognizedArguments(argcBench, args.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
\ No newline at end of file
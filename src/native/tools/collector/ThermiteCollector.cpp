@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ThermiteCollector.h"
+
+#define COLLECTOR_STATE_IDLE 0
+#define COLLECTOR_STATE_CONNECTING 1
+#define COLLECTOR_STATE_SENDING 2
+#define COLLECTOR_STATE_RECEIVING 3
+
+#define COLLECTOR_EVENTS_MAX 256
+#define COLLECTOR_READ_SIZE 4096
+
+namespace {
+
+uint64_t monotonicMillis() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000ull + ts.tv_nsec / 1000000ull;
+}
+
+uint64_t wallMillis() {
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000ull + ts.tv_nsec / 1000000ull;
+}
+
+}
+
+ThermiteCollectorConfig::ThermiteCollectorConfig()
+: path("/internalState"),
+  interval(60000ul),
+  timeout(5000ul),
+  backoffMin(1000ul),
+  backoffMax(600000ul) {}
+
+ThermiteCollectorStats::ThermiteCollectorStats()
+: polls(0ul),
+  samples(0ul),
+  failures(0ul),
+  timeouts(0ul),
+  skipped(0ul),
+  connects(0ul),
+  reuses(0ul),
+  bytesRead(0ul),
+  latencyMax(0ul),
+  latencySum(0.0) {}
+
+ThermiteCollector::ThermiteCollector(const ThermiteCollectorConfig& config, FILE* out)
+: _config(config),
+  _epoll(-1),
+  _out(out) {}
+
+ThermiteCollector::~ThermiteCollector() {
+  for (ThermiteCollectorDevice& device : _devices) {
+    _close(device);
+  }
+  if (_epoll >= 0) {
+    close(_epoll);
+  }
+}
+
+bool ThermiteCollector::addDevices(const std::string& spec, std::string& error) {
+  std::string s = spec;
+  if (s.compare(0, 7, "http://") == 0) {
+    s = s.substr(7);
+  }
+  while (!s.empty() && s.back() == '/') {
+    s.pop_back();
+  }
+
+  std::string host = s;
+  unsigned long portFirst = 80;
+  unsigned long portLast = 80;
+  size_t colon = s.rfind(':');
+  if (colon != std::string::npos) {
+    host = s.substr(0, colon);
+    const char* ports = s.c_str() + colon + 1;
+    char* end;
+    portFirst = strtoul(ports, &end, 10);
+    portLast = portFirst;
+    if (*end == '-') {
+      portLast = strtoul(end + 1, &end, 10);
+    }
+    if (*end != '\0' || portFirst == 0 || portLast < portFirst || portLast > 65535) {
+      error = "Invalid port in " + spec;
+      return false;
+    }
+  }
+  if (host.empty()) {
+    error = "Missing host in " + spec;
+    return false;
+  }
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result;
+  int rc = getaddrinfo(host.c_str(), nullptr, &hints, &result);
+  if (rc != 0) {
+    error = "Could not resolve " + host + ": " + gai_strerror(rc);
+    return false;
+  }
+
+  for (unsigned long port = portFirst; port <= portLast; port++) {
+    ThermiteCollectorDevice device;
+    device.name = host + ":" + std::to_string(port);
+    memcpy(&device.addr, result->ai_addr, result->ai_addrlen);
+    device.addrLen = result->ai_addrlen;
+    if (result->ai_family == AF_INET) {
+      reinterpret_cast<sockaddr_in*>(&device.addr)->sin_port = htons(port);
+    } else {
+      reinterpret_cast<sockaddr_in6*>(&device.addr)->sin6_port = htons(port);
+    }
+    device.request =
+      "GET " + _config.path + " HTTP/1.1\r\n"
+      "Host: " + device.name + "\r\n"
+      "Accept: application/json\r\n"
+      "Connection: keep-alive\r\n"
+      "\r\n";
+    device.fd = -1;
+    device.state = COLLECTOR_STATE_IDLE;
+    device.reused = false;
+    device.deadline = 0;
+    device.scheduledAt = 0;
+    device.requestAt = 0;
+    device.requestAtWall = 0;
+    device.backoff = 0ul;
+    device.sent = 0;
+    _devices.push_back(device);
+  }
+  freeaddrinfo(result);
+  return true;
+}
+
+void ThermiteCollector::_close(ThermiteCollectorDevice& device) {
+  if (device.fd >= 0) {
+    // closing the socket also removes it from `_epoll`
+    close(device.fd);
+    device.fd = -1;
+  }
+}
+
+bool ThermiteCollector::_watch(ThermiteCollectorDevice& device, uint32_t events, bool add) {
+  epoll_event ev;
+  ev.events = events;
+  ev.data.u32 = static_cast<uint32_t>(&device - &_devices[0]);
+  return epoll_ctl(_epoll, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, device.fd, &ev) == 0;
+}
+
+void ThermiteCollector::_schedule(uint32_t i, uint64_t at) {
+  _devices[i].deadline = at;
+  _timers.push(std::make_pair(at, i));
+}
+
+void ThermiteCollector::_startPoll(uint32_t i, uint64_t now) {
+  ThermiteCollectorDevice& device = _devices[i];
+  _stats.polls++;
+
+  /*
+   * Keep to the regular schedule, skipping any slots we've already missed.  Retries after a
+   * failure can come before the next slot, which then still stands.
+   */
+  if (device.scheduledAt <= now) {
+    device.scheduledAt += _config.interval;
+    while (device.scheduledAt <= now) {
+      device.scheduledAt += _config.interval;
+      _stats.skipped++;
+    }
+  }
+
+  device.requestAt = now;
+  device.requestAtWall = wallMillis();
+  device.sent = 0;
+  device.response.reset();
+  _schedule(i, now + _config.timeout);
+
+  if (device.fd >= 0) {
+    device.reused = true;
+    _stats.reuses++;
+    _send(i, now);
+  } else {
+    _connect(i, now);
+  }
+}
+
+void ThermiteCollector::_connect(uint32_t i, uint64_t now) {
+  ThermiteCollectorDevice& device = _devices[i];
+  device.reused = false;
+  device.fd = socket(device.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (device.fd < 0) {
+    _fail(i, now, false);
+    return;
+  }
+  int one = 1;
+  setsockopt(device.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  _stats.connects++;
+
+  int rc = connect(device.fd, reinterpret_cast<sockaddr*>(&device.addr), device.addrLen);
+  if (rc < 0 && errno != EINPROGRESS) {
+    _fail(i, now, false);
+    return;
+  }
+  device.state = COLLECTOR_STATE_CONNECTING;
+  if (!_watch(device, EPOLLOUT, true)) {
+    _fail(i, now, false);
+  }
+}
+
+void ThermiteCollector::_send(uint32_t i, uint64_t now) {
+  ThermiteCollectorDevice& device = _devices[i];
+  while (device.sent < device.request.size()) {
+    ssize_t n = write(
+      device.fd,
+      device.request.data() + device.sent,
+      device.request.size() - device.sent
+    );
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (device.state != COLLECTOR_STATE_SENDING) {
+          device.state = COLLECTOR_STATE_SENDING;
+          _watch(device, EPOLLOUT, false);
+        }
+        return;
+      }
+      if (device.reused) {
+        // the device closed a kept-alive connection just as we reused it: start over
+        _close(device);
+        _connect(i, now);
+        return;
+      }
+      _fail(i, now, false);
+      return;
+    }
+    device.sent += n;
+  }
+  device.state = COLLECTOR_STATE_RECEIVING;
+  _watch(device, EPOLLIN | EPOLLRDHUP, false);
+}
+
+void ThermiteCollector::_read(uint32_t i, uint64_t now) {
+  ThermiteCollectorDevice& device = _devices[i];
+  char buffer[COLLECTOR_READ_SIZE];
+  while (true) {
+    ssize_t n = read(device.fd, buffer, sizeof(buffer));
+    if (n > 0) {
+      _stats.bytesRead += n;
+      device.response.feed(buffer, n);
+      if (device.response.isError()) {
+        _fail(i, now, false);
+        return;
+      }
+      if (device.response.isDone()) {
+        _succeed(i, now);
+        return;
+      }
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;
+    }
+    bool empty = device.response.getState() == ThermiteHttpResponseParser::STATE_STATUS;
+    if (empty && device.reused) {
+      _close(device);
+      _connect(i, now);
+      return;
+    }
+    device.response.finish();
+    if (device.response.isDone()) {
+      _succeed(i, now);
+    } else {
+      _fail(i, now, false);
+    }
+    return;
+  }
+}
+
+void ThermiteCollector::_succeed(uint32_t i, uint64_t now) {
+  ThermiteCollectorDevice& device = _devices[i];
+  const std::string& body = device.response.getBody();
+  size_t start = body.find_first_not_of(" \t\r\n");
+  if (device.response.getCode() != 200 || start == std::string::npos || body[start] != '{') {
+    _fail(i, now, false);
+    return;
+  }
+
+  _writeSample(device, now);
+  unsigned long latency = static_cast<unsigned long>(now - device.requestAt);
+  _stats.samples++;
+  _stats.latencySum += latency;
+  if (latency > _stats.latencyMax) {
+    _stats.latencyMax = latency;
+  }
+
+  device.backoff = 0ul;
+  device.state = COLLECTOR_STATE_IDLE;
+  if (device.response.isKeepAlive()) {
+    // only watch for the device closing the connection until the next poll
+    _watch(device, EPOLLRDHUP, false);
+  } else {
+    _close(device);
+  }
+  _schedule(i, device.scheduledAt);
+}
+
+void ThermiteCollector::_fail(uint32_t i, uint64_t now, bool timeout) {
+  ThermiteCollectorDevice& device = _devices[i];
+  _stats.failures++;
+  if (timeout) {
+    _stats.timeouts++;
+  }
+  _close(device);
+  device.state = COLLECTOR_STATE_IDLE;
+  if (device.backoff == 0ul) {
+    device.backoff = _config.backoffMin;
+  } else {
+    device.backoff *= 2;
+    if (device.backoff > _config.backoffMax) {
+      device.backoff = _config.backoffMax;
+    }
+  }
+  _schedule(i, now + device.backoff);
+}
+
+void ThermiteCollector::_writeSample(const ThermiteCollectorDevice& device, uint64_t now) {
+  time_t t = static_cast<time_t>(device.requestAtWall / 1000ull);
+  tm local;
+  localtime_r(&t, &local);
+  char unixDate[32];
+  strftime(unixDate, sizeof(unixDate), "%Y-%m-%dT%H:%M:%S%z", &local);
+
+  const std::string& body = device.response.getBody();
+  size_t start = body.find_first_not_of(" \t\r\n") + 1;
+  size_t end = body.find_last_not_of(" \t\r\n");
+  bool empty = body.find_first_not_of(" \t\r\n", start) == end;
+
+  _line.clear();
+  _line += "{\"device\":\"";
+  _line += device.name;
+  _line += "\",\"unixDate\":\"";
+  _line += unixDate;
+  _line += "\",\"latency\":";
+  _line += std::to_string(now - device.requestAt);
+  if (!empty) {
+    _line += ',';
+  }
+  for (size_t j = start; j < body.size(); j++) {
+    char c = body[j];
+    _line += c == '\n' || c == '\r' ? ' ' : c;
+  }
+  while (!_line.empty() && (_line.back() == ' ' || _line.back() == '\t')) {
+    _line.pop_back();
+  }
+  _line += '\n';
+  fwrite(_line.data(), 1, _line.size(), _out);
+}
+
+void ThermiteCollector::_onEvent(uint32_t i, uint32_t events, uint64_t now) {
+  ThermiteCollectorDevice& device = _devices[i];
+  switch (device.state) {
+    case COLLECTOR_STATE_CONNECTING: {
+      int error = 0;
+      socklen_t len = sizeof(error);
+      getsockopt(device.fd, SOL_SOCKET, SO_ERROR, &error, &len);
+      if (error != 0 || (events & EPOLLERR)) {
+        _fail(i, now, false);
+        return;
+      }
+      device.state = COLLECTOR_STATE_SENDING;
+      _send(i, now);
+      break;
+    }
+    case COLLECTOR_STATE_SENDING:
+      _send(i, now);
+      break;
+    case COLLECTOR_STATE_RECEIVING:
+      _read(i, now);
+      break;
+    default:
+      // a kept-alive connection was closed, or sent something unexpected
+      _close(device);
+      break;
+  }
+}
+
+void ThermiteCollector::_onTimer(uint32_t i, uint64_t now) {
+  ThermiteCollectorDevice& device = _devices[i];
+  if (device.state == COLLECTOR_STATE_IDLE) {
+    _startPoll(i, now);
+  } else {
+    _fail(i, now, true);
+  }
+}
+
+bool ThermiteCollector::run(volatile sig_atomic_t& stop, FILE* stats, unsigned long statsInterval) {
+  _epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (_epoll < 0) {
+    return false;
+  }
+
+  /*
+   * Spread first polls evenly over one interval, so that a large fleet doesn't all connect
+   * at once.
+   */
+  uint64_t start = monotonicMillis();
+  size_t n = _devices.size();
+  for (size_t i = 0; i < n; i++) {
+    uint64_t at = start + (_config.interval * i) / (n == 0 ? 1 : n);
+    _devices[i].scheduledAt = at;
+    _schedule(static_cast<uint32_t>(i), at);
+  }
+
+  uint64_t statsAt = start + statsInterval;
+  uint64_t flushAt = start + 1000ull;
+  epoll_event events[COLLECTOR_EVENTS_MAX];
+  while (!stop) {
+    uint64_t now = monotonicMillis();
+    int wait = 1000;
+    if (!_timers.empty()) {
+      uint64_t next = _timers.top().first;
+      wait = next <= now ? 0 : static_cast<int>(std::min<uint64_t>(next - now, 1000ull));
+    }
+
+    int count = epoll_wait(_epoll, events, COLLECTOR_EVENTS_MAX, wait);
+    if (count < 0 && errno != EINTR) {
+      return false;
+    }
+    now = monotonicMillis();
+    for (int j = 0; j < count; j++) {
+      _onEvent(events[j].data.u32, events[j].events, now);
+    }
+
+    while (!_timers.empty() && _timers.top().first <= now) {
+      std::pair<uint64_t, uint32_t> timer = _timers.top();
+      _timers.pop();
+      if (_devices[timer.second].deadline == timer.first) {
+        _onTimer(timer.second, now);
+      }
+    }
+
+    if (now >= flushAt) {
+      fflush(_out);
+      flushAt = now + 1000ull;
+    }
+    if (statsInterval > 0ul && now >= statsAt) {
+      const ThermiteCollectorStats& s = _stats;
+      fprintf(
+        stats,
+        "{\"devices\":%zu,\"polls\":%lu,\"samples\":%lu,\"failures\":%lu,\"timeouts\":%lu,"
+        "\"skipped\":%lu,\"connects\":%lu,\"reuses\":%lu,\"bytesRead\":%lu,"
+        "\"latencyMean\":%.1f,\"latencyMax\":%lu}\n",
+        n,
+        s.polls,
+        s.samples,
+        s.failures,
+        s.timeouts,
+        s.skipped,
+        s.connects,
+        s.reuses,
+        s.bytesRead,
+        s.samples == 0ul ? 0.0 : s.latencySum / s.samples,
+        s.latencyMax
+      );
+      fflush(stats);
+      statsAt = now + statsInterval;
+    }
+  }
+  fflush(_out);
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,153 @@
+#ifndef _THERMITE_COLLECTOR_H__
+#define _THERMITE_COLLECTOR_H__
+
+#include <netinet/in.h>
+#include <queue>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <sys/socket.h>
+#include <utility>
+#include <vector>
+
+#include "ThermiteHttpResponseParser.h"
+
+/**
+ * Polling parameters shared by every device.  Times are in ms.
+ */
+struct ThermiteCollectorConfig {
+  /**
+   * Resource to poll on each device.
+   */
+  std::string path;
+  unsigned long interval;
+
+  /**
+   * Time allowed for each poll, from connecting (if needed) to the end of the response.
+   */
+  unsigned long timeout;
+
+  /**
+   * After a failed poll, retry after `backoffMin`, doubling on each further failure up to
+   * `backoffMax`; the regular schedule resumes on the next success.
+   */
+  unsigned long backoffMin;
+  unsigned long backoffMax;
+
+  ThermiteCollectorConfig();
+};
+
+/**
+ * Counters over the whole fleet, since the start of `run()`.
+ */
+struct ThermiteCollectorStats {
+  unsigned long polls;
+  unsigned long samples;
+  unsigned long failures;
+  unsigned long timeouts;
+
+  /**
+   * Polls that missed their slot entirely, because the previous one was still running.
+   */
+  unsigned long skipped;
+
+  /**
+   * New connections, and polls that reused a kept-alive connection instead.
+   */
+  unsigned long connects;
+  unsigned long reuses;
+  unsigned long bytesRead;
+  unsigned long latencyMax;
+  double latencySum;
+
+  ThermiteCollectorStats();
+};
+
+struct ThermiteCollectorDevice {
+  /**
+   * `host:port`, as written to each sample.
+   */
+  std::string name;
+  sockaddr_storage addr;
+  socklen_t addrLen;
+
+  /**
+   * Full `GET` request for this device, built once.
+   */
+  std::string request;
+
+  int fd;
+  uint8_t state;
+  bool reused;
+
+  /**
+   * Current timer (next poll, or timeout of the running one), and the next poll on the
+   * regular schedule.  Polls are aligned to `interval` from the first one, so they don't
+   * drift however long each one takes.
+   */
+  uint64_t deadline;
+  uint64_t scheduledAt;
+  uint64_t requestAt;
+  uint64_t requestAtWall;
+  unsigned long backoff;
+  size_t sent;
+  ThermiteHttpResponseParser response;
+};
+
+/**
+ * Polls many `thermite` devices concurrently from one `epoll` event loop, and writes each
+ * sample as a line of JSON: the device's response, plus `device`, `unixDate` and `latency`
+ * (ms).  Lines are compatible with what `thermite_http_logger.sh` used to write.
+ * 
+ * Connections are non-blocking and kept alive between polls where the device allows it.
+ * Timers live in a single min-heap keyed by deadline, with stale entries skipped when popped,
+ * so each tick costs O(log n) in the number of devices that are due.
+ */
+class ThermiteCollector {
+private:
+  ThermiteCollectorConfig _config;
+  std::vector<ThermiteCollectorDevice> _devices;
+  std::priority_queue<
+    std::pair<uint64_t, uint32_t>,
+    std::vector<std::pair<uint64_t, uint32_t> >,
+    std::greater<std::pair<uint64_t, uint32_t> >
+  > _timers;
+  int _epoll;
+  FILE* _out;
+  ThermiteCollectorStats _stats;
+  std::string _line;
+
+  void _close(ThermiteCollectorDevice& device);
+  void _connect(uint32_t i, uint64_t now);
+  void _fail(uint32_t i, uint64_t now, bool timeout);
+  void _onEvent(uint32_t i, uint32_t events, uint64_t now);
+  void _onTimer(uint32_t i, uint64_t now);
+  void _read(uint32_t i, uint64_t now);
+  void _schedule(uint32_t i, uint64_t at);
+  void _send(uint32_t i, uint64_t now);
+  void _startPoll(uint32_t i, uint64_t now);
+  void _succeed(uint32_t i, uint64_t now);
+  bool _watch(ThermiteCollectorDevice& device, uint32_t events, bool add);
+  void _writeSample(const ThermiteCollectorDevice& device, uint64_t now);
+public:
+  ThermiteCollector(const ThermiteCollectorConfig& config, FILE* out);
+  ~ThermiteCollector();
+
+  /**
+   * Adds every device in `spec`: `host[:port]`, optionally prefixed with `http://`, where
+   * `port` can be a range `first-last` (as with emulated devices on localhost).  Returns
+   * `false`, with a message in `error`, if `spec` is invalid or `host` doesn't resolve.
+   */
+  bool addDevices(const std::string& spec, std::string& error);
+  size_t getDeviceCount() const { return _devices.size(); }
+  const ThermiteCollectorStats& getStats() const { return _stats; }
+
+  /**
+   * Runs until `stop` is set, printing `getStats()` to `stats` every `statsInterval` ms
+   * (if non-zero).  Returns `false` if the event loop could not be set up.
+   */
+  bool run(volatile sig_atomic_t& stop, FILE* stats, unsigned long statsInterval);
+};
+
+#endif
\ No newline at end of file
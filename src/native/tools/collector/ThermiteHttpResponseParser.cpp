@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ThermiteHttpResponseParser.h"
+
+ThermiteHttpResponseParser::ThermiteHttpResponseParser() {
+  reset();
+}
+
+void ThermiteHttpResponseParser::reset() {
+  _state = STATE_STATUS;
+  _line.clear();
+  _code = 0;
+  _http11 = false;
+  _keepAlive = false;
+  _chunked = false;
+  _hasContentLength = false;
+  _remaining = 0;
+  _body.clear();
+}
+
+void ThermiteHttpResponseParser::_endHeaders() {
+  if (_code == 204 || _code == 304 || (_code >= 100 && _code < 200)) {
+    _state = STATE_DONE;
+  } else if (_chunked) {
+    _state = STATE_CHUNK_SIZE;
+  } else if (_hasContentLength) {
+    _state = _remaining == 0 ? STATE_DONE : STATE_BODY;
+  } else {
+    // close-delimited: the connection can't be reused
+    _keepAlive = false;
+    _state = STATE_BODY;
+  }
+}
+
+void ThermiteHttpResponseParser::_parseHeader(const std::string& line) {
+  size_t colon = line.find(':');
+  if (colon == std::string::npos) {
+    _state = STATE_ERROR;
+    return;
+  }
+  std::string name = line.substr(0, colon);
+  size_t start = line.find_first_not_of(" \t", colon + 1);
+  std::string value = start == std::string::npos ? "" : line.substr(start);
+
+  if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+    char* end;
+    unsigned long length = strtoul(value.c_str(), &end, 10);
+    if (end == value.c_str()) {
+      _state = STATE_ERROR;
+      return;
+    }
+    _hasContentLength = true;
+    _remaining = length;
+  } else if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+    _chunked = strcasestr(value.c_str(), "chunked") != nullptr;
+  } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+    if (strcasestr(value.c_str(), "close") != nullptr) {
+      _keepAlive = false;
+    } else if (strcasestr(value.c_str(), "keep-alive") != nullptr) {
+      _keepAlive = true;
+    }
+  }
+}
+
+void ThermiteHttpResponseParser::_parseLine(const std::string& line) {
+  switch (_state) {
+    case STATE_STATUS: {
+      // HTTP/1.x NNN reason
+      if (line.size() < 12 || line.compare(0, 7, "HTTP/1.") != 0 || line[8] != ' ') {
+        _state = STATE_ERROR;
+        return;
+      }
+      _http11 = line[7] == '1';
+      _keepAlive = _http11;
+      _code = atoi(line.c_str() + 9);
+      _state = STATE_HEADERS;
+      break;
+    }
+    case STATE_HEADERS:
+      if (line.empty()) {
+        _endHeaders();
+      } else {
+        _parseHeader(line);
+      }
+      break;
+    case STATE_CHUNK_SIZE: {
+      char* end;
+      unsigned long size = strtoul(line.c_str(), &end, 16);
+      if (end == line.c_str()) {
+        _state = STATE_ERROR;
+        return;
+      }
+      _remaining = size;
+      _state = size == 0 ? STATE_CHUNK_TRAILER : STATE_CHUNK_DATA;
+      break;
+    }
+    case STATE_CHUNK_END:
+      _state = line.empty() ? STATE_CHUNK_SIZE : STATE_ERROR;
+      break;
+    case STATE_CHUNK_TRAILER:
+      if (line.empty()) {
+        _state = STATE_DONE;
+      }
+      break;
+    default:
+      _state = STATE_ERROR;
+      break;
+  }
+}
+
+void ThermiteHttpResponseParser::feed(const char* data, size_t size) {
+  size_t i = 0;
+  while (i < size) {
+    if (_state == STATE_DONE || _state == STATE_ERROR) {
+      _state = STATE_ERROR;
+      return;
+    }
+    if (_state == STATE_BODY || _state == STATE_CHUNK_DATA) {
+      size_t n = size - i;
+      bool delimited = _state == STATE_CHUNK_DATA || _hasContentLength;
+      if (delimited && n > _remaining) {
+        n = _remaining;
+      }
+      _body.append(data + i, n);
+      i += n;
+      if (delimited) {
+        _remaining -= n;
+        if (_remaining == 0) {
+          _state = _state == STATE_CHUNK_DATA ? STATE_CHUNK_END : STATE_DONE;
+        }
+      }
+      continue;
+    }
+
+    char c = data[i++];
+    if (c == '\n') {
+      if (!_line.empty() && _line.back() == '\r') {
+        _line.pop_back();
+      }
+      _parseLine(_line);
+      _line.clear();
+    } else if (_line.size() >= 8192) {
+      _state = STATE_ERROR;
+      return;
+    } else {
+      _line.push_back(c);
+    }
+  }
+}
+
+void ThermiteHttpResponseParser::finish() {
+  if (_state == STATE_BODY && !_hasContentLength) {
+    _state = STATE_DONE;
+  } else if (_state != STATE_DONE) {
+    _state = STATE_ERROR;
+  }
+  _keepAlive = false;
+}
\ No newline at end of file
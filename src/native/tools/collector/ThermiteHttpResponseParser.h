@@ -0,0 +1,69 @@
+#ifndef _THERMITE_HTTP_RESPONSE_PARSER_H__
+#define _THERMITE_HTTP_RESPONSE_PARSER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/**
+ * Incremental parser for a single HTTP/1.1 response, fed with whatever `read()` returned.
+ * 
+ * Handles `Content-Length`, chunked and close-delimited bodies, which covers both `sendBuffer()`
+ * and `sendChunked()` responses from the device.  Responses are not pipelined, so anything
+ * after the end of the response is an error.
+ */
+class ThermiteHttpResponseParser {
+public:
+  enum State : uint8_t {
+    STATE_STATUS,
+    STATE_HEADERS,
+    STATE_BODY,
+    STATE_CHUNK_SIZE,
+    STATE_CHUNK_DATA,
+    STATE_CHUNK_END,
+    STATE_CHUNK_TRAILER,
+    STATE_DONE,
+    STATE_ERROR
+  };
+private:
+  State _state;
+  std::string _line;
+  int _code;
+  bool _http11;
+  bool _keepAlive;
+  bool _chunked;
+  bool _hasContentLength;
+  size_t _remaining;
+  std::string _body;
+
+  void _endHeaders();
+  void _parseHeader(const std::string& line);
+  void _parseLine(const std::string& line);
+public:
+  ThermiteHttpResponseParser();
+
+  /**
+   * Consumes `size` bytes of the response.
+   */
+  void feed(const char* data, size_t size);
+
+  /**
+   * Marks the end of the connection, which completes a close-delimited body and is an error
+   * anywhere else.
+   */
+  void finish();
+  void reset();
+
+  const std::string& getBody() const { return _body; }
+  int getCode() const { return _code; }
+  State getState() const { return _state; }
+  bool isDone() const { return _state == STATE_DONE; }
+  bool isError() const { return _state == STATE_ERROR; }
+
+  /**
+   * Whether the connection can be reused for the next request, once this response is done.
+   */
+  bool isKeepAlive() const { return _keepAlive; }
+};
+
+#endif
\ No newline at end of file
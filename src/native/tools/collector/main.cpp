@@ -0,0 +1,166 @@
+#include <fstream>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+#include "ThermiteCollector.h"
+
+/**
+ * Fleet collector: polls `GET /internalState` (or `--path`) on every device, and appends
+ * one line of JSON per sample to `--output`.  For example, against emulated devices on
+ * ports 8000-8999:
+ * 
+ *   pio run -e collector -t exec -a "--interval 10000 --output samples.jsonl 127.0.0.1:8000-8999"
+ * 
+ * Runs until interrupted.
+ */
+
+volatile sig_atomic_t stopRequested = 0;
+
+void onSignal(int) {
+  stopRequested = 1;
+}
+
+void printUsage(const char* argv0) {
+  fprintf(
+    stderr,
+    "usage: %s [options] DEVICE...\n"
+    "  DEVICE                   [http://]host[:port], where port may be a range first-last\n"
+    "  --devices FILE           read devices from FILE, one per line (# for comments)\n"
+    "  --path P                 resource to poll (default /internalState)\n"
+    "  --interval MS            poll interval per device (default 60000)\n"
+    "  --timeout MS             timeout per poll (default 5000)\n"
+    "  --backoff-min MS         first retry delay after a failure (default 1000)\n"
+    "  --backoff-max MS         longest retry delay (default 600000)\n"
+    "  --output FILE            append samples to FILE (default: standard output)\n"
+    "  --stats MS               print counters to standard error every MS (default 60000,\n"
+    "                           0 to disable)\n",
+    argv0
+  );
+}
+
+bool readDevices(const char* path, ThermiteCollector& collector) {
+  std::ifstream in(path);
+  if (!in) {
+    fprintf(stderr, "Could not read devices from %s\n", path);
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) {
+      line = line.substr(0, hash);
+    }
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos) {
+      continue;
+    }
+    size_t end = line.find_last_not_of(" \t\r");
+    std::string error;
+    if (!collector.addDevices(line.substr(start, end - start + 1), error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Each device can hold a socket open between polls, so lift the soft limit on open files
+ * as far as we're allowed to.
+ */
+void raiseFileLimit() {
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+int main(int argc, char** argv) {
+  ThermiteCollectorConfig config;
+  const char* output = nullptr;
+  unsigned long statsInterval = 60000ul;
+  std::vector<const char*> devicesFiles;
+  std::vector<const char*> devices;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--", 2) != 0) {
+      devices.push_back(arg);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    const char* value = argv[++i];
+    if (strcmp(arg, "--devices") == 0) {
+      devicesFiles.push_back(value);
+    } else if (strcmp(arg, "--path") == 0) {
+      config.path = value;
+    } else if (strcmp(arg, "--interval") == 0) {
+      config.interval = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--timeout") == 0) {
+      config.timeout = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--backoff-min") == 0) {
+      config.backoffMin = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--backoff-max") == 0) {
+      config.backoffMax = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--output") == 0) {
+      output = value;
+    } else if (strcmp(arg, "--stats") == 0) {
+      statsInterval = strtoul(value, nullptr, 10);
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (config.interval == 0ul || config.timeout == 0ul || config.backoffMin == 0ul) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  FILE* out = stdout;
+  if (output != nullptr) {
+    out = fopen(output, "a");
+    if (out == nullptr) {
+      fprintf(stderr, "Could not open %s\n", output);
+      return 1;
+    }
+  }
+  setvbuf(out, nullptr, _IOFBF, 1 << 16);
+
+  ThermiteCollector collector(config, out);
+  for (const char* path : devicesFiles) {
+    if (!readDevices(path, collector)) {
+      return 1;
+    }
+  }
+  for (const char* spec : devices) {
+    std::string error;
+    if (!collector.addDevices(spec, error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+  }
+  if (collector.getDeviceCount() == 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  raiseFileLimit();
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  bool ok = collector.run(stopRequested, stderr, statsInterval);
+  if (out != stdout) {
+    fclose(out);
+  }
+  return ok ? 0 : 1;
+}
\ No newline at end of file
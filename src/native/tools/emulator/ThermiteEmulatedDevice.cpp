@@ -0,0 +1,74 @@
+#include "ThermiteEmulatedDevice.h"
+
+ThermiteEmulatorConfig::ThermiteEmulatorConfig()
+: start(time(nullptr)),
+  offset(-300),
+  speed(1.0),
+  keepAlive(false),
+  telemetry(nullptr) {}
+
+ThermiteEmulatedDevice::ThermiteEmulatedDevice(
+  const ThermiteEmulatorConfig& config,
+  const ThermiteThermalParams& thermal,
+  uint32_t deviceId
+) : _model(thermal),
+    _thermometer(static_cast<float>(_model.getTemperature())),
+    _clock(config.start, config.offset),
+    _system(deviceId),
+    _internalState(_userSettingsStore, _thermometer, _clock),
+    _powerManager(_radio, _clock),
+    _webController(_zones, _powerManager),
+    _webTransport(_webController),
+    _server(config.keepAlive) {
+  _wifi.setState(WIFI_STATE_CONNECTED);
+  if (config.telemetry != nullptr) {
+    _telemetry.reset(new ThermiteTelemetry(*config.telemetry, _system, _wifi));
+  }
+}
+
+bool ThermiteEmulatedDevice::begin(int epoll, uint16_t port) {
+  _internalState.setFileSystem(&_fileSystem);
+  _internalState.setTelemetry(_telemetry.get());
+  _zones.add(_userSettingsStore, _internalState, _relay);
+  _zones.init();
+  _relay.begin();
+
+  // as in `initAll()` on the device
+  _webTransport.initRoutes(_server);
+  _server.addDefaultHeader("Access-Control-Allow-Headers", "*");
+  _server.addDefaultHeader("Access-Control-Allow-Methods", "PUT,GET,OPTIONS");
+  _server.addDefaultHeader("Access-Control-Allow-Origin", "*");
+  _server.addDefaultHeader("Access-Control-Max-Age", "600");
+
+  /*
+   * `millis() == 0` means "never requested" to `ThermiteInternalState`, so start at 1 ms as
+   * the device effectively does.
+   */
+  _clock.advance(1ull);
+  return _server.begin(epoll, port);
+}
+
+void ThermiteEmulatedDevice::advanceTo(unsigned long long elapsedMillis) {
+  while (true) {
+    _thermometer.setTemperature(static_cast<float>(_model.getTemperature()));
+    _zones.update(_clock.getMillis());
+    if (_clock.getElapsedMillis() >= elapsedMillis) {
+      return;
+    }
+
+    unsigned long long delay = _zones.getSleepDelay(_clock.getMillis());
+    _powerManager.update(_clock.getMillis(), static_cast<unsigned long>(delay));
+    if (elapsedMillis - _clock.getElapsedMillis() < delay) {
+      delay = elapsedMillis - _clock.getElapsedMillis();
+    }
+    if (delay == 0ull) {
+      delay = 1ull;
+    }
+
+    double dt = delay / 1000.0;
+    time_t tUtc = _clock.getEpochTime();
+    double tempOutdoor = _model.getOutdoorTemperature(tUtc + static_cast<time_t>(dt / 2.0));
+    _model.advance(dt, _relay.isOn(), tempOutdoor);
+    _clock.advance(delay);
+  }
+}
\ No newline at end of file
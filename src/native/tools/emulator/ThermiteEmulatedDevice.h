@@ -0,0 +1,97 @@
+#ifndef _THERMITE_EMULATED_DEVICE_H__
+#define _THERMITE_EMULATED_DEVICE_H__
+
+#include <memory>
+#include <stdint.h>
+#include <time.h>
+
+#include "native/ThermiteFakeHal.h"
+#include "native/tools/sim/ThermiteThermalModel.h"
+#include "ThermiteInternalState.h"
+#include "ThermitePosixHttpServer.h"
+#include "ThermitePosixWebTransport.h"
+#include "ThermitePowerManager.h"
+#include "ThermiteTelemetry.h"
+#include "ThermiteUserSettingsStore.h"
+#include "ThermiteWebController.h"
+#include "ThermiteZones.h"
+
+/**
+ * Settings shared by every emulated device.
+ */
+struct ThermiteEmulatorConfig {
+  ThermiteThermalParams thermal;
+
+  /**
+   * Virtual time at boot (UTC), and fixed UTC offset in minutes.
+   */
+  time_t start;
+  int offset;
+
+  /**
+   * Virtual ms per real ms.
+   */
+  double speed;
+
+  /**
+   * Keep connections open between requests.  The device closes them after each response.
+   */
+  bool keepAlive;
+
+  /**
+   * Where every device pushes telemetry, if anywhere.
+   */
+  ThermiteDatagramSocket* telemetry;
+
+  ThermiteEmulatorConfig();
+};
+
+/**
+ * One `thermite` device: the real controller, settings and web API, with the fake HAL from
+ * `src/native/` and a `ThermiteThermalModel` room behind the thermometer and relay.
+ * 
+ * Time only moves in `advanceTo()`, which steps from one controller deadline to the next as
+ * the simulator does, so the controller sees the same sequence of events at any speed.
+ */
+class ThermiteEmulatedDevice {
+private:
+  ThermiteThermalModel _model;
+  ThermiteFakeThermometer _thermometer;
+  ThermiteFakeClock _clock;
+  ThermiteFakeRelay _relay;
+  ThermiteFakeRadio _radio;
+  ThermiteFakeFileSystem _fileSystem;
+  ThermiteFakeSystem _system;
+  ThermiteFakeWifi _wifi;
+  std::unique_ptr<ThermiteTelemetry> _telemetry;
+  ThermiteUserSettingsStore _userSettingsStore;
+  ThermiteInternalState _internalState;
+  ThermitePowerManager _powerManager;
+  ThermiteZones _zones;
+  ThermiteWebController _webController;
+  ThermitePosixWebTransport _webTransport;
+  ThermitePosixHttpServer _server;
+public:
+  /**
+   * `deviceId` identifies the device in telemetry.
+   */
+  ThermiteEmulatedDevice(
+    const ThermiteEmulatorConfig& config,
+    const ThermiteThermalParams& thermal,
+    uint32_t deviceId
+  );
+
+  /**
+   * Boots the controller and starts serving the REST API on `port`.
+   */
+  bool begin(int epoll, uint16_t port);
+
+  /**
+   * Runs the controller until `elapsedMillis` ms of virtual time since boot.
+   */
+  void advanceTo(unsigned long long elapsedMillis);
+
+  unsigned long getRequestCount() const { return _server.getRequestCount(); }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,498 @@
+#include <ctype.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ThermiteChunkedBody.h"
+#include "ThermitePosixHttpServer.h"
+#include "ThermiteWebController.h"
+
+#define HTTP_READ_SIZE 4096
+#define HTTP_HEAD_MAX 8192
+#define HTTP_CHUNK_SIZE 1024
+
+namespace {
+
+const char* reasonPhrase(uint16_t code) {
+  switch (code) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 413: return "Request Entity Too Large";
+    case 500: return "Internal Server Error";
+    default: return "";
+  }
+}
+
+/**
+ * Decodes `%XX` escapes and `+`, as `AsyncWebServerRequest::urlDecode()` does.
+ */
+std::string urlDecode(const std::string& s) {
+  std::string decoded;
+  decoded.reserve(s.size());
+  for (size_t i = 0; i < s.size(); i++) {
+    char c = s[i];
+    if (c == '%' && i + 2 < s.size() && isxdigit(s[i + 1]) && isxdigit(s[i + 2])) {
+      char hex[3] = { s[i + 1], s[i + 2], '\0' };
+      decoded.push_back(static_cast<char>(strtol(hex, nullptr, 16)));
+      i += 2;
+    } else if (c == '+') {
+      decoded.push_back(' ');
+    } else {
+      decoded.push_back(c);
+    }
+  }
+  return decoded;
+}
+
+uint8_t parseMethod(const std::string& method) {
+  if (method == "GET") {
+    return HTTP_METHOD_GET;
+  } else if (method == "POST") {
+    return HTTP_METHOD_POST;
+  } else if (method == "DELETE") {
+    return HTTP_METHOD_DELETE;
+  } else if (method == "PUT") {
+    return HTTP_METHOD_PUT;
+  } else if (method == "PATCH") {
+    return HTTP_METHOD_PATCH;
+  } else if (method == "HEAD") {
+    return HTTP_METHOD_HEAD;
+  } else if (method == "OPTIONS") {
+    return HTTP_METHOD_OPTIONS;
+  }
+  return 0;
+}
+
+}
+
+ThermitePosixHttpRequest::ThermitePosixHttpRequest(
+  std::string& out,
+  const ThermitePosixHttpHeaders& defaultHeaders,
+  bool keepAlive
+) : _method(0),
+    _out(out),
+    _defaultHeaders(defaultHeaders),
+    _keepAlive(keepAlive),
+    _sent(false) {}
+
+bool ThermitePosixHttpRequest::parseHead(const std::string& head) {
+  size_t lineEnd = head.find("\r\n");
+  std::string requestLine = head.substr(0, lineEnd);
+  size_t sp1 = requestLine.find(' ');
+  size_t sp2 = requestLine.rfind(' ');
+  if (sp1 == std::string::npos || sp2 == sp1) {
+    return false;
+  }
+  _method = parseMethod(requestLine.substr(0, sp1));
+  std::string target = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+  std::string version = requestLine.substr(sp2 + 1);
+  if (_method == 0 || target.empty() || version.compare(0, 7, "HTTP/1.") != 0) {
+    return false;
+  }
+  if (version != "HTTP/1.1") {
+    _keepAlive = false;
+  }
+
+  size_t query = target.find('?');
+  _path = urlDecode(target.substr(0, query));
+  if (query != std::string::npos) {
+    std::string params = target.substr(query + 1);
+    size_t start = 0;
+    while (start <= params.size()) {
+      size_t end = params.find('&', start);
+      if (end == std::string::npos) {
+        end = params.size();
+      }
+      std::string param = params.substr(start, end - start);
+      if (!param.empty()) {
+        size_t eq = param.find('=');
+        std::string name = urlDecode(param.substr(0, eq));
+        std::string value = eq == std::string::npos ? "" : urlDecode(param.substr(eq + 1));
+        if (_params.find(name) == _params.end()) {
+          _params[name] = value;
+        }
+      }
+      start = end + 1;
+    }
+  }
+
+  size_t start = lineEnd == std::string::npos ? head.size() : lineEnd + 2;
+  while (start < head.size()) {
+    size_t end = head.find("\r\n", start);
+    if (end == std::string::npos) {
+      end = head.size();
+    }
+    std::string line = head.substr(start, end - start);
+    start = end + 2;
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      return false;
+    }
+    std::string name = line.substr(0, colon);
+    size_t valueStart = line.find_first_not_of(" \t", colon + 1);
+    std::string value = valueStart == std::string::npos ? "" : line.substr(valueStart);
+    if (strcasecmp(name.c_str(), "Content-Type") == 0) {
+      _contentType = value;
+    } else if (strcasecmp(name.c_str(), "Connection") == 0
+      && strcasestr(value.c_str(), "close") != nullptr) {
+      _keepAlive = false;
+    }
+  }
+  return true;
+}
+
+bool ThermitePosixHttpRequest::isPreflight() const {
+  return _method == HTTP_METHOD_OPTIONS;
+}
+
+const char* ThermitePosixHttpRequest::getPath() const {
+  return _path.c_str();
+}
+
+const char* ThermitePosixHttpRequest::getParam(const char* name) const {
+  std::map<std::string, std::string>::const_iterator it = _params.find(name);
+  if (it == _params.end()) {
+    return nullptr;
+  }
+  return it->second.c_str();
+}
+
+void ThermitePosixHttpRequest::_writeHead(
+  uint16_t code,
+  const char* contentType,
+  long contentLength
+) {
+  char line[128];
+  snprintf(line, sizeof(line), "HTTP/1.1 %u %s\r\n", code, reasonPhrase(code));
+  _out += line;
+  if (contentLength >= 0) {
+    snprintf(line, sizeof(line), "Content-Length: %ld\r\n", contentLength);
+    _out += line;
+  }
+  if (contentType != nullptr) {
+    _out += "Content-Type: ";
+    _out += contentType;
+    _out += "\r\n";
+  }
+  for (const std::pair<std::string, std::string>& header : _defaultHeaders) {
+    _out += header.first + ": " + header.second + "\r\n";
+  }
+  _out += "Accept-Ranges: none\r\n";
+  if (contentLength < 0) {
+    _out += "Transfer-Encoding: chunked\r\n";
+  }
+  _out += _keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+  _out += "\r\n";
+  _sent = true;
+}
+
+void ThermitePosixHttpRequest::send(uint16_t code) {
+  _writeHead(code, nullptr, 0);
+}
+
+void ThermitePosixHttpRequest::sendBuffer(
+  uint16_t code,
+  const ThermiteResponseBuffer& body,
+  const char* head
+) {
+  if (head == nullptr) {
+    _writeHead(code, "application/json", static_cast<long>(body.getLength()));
+    _out.append(body.getData(), body.getLength());
+    return;
+  }
+  size_t headLen = strlen(head);
+  _writeHead(code, "application/json", static_cast<long>(headLen + body.getLength() - 1));
+  _out.append(head, headLen);
+  _out.append(body.getData() + 1, body.getLength() - 1);
+}
+
+void ThermitePosixHttpRequest::sendJsonConstant(uint16_t code, const char* body) {
+  size_t len = strlen(body);
+  _writeHead(code, "application/json", static_cast<long>(len));
+  _out.append(body, len);
+}
+
+void ThermitePosixHttpRequest::sendChunked(uint16_t code, ThermiteChunkedBody* body) {
+  _writeHead(code, "application/json", -1l);
+  uint8_t buffer[HTTP_CHUNK_SIZE];
+  size_t len;
+  while ((len = body->fill(buffer, sizeof(buffer))) > 0) {
+    char size[24];
+    snprintf(size, sizeof(size), "%zx\r\n", len);
+    _out += size;
+    _out.append(reinterpret_cast<const char*>(buffer), len);
+    _out += "\r\n";
+  }
+  _out += "0\r\n\r\n";
+  delete body;
+}
+
+ThermitePosixHttpServer::ThermitePosixHttpServer(bool keepAlive)
+: _keepAlive(keepAlive),
+  _epoll(-1),
+  _listener(nullptr),
+  _requestCount(0ul) {}
+
+ThermitePosixHttpServer::~ThermitePosixHttpServer() {
+  while (!_connections.empty()) {
+    _close(_connections.back());
+  }
+  if (_listener != nullptr) {
+    close(_listener->fd);
+    delete _listener;
+  }
+}
+
+void ThermitePosixHttpServer::addDefaultHeader(const char* name, const char* value) {
+  _defaultHeaders.push_back(std::make_pair(std::string(name), std::string(value)));
+}
+
+void ThermitePosixHttpServer::on(
+  const char* uri,
+  uint8_t methods,
+  ThermitePosixHttpHandler handler
+) {
+  Route route = { uri, methods, 0, handler, nullptr };
+  _routes.push_back(route);
+}
+
+void ThermitePosixHttpServer::onJson(
+  const char* uri,
+  uint8_t methods,
+  ThermitePosixJsonHandler handler,
+  size_t capacity
+) {
+  Route route = { uri, methods, capacity, nullptr, handler };
+  _routes.push_back(route);
+}
+
+void ThermitePosixHttpServer::onNotFound(ThermitePosixHttpHandler handler) {
+  _notFound = handler;
+}
+
+bool ThermitePosixHttpServer::begin(int epoll, uint16_t port) {
+  _epoll = epoll;
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return false;
+  }
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 128) < 0) {
+    close(fd);
+    return false;
+  }
+
+  _listener = new Connection();
+  _listener->server = this;
+  _listener->fd = fd;
+  _listener->listener = true;
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = _listener;
+  return epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+void ThermitePosixHttpServer::onEvent(const epoll_event& event) {
+  Connection* connection = static_cast<Connection*>(event.data.ptr);
+  if (connection->listener) {
+    connection->server->_accept();
+  } else {
+    connection->server->_onConnectionEvent(connection, event.events);
+  }
+}
+
+void ThermitePosixHttpServer::_accept() {
+  while (true) {
+    int fd = accept4(_listener->fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    Connection* connection = new Connection();
+    connection->server = this;
+    connection->fd = fd;
+    connection->listener = false;
+    connection->closing = false;
+    connection->outOffset = 0;
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = connection;
+    if (epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      close(fd);
+      delete connection;
+      continue;
+    }
+    _connections.push_back(connection);
+  }
+}
+
+void ThermitePosixHttpServer::_close(Connection* connection) {
+  close(connection->fd);
+  for (size_t i = 0; i < _connections.size(); i++) {
+    if (_connections[i] == connection) {
+      _connections[i] = _connections.back();
+      _connections.pop_back();
+      break;
+    }
+  }
+  delete connection;
+}
+
+void ThermitePosixHttpServer::_onConnectionEvent(Connection* connection, uint32_t events) {
+  if (events & EPOLLERR) {
+    _close(connection);
+    return;
+  }
+  if (events & EPOLLOUT) {
+    _write(connection);
+    return;
+  }
+
+  char buffer[HTTP_READ_SIZE];
+  while (true) {
+    ssize_t n = read(connection->fd, buffer, sizeof(buffer));
+    if (n > 0) {
+      connection->in.append(buffer, n);
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    // the client is done sending; answer whatever is complete, then close
+    connection->closing = true;
+    break;
+  }
+  while (_parse(connection)) {}
+  _write(connection);
+}
+
+bool ThermitePosixHttpServer::_parse(Connection* connection) {
+  std::string& in = connection->in;
+  size_t headEnd = in.find("\r\n\r\n");
+  if (headEnd == std::string::npos) {
+    if (in.size() > HTTP_HEAD_MAX) {
+      connection->closing = true;
+      in.clear();
+    }
+    return false;
+  }
+
+  ThermitePosixHttpRequest request(connection->out, _defaultHeaders, _keepAlive);
+  if (!request.parseHead(in.substr(0, headEnd))) {
+    request.send(HTTP_BAD_REQUEST);
+    connection->closing = true;
+    in.clear();
+    return false;
+  }
+
+  size_t contentLength = 0;
+  const char* header = strcasestr(in.c_str(), "\r\nContent-Length:");
+  if (header != nullptr && header < in.c_str() + headEnd) {
+    contentLength = strtoul(header + 17, nullptr, 10);
+  }
+  if (contentLength > HTTP_BODY_MAX) {
+    request.send(HTTP_PAYLOAD_TOO_LARGE);
+    connection->closing = true;
+    in.clear();
+    return false;
+  }
+  if (in.size() < headEnd + 4 + contentLength) {
+    return false;
+  }
+  request.setBody(in.substr(headEnd + 4, contentLength));
+  in.erase(0, headEnd + 4 + contentLength);
+
+  _requestCount++;
+  _dispatch(request);
+  if (!request.isSent()) {
+    request.send(HTTP_INTERNAL_SERVER_ERROR);
+  }
+  if (!request.isKeepAlive()) {
+    connection->closing = true;
+    in.clear();
+    return false;
+  }
+  return true;
+}
+
+void ThermitePosixHttpServer::_dispatch(ThermitePosixHttpRequest& request) {
+  const std::string path = request.getPath();
+  for (const Route& route : _routes) {
+    if ((route.methods & request.getMethod()) == 0) {
+      continue;
+    }
+    if (route.uri != path && path.compare(0, route.uri.size() + 1, route.uri + "/") != 0) {
+      continue;
+    }
+    if (!route.jsonHandler) {
+      route.handler(request);
+      return;
+    }
+    if (strcasecmp(request.getContentType().c_str(), "application/json") != 0) {
+      continue;
+    }
+
+    // as `AsyncCallbackJsonWebHandler`: an empty or invalid body is a 400
+    DynamicJsonDocument doc(route.capacity);
+    if (request.getBody().empty() || deserializeJson(doc, request.getBody())) {
+      request.send(HTTP_BAD_REQUEST);
+      return;
+    }
+    JsonVariant json = doc.as<JsonVariant>();
+    route.jsonHandler(request, json);
+    return;
+  }
+  if (_notFound) {
+    _notFound(request);
+  }
+}
+
+void ThermitePosixHttpServer::_write(Connection* connection) {
+  std::string& out = connection->out;
+  while (connection->outOffset < out.size()) {
+    ssize_t n = ::write(
+      connection->fd,
+      out.data() + connection->outOffset,
+      out.size() - connection->outOffset
+    );
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        epoll_event ev;
+        ev.events = EPOLLOUT | EPOLLRDHUP;
+        ev.data.ptr = connection;
+        epoll_ctl(_epoll, EPOLL_CTL_MOD, connection->fd, &ev);
+        return;
+      }
+      _close(connection);
+      return;
+    }
+    connection->outOffset += n;
+  }
+  out.clear();
+  connection->outOffset = 0;
+  if (connection->closing) {
+    _close(connection);
+    return;
+  }
+  epoll_event ev;
+  ev.events = EPOLLIN | EPOLLRDHUP;
+  ev.data.ptr = connection;
+  epoll_ctl(_epoll, EPOLL_CTL_MOD, connection->fd, &ev);
+}
\ No newline at end of file
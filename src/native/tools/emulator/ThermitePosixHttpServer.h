@@ -0,0 +1,155 @@
+#ifndef _THERMITE_POSIX_HTTP_SERVER_H__
+#define _THERMITE_POSIX_HTTP_SERVER_H__
+
+#include <ArduinoJson.h>
+#include <functional>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <sys/epoll.h>
+#include <utility>
+#include <vector>
+
+#include "ThermiteHal.h"
+
+/**
+ * Request methods, as bits with the same values as `WebRequestMethod` in `ESPAsyncWebServer`.
+ */
+#define HTTP_METHOD_GET 0b00000001
+#define HTTP_METHOD_POST 0b00000010
+#define HTTP_METHOD_DELETE 0b00000100
+#define HTTP_METHOD_PUT 0b00001000
+#define HTTP_METHOD_PATCH 0b00010000
+#define HTTP_METHOD_HEAD 0b00100000
+#define HTTP_METHOD_OPTIONS 0b01000000
+
+/**
+ * Largest request body accepted, as with `AsyncCallbackJsonWebHandler`.
+ */
+#define HTTP_BODY_MAX 16384
+
+#define HTTP_PAYLOAD_TOO_LARGE 413
+#define HTTP_INTERNAL_SERVER_ERROR 500
+
+typedef std::vector<std::pair<std::string, std::string> > ThermitePosixHttpHeaders;
+
+/**
+ * `ThermiteHttpRequest` read from a socket by `ThermitePosixHttpServer`.  Responses are
+ * appended to the connection's output, formatted as `ESPAsyncWebServer` would send them.
+ */
+class ThermitePosixHttpRequest : public ThermiteHttpRequest {
+private:
+  uint8_t _method;
+  std::string _path;
+  std::map<std::string, std::string> _params;
+  std::string _contentType;
+  std::string _body;
+
+  std::string& _out;
+  const ThermitePosixHttpHeaders& _defaultHeaders;
+  bool _keepAlive;
+  bool _sent;
+
+  void _writeHead(uint16_t code, const char* contentType, long contentLength);
+public:
+  ThermitePosixHttpRequest(
+    std::string& out,
+    const ThermitePosixHttpHeaders& defaultHeaders,
+    bool keepAlive
+  );
+
+  /**
+   * Parses the request line and headers in `head` (without the final blank line), and
+   * returns `false` if they are malformed.
+   */
+  bool parseHead(const std::string& head);
+
+  uint8_t getMethod() const { return _method; }
+  const std::string& getBody() const { return _body; }
+  const std::string& getContentType() const { return _contentType; }
+  bool isKeepAlive() const { return _keepAlive; }
+  bool isSent() const { return _sent; }
+  void setBody(const std::string& body) { _body = body; }
+
+  bool isPreflight() const;
+  const char* getPath() const;
+  const char* getParam(const char* name) const;
+  void send(uint16_t code);
+  void sendBuffer(uint16_t code, const ThermiteResponseBuffer& body, const char* head);
+  void sendJsonConstant(uint16_t code, const char* body);
+  void sendChunked(uint16_t code, ThermiteChunkedBody* body);
+};
+
+typedef std::function<void(ThermitePosixHttpRequest&)> ThermitePosixHttpHandler;
+typedef std::function<void(ThermitePosixHttpRequest&, JsonVariant&)> ThermitePosixJsonHandler;
+
+/**
+ * Minimal non-blocking HTTP/1.1 server with the same routing rules as `AsyncWebServer`:
+ * handlers are tried in the order they were added, a handler for `/a` also matches `/a/...`,
+ * JSON handlers only match requests with `Content-Type: application/json`, and anything else
+ * goes to the not-found handler.
+ * 
+ * Servers don't run their own loop: `begin()` registers the listening socket with an `epoll`
+ * instance, which can be shared by many servers, and the owner of that instance passes each
+ * event on to `onEvent()`.
+ * 
+ * Like the device, connections are closed after each response, unless built with
+ * `keepAlive`.
+ */
+class ThermitePosixHttpServer {
+private:
+  struct Route {
+    std::string uri;
+    uint8_t methods;
+    size_t capacity;
+    ThermitePosixHttpHandler handler;
+    ThermitePosixJsonHandler jsonHandler;
+  };
+
+  struct Connection {
+    ThermitePosixHttpServer* server;
+    int fd;
+    bool listener;
+    bool closing;
+    std::string in;
+    std::string out;
+    size_t outOffset;
+  };
+
+  bool _keepAlive;
+  int _epoll;
+  Connection* _listener;
+  std::vector<Route> _routes;
+  ThermitePosixHttpHandler _notFound;
+  ThermitePosixHttpHeaders _defaultHeaders;
+  std::vector<Connection*> _connections;
+  unsigned long _requestCount;
+
+  void _accept();
+  void _close(Connection* connection);
+  void _dispatch(ThermitePosixHttpRequest& request);
+  void _onConnectionEvent(Connection* connection, uint32_t events);
+  bool _parse(Connection* connection);
+  void _write(Connection* connection);
+public:
+  ThermitePosixHttpServer(bool keepAlive = false);
+  ~ThermitePosixHttpServer();
+
+  void addDefaultHeader(const char* name, const char* value);
+  void on(const char* uri, uint8_t methods, ThermitePosixHttpHandler handler);
+  void onJson(const char* uri, uint8_t methods, ThermitePosixJsonHandler handler, size_t capacity);
+  void onNotFound(ThermitePosixHttpHandler handler);
+
+  /**
+   * Starts listening on `port` on all interfaces, and returns `false` if that fails.
+   */
+  bool begin(int epoll, uint16_t port);
+  unsigned long getRequestCount() const { return _requestCount; }
+
+  /**
+   * Handles an event returned by `epoll_wait()` for a socket registered by any server.
+   */
+  static void onEvent(const epoll_event& event);
+};
+
+#endif
\ No newline at end of file
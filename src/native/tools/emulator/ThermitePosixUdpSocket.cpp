@@ -0,0 +1,60 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ThermitePosixUdpSocket.h"
+
+ThermitePosixUdpSocket::ThermitePosixUdpSocket()
+: _fd(-1) {
+  memset(&_addr, 0, sizeof(_addr));
+}
+
+ThermitePosixUdpSocket::~ThermitePosixUdpSocket() {
+  if (_fd >= 0) {
+    close(_fd);
+  }
+}
+
+bool ThermitePosixUdpSocket::begin(const std::string& spec, std::string& error) {
+  size_t colon = spec.rfind(':');
+  if (colon == std::string::npos) {
+    error = "Invalid telemetry address " + spec + ", expected host:port";
+    return false;
+  }
+  std::string host = spec.substr(0, colon);
+  unsigned long port = strtoul(spec.c_str() + colon + 1, nullptr, 10);
+  _addr.sin_family = AF_INET;
+  _addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (port == 0ul || port > 65535ul || inet_pton(AF_INET, host.c_str(), &_addr.sin_addr) != 1) {
+    error = "Invalid telemetry address " + spec + ", expected host:port";
+    return false;
+  }
+
+  _fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (_fd < 0) {
+    error = std::string("socket: ") + strerror(errno);
+    return false;
+  }
+  if ((ntohl(_addr.sin_addr.s_addr) & 0xf0000000ul) == 0xe0000000ul) {
+    unsigned char ttl = 1;
+    unsigned char loop = 1;
+    setsockopt(_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+  }
+  return true;
+}
+
+bool ThermitePosixUdpSocket::send(const void* data, size_t size) {
+  ssize_t n = sendto(
+    _fd,
+    data,
+    size,
+    0,
+    reinterpret_cast<const sockaddr*>(&_addr),
+    sizeof(_addr)
+  );
+  return n == static_cast<ssize_t>(size);
+}
\ No newline at end of file
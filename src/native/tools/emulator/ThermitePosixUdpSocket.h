@@ -0,0 +1,31 @@
+#ifndef _THERMITE_POSIX_UDP_SOCKET_H__
+#define _THERMITE_POSIX_UDP_SOCKET_H__
+
+#include <netinet/in.h>
+#include <string>
+
+#include "ThermiteHal.h"
+
+/**
+ * Non-blocking UDP socket sending to one IPv4 address, shared by every emulated device.  A
+ * full socket buffer fails `send()`, as running out of buffers does on the device.
+ */
+class ThermitePosixUdpSocket : public ThermiteDatagramSocket {
+private:
+  int _fd;
+  sockaddr_in _addr;
+public:
+  ThermitePosixUdpSocket();
+  ~ThermitePosixUdpSocket();
+
+  /**
+   * Opens the socket, sending to `spec`: `host:port`, where `host` is a dotted IPv4 address.
+   * Multicast groups are sent to with a TTL of 1, and looped back.  Returns `false`, with a
+   * message in `error`, if `spec` is invalid or the socket can't be opened.
+   */
+  bool begin(const std::string& spec, std::string& error);
+
+  bool send(const void* data, size_t size);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include <functional>
+
+#include "ThermitePosixWebTransport.h"
+
+ThermitePosixWebTransport::ThermitePosixWebTransport(ThermiteWebController& webController)
+: _webController(webController) {}
+
+void ThermitePosixWebTransport::initRoutes(ThermitePosixHttpServer& server) {
+  ThermiteWebController& webController = _webController;
+
+  server.on("/calendar", HTTP_METHOD_GET, [&webController](ThermitePosixHttpRequest& request) {
+    webController.getCalendar(request);
+  });
+
+  server.onJson(
+    "/calendar",
+    HTTP_METHOD_PUT,
+    [&webController](ThermitePosixHttpRequest& request, JsonVariant& json) {
+      webController.putCalendar(request, json);
+    },
+    CAPACITY_USER_SETTINGS_UPDATE
+  );
+
+  server.on("/debug/alloc", HTTP_METHOD_GET, [&webController](ThermitePosixHttpRequest& request) {
+    webController.getAllocProfile(request);
+  });
+
+  server.on("/heater", HTTP_METHOD_GET, [&webController](ThermitePosixHttpRequest& request) {
+    webController.getHeaterRuntime(request);
+  });
+
+  server.on("/history", HTTP_METHOD_GET, [&webController](ThermitePosixHttpRequest& request) {
+    webController.getHistory(request);
+  });
+
+  server.on("/internalState", HTTP_METHOD_GET, [&webController](ThermitePosixHttpRequest& request) {
+    webController.getInternalState(request);
+  });
+
+  server.on("/power", HTTP_METHOD_GET, [&webController](ThermitePosixHttpRequest& request) {
+    webController.getPower(request);
+  });
+
+  server.on("/rollups", HTTP_METHOD_GET, [&webController](ThermitePosixHttpRequest& request) {
+    webController.getRollups(request);
+  });
+
+  server.on(
+    "/schedule/timeline",
+    HTTP_METHOD_GET,
+    [&webController](ThermitePosixHttpRequest& request) {
+      webController.getScheduleTimeline(request);
+    }
+  );
+
+  server.on("/thermalModel", HTTP_METHOD_GET, [&webController](ThermitePosixHttpRequest& request) {
+    webController.getThermalModel(request);
+  });
+
+  server.on("/userSettings", HTTP_METHOD_GET, [&webController](ThermitePosixHttpRequest& request) {
+    webController.getUserSettings(request);
+  });
+
+  server.onJson(
+    "/userSettings",
+    HTTP_METHOD_PUT,
+    [&webController](ThermitePosixHttpRequest& request, JsonVariant& json) {
+      webController.putUserSettings(request, json);
+    },
+    CAPACITY_USER_SETTINGS_UPDATE
+  );
+
+  server.on("/zones", HTTP_METHOD_GET, [&webController](ThermitePosixHttpRequest& request) {
+    webController.getZones(request);
+  });
+
+  server.onJson(
+    "/zones",
+    HTTP_METHOD_PUT,
+    [&webController](ThermitePosixHttpRequest& request, JsonVariant& json) {
+      webController.putZones(request, json);
+    },
+    CAPACITY_USER_SETTINGS_UPDATE
+  );
+
+  server.onNotFound([&webController](ThermitePosixHttpRequest& request) {
+    webController.notFound(request);
+  });
+}
\ No newline at end of file
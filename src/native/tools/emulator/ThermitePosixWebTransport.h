@@ -0,0 +1,20 @@
+#ifndef _THERMITE_POSIX_WEB_TRANSPORT_H__
+#define _THERMITE_POSIX_WEB_TRANSPORT_H__
+
+#include "ThermitePosixHttpServer.h"
+#include "ThermiteWebController.h"
+
+/**
+ * Binds `ThermiteWebController` handlers to routes on a `ThermitePosixHttpServer`, exactly
+ * as `ThermiteAsyncWebTransport::initRoutes()` does on the device.  Keep the two in sync.
+ */
+class ThermitePosixWebTransport {
+private:
+  ThermiteWebController& _webController;
+public:
+  ThermitePosixWebTransport(ThermiteWebController& webController);
+
+  void initRoutes(ThermitePosixHttpServer& server);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include <memory>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "ThermiteEmulatedDevice.h"
+#include "ThermitePosixUdpSocket.h"
+
+/**
+ * Emulates one or more `thermite` devices on localhost, serving the real REST API (see
+ * `ThermiteEmulatedDevice`).  Device `i` listens on `--port + i`.  For example, a thousand
+ * devices running an hour per second:
+ * 
+ *   pio run -e emulator -t exec -a "--count 1000 --port 8000 --speed 3600"
+ * 
+ * Runs until interrupted.
+ */
+
+#define EMULATOR_EVENTS_MAX 256
+
+/**
+ * Real ms between controller updates, as `LOOP_INTERVAL` on the device.
+ */
+#define EMULATOR_TICK 10
+
+volatile sig_atomic_t stopRequested = 0;
+
+void onSignal(int) {
+  stopRequested = 1;
+}
+
+void printUsage(const char* argv0) {
+  fprintf(
+    stderr,
+    "usage: %s [options]\n"
+    "  --port P                 port of the first device (default 8000)\n"
+    "  --count N                number of devices (default 1)\n"
+    "  --speed X                virtual time per real time (default 1)\n"
+    "  --start T                virtual time at boot, UTC seconds (default now)\n"
+    "  --offset M               fixed UTC offset in minutes (default -300)\n"
+    "  --keep-alive             keep connections open between requests\n"
+    "  --telemetry HOST:PORT    push UDP telemetry there, from device IDs 1..count\n"
+    "  --tau HOURS              room time constant (default 20)\n"
+    "  --heat-rise C            equilibrium rise with heater on (default 25)\n"
+    "  --outdoor-mean C         annual mean outdoor temperature (default 8)\n",
+    argv0
+  );
+}
+
+unsigned long long monotonicMillis() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<unsigned long long>(ts.tv_sec) * 1000ull + ts.tv_nsec / 1000000ull;
+}
+
+void raiseFileLimit() {
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+int main(int argc, char** argv) {
+  ThermiteEmulatorConfig config;
+  unsigned long port = 8000ul;
+  unsigned long count = 1ul;
+  const char* telemetry = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strcmp(arg, "--keep-alive") == 0) {
+      config.keepAlive = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    const char* value = argv[++i];
+    if (strcmp(arg, "--port") == 0) {
+      port = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--count") == 0) {
+      count = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--speed") == 0) {
+      config.speed = atof(value);
+    } else if (strcmp(arg, "--start") == 0) {
+      config.start = strtol(value, nullptr, 10);
+    } else if (strcmp(arg, "--telemetry") == 0) {
+      telemetry = value;
+    } else if (strcmp(arg, "--offset") == 0) {
+      config.offset = atoi(value);
+    } else if (strcmp(arg, "--tau") == 0) {
+      config.thermal.tauHours = atof(value);
+    } else if (strcmp(arg, "--heat-rise") == 0) {
+      config.thermal.heatRise = atof(value);
+    } else if (strcmp(arg, "--outdoor-mean") == 0) {
+      config.thermal.outdoorMean = atof(value);
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (count == 0ul || port == 0ul || port + count - 1 > 65535ul || config.speed <= 0.0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  ThermitePosixUdpSocket telemetrySocket;
+  if (telemetry != nullptr) {
+    std::string error;
+    if (!telemetrySocket.begin(telemetry, error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    config.telemetry = &telemetrySocket;
+  }
+
+  raiseFileLimit();
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  int epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll < 0) {
+    perror("epoll_create1");
+    return 1;
+  }
+
+  /*
+   * Rooms differ slightly, so that a fleet of emulated devices doesn't switch in lockstep.
+   */
+  std::vector<std::unique_ptr<ThermiteEmulatedDevice> > devices;
+  for (unsigned long i = 0; i < count; i++) {
+    ThermiteThermalParams thermal = config.thermal;
+    thermal.tempInitial += (i % 8) * 0.25;
+    thermal.tauHours *= 1.0 + (i % 5) * 0.05;
+    devices.emplace_back(
+      new ThermiteEmulatedDevice(config, thermal, static_cast<uint32_t>(i + 1))
+    );
+    if (!devices.back()->begin(epoll, static_cast<uint16_t>(port + i))) {
+      fprintf(stderr, "Could not listen on port %lu\n", port + i);
+      return 1;
+    }
+  }
+  fprintf(stderr, "Emulating %lu devices on ports %lu-%lu\n", count, port, port + count - 1);
+
+  unsigned long long start = monotonicMillis();
+  unsigned long long tickAt = start;
+  epoll_event events[EMULATOR_EVENTS_MAX];
+  while (!stopRequested) {
+    unsigned long long now = monotonicMillis();
+    if (now >= tickAt) {
+      unsigned long long elapsed = 1ull + static_cast<unsigned long long>(
+        (now - start) * config.speed
+      );
+      for (std::unique_ptr<ThermiteEmulatedDevice>& device : devices) {
+        device->advanceTo(elapsed);
+      }
+      tickAt = now + EMULATOR_TICK;
+      now = monotonicMillis();
+    }
+
+    int wait = tickAt > now ? static_cast<int>(tickAt - now) : 0;
+    int n = epoll_wait(epoll, events, EMULATOR_EVENTS_MAX, wait);
+    for (int i = 0; i < n; i++) {
+      ThermitePosixHttpServer::onEvent(events[i]);
+    }
+  }
+
+  unsigned long requests = 0ul;
+  for (std::unique_ptr<ThermiteEmulatedDevice>& device : devices) {
+    requests += device->getRequestCount();
+  }
+  fprintf(stderr, "Served %lu requests\n", requests);
+  devices.clear();
+  close(epoll);
+  return 0;
+}
\ No newline at end of file
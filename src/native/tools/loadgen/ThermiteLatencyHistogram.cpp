@@ -0,0 +1,150 @@
+#include <math.h>
+
+#include "ThermiteLatencyHistogram.h"
+
+ThermiteLatencyHistogram::ThermiteLatencyHistogram(uint64_t highest, uint8_t significantDigits)
+: _highest(highest),
+  _totalCount(0ull),
+  _max(0ull),
+  _sum(0.0),
+  _sumSquares(0.0) {
+  /*
+   * Each bucket covers twice the range of the previous one, with enough linear sub-buckets
+   * that adjacent values differ by less than one unit in the last significant digit.
+   */
+  uint64_t largestSingleUnitResolution = 2ull * static_cast<uint64_t>(pow(10.0, significantDigits));
+  uint8_t subBucketCountMagnitude = 0;
+  while ((1ull << subBucketCountMagnitude) < largestSingleUnitResolution) {
+    subBucketCountMagnitude++;
+  }
+  _subBucketHalfCountMagnitude = subBucketCountMagnitude - 1;
+  uint64_t subBucketCount = 1ull << subBucketCountMagnitude;
+  _subBucketHalfCount = static_cast<uint32_t>(subBucketCount / 2);
+  _subBucketMask = subBucketCount - 1;
+
+  uint64_t smallestUntrackable = subBucketCount;
+  size_t bucketCount = 1;
+  while (smallestUntrackable <= highest) {
+    smallestUntrackable <<= 1;
+    bucketCount++;
+  }
+  _counts.assign((bucketCount + 1) * _subBucketHalfCount, 0ull);
+}
+
+size_t ThermiteLatencyHistogram::_getIndex(uint64_t value) const {
+  int pow2Ceiling = 64 - __builtin_clzll(value | _subBucketMask);
+  int bucketIndex = pow2Ceiling - (_subBucketHalfCountMagnitude + 1);
+  uint64_t subBucketIndex = value >> bucketIndex;
+  return (static_cast<size_t>(bucketIndex + 1) << _subBucketHalfCountMagnitude)
+    + (subBucketIndex - _subBucketHalfCount);
+}
+
+uint64_t ThermiteLatencyHistogram::_getValue(size_t index) const {
+  int bucketIndex = static_cast<int>(index >> _subBucketHalfCountMagnitude) - 1;
+  uint64_t subBucketIndex = (index & (_subBucketHalfCount - 1)) + _subBucketHalfCount;
+  if (bucketIndex < 0) {
+    subBucketIndex -= _subBucketHalfCount;
+    bucketIndex = 0;
+  }
+  return subBucketIndex << bucketIndex;
+}
+
+uint64_t ThermiteLatencyHistogram::_getHighestEquivalentValue(uint64_t value) const {
+  size_t index = _getIndex(value);
+  return _getValue(index + 1) - 1;
+}
+
+void ThermiteLatencyHistogram::record(uint64_t value) {
+  if (value < 1ull) {
+    value = 1ull;
+  } else if (value > _highest) {
+    value = _highest;
+  }
+  _counts[_getIndex(value)]++;
+  _totalCount++;
+  if (value > _max) {
+    _max = value;
+  }
+  _sum += value;
+  _sumSquares += static_cast<double>(value) * value;
+}
+
+void ThermiteLatencyHistogram::add(const ThermiteLatencyHistogram& other) {
+  for (size_t i = 0; i < _counts.size() && i < other._counts.size(); i++) {
+    _counts[i] += other._counts[i];
+  }
+  _totalCount += other._totalCount;
+  if (other._max > _max) {
+    _max = other._max;
+  }
+  _sum += other._sum;
+  _sumSquares += other._sumSquares;
+}
+
+double ThermiteLatencyHistogram::getMean() const {
+  return _totalCount == 0ull ? 0.0 : _sum / _totalCount;
+}
+
+double ThermiteLatencyHistogram::getStdDeviation() const {
+  if (_totalCount == 0ull) {
+    return 0.0;
+  }
+  double mean = getMean();
+  double variance = _sumSquares / _totalCount - mean * mean;
+  return variance > 0.0 ? sqrt(variance) : 0.0;
+}
+
+uint64_t ThermiteLatencyHistogram::getValueAtPercentile(double percentile) const {
+  if (_totalCount == 0ull) {
+    return 0ull;
+  }
+  if (percentile > 100.0) {
+    percentile = 100.0;
+  }
+  uint64_t target = static_cast<uint64_t>(percentile / 100.0 * _totalCount + 0.5);
+  if (target < 1ull) {
+    target = 1ull;
+  }
+  uint64_t cumulative = 0ull;
+  for (size_t i = 0; i < _counts.size(); i++) {
+    cumulative += _counts[i];
+    if (cumulative >= target) {
+      uint64_t value = _getHighestEquivalentValue(_getValue(i));
+      return value < _max ? value : _max;
+    }
+  }
+  return _max;
+}
+
+void ThermiteLatencyHistogram::printPercentiles(
+  FILE* out,
+  double scale,
+  uint8_t ticksPerHalfDistance
+) const {
+  fprintf(out, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+  if (_totalCount > 0ull) {
+    double percentile = 0.0;
+    size_t index = 0;
+    uint64_t cumulative = 0ull;
+    while (true) {
+      uint64_t value = getValueAtPercentile(percentile);
+      while (index < _counts.size() && _getValue(index) <= value) {
+        cumulative += _counts[index++];
+      }
+      if (cumulative >= _totalCount) {
+        fprintf(out, "%12.3f %1.12f %10llu\n", value / scale, 1.0,
+          static_cast<unsigned long long>(cumulative));
+        break;
+      }
+      fprintf(out, "%12.3f %1.12f %10llu %14.2f\n", value / scale, percentile / 100.0,
+        static_cast<unsigned long long>(cumulative), 1.0 / (1.0 - percentile / 100.0));
+
+      double halfDistance = pow(2.0, floor(log2(100.0 / (100.0 - percentile))) + 1.0);
+      percentile += 100.0 / (ticksPerHalfDistance * halfDistance);
+    }
+  }
+  fprintf(out, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", getMean() / scale,
+    getStdDeviation() / scale);
+  fprintf(out, "#[Max     = %12.3f, Total count    = %12llu]\n", _max / scale,
+    static_cast<unsigned long long>(_totalCount));
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef _THERMITE_LATENCY_HISTOGRAM_H__
+#define _THERMITE_LATENCY_HISTOGRAM_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+/**
+ * High dynamic range histogram of latencies in µs, using the bucketing scheme from
+ * HdrHistogram: values up to `highest` are recorded with `significantDigits` significant
+ * decimal digits of precision, in fixed memory, at O(1) cost per value.
+ * 
+ * Percentile output follows HdrHistogram's `.hgrm` text format, so it can be fed to the
+ * usual HdrHistogram plotting tools.
+ */
+class ThermiteLatencyHistogram {
+private:
+  uint64_t _highest;
+  uint8_t _subBucketHalfCountMagnitude;
+  uint32_t _subBucketHalfCount;
+  uint64_t _subBucketMask;
+  std::vector<uint64_t> _counts;
+  uint64_t _totalCount;
+  uint64_t _max;
+  double _sum;
+  double _sumSquares;
+
+  size_t _getIndex(uint64_t value) const;
+  uint64_t _getValue(size_t index) const;
+  uint64_t _getHighestEquivalentValue(uint64_t value) const;
+public:
+  ThermiteLatencyHistogram(uint64_t highest = 60000000ull, uint8_t significantDigits = 3);
+
+  /**
+   * Records `value`, clamped to `[1, highest]`.
+   */
+  void record(uint64_t value);
+  void add(const ThermiteLatencyHistogram& other);
+
+  uint64_t getCount() const { return _totalCount; }
+  uint64_t getMax() const { return _max; }
+  double getMean() const;
+  double getStdDeviation() const;
+
+  /**
+   * Returns the smallest recorded value (to within the histogram's precision) that at least
+   * `percentile` percent of values are at or below.
+   */
+  uint64_t getValueAtPercentile(double percentile) const;
+
+  /**
+   * Writes the percentile distribution in `.hgrm` format, with values divided by `scale`
+   * (1000 for ms).
+   */
+  void printPercentiles(FILE* out, double scale, uint8_t ticksPerHalfDistance = 5) const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,529 @@
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ThermiteLoadGenerator.h"
+
+#define LOAD_STATE_FREE 0
+#define LOAD_STATE_CONNECTING 1
+#define LOAD_STATE_SENDING 2
+#define LOAD_STATE_RECEIVING 3
+#define LOAD_STATE_IDLE 4
+
+#define LOAD_EVENTS_MAX 256
+#define LOAD_READ_SIZE 4096
+
+const char* LOAD_REQUEST_NAMES[LOAD_REQUEST_TYPES] = {
+  "internalState",
+  "userSettings",
+  "putUserSettings",
+  "preflight"
+};
+
+namespace {
+
+uint64_t monotonicMicros() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000ull + ts.tv_nsec / 1000ull;
+}
+
+void printLatency(FILE* out, const char* name, const ThermiteLatencyHistogram& histogram) {
+  fprintf(
+    out,
+    "\"%s\":{\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f}",
+    name,
+    histogram.getMean() / 1000.0,
+    histogram.getValueAtPercentile(50.0) / 1000.0,
+    histogram.getValueAtPercentile(90.0) / 1000.0,
+    histogram.getValueAtPercentile(99.0) / 1000.0,
+    histogram.getValueAtPercentile(99.9) / 1000.0,
+    histogram.getMax() / 1000.0
+  );
+}
+
+void printResult(FILE* out, const ThermiteLoadResult& result, double elapsed) {
+  unsigned long errors = result.errorsConnect + result.errorsTimeout + result.errorsHttp;
+  fprintf(
+    out,
+    "{\"sent\":%lu,\"completed\":%lu,\"throughput\":%.2f,"
+    "\"errors\":{\"connect\":%lu,\"timeout\":%lu,\"http\":%lu},\"errorRate\":%.5f,",
+    result.sent,
+    result.completed,
+    elapsed > 0.0 ? result.completed / elapsed : 0.0,
+    result.errorsConnect,
+    result.errorsTimeout,
+    result.errorsHttp,
+    result.sent == 0ul ? 0.0 : static_cast<double>(errors) / result.sent
+  );
+  printLatency(out, "latency", result.latency);
+  fputc(',', out);
+  printLatency(out, "serviceTime", result.serviceTime);
+  fputc('}', out);
+}
+
+}
+
+ThermiteLoadConfig::ThermiteLoadConfig()
+: target("127.0.0.1:8000"),
+  rate(10.0),
+  poisson(true),
+  duration(60.0),
+  warmup(5.0),
+  connections(64),
+  timeout(5000ul),
+  mix { 70.0, 20.0, 5.0, 5.0 },
+  seed(1ul) {}
+
+ThermiteLoadResult::ThermiteLoadResult()
+: sent(0ul),
+  completed(0ul),
+  errorsConnect(0ul),
+  errorsTimeout(0ul),
+  errorsHttp(0ul) {}
+
+ThermiteLoadGenerator::ThermiteLoadGenerator(const ThermiteLoadConfig& config)
+: _config(config),
+  _addrLen(0),
+  _epoll(-1),
+  _random(config.seed),
+  _elapsed(0.0) {}
+
+ThermiteLoadGenerator::~ThermiteLoadGenerator() {
+  for (Connection& connection : _connections) {
+    _close(connection);
+  }
+  if (_epoll >= 0) {
+    close(_epoll);
+  }
+}
+
+bool ThermiteLoadGenerator::init(std::string& error) {
+  std::string s = _config.target;
+  if (s.compare(0, 7, "http://") == 0) {
+    s = s.substr(7);
+  }
+  while (!s.empty() && s.back() == '/') {
+    s.pop_back();
+  }
+  _host = s;
+  std::string port = "80";
+  size_t colon = s.rfind(':');
+  if (colon != std::string::npos) {
+    _host = s.substr(0, colon);
+    port = s.substr(colon + 1);
+  }
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result;
+  int rc = getaddrinfo(_host.c_str(), port.c_str(), &hints, &result);
+  if (rc != 0) {
+    error = "Could not resolve " + _config.target + ": " + gai_strerror(rc);
+    return false;
+  }
+  memcpy(&_addr, result->ai_addr, result->ai_addrlen);
+  _addrLen = result->ai_addrlen;
+  freeaddrinfo(result);
+
+  std::string hostHeader = "Host: " + s + "\r\n";
+  _requests[LOAD_REQUEST_INTERNAL_STATE] =
+    "GET /internalState HTTP/1.1\r\n" + hostHeader + "Accept: application/json\r\n\r\n";
+  _requests[LOAD_REQUEST_USER_SETTINGS] =
+    "GET /userSettings HTTP/1.1\r\n" + hostHeader + "Accept: application/json\r\n\r\n";
+  _requests[LOAD_REQUEST_PREFLIGHT] =
+    "OPTIONS /userSettings HTTP/1.1\r\n" + hostHeader
+    + "Origin: http://localhost\r\n"
+      "Access-Control-Request-Method: PUT\r\n"
+      "Access-Control-Request-Headers: content-type\r\n\r\n";
+
+  if (_config.mix[LOAD_REQUEST_PUT_USER_SETTINGS] > 0.0) {
+    if (!_fetch("/userSettings", _userSettings)) {
+      error = "Could not read user settings from " + _config.target;
+      return false;
+    }
+    _requests[LOAD_REQUEST_PUT_USER_SETTINGS] =
+      "PUT /userSettings HTTP/1.1\r\n" + hostHeader
+      + "Content-Type: application/json\r\n"
+        "Content-Length: " + std::to_string(_userSettings.size()) + "\r\n\r\n"
+      + _userSettings;
+  }
+  return true;
+}
+
+bool ThermiteLoadGenerator::_fetch(const char* path, std::string& body) {
+  int fd = socket(_addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return false;
+  }
+  timeval tv;
+  tv.tv_sec = _config.timeout / 1000ul;
+  tv.tv_usec = (_config.timeout % 1000ul) * 1000ul;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  if (connect(fd, reinterpret_cast<sockaddr*>(&_addr), _addrLen) < 0) {
+    close(fd);
+    return false;
+  }
+
+  std::string request = std::string("GET ") + path + " HTTP/1.1\r\n"
+    "Host: " + _host + "\r\n"
+    "Connection: close\r\n\r\n";
+  if (write(fd, request.data(), request.size()) != static_cast<ssize_t>(request.size())) {
+    close(fd);
+    return false;
+  }
+
+  ThermiteHttpResponseParser response;
+  char buffer[LOAD_READ_SIZE];
+  while (!response.isDone() && !response.isError()) {
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n <= 0) {
+      response.finish();
+      break;
+    }
+    response.feed(buffer, n);
+  }
+  close(fd);
+  if (!response.isDone() || response.getCode() != 200) {
+    return false;
+  }
+  body = response.getBody();
+  return true;
+}
+
+uint8_t ThermiteLoadGenerator::_nextType() {
+  double total = 0.0;
+  for (uint8_t i = 0; i < LOAD_REQUEST_TYPES; i++) {
+    total += _config.mix[i];
+  }
+  double r = std::uniform_real_distribution<double>(0.0, total)(_random);
+  for (uint8_t i = 0; i < LOAD_REQUEST_TYPES; i++) {
+    if (r < _config.mix[i]) {
+      return i;
+    }
+    r -= _config.mix[i];
+  }
+  return LOAD_REQUEST_INTERNAL_STATE;
+}
+
+void ThermiteLoadGenerator::_close(Connection& connection) {
+  if (connection.fd >= 0) {
+    close(connection.fd);
+    connection.fd = -1;
+  }
+  connection.state = LOAD_STATE_FREE;
+}
+
+bool ThermiteLoadGenerator::_start(Connection& connection, const Request& request, uint64_t now) {
+  connection.request = request;
+  connection.request.sentAt = now;
+  connection.out = _requests[request.type];
+  connection.sent = 0;
+  connection.reused = connection.fd >= 0;
+  connection.response.reset();
+
+  epoll_event ev;
+  ev.data.u32 = static_cast<uint32_t>(&connection - &_connections[0]);
+  if (connection.fd >= 0) {
+    connection.state = LOAD_STATE_SENDING;
+    ev.events = EPOLLOUT;
+    epoll_ctl(_epoll, EPOLL_CTL_MOD, connection.fd, &ev);
+    _send(connection, now);
+    return true;
+  }
+
+  connection.fd = socket(_addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (connection.fd < 0) {
+    return false;
+  }
+  int one = 1;
+  setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  int rc = connect(connection.fd, reinterpret_cast<sockaddr*>(&_addr), _addrLen);
+  if (rc < 0 && errno != EINPROGRESS) {
+    _close(connection);
+    return false;
+  }
+  connection.state = LOAD_STATE_CONNECTING;
+  ev.events = EPOLLOUT;
+  if (epoll_ctl(_epoll, EPOLL_CTL_ADD, connection.fd, &ev) < 0) {
+    _close(connection);
+    return false;
+  }
+  return true;
+}
+
+void ThermiteLoadGenerator::_dispatch(uint64_t now) {
+  while (!_pending.empty()) {
+    Connection* chosen = nullptr;
+    for (Connection& connection : _connections) {
+      if (connection.state == LOAD_STATE_IDLE) {
+        chosen = &connection;
+        break;
+      }
+      if (connection.state == LOAD_STATE_FREE && chosen == nullptr) {
+        chosen = &connection;
+      }
+    }
+    if (chosen == nullptr) {
+      return;
+    }
+    Request request = _pending.front();
+    _pending.pop_front();
+    if (!_start(*chosen, request, now) && request.measured) {
+      _results[request.type].errorsConnect++;
+    }
+  }
+}
+
+void ThermiteLoadGenerator::_send(Connection& connection, uint64_t now) {
+  while (connection.sent < connection.out.size()) {
+    ssize_t n = write(
+      connection.fd,
+      connection.out.data() + connection.sent,
+      connection.out.size() - connection.sent
+    );
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return;
+      }
+      _fail(connection, now, false);
+      return;
+    }
+    connection.sent += n;
+  }
+  connection.state = LOAD_STATE_RECEIVING;
+  epoll_event ev;
+  ev.events = EPOLLIN | EPOLLRDHUP;
+  ev.data.u32 = static_cast<uint32_t>(&connection - &_connections[0]);
+  epoll_ctl(_epoll, EPOLL_CTL_MOD, connection.fd, &ev);
+}
+
+void ThermiteLoadGenerator::_complete(Connection& connection, uint64_t now) {
+  const Request& request = connection.request;
+  if (request.measured) {
+    ThermiteLoadResult& result = _results[request.type];
+    uint16_t expected = request.type == LOAD_REQUEST_PREFLIGHT ? 204 : 200;
+    if (connection.response.getCode() == expected) {
+      result.completed++;
+      result.latency.record(now - request.scheduledAt);
+      result.serviceTime.record(now - request.sentAt);
+    } else {
+      result.errorsHttp++;
+    }
+  }
+
+  if (connection.response.isKeepAlive()) {
+    connection.state = LOAD_STATE_IDLE;
+    epoll_event ev;
+    ev.events = EPOLLRDHUP;
+    ev.data.u32 = static_cast<uint32_t>(&connection - &_connections[0]);
+    epoll_ctl(_epoll, EPOLL_CTL_MOD, connection.fd, &ev);
+  } else {
+    _close(connection);
+  }
+}
+
+void ThermiteLoadGenerator::_fail(Connection& connection, uint64_t, bool timeout) {
+  const Request& request = connection.request;
+  if (!timeout && connection.reused) {
+    // the server closed a kept-alive connection as we reused it: retry on a fresh one
+    _pending.push_front(request);
+    _close(connection);
+    return;
+  }
+  if (request.measured) {
+    ThermiteLoadResult& result = _results[request.type];
+    if (timeout) {
+      result.errorsTimeout++;
+    } else if (connection.state == LOAD_STATE_CONNECTING) {
+      result.errorsConnect++;
+    } else {
+      result.errorsHttp++;
+    }
+  }
+  _close(connection);
+}
+
+void ThermiteLoadGenerator::_onEvent(Connection& connection, uint32_t events, uint64_t now) {
+  switch (connection.state) {
+    case LOAD_STATE_CONNECTING: {
+      int error = 0;
+      socklen_t len = sizeof(error);
+      getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &len);
+      if (error != 0 || (events & EPOLLERR)) {
+        _fail(connection, now, false);
+        return;
+      }
+      connection.state = LOAD_STATE_SENDING;
+      _send(connection, now);
+      break;
+    }
+    case LOAD_STATE_SENDING:
+      _send(connection, now);
+      break;
+    case LOAD_STATE_RECEIVING: {
+      char buffer[LOAD_READ_SIZE];
+      while (true) {
+        ssize_t n = read(connection.fd, buffer, sizeof(buffer));
+        if (n > 0) {
+          connection.response.feed(buffer, n);
+          if (connection.response.isDone()) {
+            _complete(connection, now);
+            return;
+          }
+          if (connection.response.isError()) {
+            _fail(connection, now, false);
+            return;
+          }
+          continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+          return;
+        }
+        connection.response.finish();
+        if (connection.response.isDone()) {
+          _complete(connection, now);
+        } else {
+          _fail(connection, now, false);
+        }
+        return;
+      }
+    }
+    default:
+      // the server closed an idle kept-alive connection
+      _close(connection);
+      break;
+  }
+}
+
+bool ThermiteLoadGenerator::run() {
+  _epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (_epoll < 0) {
+    return false;
+  }
+  _connections.resize(_config.connections);
+  for (Connection& connection : _connections) {
+    connection.fd = -1;
+    connection.state = LOAD_STATE_FREE;
+  }
+
+  std::exponential_distribution<double> poissonInterval(_config.rate / 1e6);
+  double evenInterval = 1e6 / _config.rate;
+  uint64_t timeout = _config.timeout * 1000ull;
+
+  uint64_t start = monotonicMicros();
+  uint64_t warmupEnd = start + static_cast<uint64_t>(_config.warmup * 1e6);
+  uint64_t end = start + static_cast<uint64_t>((_config.warmup + _config.duration) * 1e6);
+  double nextArrival = static_cast<double>(start);
+
+  epoll_event events[LOAD_EVENTS_MAX];
+  while (true) {
+    uint64_t now = monotonicMicros();
+
+    // issue every request whose arrival time has come, whether or not the server keeps up
+    while (nextArrival <= now && nextArrival < end) {
+      Request request;
+      request.type = _nextType();
+      request.scheduledAt = static_cast<uint64_t>(nextArrival);
+      request.sentAt = 0ull;
+      request.measured = request.scheduledAt >= warmupEnd;
+      if (request.measured) {
+        _results[request.type].sent++;
+      }
+      _pending.push_back(request);
+      nextArrival += _config.poisson ? poissonInterval(_random) : evenInterval;
+    }
+    _dispatch(now);
+
+    bool active = false;
+    for (Connection& connection : _connections) {
+      if (connection.state == LOAD_STATE_FREE || connection.state == LOAD_STATE_IDLE) {
+        continue;
+      }
+      if (now - connection.request.scheduledAt >= timeout) {
+        _fail(connection, now, true);
+      } else {
+        active = true;
+      }
+    }
+    while (!_pending.empty() && now - _pending.front().scheduledAt >= timeout) {
+      if (_pending.front().measured) {
+        _results[_pending.front().type].errorsTimeout++;
+      }
+      _pending.pop_front();
+    }
+    if (nextArrival >= end && _pending.empty() && !active) {
+      break;
+    }
+
+    int wait = 10;
+    if (nextArrival < end) {
+      wait = nextArrival <= now ? 0 : static_cast<int>((nextArrival - now) / 1000.0);
+    }
+    int n = epoll_wait(_epoll, events, LOAD_EVENTS_MAX, wait);
+    if (n < 0 && errno != EINTR) {
+      return false;
+    }
+    now = monotonicMicros();
+    for (int i = 0; i < n; i++) {
+      _onEvent(_connections[events[i].data.u32], events[i].events, now);
+    }
+  }
+  _elapsed = _config.duration;
+  return true;
+}
+
+void ThermiteLoadGenerator::printReport(FILE* out) const {
+  ThermiteLoadResult total;
+  for (uint8_t i = 0; i < LOAD_REQUEST_TYPES; i++) {
+    const ThermiteLoadResult& result = _results[i];
+    total.sent += result.sent;
+    total.completed += result.completed;
+    total.errorsConnect += result.errorsConnect;
+    total.errorsTimeout += result.errorsTimeout;
+    total.errorsHttp += result.errorsHttp;
+    total.latency.add(result.latency);
+    total.serviceTime.add(result.serviceTime);
+  }
+
+  fprintf(
+    out,
+    "{\"target\":\"%s\",\"rate\":%g,\"arrival\":\"%s\",\"duration\":%g,\"warmup\":%g,"
+    "\"connections\":%u,\"timeout\":%lu,\"mix\":{",
+    _config.target.c_str(),
+    _config.rate,
+    _config.poisson ? "poisson" : "uniform",
+    _config.duration,
+    _config.warmup,
+    _config.connections,
+    _config.timeout
+  );
+  for (uint8_t i = 0; i < LOAD_REQUEST_TYPES; i++) {
+    fprintf(out, "%s\"%s\":%g", i == 0 ? "" : ",", LOAD_REQUEST_NAMES[i], _config.mix[i]);
+  }
+  fputs("},\"total\":", out);
+  printResult(out, total, _elapsed);
+  fputs(",\"requests\":{", out);
+  for (uint8_t i = 0; i < LOAD_REQUEST_TYPES; i++) {
+    fprintf(out, "%s\"%s\":", i == 0 ? "" : ",", LOAD_REQUEST_NAMES[i]);
+    printResult(out, _results[i], _elapsed);
+  }
+  fputs("}}\n", out);
+}
+
+void ThermiteLoadGenerator::printPercentiles(FILE* out) const {
+  ThermiteLatencyHistogram total;
+  for (uint8_t i = 0; i < LOAD_REQUEST_TYPES; i++) {
+    total.add(_results[i].latency);
+  }
+  total.printPercentiles(out, 1000.0);
+}
\ No newline at end of file
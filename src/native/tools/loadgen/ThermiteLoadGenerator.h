@@ -0,0 +1,157 @@
+#ifndef _THERMITE_LOAD_GENERATOR_H__
+#define _THERMITE_LOAD_GENERATOR_H__
+
+#include <deque>
+#include <netinet/in.h>
+#include <random>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+#include "native/tools/collector/ThermiteHttpResponseParser.h"
+#include "ThermiteLatencyHistogram.h"
+
+/**
+ * Kinds of request in the mix, as seen from the web UI.
+ */
+#define LOAD_REQUEST_INTERNAL_STATE 0
+#define LOAD_REQUEST_USER_SETTINGS 1
+#define LOAD_REQUEST_PUT_USER_SETTINGS 2
+#define LOAD_REQUEST_PREFLIGHT 3
+#define LOAD_REQUEST_TYPES 4
+
+extern const char* LOAD_REQUEST_NAMES[LOAD_REQUEST_TYPES];
+
+struct ThermiteLoadConfig {
+  /**
+   * Target device or emulator, as `host[:port]`.
+   */
+  std::string target;
+
+  /**
+   * Offered load in requests per second, held regardless of how fast responses come back
+   * ("open loop"), with either Poisson or evenly spaced arrivals.
+   */
+  double rate;
+  bool poisson;
+
+  /**
+   * Run time and initial warmup, excluded from the results, in seconds.
+   */
+  double duration;
+  double warmup;
+
+  /**
+   * Most connections open at once.  Requests that arrive while all of them are busy wait,
+   * and that wait counts towards their latency.
+   */
+  unsigned connections;
+
+  /**
+   * Per-request timeout in ms, from its scheduled arrival.
+   */
+  unsigned long timeout;
+
+  /**
+   * Relative weight of each request type.
+   */
+  double mix[LOAD_REQUEST_TYPES];
+  unsigned long seed;
+
+  ThermiteLoadConfig();
+};
+
+/**
+ * Outcome of each type of request.  Latency runs from each request's scheduled arrival to
+ * the end of its response, so it includes any queueing behind a slow server; service time
+ * runs from when it was actually sent.
+ */
+struct ThermiteLoadResult {
+  unsigned long sent;
+  unsigned long completed;
+  unsigned long errorsConnect;
+  unsigned long errorsTimeout;
+  unsigned long errorsHttp;
+  ThermiteLatencyHistogram latency;
+  ThermiteLatencyHistogram serviceTime;
+
+  ThermiteLoadResult();
+};
+
+/**
+ * Open-loop HTTP load generator for the `thermite` REST API, driven from one `epoll` loop.
+ * Works against the device and the emulator alike; `PUT /userSettings` writes back the
+ * settings read at startup, so a run leaves the target as it found it.
+ */
+class ThermiteLoadGenerator {
+private:
+  struct Request {
+    uint8_t type;
+    bool measured;
+    uint64_t scheduledAt;
+    uint64_t sentAt;
+  };
+
+  struct Connection {
+    int fd;
+    uint8_t state;
+    Request request;
+    std::string out;
+    size_t sent;
+    bool reused;
+    ThermiteHttpResponseParser response;
+  };
+
+  ThermiteLoadConfig _config;
+  std::string _host;
+  sockaddr_storage _addr;
+  socklen_t _addrLen;
+  std::string _userSettings;
+  std::string _requests[LOAD_REQUEST_TYPES];
+
+  int _epoll;
+  std::vector<Connection> _connections;
+  std::deque<Request> _pending;
+  std::mt19937_64 _random;
+  ThermiteLoadResult _results[LOAD_REQUEST_TYPES];
+  double _elapsed;
+
+  void _close(Connection& connection);
+  void _complete(Connection& connection, uint64_t now);
+  void _dispatch(uint64_t now);
+  void _fail(Connection& connection, uint64_t now, bool timeout);
+  bool _fetch(const char* path, std::string& body);
+  void _onEvent(Connection& connection, uint32_t events, uint64_t now);
+  void _send(Connection& connection, uint64_t now);
+  bool _start(Connection& connection, const Request& request, uint64_t now);
+  uint8_t _nextType();
+public:
+  ThermiteLoadGenerator(const ThermiteLoadConfig& config);
+  ~ThermiteLoadGenerator();
+
+  /**
+   * Resolves the target and reads its user settings, for `PUT` requests.  Returns `false`,
+   * with a message in `error`, if either fails.
+   */
+  bool init(std::string& error);
+
+  /**
+   * Runs the load for the configured duration, then waits for outstanding requests up to
+   * their timeout.
+   */
+  bool run();
+
+  /**
+   * Writes the results as one JSON object, with latencies in ms.
+   */
+  void printReport(FILE* out) const;
+
+  /**
+   * Writes the latency distribution over all requests, in HdrHistogram `.hgrm` format.
+   */
+  void printPercentiles(FILE* out) const;
+};
+
+#endif
\ No newline at end of file
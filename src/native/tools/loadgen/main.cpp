@@ -0,0 +1,168 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/resource.h>
+
+#include "ThermiteLoadGenerator.h"
+
+/**
+ * Load generator: offers a fixed rate of requests to one device or emulator, in a mix like
+ * the web UI's, and reports latency percentiles and error rates as JSON.  For example:
+ * 
+ *   pio run -e loadgen -t exec -a "--rate 50 --duration 60 192.168.1.20"
+ * 
+ * Run the same options against the emulator and a real device to compare the two.
+ */
+
+void printUsage(const char* argv0) {
+  fprintf(
+    stderr,
+    "usage: %s [options] TARGET\n"
+    "  TARGET                   [http://]host[:port]\n"
+    "  --rate R                 requests per second (default 10)\n"
+    "  --arrival A              poisson or uniform (default poisson)\n"
+    "  --duration S             measured run time in seconds (default 60)\n"
+    "  --warmup S               unmeasured run time before it (default 5)\n"
+    "  --connections N          most connections open at once (default 64)\n"
+    "  --timeout MS             timeout per request (default 5000)\n"
+    "  --mix M                  weights as type:weight,... over internalState,\n"
+    "                           userSettings, putUserSettings and preflight\n"
+    "                           (default internalState:70,userSettings:20,\n"
+    "                           putUserSettings:5,preflight:5)\n"
+    "  --seed N                 random seed (default 1)\n"
+    "  --histogram FILE         also write the latency distribution, in .hgrm format\n",
+    argv0
+  );
+}
+
+bool parseMix(const char* value, ThermiteLoadConfig& config) {
+  for (uint8_t i = 0; i < LOAD_REQUEST_TYPES; i++) {
+    config.mix[i] = 0.0;
+  }
+  std::string s = value;
+  size_t start = 0;
+  while (start < s.size()) {
+    size_t end = s.find(',', start);
+    if (end == std::string::npos) {
+      end = s.size();
+    }
+    std::string item = s.substr(start, end - start);
+    size_t colon = item.find(':');
+    if (colon == std::string::npos) {
+      return false;
+    }
+    std::string name = item.substr(0, colon);
+    uint8_t type = 0;
+    while (type < LOAD_REQUEST_TYPES && name != LOAD_REQUEST_NAMES[type]) {
+      type++;
+    }
+    if (type == LOAD_REQUEST_TYPES) {
+      return false;
+    }
+    config.mix[type] = strtod(item.c_str() + colon + 1, nullptr);
+    if (config.mix[type] < 0.0) {
+      return false;
+    }
+    start = end + 1;
+  }
+  double total = 0.0;
+  for (uint8_t i = 0; i < LOAD_REQUEST_TYPES; i++) {
+    total += config.mix[i];
+  }
+  return total > 0.0;
+}
+
+void raiseFileLimit() {
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+int main(int argc, char** argv) {
+  ThermiteLoadConfig config;
+  const char* histogram = nullptr;
+  const char* target = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--", 2) != 0) {
+      target = arg;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    const char* value = argv[++i];
+    if (strcmp(arg, "--rate") == 0) {
+      config.rate = strtod(value, nullptr);
+    } else if (strcmp(arg, "--arrival") == 0 && strcmp(value, "poisson") == 0) {
+      config.poisson = true;
+    } else if (strcmp(arg, "--arrival") == 0 && strcmp(value, "uniform") == 0) {
+      config.poisson = false;
+    } else if (strcmp(arg, "--duration") == 0) {
+      config.duration = strtod(value, nullptr);
+    } else if (strcmp(arg, "--warmup") == 0) {
+      config.warmup = strtod(value, nullptr);
+    } else if (strcmp(arg, "--connections") == 0) {
+      config.connections = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--timeout") == 0) {
+      config.timeout = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--mix") == 0) {
+      if (!parseMix(value, config)) {
+        printUsage(argv[0]);
+        return 1;
+      }
+    } else if (strcmp(arg, "--seed") == 0) {
+      config.seed = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--histogram") == 0) {
+      histogram = value;
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (
+    target == nullptr
+    || config.rate <= 0.0
+    || config.duration <= 0.0
+    || config.warmup < 0.0
+    || config.connections == 0u
+    || config.timeout == 0ul
+  ) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  config.target = target;
+
+  raiseFileLimit();
+  signal(SIGPIPE, SIG_IGN);
+
+  ThermiteLoadGenerator generator(config);
+  std::string error;
+  if (!generator.init(error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  if (!generator.run()) {
+    fprintf(stderr, "Load generator failed: %s\n", strerror(errno));
+    return 1;
+  }
+  generator.printReport(stdout);
+
+  if (histogram != nullptr) {
+    FILE* out = fopen(histogram, "w");
+    if (out == nullptr) {
+      fprintf(stderr, "Could not open %s\n", histogram);
+      return 1;
+    }
+    generator.printPercentiles(out);
+    fclose(out);
+  }
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,408 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ThermiteRecordReader.h"
+#include "ThermiteTime.h"
+
+ThermiteRecord::ThermiteRecord()
+: device(""),
+  deviceLen(0),
+  t(0l),
+  offset(0),
+  hasOffset(false),
+  temp(0.0f),
+  tempTarget(0.0f),
+  heater(false) {}
+
+ThermiteMappedFile::ThermiteMappedFile()
+: _fd(-1),
+  _data(nullptr),
+  _size(0) {}
+
+ThermiteMappedFile::~ThermiteMappedFile() {
+  if (_data != nullptr) {
+    munmap(const_cast<char*>(_data), _size);
+  }
+  if (_fd >= 0) {
+    close(_fd);
+  }
+}
+
+bool ThermiteMappedFile::open(const char* path, std::string& error) {
+  _fd = ::open(path, O_RDONLY);
+  if (_fd < 0) {
+    error = std::string("Could not open ") + path + ": " + strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(_fd, &st) != 0) {
+    error = std::string("Could not stat ") + path + ": " + strerror(errno);
+    return false;
+  }
+  _size = static_cast<size_t>(st.st_size);
+  if (_size == 0) {
+    return true;
+  }
+  void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+  if (data == MAP_FAILED) {
+    error = std::string("Could not map ") + path + ": " + strerror(errno);
+    return false;
+  }
+  _data = static_cast<const char*>(data);
+
+  // we read front to back exactly once, so let the kernel read ahead aggressively
+  madvise(data, _size, MADV_SEQUENTIAL);
+  return true;
+}
+
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+static const char* skipSpace(const char* p, const char* end) {
+  while (p < end && isSpace(*p)) {
+    p++;
+  }
+  return p;
+}
+
+/**
+ * Skips the string starting at `p`, which must be `"`.  Returns the position just after it,
+ * or `nullptr` if it doesn't end before `end`.
+ */
+static const char* skipString(const char* p, const char* end) {
+  p++;
+  while (p < end) {
+    if (*p == '\\') {
+      p += 2;
+    } else if (*p == '"') {
+      return p + 1;
+    } else {
+      p++;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * Skips the value starting at `p`, whatever it is.  Returns the position just after it, or
+ * `nullptr` if it doesn't end before `end`.
+ */
+static const char* skipValue(const char* p, const char* end) {
+  if (p >= end) {
+    return nullptr;
+  }
+  if (*p == '"') {
+    return skipString(p, end);
+  }
+  if (*p == '{' || *p == '[') {
+    int depth = 0;
+    while (p < end) {
+      char c = *p;
+      if (c == '"') {
+        p = skipString(p, end);
+        if (p == nullptr) {
+          return nullptr;
+        }
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        depth++;
+      } else if (c == '}' || c == ']') {
+        depth--;
+        if (depth == 0) {
+          return p + 1;
+        }
+      }
+      p++;
+    }
+    return nullptr;
+  }
+  const char* start = p;
+  while (p < end && !isSpace(*p) && *p != ',' && *p != '}' && *p != ']') {
+    p++;
+  }
+  return p > start ? p : nullptr;
+}
+
+/**
+ * Parses all of `[p, end)` as a JSON number.  Plain decimals, which is all the device writes,
+ * take the fast path; exponents go through `pow()`.
+ */
+static bool parseNumber(const char* p, const char* end, double& value) {
+  bool negative = false;
+  if (p < end && *p == '-') {
+    negative = true;
+    p++;
+  }
+  if (p == end || !isDigit(*p)) {
+    return false;
+  }
+  double v = 0.0;
+  while (p < end && isDigit(*p)) {
+    v = v * 10.0 + (*p - '0');
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    double scale = 0.1;
+    while (p < end && isDigit(*p)) {
+      v += (*p - '0') * scale;
+      scale *= 0.1;
+      p++;
+    }
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool exponentNegative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+      exponentNegative = *p == '-';
+      p++;
+    }
+    int exponent = 0;
+    while (p < end && isDigit(*p)) {
+      exponent = exponent * 10 + (*p - '0');
+      p++;
+    }
+    v *= pow(10.0, exponentNegative ? -exponent : exponent);
+  }
+  value = negative ? -v : v;
+  return p == end;
+}
+
+static bool parseDigits(const char* p, int count, int& value) {
+  value = 0;
+  for (int i = 0; i < count; i++) {
+    if (!isDigit(p[i])) {
+      return false;
+    }
+    value = value * 10 + (p[i] - '0');
+  }
+  return true;
+}
+
+/**
+ * Parses ISO 8601 `YYYY-MM-DDTHH:MM:SS`, with optional fraction of a second and UTC offset
+ * (`Z`, `+HH:MM` or `+HHMM`), from `[p, end)`.
+ */
+static bool parseIsoDate(
+  const char* p,
+  const char* end,
+  time_t& t,
+  int& offset,
+  bool& hasOffset
+) {
+  if (end - p < 19 || p[4] != '-' || p[7] != '-' || p[13] != ':' || p[16] != ':') {
+    return false;
+  }
+  if (p[10] != 'T' && p[10] != ' ') {
+    return false;
+  }
+  int year;
+  int month;
+  int day;
+  int hour;
+  int minute;
+  int second;
+  if (!parseDigits(p, 4, year) || !parseDigits(p + 5, 2, month) || !parseDigits(p + 8, 2, day)
+    || !parseDigits(p + 11, 2, hour) || !parseDigits(p + 14, 2, minute)
+    || !parseDigits(p + 17, 2, second)) {
+    return false;
+  }
+  if (year < 1970 || month < 1 || month > 12 || day < 1 || day > 31) {
+    return false;
+  }
+  ThermiteTimeElements tm;
+  tm.year = static_cast<uint16_t>(year);
+  tm.month = static_cast<uint8_t>(month);
+  tm.day = static_cast<uint8_t>(day);
+  tm.hour = static_cast<uint8_t>(hour);
+  tm.minute = static_cast<uint8_t>(minute);
+  tm.second = static_cast<uint8_t>(second);
+  tm.weekday = 0;
+  time_t tLocal = thermiteMakeTime(tm);
+
+  p += 19;
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && isDigit(*p)) {
+      p++;
+    }
+  }
+  hasOffset = false;
+  offset = 0;
+  if (p < end && *p == 'Z') {
+    hasOffset = true;
+    p++;
+  } else if (p < end && (*p == '+' || *p == '-')) {
+    int sign = *p == '-' ? -1 : 1;
+    p++;
+    int hours;
+    int minutes;
+    if (end - p < 4 || !parseDigits(p, 2, hours)) {
+      return false;
+    }
+    p += 2;
+    if (*p == ':') {
+      p++;
+    }
+    if (end - p < 2 || !parseDigits(p, 2, minutes)) {
+      return false;
+    }
+    p += 2;
+    offset = sign * (hours * 60 + minutes);
+    hasOffset = true;
+  }
+  if (p != end) {
+    return false;
+  }
+  t = tLocal - offset * 60l;
+  return true;
+}
+
+static bool isKey(const char* key, size_t keyLen, const char* name) {
+  return strlen(name) == keyLen && memcmp(key, name, keyLen) == 0;
+}
+
+/**
+ * Decodes the line `[p, end)`, which starts with something other than white space, into
+ * `record`.  Returns whether it had everything a record needs.
+ */
+static bool parseLine(const char* p, const char* end, ThermiteRecord& record) {
+  record = ThermiteRecord();
+  bool hasT = false;
+  bool hasTemp = false;
+  bool hasTempTarget = false;
+  bool hasHeater = false;
+  bool hasDeviceTime = false;
+
+  if (*p != '{') {
+    return false;
+  }
+  p++;
+  while (true) {
+    p = skipSpace(p, end);
+    if (p < end && *p == '}') {
+      break;
+    }
+    if (p == end || *p != '"') {
+      return false;
+    }
+    const char* key = p + 1;
+    p = skipString(p, end);
+    if (p == nullptr) {
+      return false;
+    }
+    size_t keyLen = p - 1 - key;
+    p = skipSpace(p, end);
+    if (p == end || *p != ':') {
+      return false;
+    }
+    p = skipSpace(p + 1, end);
+    const char* value = p;
+    p = skipValue(p, end);
+    if (p == nullptr) {
+      return false;
+    }
+    bool isString = *value == '"';
+
+    double number;
+    if (isKey(key, keyLen, "device") && isString) {
+      record.device = value + 1;
+      record.deviceLen = p - value - 2;
+    } else if (isKey(key, keyLen, "unixDate")) {
+      time_t t;
+      int offset = 0;
+      bool hasOffset = false;
+      if (isString) {
+        if (!parseIsoDate(value + 1, p - 1, t, offset, hasOffset)) {
+          return false;
+        }
+      } else if (parseNumber(value, p, number)) {
+        t = static_cast<time_t>(number);
+      } else {
+        return false;
+      }
+      if (!hasDeviceTime) {
+        record.t = t;
+        record.offset = offset;
+        record.hasOffset = hasOffset;
+      }
+      hasT = true;
+    } else if (isKey(key, keyLen, "dateTime") && isString) {
+      time_t t;
+      int offset;
+      bool hasOffset;
+      if (parseIsoDate(value + 1, p - 1, t, offset, hasOffset) && hasOffset) {
+        record.t = t;
+        record.offset = offset;
+        record.hasOffset = true;
+        hasDeviceTime = true;
+        hasT = true;
+      }
+    } else if (isKey(key, keyLen, "temp")) {
+      if (!parseNumber(value, p, number)) {
+        return false;
+      }
+      record.temp = static_cast<float>(number);
+      hasTemp = true;
+    } else if (isKey(key, keyLen, "tempTarget")) {
+      if (!parseNumber(value, p, number)) {
+        return false;
+      }
+      record.tempTarget = static_cast<float>(number);
+      hasTempTarget = true;
+    } else if (isKey(key, keyLen, "heater")) {
+      if (p - value == 4 && memcmp(value, "true", 4) == 0) {
+        record.heater = true;
+      } else if (p - value == 5 && memcmp(value, "false", 5) == 0) {
+        record.heater = false;
+      } else {
+        return false;
+      }
+      hasHeater = true;
+    }
+
+    p = skipSpace(p, end);
+    if (p < end && *p == ',') {
+      p++;
+    } else if (p < end && *p == '}') {
+      break;
+    } else {
+      return false;
+    }
+  }
+  return hasT && hasTemp && hasTempTarget && hasHeater;
+}
+
+ThermiteRecordReader::ThermiteRecordReader(const char* data, size_t size)
+: _p(data),
+  _end(data + size),
+  _line(0ul) {}
+
+bool ThermiteRecordReader::next(ThermiteRecord& record, bool& valid) {
+  while (_p < _end) {
+    const char* eol = static_cast<const char*>(memchr(_p, '\n', _end - _p));
+    if (eol == nullptr) {
+      eol = _end;
+    }
+    const char* line = skipSpace(_p, eol);
+    _p = eol < _end ? eol + 1 : _end;
+    _line++;
+    if (line == eol) {
+      continue;
+    }
+    valid = parseLine(line, eol, record);
+    return true;
+  }
+  return false;
+}
\ No newline at end of file
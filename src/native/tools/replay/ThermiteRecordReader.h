@@ -0,0 +1,89 @@
+#ifndef _THERMITE_RECORD_READER_H__
+#define _THERMITE_RECORD_READER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <time.h>
+
+/**
+ * One sample of `/internalState`, as logged by the collector (or `thermite_http_logger.sh`
+ * before it).  Strings point into the mapped file, and are only valid while it is.
+ */
+struct ThermiteRecord {
+  /**
+   * Device the sample came from, or empty for logs of a single device.
+   */
+  const char* device;
+  size_t deviceLen;
+
+  /**
+   * When the sample was taken (UTC), and the device's UTC offset then, in minutes.
+   * `hasOffset` is `false` if the line gave no offset.
+   */
+  time_t t;
+  int offset;
+  bool hasOffset;
+
+  float temp;
+  float tempTarget;
+  bool heater;
+
+  ThermiteRecord();
+};
+
+/**
+ * Read-only memory map of a whole file, for the life of the object.
+ */
+class ThermiteMappedFile {
+private:
+  int _fd;
+  const char* _data;
+  size_t _size;
+public:
+  ThermiteMappedFile();
+  ~ThermiteMappedFile();
+
+  ThermiteMappedFile(const ThermiteMappedFile&) = delete;
+  ThermiteMappedFile& operator=(const ThermiteMappedFile&) = delete;
+
+  /**
+   * Maps `path`.  Returns `false`, with a message in `error`, if it can't.
+   */
+  bool open(const char* path, std::string& error);
+
+  const char* getData() const { return _data; }
+  size_t getSize() const { return _size; }
+};
+
+/**
+ * Walks JSON lines in place, one record at a time, without copying or allocating.
+ * 
+ * Only the top level of each line is scanned, and only `device`, `unixDate`, `dateTime`,
+ * `temp`, `tempTarget` and `heater` are decoded; everything else, nested or not, is skipped.
+ * Time comes from `dateTime`, which is the device's own clock and so what its controller
+ * saw, or failing that from the logger's `unixDate`, which may be seconds since the epoch or
+ * ISO 8601 as the collector writes it.
+ */
+class ThermiteRecordReader {
+private:
+  const char* _p;
+  const char* _end;
+  unsigned long _line;
+public:
+  ThermiteRecordReader(const char* data, size_t size);
+
+  /**
+   * Decodes the next line into `record`.  Returns `false` at the end of the input;
+   * otherwise sets `valid` to whether the line had everything a record needs.  Blank lines
+   * are skipped.
+   */
+  bool next(ThermiteRecord& record, bool& valid);
+
+  /**
+   * Line number of the line `next()` last read, counting from 1.
+   */
+  unsigned long getLine() const { return _line; }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+#include "ThermiteReplay.h"
+
+/**
+ * Replayed devices request the thermometer this long before each record, and read it at the
+ * record, so that every record is a fresh reading.
+ */
+#define REPLAY_READ_DELAY (TEMP_REQUEST_DELAY + 1ul)
+
+ThermiteReplayConfig::ThermiteReplayConfig()
+: tempHysteresis(1.0f),
+  preheatMargin(0.0f),
+  offset(0),
+  mismatchesMax(20ul) {}
+
+ThermiteReplayStats::ThermiteReplayStats()
+: files(0ul),
+  bytes(0ull),
+  records(0ull),
+  invalid(0ull),
+  skipped(0ull),
+  devices(0ul),
+  mismatches(0ull),
+  tempTargetMismatches(0ull),
+  heaterMismatches(0ull),
+  wallSeconds(0.0) {}
+
+ThermiteReplayDevice::ThermiteReplayDevice(const std::string& name, time_t start, int offset)
+: name(name),
+  userSettingsStore(),
+  thermometer(TEMP_DISCONNECTED),
+  clock(start, offset),
+  internalState(userSettingsStore, thermometer, clock),
+  start(start),
+  last(start - 1l) {}
+
+ThermiteReplay::ThermiteReplay(const ThermiteReplayConfig& config, FILE* out)
+: _config(config),
+  _userSettingsDoc(CAPACITY_USER_SETTINGS_UPDATE),
+  _out(out),
+  _deviceLast(nullptr) {}
+
+ThermiteReplayDevice* ThermiteReplay::_getDevice(const ThermiteRecord& record) {
+  if (_deviceLast != nullptr
+    && _deviceLast->name.size() == record.deviceLen
+    && memcmp(_deviceLast->name.data(), record.device, record.deviceLen) == 0) {
+    return _deviceLast;
+  }
+  std::string name(record.device, record.deviceLen);
+  std::unordered_map<std::string, size_t>::const_iterator it = _deviceIndex.find(name);
+  if (it != _deviceIndex.end()) {
+    _deviceLast = _devices[it->second].get();
+    return _deviceLast;
+  }
+
+  int offset = record.hasOffset ? record.offset : _config.offset;
+  ThermiteReplayDevice* device = new ThermiteReplayDevice(name, record.t, offset);
+  if (!_config.userSettingsJson.empty()) {
+    // already validated by `init()`
+    device->userSettingsStore.update(_userSettingsDoc.as<JsonObject>());
+  }
+  device->internalState.setTempHysteresis(_config.tempHysteresis);
+  device->internalState.setTempRequestInterval(REPLAY_READ_DELAY);
+  device->internalState.setPreheatMargin(_config.preheatMargin);
+  _deviceIndex[name] = _devices.size();
+  _devices.emplace_back(device);
+  _stats.devices++;
+  _deviceLast = device;
+  return device;
+}
+
+void ThermiteReplay::_printMismatch(
+  const ThermiteReplayDevice& device,
+  const ThermiteRecord& record,
+  const char* path,
+  unsigned long line
+) {
+  const ThermiteInternalState& internalState = device.internalState;
+  fprintf(
+    _out,
+    "{\"file\":\"%s\",\"line\":%lu,\"device\":\"%s\",\"t\":%ld,\"temp\":%g,"
+    "\"tempTarget\":%g,\"heater\":%s,\"replayTempTarget\":%g,\"replayHeater\":%s}\n",
+    path,
+    line,
+    device.name.c_str(),
+    static_cast<long>(record.t),
+    record.temp,
+    record.tempTarget,
+    record.heater ? "true" : "false",
+    internalState.getTempTarget(),
+    internalState.getHeater() ? "true" : "false"
+  );
+}
+
+bool ThermiteReplay::init(std::string& error) {
+  if (_config.userSettingsJson.empty()) {
+    return true;
+  }
+  if (deserializeJson(_userSettingsDoc, _config.userSettingsJson)) {
+    error = "Could not parse user settings";
+    return false;
+  }
+  ThermiteUserSettingsStore userSettingsStore;
+  if (userSettingsStore.update(_userSettingsDoc.as<JsonObject>()) != SETTINGS_UPDATE_OK) {
+    error = "Invalid user settings";
+    return false;
+  }
+  return true;
+}
+
+bool ThermiteReplay::replayFile(const char* path, std::string& error) {
+  std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+  ThermiteMappedFile file;
+  if (!file.open(path, error)) {
+    return false;
+  }
+  _stats.files++;
+  _stats.bytes += file.getSize();
+
+  ThermiteRecordReader reader(file.getData(), file.getSize());
+  ThermiteRecord record;
+  bool valid;
+  while (reader.next(record, valid)) {
+    if (!valid) {
+      _stats.invalid++;
+      continue;
+    }
+    ThermiteReplayDevice* device = _getDevice(record);
+    if (record.t <= device->last) {
+      _stats.skipped++;
+      continue;
+    }
+    _stats.records++;
+    device->last = record.t;
+
+    ThermiteFakeClock& clock = device->clock;
+    clock.setOffset(record.hasOffset ? record.offset : _config.offset);
+    unsigned long long readAt = (record.t - device->start) * 1000ull + REPLAY_READ_DELAY + 1ull;
+    clock.advance(readAt - REPLAY_READ_DELAY - clock.getElapsedMillis());
+    device->thermometer.setTemperature(record.temp);
+    device->internalState.update(clock.getMillis());
+    clock.advance(REPLAY_READ_DELAY);
+    device->internalState.update(clock.getMillis());
+
+    const ThermiteInternalState& internalState = device->internalState;
+    bool mismatch = false;
+    if (fabsf(internalState.getTempTarget() - record.tempTarget) > 0.005f) {
+      _stats.tempTargetMismatches++;
+      mismatch = true;
+    }
+    if (internalState.getHeater() != record.heater) {
+      _stats.heaterMismatches++;
+      mismatch = true;
+    }
+    if (mismatch) {
+      _stats.mismatches++;
+      if (_stats.mismatches <= _config.mismatchesMax) {
+        _printMismatch(*device, record, path, reader.getLine());
+      }
+    }
+  }
+
+  _stats.wallSeconds += std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - wallStart
+  ).count();
+  return true;
+}
\ No newline at end of file
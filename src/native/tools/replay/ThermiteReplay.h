@@ -0,0 +1,140 @@
+#ifndef _THERMITE_REPLAY_H__
+#define _THERMITE_REPLAY_H__
+
+#include <ArduinoJson.h>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "native/ThermiteFakeHal.h"
+#include "ThermiteInternalState.h"
+#include "ThermiteRecordReader.h"
+#include "ThermiteUserSettingsStore.h"
+
+/**
+ * How the replayed controller is set up.  These should match what the device was running
+ * when the log was recorded, or mismatches will mostly be about that.
+ */
+struct ThermiteReplayConfig {
+  /**
+   * User settings, as they would be sent to `PUT /userSettings` (calendar included).  Empty
+   * means the defaults from `ThermiteUserSettingsManager`.
+   */
+  std::string userSettingsJson;
+
+  float tempHysteresis;
+  float preheatMargin;
+
+  /**
+   * UTC offset in minutes, for records that carry none.
+   */
+  int offset;
+
+  /**
+   * Most mismatches to print; the rest are only counted.
+   */
+  unsigned long mismatchesMax;
+
+  ThermiteReplayConfig();
+};
+
+struct ThermiteReplayStats {
+  unsigned long files;
+  unsigned long long bytes;
+  unsigned long long records;
+
+  /**
+   * Lines that were not valid records, and records that did not move their device's clock
+   * forward.  Neither is replayed.
+   */
+  unsigned long long invalid;
+  unsigned long long skipped;
+  unsigned long devices;
+
+  /**
+   * Replayed records whose `tempTarget`, `heater` or either differs from what the device
+   * reported.
+   */
+  unsigned long long mismatches;
+  unsigned long long tempTargetMismatches;
+  unsigned long long heaterMismatches;
+  double wallSeconds;
+
+  ThermiteReplayStats();
+};
+
+/**
+ * Real controller for one device, fed that device's records.
+ */
+struct ThermiteReplayDevice {
+  std::string name;
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock;
+  ThermiteInternalState internalState;
+
+  /**
+   * Time of the first record (where the clock starts) and of the last one replayed.
+   */
+  time_t start;
+  time_t last;
+
+  ThermiteReplayDevice(const std::string& name, time_t start, int offset);
+};
+
+/**
+ * Replays recorded `/internalState` samples through a natively built `ThermiteInternalState`
+ * and `ThermiteUserSettingsManager`, one controller per device, and compares the
+ * controller's `tempTarget` and `heater` with what the device reported.
+ * 
+ * Each record is replayed as the device would have seen it: the clock jumps to just before
+ * the record, the thermometer is requested, and `TEMP_REQUEST_DELAY` later read at exactly
+ * the recorded time and temperature.  Nothing else happens in between, so there is nothing
+ * else to simulate; that, and reading files in place (see `ThermiteRecordReader`), is what
+ * makes this fast.
+ */
+class ThermiteReplay {
+private:
+  ThermiteReplayConfig _config;
+  DynamicJsonDocument _userSettingsDoc;
+  FILE* _out;
+  ThermiteReplayStats _stats;
+  std::vector<std::unique_ptr<ThermiteReplayDevice>> _devices;
+  std::unordered_map<std::string, size_t> _deviceIndex;
+
+  /**
+   * Device of the last record, which is nearly always the device of the next.
+   */
+  ThermiteReplayDevice* _deviceLast;
+
+  ThermiteReplayDevice* _getDevice(const ThermiteRecord& record);
+  void _printMismatch(
+    const ThermiteReplayDevice& device,
+    const ThermiteRecord& record,
+    const char* path,
+    unsigned long line
+  );
+public:
+  /**
+   * Mismatches are printed to `out`, as JSON lines.
+   */
+  ThermiteReplay(const ThermiteReplayConfig& config, FILE* out);
+
+  /**
+   * Checks that the configuration is usable.  Returns `false`, with a message in `error`, if
+   * it isn't.
+   */
+  bool init(std::string& error);
+
+  /**
+   * Replays every record in the file at `path`.  Returns `false`, with a message in
+   * `error`, if the file can't be read.
+   */
+  bool replayFile(const char* path, std::string& error);
+
+  const ThermiteReplayStats& getStats() const { return _stats; }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "ThermiteReplay.h"
+
+/**
+ * Replays logged `/internalState` samples (as written by the collector) through the real
+ * controller, and reports where its decisions differ from the device's.  For example:
+ * 
+ *   pio run -e replay -t exec -a "--settings userSettings.json --offset -300 samples.jsonl"
+ * 
+ * Mismatches are printed as JSON lines, followed by one line of JSON summarizing the run.
+ * Exits with status 1 if a file can't be read, or more than `--max-mismatch-rate` of records
+ * mismatch, so that controller changes can be regression-tested against recorded history.
+ */
+
+void printUsage(const char* argv0) {
+  fprintf(
+    stderr,
+    "usage: %s [options] FILE...\n"
+    "  FILE                     JSON lines of /internalState samples, replayed in order\n"
+    "  --settings F             user settings JSON file (default: built-in defaults)\n"
+    "  --hysteresis H           hysteresis in degrees Celsius (default 1)\n"
+    "  --preheat M              optimal-start margin, or 0 for none (default 0)\n"
+    "  --offset M               UTC offset in minutes for samples without one (default 0)\n"
+    "  --mismatches N           print at most N mismatches (default 20)\n"
+    "  --max-mismatch-rate R    fail if more than this fraction of records mismatch\n"
+    "                           (default 1, never)\n",
+    argv0
+  );
+}
+
+bool readFile(const std::string& path, std::string& contents) {
+  std::ifstream in(path.c_str());
+  if (!in) {
+    return false;
+  }
+  std::stringstream ss;
+  ss << in.rdbuf();
+  contents = ss.str();
+  return true;
+}
+
+void printStats(const ThermiteReplayStats& stats) {
+  double records = stats.records > 0ull ? static_cast<double>(stats.records) : 1.0;
+  double wallSeconds = stats.wallSeconds > 0.0 ? stats.wallSeconds : 1e-9;
+  printf(
+    "{\"files\":%lu,\"bytes\":%llu,\"records\":%llu,\"invalid\":%llu,\"skipped\":%llu,"
+    "\"devices\":%lu,\"mismatches\":%llu,\"tempTargetMismatches\":%llu,"
+    "\"heaterMismatches\":%llu,\"tempTargetAgreement\":%.4f,\"heaterAgreement\":%.4f,"
+    "\"recordsPerSecond\":%.0f,\"wallSeconds\":%.4f}\n",
+    stats.files,
+    stats.bytes,
+    stats.records,
+    stats.invalid,
+    stats.skipped,
+    stats.devices,
+    stats.mismatches,
+    stats.tempTargetMismatches,
+    stats.heaterMismatches,
+    1.0 - stats.tempTargetMismatches / records,
+    1.0 - stats.heaterMismatches / records,
+    stats.records / wallSeconds,
+    stats.wallSeconds
+  );
+}
+
+int main(int argc, char** argv) {
+  ThermiteReplayConfig config;
+  double mismatchRateMax = 1.0;
+  std::vector<const char*> paths;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--", 2) != 0) {
+      paths.push_back(arg);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    const char* value = argv[++i];
+    if (strcmp(arg, "--settings") == 0) {
+      if (!readFile(value, config.userSettingsJson)) {
+        fprintf(stderr, "Could not read user settings from %s\n", value);
+        return 1;
+      }
+    } else if (strcmp(arg, "--hysteresis") == 0) {
+      config.tempHysteresis = static_cast<float>(atof(value));
+    } else if (strcmp(arg, "--preheat") == 0) {
+      config.preheatMargin = static_cast<float>(atof(value));
+    } else if (strcmp(arg, "--offset") == 0) {
+      config.offset = atoi(value);
+    } else if (strcmp(arg, "--mismatches") == 0) {
+      config.mismatchesMax = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--max-mismatch-rate") == 0) {
+      mismatchRateMax = atof(value);
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (paths.empty()) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  ThermiteReplay replay(config, stdout);
+  std::string error;
+  if (!replay.init(error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  int status = 0;
+  for (const char* path : paths) {
+    if (!replay.replayFile(path, error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      status = 1;
+    }
+  }
+
+  const ThermiteReplayStats& stats = replay.getStats();
+  printStats(stats);
+  if (stats.records > 0ull
+    && static_cast<double>(stats.mismatches) / stats.records > mismatchRateMax) {
+    status = 1;
+  }
+  return status;
+}
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include <chrono>
+#include <math.h>
+#include <random>
+
+#include "native/ThermiteFakeHal.h"
+#include "ThermiteInternalState.h"
+#include "ThermitePowerManager.h"
+#include "ThermiteSimulation.h"
+
+ThermiteSimulationConfig::ThermiteSimulationConfig()
+: userSettingsName("default"),
+  tempHysteresis(1.0f),
+  tempRequestInterval(TEMP_REQUEST_INTERVAL),
+  preheatMargin(0.0f),
+  start(1609477200l),
+  offset(-300),
+  days(365ul),
+  powerMode(POWER_MODE_AWAKE),
+  listenInterval(POWER_LISTEN_INTERVAL),
+  requestsPerHour(4.0),
+  seed(1ul) {}
+
+ThermiteSimulationResult::ThermiteSimulationResult()
+: ok(false),
+  comfortMeanAbsError(0.0),
+  comfortRmsError(0.0),
+  comfortDegreeHoursBelow(0.0),
+  heaterRuntimeHours(0.0),
+  relayCycles(0ul),
+  energyKwh(0.0),
+  currentAverage(0.0),
+  requests(0ul),
+  wakeLatencyMean(0.0),
+  wakeLatencyMax(0ul),
+  modelHeatingRate(0.0),
+  modelTimeConstant(0.0),
+  events(0ul),
+  wallSeconds(0.0) {}
+
+ThermiteSimulation::ThermiteSimulation(const ThermiteSimulationConfig& config)
+: _config(config) {}
+
+ThermiteSimulationResult ThermiteSimulation::run() const {
+  ThermiteSimulationResult result;
+  std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+
+  ThermiteUserSettingsStore userSettingsStore;
+  if (!_config.userSettingsJson.empty()) {
+    DynamicJsonDocument doc(CAPACITY_USER_SETTINGS_UPDATE);
+    if (deserializeJson(doc, _config.userSettingsJson)) {
+      return result;
+    }
+    if (userSettingsStore.update(doc.as<JsonObject>()) != SETTINGS_UPDATE_OK) {
+      return result;
+    }
+  }
+
+  ThermiteThermalModel model(_config.thermal);
+  ThermiteFakeThermometer thermometer(static_cast<float>(model.getTemperature()));
+  ThermiteFakeClock clock(_config.start, _config.offset);
+  ThermiteFakeRelay relay;
+  ThermiteFakeRadio radio;
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermitePowerManager powerManager(radio, clock, _config.powerMode, _config.listenInterval);
+  internalState.setTempHysteresis(_config.tempHysteresis);
+  internalState.setTempRequestInterval(_config.tempRequestInterval);
+  internalState.setPreheatMargin(_config.preheatMargin);
+  internalState.init();
+  relay.begin();
+
+  /*
+   * `millis() == 0` means "never requested" to `ThermiteInternalState`, so start at 1 ms as
+   * the device effectively does.
+   */
+  clock.advance(1ull);
+  unsigned long long end = _config.days * 86400000ull;
+
+  double comfortSeconds = 0.0;
+  double absErrorSum = 0.0;
+  double sqErrorSum = 0.0;
+  double heaterSeconds = 0.0;
+
+  std::mt19937_64 random(_config.seed);
+  std::exponential_distribution<double> requestInterval(_config.requestsPerHour / 3600000.0);
+  unsigned long long nextRequestAt = end;
+  if (_config.requestsPerHour > 0.0) {
+    nextRequestAt = static_cast<unsigned long long>(requestInterval(random));
+  }
+  double wakeLatencySum = 0.0;
+  ThermiteCalendarCursor calendarCursor;
+
+  while (clock.getElapsedMillis() < end) {
+    if (clock.getElapsedMillis() >= nextRequestAt) {
+      unsigned long wakeLatency = powerManager.getWakeLatency(clock.getMillis());
+      wakeLatencySum += wakeLatency;
+      if (wakeLatency > result.wakeLatencyMax) {
+        result.wakeLatencyMax = wakeLatency;
+      }
+      result.requests++;
+      powerManager.noteRequest();
+      nextRequestAt += 1ull + static_cast<unsigned long long>(requestInterval(random));
+    }
+
+    thermometer.setTemperature(static_cast<float>(model.getTemperature()));
+    internalState.update(clock.getMillis());
+    bool heater = internalState.getHeater();
+    relay.set(heater);
+    result.events++;
+
+    unsigned long long delay = internalState.getUpdateDelay(clock.getMillis());
+
+    time_t tUtc = clock.getEpochTime();
+    time_t tLocal = clock.toLocal(tUtc, nullptr);
+    time_t boundary = userSettingsStore.read().getNextScheduleBoundary(tLocal);
+    unsigned long long delayBoundary = (boundary - tLocal) * 1000ull
+      - clock.getElapsedMillis() % 1000ull;
+    if (delayBoundary < delay) {
+      delay = delayBoundary;
+    }
+
+    /*
+     * On the device, `loop()` would also wake up every `POWER_SLEEP_MAX` ms; the power
+     * manager accounts for that without us having to simulate each wake-up.
+     */
+    powerManager.update(clock.getMillis(), static_cast<unsigned long>(delay));
+    unsigned long long delaySession = powerManager.getSessionDelay(clock.getMillis());
+    if (delaySession > 0ull && delaySession < delay) {
+      delay = delaySession;
+    }
+    if (nextRequestAt - clock.getElapsedMillis() < delay) {
+      delay = nextRequestAt - clock.getElapsedMillis();
+    }
+    if (end - clock.getElapsedMillis() < delay) {
+      delay = end - clock.getElapsedMillis();
+    }
+    if (delay == 0ull) {
+      delay = 1ull;
+    }
+
+    double dt = delay / 1000.0;
+    double tempOutdoor = model.getOutdoorTemperature(tUtc + static_cast<time_t>(dt / 2.0));
+    double tempMean = model.advance(dt, heater, tempOutdoor);
+    clock.advance(delay);
+
+    float tempTarget = userSettingsStore.read().getTargetTemperature(tLocal, calendarCursor);
+    if (internalState.getTempTarget() != TEMP_DISCONNECTED) {
+      double error = tempMean - tempTarget;
+      comfortSeconds += dt;
+      absErrorSum += fabs(error) * dt;
+      sqErrorSum += error * error * dt;
+      if (error < 0.0) {
+        result.comfortDegreeHoursBelow += -error * dt / 3600.0;
+      }
+    }
+    if (heater) {
+      heaterSeconds += dt;
+    }
+  }
+
+  if (comfortSeconds > 0.0) {
+    result.comfortMeanAbsError = absErrorSum / comfortSeconds;
+    result.comfortRmsError = sqrt(sqErrorSum / comfortSeconds);
+  }
+  result.heaterRuntimeHours = heaterSeconds / 3600.0;
+  result.relayCycles = relay.getSwitchCount() / 2;
+  result.energyKwh = result.heaterRuntimeHours * _config.thermal.heaterPower;
+  powerManager.update(clock.getMillis(), 0ul);
+  result.currentAverage = powerManager.getCurrentAverage();
+  if (result.requests > 0ul) {
+    result.wakeLatencyMean = wakeLatencySum / result.requests;
+  }
+  result.modelHeatingRate = internalState.getThermalModel().getHeatingRate();
+  result.modelTimeConstant = internalState.getThermalModel().getTimeConstant();
+  result.wallSeconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - wallStart
+  ).count();
+  result.ok = true;
+  return result;
+}
\ No newline at end of file
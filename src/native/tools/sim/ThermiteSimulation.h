@@ -0,0 +1,119 @@
+#ifndef _THERMITE_SIMULATION_H__
+#define _THERMITE_SIMULATION_H__
+
+#include <stdint.h>
+#include <string>
+#include <time.h>
+
+#include "ThermiteThermalModel.h"
+#include "ThermiteUserSettingsStore.h"
+
+/**
+ * Everything that defines one simulation run.
+ */
+struct ThermiteSimulationConfig {
+  ThermiteThermalParams thermal;
+
+  /**
+   * User settings, as they would be sent to `PUT /userSettings`.  Empty means the defaults
+   * from `ThermiteUserSettingsManager`.
+   */
+  std::string userSettingsJson;
+
+  /**
+   * Label for the user settings, used in reports.
+   */
+  std::string userSettingsName;
+
+  float tempHysteresis;
+  unsigned long tempRequestInterval;
+
+  /**
+   * Optimal-start margin, as given to `ThermiteInternalState::setPreheatMargin()`; zero for
+   * none.  Comfort is always measured against the schedule, not the preheated target.
+   */
+  float preheatMargin;
+
+  /**
+   * Start of the simulation (UTC), fixed UTC offset in minutes, and duration in days.
+   */
+  time_t start;
+  int offset;
+  unsigned long days;
+
+  /**
+   * Radio power mode and DTIM listen interval, as given to `ThermitePowerManager`.
+   */
+  uint8_t powerMode;
+  uint8_t listenInterval;
+
+  /**
+   * Mean rate of HTTP requests (Poisson arrivals, seeded by `seed`), used to measure the
+   * wake-up latency added by sleep modes.
+   */
+  double requestsPerHour;
+  unsigned long seed;
+
+  ThermiteSimulationConfig();
+};
+
+/**
+ * Summary of a simulation run.
+ */
+struct ThermiteSimulationResult {
+  bool ok;
+
+  /**
+   * Comfort error: time-weighted mean absolute and RMS difference between room temperature and
+   * target, and degree-hours spent below target.
+   */
+  double comfortMeanAbsError;
+  double comfortRmsError;
+  double comfortDegreeHoursBelow;
+
+  double heaterRuntimeHours;
+  unsigned long relayCycles;
+  double energyKwh;
+
+  /**
+   * Estimated mean supply current of the board, in mA, and the wake-up latency seen by
+   * HTTP requests, in ms.
+   */
+  double currentAverage;
+  unsigned long requests;
+  double wakeLatencyMean;
+  unsigned long wakeLatencyMax;
+
+  /**
+   * What `ThermiteThermalEstimator` learned by the end of the run, to compare against
+   * `ThermiteThermalParams` (whose heating rate is `heatRise / tauHours`).
+   */
+  double modelHeatingRate;
+  double modelTimeConstant;
+
+  unsigned long events;
+  double wallSeconds;
+
+  ThermiteSimulationResult();
+};
+
+/**
+ * Drives the real `ThermiteInternalState` and `ThermiteUserSettingsManager` against a
+ * `ThermiteThermalModel`.
+ * 
+ * Rather than ticking `loop()` every `LOOP_INTERVAL` ms, the simulation jumps from one
+ * controller event to the next: temperature requests and readings (as given by
+ * `ThermiteInternalState::getUpdateDelay()`) and schedule boundaries (as given by
+ * `ThermiteUserSettingsManager::getNextScheduleBoundary()`).  Nothing the controller can see
+ * changes in between, so this gives the same decisions at a tiny fraction of the cost.
+ */
+class ThermiteSimulation {
+private:
+  ThermiteSimulationConfig _config;
+public:
+  ThermiteSimulation(const ThermiteSimulationConfig& config);
+
+  ThermiteSimulationResult run() const;
+};
+
+#endif
\ No newline at end of file
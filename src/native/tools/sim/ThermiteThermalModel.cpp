@@ -0,0 +1,49 @@
+#include <math.h>
+
+#include "Constants.h"
+#include "ThermiteThermalModel.h"
+
+#define SECS_PER_YEAR (365.25 * static_cast<double>(SECONDS_PER_DAY))
+#define T_COLDEST_DAY 1610668800.0
+#define T_COLDEST_HOUR (5.0 * 3600.0)
+
+ThermiteThermalParams::ThermiteThermalParams()
+: tauHours(20.0),
+  heatRise(25.0),
+  heaterPower(5.0),
+  outdoorMean(8.0),
+  outdoorSeasonal(12.0),
+  outdoorDaily(4.0),
+  tempInitial(18.0) {}
+
+ThermiteThermalModel::ThermiteThermalModel(const ThermiteThermalParams& params)
+: _params(params),
+  _temp(params.tempInitial) {}
+
+double ThermiteThermalModel::getOutdoorTemperature(time_t tUtc) const {
+  double t = static_cast<double>(tUtc);
+  double day = static_cast<double>(SECONDS_PER_DAY);
+  double phaseSeasonal = 2.0 * M_PI * (t - T_COLDEST_DAY) / SECS_PER_YEAR;
+  double phaseDaily = 2.0 * M_PI * (fmod(t, day) - T_COLDEST_HOUR) / day;
+  return _params.outdoorMean
+    - _params.outdoorSeasonal * cos(phaseSeasonal)
+    - _params.outdoorDaily * cos(phaseDaily);
+}
+
+double ThermiteThermalModel::advance(double dt, bool heater, double tempOutdoor) {
+  double tempEquilibrium = tempOutdoor + (heater ? _params.heatRise : 0.0);
+  double tau = _params.tauHours * 3600.0;
+  double x = dt / tau;
+  double decay = exp(-x);
+  double delta = _temp - tempEquilibrium;
+
+  /*
+   * Mean of `tempEquilibrium + delta * exp(-s / tau)` over `s` in `[0, dt]`; for very short
+   * intervals, `(1 - exp(-x)) / x` tends to 1.
+   */
+  double meanFactor = x > 1e-9 ? (1.0 - decay) / x : 1.0;
+  double tempMean = tempEquilibrium + delta * meanFactor;
+
+  _temp = tempEquilibrium + delta * decay;
+  return tempMean;
+}
\ No newline at end of file
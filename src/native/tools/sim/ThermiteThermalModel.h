@@ -0,0 +1,66 @@
+#ifndef _THERMITE_THERMAL_MODEL_H__
+#define _THERMITE_THERMAL_MODEL_H__
+
+#include <time.h>
+
+/**
+ * Parameters for `ThermiteThermalModel`.
+ */
+struct ThermiteThermalParams {
+  /**
+   * RC time constant of the room, in hours: how quickly it approaches equilibrium.
+   */
+  double tauHours;
+
+  /**
+   * Equilibrium temperature rise above outdoor with the heater on, in degrees Celsius.
+   */
+  double heatRise;
+
+  /**
+   * Heater power draw while on, in kW.
+   */
+  double heaterPower;
+
+  /**
+   * Outdoor temperature: annual mean, plus seasonal and daily sinusoids of the given
+   * amplitudes (coldest at 2021-01-15 and at 05:00 UTC respectively).
+   */
+  double outdoorMean;
+  double outdoorSeasonal;
+  double outdoorDaily;
+
+  /**
+   * Room temperature at the start of the simulation.
+   */
+  double tempInitial;
+
+  ThermiteThermalParams();
+};
+
+/**
+ * First-order RC model of a single heated room:
+ * 
+ *   dT/dt = (T_out + heater * heatRise - T) / tau
+ * 
+ * Between controller events the heater and outdoor temperature are held constant, so `advance()`
+ * can use the closed-form solution and skip straight to the next event.
+ */
+class ThermiteThermalModel {
+private:
+  ThermiteThermalParams _params;
+  double _temp;
+public:
+  ThermiteThermalModel(const ThermiteThermalParams& params);
+
+  double getTemperature() const { return _temp; }
+  double getOutdoorTemperature(time_t tUtc) const;
+
+  /**
+   * Advances the model by `dt` seconds with the given heater state and outdoor temperature,
+   * and returns the mean room temperature over that interval.
+   */
+  double advance(double dt, bool heater, double tempOutdoor);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ThermiteSimulation.h"
+
+/**
+ * Year-long thermal simulation of `thermite`, with parameter sweeps.
+ * 
+ * Every combination of the comma-separated `--hysteresis`, `--interval`, `--schedule` and
+ * `--power-mode` values is simulated, in parallel across all host cores; each result is printed as one
+ * line of JSON.  For example:
+ * 
+ *   pio run -e sim -t exec -a "--hysteresis 0.25,0.5,1 --interval 30000,60000"
+ */
+
+void printUsage(const char* argv0) {
+  fprintf(
+    stderr,
+    "usage: %s [options]\n"
+    "  --days N                 simulated duration (default 365)\n"
+    "  --start T                start time, UTC seconds (default 2021-01-01T00:00:00-05:00)\n"
+    "  --offset M               fixed UTC offset in minutes (default -300)\n"
+    "  --hysteresis H[,H...]    hysteresis values in degrees Celsius (default 1)\n"
+    "  --interval MS[,MS...]    temperature request intervals in ms (default 60000)\n"
+    "  --preheat M[,M...]       optimal-start margins, or 0 for none (default 0)\n"
+    "  --schedule F[,F...]      user settings JSON files, or \"default\" (default default)\n"
+    "  --power-mode M[,M...]    awake, modem or light (default awake)\n"
+    "  --listen-interval N      DTIM listen interval in sleep modes (default 3)\n"
+    "  --requests-per-hour R    mean HTTP request rate (default 4)\n"
+    "  --seed N                 request arrival seed (default 1)\n"
+    "  --tau HOURS              room time constant (default 20)\n"
+    "  --heat-rise C            equilibrium rise with heater on (default 25)\n"
+    "  --heater-kw KW           heater power (default 5)\n"
+    "  --outdoor-mean C         annual mean outdoor temperature (default 8)\n"
+    "  --outdoor-seasonal C     seasonal amplitude (default 12)\n"
+    "  --outdoor-daily C        daily amplitude (default 4)\n"
+    "  --threads N              worker threads (default: all cores)\n",
+    argv0
+  );
+}
+
+std::vector<std::string> splitList(const char* list) {
+  std::vector<std::string> values;
+  std::stringstream ss(list);
+  std::string value;
+  while (std::getline(ss, value, ',')) {
+    if (!value.empty()) {
+      values.push_back(value);
+    }
+  }
+  return values;
+}
+
+const char* POWER_MODE_NAMES[] = { "awake", "modem", "light" };
+
+bool parsePowerMode(const std::string& name, uint8_t& mode) {
+  for (uint8_t i = 0; i < 3; i++) {
+    if (name == POWER_MODE_NAMES[i]) {
+      mode = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool readFile(const std::string& path, std::string& contents) {
+  std::ifstream in(path.c_str());
+  if (!in) {
+    return false;
+  }
+  std::stringstream ss;
+  ss << in.rdbuf();
+  contents = ss.str();
+  return true;
+}
+
+void printResult(const ThermiteSimulationConfig& config, const ThermiteSimulationResult& result) {
+  printf(
+    "{\"schedule\":\"%s\",\"hysteresis\":%g,\"interval\":%lu,\"preheat\":%g,"
+    "\"days\":%lu,\"ok\":%s,"
+    "\"comfortMeanAbsError\":%.4f,\"comfortRmsError\":%.4f,\"comfortDegreeHoursBelow\":%.2f,"
+    "\"heaterRuntimeHours\":%.2f,\"relayCycles\":%lu,\"energyKwh\":%.2f,"
+    "\"powerMode\":\"%s\",\"currentAverage\":%.3f,\"requests\":%lu,"
+    "\"wakeLatencyMean\":%.1f,\"wakeLatencyMax\":%lu,"
+    "\"modelHeatingRate\":%.2f,\"modelTimeConstant\":%.1f,"
+    "\"events\":%lu,\"wallSeconds\":%.4f}\n",
+    config.userSettingsName.c_str(),
+    config.tempHysteresis,
+    config.tempRequestInterval,
+    config.preheatMargin,
+    config.days,
+    result.ok ? "true" : "false",
+    result.comfortMeanAbsError,
+    result.comfortRmsError,
+    result.comfortDegreeHoursBelow,
+    result.heaterRuntimeHours,
+    result.relayCycles,
+    result.energyKwh,
+    POWER_MODE_NAMES[config.powerMode],
+    result.currentAverage,
+    result.requests,
+    result.wakeLatencyMean,
+    result.wakeLatencyMax,
+    result.modelHeatingRate,
+    result.modelTimeConstant,
+    result.events,
+    result.wallSeconds
+  );
+}
+
+int main(int argc, char** argv) {
+  ThermiteSimulationConfig base;
+  std::vector<std::string> hysteresisValues = { "1" };
+  std::vector<std::string> intervalValues = { "60000" };
+  std::vector<std::string> preheatValues = { "0" };
+  std::vector<std::string> scheduleValues = { "default" };
+  std::vector<std::string> powerModeValues = { "awake" };
+  unsigned threads = std::thread::hardware_concurrency();
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    const char* value = argv[++i];
+    if (strcmp(arg, "--days") == 0) {
+      base.days = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--start") == 0) {
+      base.start = strtol(value, nullptr, 10);
+    } else if (strcmp(arg, "--offset") == 0) {
+      base.offset = atoi(value);
+    } else if (strcmp(arg, "--hysteresis") == 0) {
+      hysteresisValues = splitList(value);
+    } else if (strcmp(arg, "--interval") == 0) {
+      intervalValues = splitList(value);
+    } else if (strcmp(arg, "--preheat") == 0) {
+      preheatValues = splitList(value);
+    } else if (strcmp(arg, "--schedule") == 0) {
+      scheduleValues = splitList(value);
+    } else if (strcmp(arg, "--power-mode") == 0) {
+      powerModeValues = splitList(value);
+    } else if (strcmp(arg, "--listen-interval") == 0) {
+      base.listenInterval = static_cast<uint8_t>(atoi(value));
+    } else if (strcmp(arg, "--requests-per-hour") == 0) {
+      base.requestsPerHour = atof(value);
+    } else if (strcmp(arg, "--seed") == 0) {
+      base.seed = strtoul(value, nullptr, 10);
+    } else if (strcmp(arg, "--tau") == 0) {
+      base.thermal.tauHours = atof(value);
+    } else if (strcmp(arg, "--heat-rise") == 0) {
+      base.thermal.heatRise = atof(value);
+    } else if (strcmp(arg, "--heater-kw") == 0) {
+      base.thermal.heaterPower = atof(value);
+    } else if (strcmp(arg, "--outdoor-mean") == 0) {
+      base.thermal.outdoorMean = atof(value);
+    } else if (strcmp(arg, "--outdoor-seasonal") == 0) {
+      base.thermal.outdoorSeasonal = atof(value);
+    } else if (strcmp(arg, "--outdoor-daily") == 0) {
+      base.thermal.outdoorDaily = atof(value);
+    } else if (strcmp(arg, "--threads") == 0) {
+      threads = strtoul(value, nullptr, 10);
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<ThermiteSimulationConfig> configs;
+  for (const std::string& schedule : scheduleValues) {
+    ThermiteSimulationConfig config = base;
+    config.userSettingsName = schedule;
+    if (schedule != "default" && !readFile(schedule, config.userSettingsJson)) {
+      fprintf(stderr, "Could not read user settings from %s\n", schedule.c_str());
+      return 1;
+    }
+    for (const std::string& hysteresis : hysteresisValues) {
+      config.tempHysteresis = static_cast<float>(atof(hysteresis.c_str()));
+      for (const std::string& interval : intervalValues) {
+        config.tempRequestInterval = strtoul(interval.c_str(), nullptr, 10);
+        for (const std::string& preheat : preheatValues) {
+          config.preheatMargin = static_cast<float>(atof(preheat.c_str()));
+          for (const std::string& powerMode : powerModeValues) {
+            if (!parsePowerMode(powerMode, config.powerMode)) {
+              fprintf(stderr, "Unknown power mode %s\n", powerMode.c_str());
+              return 1;
+            }
+            configs.push_back(config);
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<ThermiteSimulationResult> results(configs.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  threads = std::max(1u, std::min<unsigned>(threads, configs.size()));
+  for (unsigned i = 0; i < threads; i++) {
+    workers.emplace_back([&configs, &results, &next]() {
+      size_t j;
+      while ((j = next.fetch_add(1)) < configs.size()) {
+        results[j] = ThermiteSimulation(configs[j]).run();
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  int status = 0;
+  for (size_t j = 0; j < configs.size(); j++) {
+    printResult(configs[j], results[j]);
+    if (!results[j].ok) {
+      status = 1;
+    }
+  }
+  return status;
+}
\ No newline at end of file
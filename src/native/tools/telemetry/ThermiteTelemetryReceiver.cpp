@@ -0,0 +1,324 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ThermiteTelemetryReceiver.h"
+
+/**
+ * Datagrams per `recvmmsg()`, and bytes kept of each: anything longer than a packet is
+ * truncated, and counted as invalid.
+ */
+#define TELEMETRY_BATCH_SIZE 64
+#define TELEMETRY_DATAGRAM_SIZE 64
+
+static_assert(
+  __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+  "ThermiteTelemetryPacket is little-endian, and read in place"
+);
+
+namespace {
+
+uint64_t monotonicMillis() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000ull + ts.tv_nsec / 1000000ull;
+}
+
+uint64_t wallMillis() {
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000ull + ts.tv_nsec / 1000000ull;
+}
+
+}
+
+ThermiteTelemetryReceiverConfig::ThermiteTelemetryReceiverConfig()
+: bind("0.0.0.0"),
+  port(TELEMETRY_PORT),
+  receiveBuffer(4 << 20) {}
+
+ThermiteTelemetryReceiverStats::ThermiteTelemetryReceiverStats()
+: datagrams(0ul),
+  bytes(0ul),
+  invalid(0ul),
+  lost(0ul),
+  late(0ul),
+  duplicates(0ul),
+  restarts(0ul),
+  batches(0ul),
+  elapsed(0ull) {}
+
+ThermiteTelemetryReceiver::ThermiteTelemetryReceiver(
+  const ThermiteTelemetryReceiverConfig& config,
+  FILE* out
+) : _config(config),
+    _out(out),
+    _fd(-1) {}
+
+ThermiteTelemetryReceiver::~ThermiteTelemetryReceiver() {
+  if (_fd >= 0) {
+    close(_fd);
+  }
+}
+
+bool ThermiteTelemetryReceiver::begin(std::string& error) {
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_config.port);
+  if (inet_pton(AF_INET, _config.bind.c_str(), &addr.sin_addr) != 1) {
+    error = "Invalid address " + _config.bind;
+    return false;
+  }
+  ip_mreq membership;
+  memset(&membership, 0, sizeof(membership));
+  if (!_config.group.empty()) {
+    if (inet_pton(AF_INET, _config.group.c_str(), &membership.imr_multiaddr) != 1
+      || (ntohl(membership.imr_multiaddr.s_addr) & 0xf0000000ul) != 0xe0000000ul) {
+      error = "Invalid multicast group " + _config.group;
+      return false;
+    }
+    membership.imr_interface.s_addr = htonl(INADDR_ANY);
+  }
+
+  _fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (_fd < 0) {
+    error = std::string("socket: ") + strerror(errno);
+    return false;
+  }
+  int one = 1;
+  setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  setsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &_config.receiveBuffer, sizeof(_config.receiveBuffer));
+  if (::bind(_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    error = std::string("bind: ") + strerror(errno);
+    return false;
+  }
+  if (!_config.group.empty()) {
+    if (setsockopt(_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+      error = std::string("IP_ADD_MEMBERSHIP: ") + strerror(errno);
+      return false;
+    }
+  }
+  return true;
+}
+
+void ThermiteTelemetryReceiver::_onDatagram(
+  const uint8_t* data,
+  size_t size,
+  bool truncated,
+  uint64_t nowWall
+) {
+  _stats.datagrams++;
+  _stats.bytes += size;
+  ThermiteTelemetryPacket packet;
+  if (truncated || size != sizeof(packet)) {
+    _stats.invalid++;
+    return;
+  }
+  memcpy(&packet, data, sizeof(packet));
+  if (packet.magic != TELEMETRY_PACKET_MAGIC || packet.version != TELEMETRY_PACKET_VERSION) {
+    _stats.invalid++;
+    return;
+  }
+
+  uint64_t key = (static_cast<uint64_t>(packet.deviceId) << 8) | packet.zone;
+  std::unordered_map<uint64_t, uint32_t>::iterator it = _streamIndex.find(key);
+  if (it == _streamIndex.end()) {
+    ThermiteTelemetryStream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.deviceId = packet.deviceId;
+    stream.zone = packet.zone;
+    stream.sequence = packet.sequence;
+    stream.window = 1ull;
+    stream.received = 1ul;
+    _streamIndex[key] = static_cast<uint32_t>(_streams.size());
+    _streams.push_back(stream);
+  } else {
+    _track(_streams[it->second], packet.sequence);
+  }
+  _writePacket(packet, nowWall);
+}
+
+void ThermiteTelemetryReceiver::_track(ThermiteTelemetryStream& stream, uint32_t sequence) {
+  if (sequence > stream.sequence) {
+    uint32_t gap = sequence - stream.sequence;
+    stream.lost += gap - 1ul;
+    _stats.lost += gap - 1ul;
+    stream.window = gap >= 64ul ? 1ull : (stream.window << gap) | 1ull;
+    stream.sequence = sequence;
+    stream.received++;
+    return;
+  }
+
+  uint32_t back = stream.sequence - sequence;
+  if (sequence == 0ul || back >= 64ul) {
+    stream.restarts++;
+    _stats.restarts++;
+    stream.sequence = sequence;
+    stream.window = 1ull;
+    stream.received++;
+    return;
+  }
+  uint64_t bit = 1ull << back;
+  if ((stream.window & bit) != 0ull) {
+    stream.duplicates++;
+    _stats.duplicates++;
+    return;
+  }
+  // counted as lost when the gap opened, but arrived after all
+  stream.window |= bit;
+  stream.late++;
+  _stats.late++;
+  if (stream.lost > 0ul) {
+    stream.lost--;
+    _stats.lost--;
+  }
+  stream.received++;
+}
+
+void ThermiteTelemetryReceiver::_writePacket(
+  const ThermiteTelemetryPacket& packet,
+  uint64_t nowWall
+) {
+  if (_out == nullptr) {
+    return;
+  }
+  fprintf(
+    _out,
+    "{\"device\":\"%08x\",\"zone\":%u,\"sequence\":%u,\"unixDate\":%llu,\"epoch\":%u,"
+    "\"temp\":%.2f,\"tempTarget\":%.2f,\"heater\":%s,\"heartbeat\":%s,"
+    "\"freeHeap\":%u,\"rssi\":%d}\n",
+    packet.deviceId,
+    packet.zone,
+    packet.sequence,
+    static_cast<unsigned long long>(nowWall / 1000ull),
+    packet.epoch,
+    packet.temp / 100.0,
+    packet.tempTarget / 100.0,
+    (packet.flags & TELEMETRY_FLAG_HEATER) != 0 ? "true" : "false",
+    (packet.flags & TELEMETRY_FLAG_HEARTBEAT) != 0 ? "true" : "false",
+    packet.freeHeap,
+    packet.rssi
+  );
+}
+
+bool ThermiteTelemetryReceiver::run(
+  volatile sig_atomic_t& stop,
+  FILE* stats,
+  unsigned long statsInterval
+) {
+  static uint8_t buffers[TELEMETRY_BATCH_SIZE][TELEMETRY_DATAGRAM_SIZE];
+  iovec iovecs[TELEMETRY_BATCH_SIZE];
+  mmsghdr messages[TELEMETRY_BATCH_SIZE];
+  memset(messages, 0, sizeof(messages));
+  for (int i = 0; i < TELEMETRY_BATCH_SIZE; i++) {
+    iovecs[i].iov_base = buffers[i];
+    iovecs[i].iov_len = TELEMETRY_DATAGRAM_SIZE;
+    messages[i].msg_hdr.msg_iov = &iovecs[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  uint64_t start = monotonicMillis();
+  uint64_t statsAt = start + statsInterval;
+  uint64_t flushAt = start + 1000ull;
+  unsigned long statsDatagrams = 0ul;
+  uint64_t statsFrom = start;
+  pollfd pfd;
+  pfd.fd = _fd;
+  pfd.events = POLLIN;
+  while (!stop) {
+    int ready = poll(&pfd, 1, 200);
+    if (ready < 0 && errno != EINTR) {
+      return false;
+    }
+
+    /*
+     * Drain the socket before polling again: under load, each `poll()` wakeup is followed by
+     * full batches.
+     */
+    while (ready > 0) {
+      int n = recvmmsg(_fd, messages, TELEMETRY_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+      if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+          break;
+        }
+        return false;
+      }
+      _stats.batches++;
+      uint64_t nowWall = wallMillis();
+      for (int i = 0; i < n; i++) {
+        _onDatagram(
+          buffers[i],
+          messages[i].msg_len,
+          (messages[i].msg_hdr.msg_flags & MSG_TRUNC) != 0,
+          nowWall
+        );
+        messages[i].msg_hdr.msg_flags = 0;
+      }
+      if (n < TELEMETRY_BATCH_SIZE) {
+        break;
+      }
+    }
+
+    uint64_t now = monotonicMillis();
+    _stats.elapsed = now - start;
+    if (_out != nullptr && now >= flushAt) {
+      fflush(_out);
+      flushAt = now + 1000ull;
+    }
+    if (statsInterval > 0ul && now >= statsAt) {
+      writeStats(stats, (_stats.datagrams - statsDatagrams) * 1000.0 / (now - statsFrom));
+      statsDatagrams = _stats.datagrams;
+      statsFrom = now;
+      statsAt = now + statsInterval;
+    }
+  }
+  if (_out != nullptr) {
+    fflush(_out);
+  }
+  return true;
+}
+
+void ThermiteTelemetryReceiver::writeStats(FILE* out, double rate) const {
+  const ThermiteTelemetryReceiverStats& s = _stats;
+  fprintf(
+    out,
+    "{\"streams\":%zu,\"datagrams\":%lu,\"rate\":%.1f,\"bytes\":%lu,\"invalid\":%lu,"
+    "\"lost\":%lu,\"late\":%lu,\"duplicates\":%lu,\"restarts\":%lu,\"batchMean\":%.1f}\n",
+    _streams.size(),
+    s.datagrams,
+    rate,
+    s.bytes,
+    s.invalid,
+    s.lost,
+    s.late,
+    s.duplicates,
+    s.restarts,
+    s.batches == 0ul ? 0.0 : static_cast<double>(s.datagrams) / s.batches
+  );
+  fflush(out);
+}
+
+void ThermiteTelemetryReceiver::writeStreams(FILE* out) const {
+  for (const ThermiteTelemetryStream& stream : _streams) {
+    fprintf(
+      out,
+      "{\"device\":\"%08x\",\"zone\":%u,\"sequence\":%u,\"received\":%lu,\"lost\":%lu,"
+      "\"late\":%lu,\"duplicates\":%lu,\"restarts\":%lu}\n",
+      stream.deviceId,
+      stream.zone,
+      stream.sequence,
+      stream.received,
+      stream.lost,
+      stream.late,
+      stream.duplicates,
+      stream.restarts
+    );
+  }
+  fflush(out);
+}
\ No newline at end of file
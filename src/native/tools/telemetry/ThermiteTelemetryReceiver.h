@@ -0,0 +1,131 @@
+#ifndef _THERMITE_TELEMETRY_RECEIVER_H__
+#define _THERMITE_TELEMETRY_RECEIVER_H__
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ThermiteTelemetry.h"
+
+/**
+ * Where to listen.  `group`, if not empty, is a multicast group to join on every interface.
+ */
+struct ThermiteTelemetryReceiverConfig {
+  std::string bind;
+  std::string group;
+  uint16_t port;
+
+  /**
+   * Requested socket receive buffer, in bytes; the kernel may cap it (see
+   * `net.core.rmem_max`).
+   */
+  int receiveBuffer;
+
+  ThermiteTelemetryReceiverConfig();
+};
+
+/**
+ * Packets from one zone of one device, tracked by sequence number.
+ * 
+ * `window` has bit `i` set if `sequence - i` has been received, so that a packet arriving up
+ * to 63 places late can be told apart from a duplicate, and taken back out of `lost`.
+ */
+struct ThermiteTelemetryStream {
+  uint32_t deviceId;
+  uint8_t zone;
+  uint32_t sequence;
+  uint64_t window;
+  unsigned long received;
+  unsigned long lost;
+  unsigned long late;
+  unsigned long duplicates;
+
+  /**
+   * Times the sequence went back to zero, or further back than `window` reaches: the device
+   * rebooted.
+   */
+  unsigned long restarts;
+};
+
+/**
+ * Counters over every stream, since the start of `run()`.
+ */
+struct ThermiteTelemetryReceiverStats {
+  unsigned long datagrams;
+  unsigned long bytes;
+
+  /**
+   * Datagrams that were not a `ThermiteTelemetryPacket` of `TELEMETRY_PACKET_VERSION`.
+   */
+  unsigned long invalid;
+  unsigned long lost;
+  unsigned long late;
+  unsigned long duplicates;
+  unsigned long restarts;
+
+  /**
+   * `recvmmsg()` calls, so that `datagrams / batches` shows how well reads are batched.
+   */
+  unsigned long batches;
+
+  /**
+   * Time spent in `run()`, in ms.
+   */
+  uint64_t elapsed;
+
+  ThermiteTelemetryReceiverStats();
+};
+
+/**
+ * Receives `ThermiteTelemetryPacket`s from any number of devices on one UDP socket, counts
+ * lost, late and duplicate packets per stream, and writes each packet as a line of JSON.
+ * 
+ * Datagrams are read `recvmmsg()` batches at a time, and streams are found by hashing
+ * device ID and zone, so each packet costs O(1) and one system call serves many of them.
+ */
+class ThermiteTelemetryReceiver {
+private:
+  ThermiteTelemetryReceiverConfig _config;
+  FILE* _out;
+  int _fd;
+  std::unordered_map<uint64_t, uint32_t> _streamIndex;
+  std::vector<ThermiteTelemetryStream> _streams;
+  ThermiteTelemetryReceiverStats _stats;
+
+  void _onDatagram(const uint8_t* data, size_t size, bool truncated, uint64_t nowWall);
+  void _track(ThermiteTelemetryStream& stream, uint32_t sequence);
+  void _writePacket(const ThermiteTelemetryPacket& packet, uint64_t nowWall);
+public:
+  ThermiteTelemetryReceiver(const ThermiteTelemetryReceiverConfig& config, FILE* out);
+  ~ThermiteTelemetryReceiver();
+
+  /**
+   * Opens and binds the socket, and joins `group` if given.  Returns `false`, with a message
+   * in `error`, if any of that fails.
+   */
+  bool begin(std::string& error);
+  const ThermiteTelemetryReceiverStats& getStats() const { return _stats; }
+  const std::vector<ThermiteTelemetryStream>& getStreams() const { return _streams; }
+
+  /**
+   * Runs until `stop` is set, printing `getStats()` to `stats` every `statsInterval` ms
+   * (if non-zero).  Returns `false` if the socket fails.
+   */
+  bool run(volatile sig_atomic_t& stop, FILE* stats, unsigned long statsInterval);
+
+  /**
+   * Prints `getStats()` to `out` as one line of JSON, including `rate`, in datagrams per
+   * second.
+   */
+  void writeStats(FILE* out, double rate) const;
+
+  /**
+   * Prints one line of JSON per stream to `out`.
+   */
+  void writeStreams(FILE* out) const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "ThermiteTelemetryReceiver.h"
+
+/**
+ * Telemetry receiver: listens for `ThermiteTelemetryPacket`s from any number of devices (see
+ * `ThermiteTelemetry`), and appends one line of JSON per packet to `--output`.  For example,
+ * against a thousand emulated devices on loopback:
+ * 
+ *   pio run -e emulator -t exec -a "--count 1000 --speed 600 --telemetry 127.0.0.1:4210"
+ *   pio run -e telemetry -t exec -a "--no-packets --stats 1000"
+ * 
+ * Runs until interrupted, then prints each stream's counters to standard error.
+ */
+
+volatile sig_atomic_t stopRequested = 0;
+
+void onSignal(int) {
+  stopRequested = 1;
+}
+
+void printUsage(const char* argv0) {
+  fprintf(
+    stderr,
+    "usage: %s [options]\n"
+    "  --port P                 UDP port to listen on (default %d)\n"
+    "  --bind ADDR              local IPv4 address to listen on (default 0.0.0.0)\n"
+    "  --group ADDR             multicast group to join\n"
+    "  --receive-buffer BYTES   socket receive buffer (default 4194304)\n"
+    "  --output FILE            append packets to FILE (default: standard output)\n"
+    "  --no-packets             only count packets, don't write them\n"
+    "  --stats MS               print counters to standard error every MS (default 60000,\n"
+    "                           0 to disable)\n",
+    argv0,
+    TELEMETRY_PORT
+  );
+}
+
+int main(int argc, char** argv) {
+  ThermiteTelemetryReceiverConfig config;
+  const char* output = nullptr;
+  bool packets = true;
+  unsigned long statsInterval = 60000ul;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strcmp(arg, "--no-packets") == 0) {
+      packets = false;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    const char* value = argv[++i];
+    if (strcmp(arg, "--port") == 0) {
+      config.port = static_cast<uint16_t>(strtoul(value, nullptr, 10));
+    } else if (strcmp(arg, "--bind") == 0) {
+      config.bind = value;
+    } else if (strcmp(arg, "--group") == 0) {
+      config.group = value;
+    } else if (strcmp(arg, "--receive-buffer") == 0) {
+      config.receiveBuffer = atoi(value);
+    } else if (strcmp(arg, "--output") == 0) {
+      output = value;
+    } else if (strcmp(arg, "--stats") == 0) {
+      statsInterval = strtoul(value, nullptr, 10);
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (config.port == 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  FILE* out = nullptr;
+  if (packets) {
+    out = stdout;
+    if (output != nullptr) {
+      out = fopen(output, "a");
+      if (out == nullptr) {
+        fprintf(stderr, "Could not open %s\n", output);
+        return 1;
+      }
+    }
+    setvbuf(out, nullptr, _IOFBF, 1 << 16);
+  }
+
+  ThermiteTelemetryReceiver receiver(config, out);
+  std::string error;
+  if (!receiver.begin(error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  fprintf(stderr, "Listening on %s:%u\n", config.bind.c_str(), config.port);
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  bool ok = receiver.run(stopRequested, stderr, statsInterval);
+  receiver.writeStreams(stderr);
+  const ThermiteTelemetryReceiverStats& stats = receiver.getStats();
+  receiver.writeStats(
+    stderr,
+    stats.elapsed == 0ull ? 0.0 : stats.datagrams * 1000.0 / stats.elapsed
+  );
+  if (out != nullptr && out != stdout) {
+    fclose(out);
+  }
+  return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -1,9 +1,12 @@
 #ifdef UNIT_TEST
 
+#ifdef ARDUINO
 #include <Arduino.h>
+#endif
 #include <unity.h>
 
 #include "Constants.h"
+#include "ThermiteCalendar.cpp"
 #include "ThermiteUserSettingsManager.cpp"
 
 void testSetPointEmpty() {
@@ -322,6 +325,49 @@ void testDailyScheduleToJson() {
   }
 }
 
+void testHeaterSettingsValid() {
+  ThermiteHeaterSettings heaterSettings(60, 60, 6);
+
+  StaticJsonDocument<CAPACITY_HEATER_SETTINGS> doc;
+  JsonObject root = doc.to<JsonObject>();
+  root["minOnTime"] = 300;
+  root["minOffTime"] = 600;
+  root["maxCyclesPerHour"] = 0;
+  TEST_ASSERT_TRUE(heaterSettings.validateJSON(root));
+
+  heaterSettings.updateFromJSON(root);
+  TEST_ASSERT_EQUAL(heaterSettings._minOnTime, 300);
+  TEST_ASSERT_EQUAL(heaterSettings._minOffTime, 600);
+  TEST_ASSERT_EQUAL(heaterSettings._maxCyclesPerHour, 0);
+}
+
+void testHeaterSettingsMinTimeTooHigh() {
+  ThermiteHeaterSettings heaterSettings(60, 60, 6);
+
+  StaticJsonDocument<CAPACITY_HEATER_SETTINGS> doc;
+  JsonObject root = doc.to<JsonObject>();
+  root["minOffTime"] = 3601;
+  TEST_ASSERT_FALSE(heaterSettings.validateJSON(root));
+}
+
+void testHeaterSettingsMinTimeNegative() {
+  ThermiteHeaterSettings heaterSettings(60, 60, 6);
+
+  StaticJsonDocument<CAPACITY_HEATER_SETTINGS> doc;
+  JsonObject root = doc.to<JsonObject>();
+  root["minOnTime"] = -1;
+  TEST_ASSERT_FALSE(heaterSettings.validateJSON(root));
+}
+
+void testHeaterSettingsMaxCyclesTooHigh() {
+  ThermiteHeaterSettings heaterSettings(60, 60, 6);
+
+  StaticJsonDocument<CAPACITY_HEATER_SETTINGS> doc;
+  JsonObject root = doc.to<JsonObject>();
+  root["maxCyclesPerHour"] = HEATER_MAX_CYCLES_PER_HOUR + 1;
+  TEST_ASSERT_FALSE(heaterSettings.validateJSON(root));
+}
+
 void testUserSettingsManagerEmpty() {
   ThermiteUserSettingsManager userSettingsManager;
 
@@ -613,6 +659,32 @@ void testUserSettingsManagerOverrideStartAfterEnd() {
   TEST_ASSERT_FALSE(userSettingsManager.validateJSON(root));
 }
 
+void testUserSettingsManagerHeaterValid() {
+  ThermiteUserSettingsManager userSettingsManager;
+  TEST_ASSERT_EQUAL(userSettingsManager._heaterSettings._minOnTime, 0);
+  TEST_ASSERT_EQUAL(userSettingsManager._heaterSettings._minOffTime, 0);
+  TEST_ASSERT_EQUAL(userSettingsManager._heaterSettings._maxCyclesPerHour, 0);
+
+  StaticJsonDocument<CAPACITY_USER_SETTINGS_MANAGER> doc;
+  JsonObject root = doc.to<JsonObject>();
+  JsonObject heaterSettings = root.createNestedObject("heater");
+  heaterSettings["minOnTime"] = 120;
+  TEST_ASSERT_TRUE(userSettingsManager.validateJSON(root));
+
+  userSettingsManager.updateFromJSON(root);
+  TEST_ASSERT_EQUAL(userSettingsManager._heaterSettings._minOnTime, 120);
+  TEST_ASSERT_EQUAL(userSettingsManager._heaterSettings._minOffTime, 0);
+}
+
+void testUserSettingsManagerHeaterNotObject() {
+  ThermiteUserSettingsManager userSettingsManager;
+
+  StaticJsonDocument<CAPACITY_USER_SETTINGS_MANAGER> doc;
+  JsonObject root = doc.to<JsonObject>();
+  root["heater"] = 120;
+  TEST_ASSERT_FALSE(userSettingsManager.validateJSON(root));
+}
+
 void testUserSettingsManagerToJson() {
   ThermiteUserSettingsManager userSettingsManager;
   
@@ -647,13 +719,247 @@ void testUserSettingsManagerToJson() {
   TEST_ASSERT_EQUAL(userSettingsManager._tempOverride, root["tempOverride"]);
   TEST_ASSERT_EQUAL(userSettingsManager._overrideStart, root["overrideStart"]);
   TEST_ASSERT_EQUAL(userSettingsManager._overrideEnd, root["overrideEnd"]);
+  TEST_ASSERT_EQUAL(userSettingsManager._heaterSettings._minOnTime, root["heater"]["minOnTime"]);
+  TEST_ASSERT_EQUAL(userSettingsManager._heaterSettings._minOffTime, root["heater"]["minOffTime"]);
+  TEST_ASSERT_EQUAL(
+    userSettingsManager._heaterSettings._maxCyclesPerHour,
+    root["heater"]["maxCyclesPerHour"]
+  );
 }
 
-void setup() {
-  // NOTE!!! Wait for >2 secs
-  // if board doesn't support software reset via Serial.DTR/RTS
-  delay(2000);
+void testUserSettingsManagerNextScheduleBoundary() {
+  ThermiteUserSettingsManager userSettingsManager;
+
+  TEST_ASSERT_EQUAL(1612242000l + 1800l, userSettingsManager.getNextScheduleBoundary(1612242000l));
+  TEST_ASSERT_EQUAL(1612242000l + 1800l, userSettingsManager.getNextScheduleBoundary(1612242001l));
 
+  userSettingsManager._overrideStart = 1612242600l;
+  userSettingsManager._overrideEnd = 1612243200l;
+  TEST_ASSERT_EQUAL(1612242600l, userSettingsManager.getNextScheduleBoundary(1612242000l));
+  TEST_ASSERT_EQUAL(1612243200l, userSettingsManager.getNextScheduleBoundary(1612242600l));
+  TEST_ASSERT_EQUAL(1612242000l + 1800l, userSettingsManager.getNextScheduleBoundary(1612243200l));
+}
+
+void testUserSettingsManagerVersion() {
+  ThermiteUserSettingsManager userSettingsManager;
+  uint32_t version = userSettingsManager.getVersion();
+
+  StaticJsonDocument<CAPACITY_USER_SETTINGS_MANAGER> doc;
+  JsonObject root = doc.to<JsonObject>();
+  JsonObject heaterSettings = root.createNestedObject("heater");
+  heaterSettings["minOnTime"] = 0;
+  userSettingsManager.updateFromJSON(root);
+  TEST_ASSERT_EQUAL(version, userSettingsManager.getVersion());
+
+  heaterSettings["minOnTime"] = 120;
+  userSettingsManager.updateFromJSON(root);
+  TEST_ASSERT_EQUAL(version + 1, userSettingsManager.getVersion());
+}
+
+/*
+ * 2021-02-02T00:00:00, a Tuesday, in local time.
+ */
+#define T_CALENDAR 1612224000l
+
+void testCalendarValid() {
+  ThermiteCalendar calendar;
+
+  DynamicJsonDocument doc(CAPACITY_CALENDAR);
+  deserializeJson(
+    doc,
+    "{\"calendar\":["
+      "{\"start\":1612310400,\"end\":1612396800,\"dailySchedule\":2},"
+      "{\"start\":1612224000,\"end\":1612227600,\"tempTarget\":12.5}"
+    "]}"
+  );
+  JsonObject root = doc.as<JsonObject>();
+  TEST_ASSERT_TRUE(calendar.validateJSON(root));
+
+  calendar.updateFromJSON(root);
+  TEST_ASSERT_EQUAL(2, calendar._count);
+  TEST_ASSERT_EQUAL(1ul, calendar._version);
+  TEST_ASSERT_EQUAL(T_CALENDAR / 1800l, calendar._exceptions[0].start);
+  TEST_ASSERT_EQUAL(2, calendar._exceptions[0].length);
+  TEST_ASSERT_EQUAL(CALENDAR_EXCEPTION_TEMPERATURE, calendar._exceptions[0].kind);
+  TEST_ASSERT_EQUAL(50, calendar._exceptions[0].value);
+  TEST_ASSERT_EQUAL((T_CALENDAR + 86400l) / 1800l, calendar._exceptions[1].start);
+  TEST_ASSERT_EQUAL(48, calendar._exceptions[1].length);
+  TEST_ASSERT_EQUAL(CALENDAR_EXCEPTION_SCHEDULE, calendar._exceptions[1].kind);
+  TEST_ASSERT_EQUAL(2, calendar._exceptions[1].value);
+
+  // the same exceptions again change nothing
+  calendar.updateFromJSON(root);
+  TEST_ASSERT_EQUAL(1ul, calendar._version);
+
+  DynamicJsonDocument docOut(CAPACITY_CALENDAR);
+  JsonObject rootOut = docOut.to<JsonObject>();
+  TEST_ASSERT_TRUE(calendar.toJSON(rootOut));
+  TEST_ASSERT_EQUAL(T_CALENDAR, rootOut["calendar"][0]["start"].as<time_t>());
+  TEST_ASSERT_EQUAL(T_CALENDAR + 3600l, rootOut["calendar"][0]["end"].as<time_t>());
+  TEST_ASSERT_EQUAL(12.5f, rootOut["calendar"][0]["tempTarget"].as<float>());
+  TEST_ASSERT_EQUAL(2, rootOut["calendar"][1]["dailySchedule"].as<int>());
+}
+
+void testCalendarInvalid() {
+  ThermiteCalendar calendar;
+
+  const char* invalid[] = {
+    // not an array
+    "{\"calendar\":{}}",
+    // overlapping
+    "{\"calendar\":["
+      "{\"start\":1612224000,\"end\":1612231200,\"tempTarget\":12},"
+      "{\"start\":1612227600,\"end\":1612234800,\"tempTarget\":12}"
+    "]}",
+    // not on a 30-minute boundary
+    "{\"calendar\":[{\"start\":1612224060,\"end\":1612227600,\"tempTarget\":12}]}",
+    // empty
+    "{\"calendar\":[{\"start\":1612224000,\"end\":1612224000,\"tempTarget\":12}]}",
+    // both kinds
+    "{\"calendar\":[{\"start\":1612224000,\"end\":1612227600,\"tempTarget\":12,\"dailySchedule\":1}]}",
+    // neither kind
+    "{\"calendar\":[{\"start\":1612224000,\"end\":1612227600}]}",
+    // temperature out of range
+    "{\"calendar\":[{\"start\":1612224000,\"end\":1612227600,\"tempTarget\":31}]}",
+    // temperature not a multiple of 0.25
+    "{\"calendar\":[{\"start\":1612224000,\"end\":1612227600,\"tempTarget\":17.1}]}",
+    // no such daily schedule
+    "{\"calendar\":[{\"start\":1612224000,\"end\":1612227600,\"dailySchedule\":4}]}",
+  };
+  for (const char* json : invalid) {
+    DynamicJsonDocument doc(CAPACITY_CALENDAR);
+    deserializeJson(doc, json);
+    TEST_ASSERT_FALSE(calendar.validateJSON(doc.as<JsonObject>()));
+  }
+
+  // back-to-back exceptions are fine
+  DynamicJsonDocument doc(CAPACITY_CALENDAR);
+  deserializeJson(
+    doc,
+    "{\"calendar\":["
+      "{\"start\":1612224000,\"end\":1612227600,\"tempTarget\":12},"
+      "{\"start\":1612227600,\"end\":1612231200,\"tempTarget\":17.25}"
+    "]}"
+  );
+  TEST_ASSERT_TRUE(calendar.validateJSON(doc.as<JsonObject>()));
+  calendar.updateFromJSON(doc.as<JsonObject>());
+  TEST_ASSERT_EQUAL(69, calendar._exceptions[1].value);
+}
+
+void testCalendarTooLong() {
+  ThermiteCalendar calendar;
+
+  DynamicJsonDocument doc(2 * CAPACITY_CALENDAR);
+  JsonObject root = doc.to<JsonObject>();
+  JsonArray exceptions = root.createNestedArray("calendar");
+  for (int i = 0; i <= CALENDAR_SIZE; i++) {
+    TEST_ASSERT_TRUE(calendar.validateJSON(root));
+    JsonObject exception = exceptions.createNestedObject();
+    exception["start"] = T_CALENDAR + i * 86400l;
+    exception["end"] = T_CALENDAR + i * 86400l + 1800l;
+    exception["tempTarget"] = 12;
+  }
+  TEST_ASSERT_FALSE(calendar.validateJSON(root));
+}
+
+void testCalendarSeek() {
+  ThermiteCalendar calendar;
+  for (int i = 0; i < CALENDAR_SIZE; i++) {
+    // one hour on each day, starting at 02:00
+    calendar._exceptions[i] = { static_cast<uint32_t>((T_CALENDAR + i * 86400l) / 1800l + 4), 2, 0, 48 };
+  }
+  calendar._count = CALENDAR_SIZE;
+  calendar._version = 1ul;
+
+  ThermiteCalendarCursor cursor;
+  TEST_ASSERT_EQUAL(0, calendar.seek(T_CALENDAR, cursor));
+  TEST_ASSERT_NULL(calendar.find(T_CALENDAR, cursor));
+  TEST_ASSERT_EQUAL_PTR(&calendar._exceptions[0], calendar.find(T_CALENDAR + 7200l, cursor));
+  TEST_ASSERT_EQUAL_PTR(&calendar._exceptions[0], calendar.find(T_CALENDAR + 10799l, cursor));
+  TEST_ASSERT_NULL(calendar.find(T_CALENDAR + 10800l, cursor));
+  TEST_ASSERT_EQUAL(1, cursor._index);
+
+  // stepping through time visits every exception in turn
+  for (time_t t = T_CALENDAR; t < T_CALENDAR + (CALENDAR_SIZE + 1) * 86400l; t += 1800l) {
+    ThermiteCalendarCursor fresh;
+    TEST_ASSERT_EQUAL(calendar.seek(t, fresh), calendar.seek(t, cursor));
+  }
+  TEST_ASSERT_EQUAL(CALENDAR_SIZE, cursor._index);
+
+  // jumps either way
+  TEST_ASSERT_EQUAL_PTR(&calendar._exceptions[3], calendar.find(T_CALENDAR + 3 * 86400l + 7200l, cursor));
+  TEST_ASSERT_EQUAL_PTR(&calendar._exceptions[9], calendar.find(T_CALENDAR + 9 * 86400l + 7200l, cursor));
+  TEST_ASSERT_EQUAL(0, calendar.seek(T_CALENDAR - 86400l, cursor));
+
+  // a changed calendar invalidates cursors
+  calendar._count = 2;
+  calendar._version++;
+  cursor._index = 9;
+  TEST_ASSERT_EQUAL(2, calendar.seek(T_CALENDAR + 9 * 86400l, cursor));
+}
+
+void testCalendarSaveRestore() {
+  ThermiteCalendar calendar;
+  calendar._exceptions[0] = { static_cast<uint32_t>(T_CALENDAR / 1800l), 48, 1, 2 };
+  calendar._count = 1;
+
+  ThermiteCalendarRecord record;
+  calendar.save(record);
+
+  ThermiteCalendar calendarRestored;
+  TEST_ASSERT_TRUE(calendarRestored.restore(record));
+  TEST_ASSERT_EQUAL(1, calendarRestored._count);
+  TEST_ASSERT_EQUAL(1ul, calendarRestored._version);
+  TEST_ASSERT_EQUAL_MEMORY(&calendar._exceptions[0], &calendarRestored._exceptions[0], 8);
+
+  record.exceptions[0].value = 3;
+  TEST_ASSERT_FALSE(calendarRestored.restore(record));
+  TEST_ASSERT_EQUAL(1ul, calendarRestored._version);
+}
+
+void testUserSettingsManagerCalendar() {
+  ThermiteUserSettingsManager userSettingsManager;
+  uint32_t version = userSettingsManager.getVersion();
+
+  DynamicJsonDocument doc(CAPACITY_USER_SETTINGS_UPDATE);
+  deserializeJson(
+    doc,
+    "{\"calendar\":["
+      "{\"start\":1612224000,\"end\":1612231200,\"tempTarget\":12.5},"
+      "{\"start\":1612310400,\"end\":1612396800,\"dailySchedule\":2}"
+    "]}"
+  );
+  JsonObject root = doc.as<JsonObject>();
+  TEST_ASSERT_TRUE(userSettingsManager.validateJSON(root));
+  userSettingsManager.updateFromJSON(root);
+  TEST_ASSERT_EQUAL(version + 1, userSettingsManager.getVersion());
+
+  // pinned temperature, then back to Tuesday's "Work from Home"
+  ThermiteCalendarCursor cursor;
+  TEST_ASSERT_EQUAL(12.5f, userSettingsManager.getTargetTemperature(T_CALENDAR + 3600l, cursor));
+  TEST_ASSERT_EQUAL(16.0f, userSettingsManager.getTargetTemperature(T_CALENDAR + 7200l, cursor));
+  TEST_ASSERT_EQUAL(20.0f, userSettingsManager.getTargetTemperature(T_CALENDAR + 9 * 3600l, cursor));
+
+  // Wednesday follows "Day Off", where 07:30 is still asleep
+  time_t wednesday = T_CALENDAR + 86400l;
+  TEST_ASSERT_EQUAL(16.0f, userSettingsManager.getTargetTemperature(wednesday + 7 * 3600l + 1800l, cursor));
+  TEST_ASSERT_EQUAL(17.0f, userSettingsManager.getTargetTemperature(wednesday + 7 * 3600l + 1800l - 86400l * 7));
+
+  // an override takes precedence
+  userSettingsManager._tempOverride = 19.0f;
+  userSettingsManager._overrideStart = T_CALENDAR;
+  userSettingsManager._overrideEnd = T_CALENDAR + 1800l;
+  TEST_ASSERT_EQUAL(19.0f, userSettingsManager.getTargetTemperature(T_CALENDAR, cursor));
+  TEST_ASSERT_EQUAL(12.5f, userSettingsManager.getTargetTemperature(T_CALENDAR + 1800l, cursor));
+
+  // the calendar is left out of user settings
+  DynamicJsonDocument docOut(CAPACITY_USER_SETTINGS_MANAGER);
+  JsonObject rootOut = docOut.to<JsonObject>();
+  TEST_ASSERT_TRUE(userSettingsManager.toJSON(rootOut));
+  TEST_ASSERT_FALSE(rootOut.containsKey("calendar"));
+}
+
+int runTests() {
   UNITY_BEGIN();
 
   RUN_TEST(testSetPointEmpty);
@@ -680,6 +986,11 @@ void setup() {
   RUN_TEST(testDailyScheduleBothValid);
   RUN_TEST(testDailyScheduleToJson);
 
+  RUN_TEST(testHeaterSettingsValid);
+  RUN_TEST(testHeaterSettingsMinTimeTooHigh);
+  RUN_TEST(testHeaterSettingsMinTimeNegative);
+  RUN_TEST(testHeaterSettingsMaxCyclesTooHigh);
+
   RUN_TEST(testUserSettingsManagerEmpty);
   RUN_TEST(testUserSettingsManagerSetPointsValid);
   RUN_TEST(testUserSettingsManagerSetPointsEmpty);
@@ -702,11 +1013,36 @@ void setup() {
   RUN_TEST(testUserSettingsManagerOverrideStartZeroEndNonZero);
   RUN_TEST(testUserSettingsManagerOverrideStartNonZeroEndZero);
   RUN_TEST(testUserSettingsManagerOverrideStartAfterEnd);
+  RUN_TEST(testUserSettingsManagerHeaterValid);
+  RUN_TEST(testUserSettingsManagerHeaterNotObject);
   RUN_TEST(testUserSettingsManagerToJson);
+  RUN_TEST(testUserSettingsManagerNextScheduleBoundary);
+  RUN_TEST(testUserSettingsManagerVersion);
+  RUN_TEST(testUserSettingsManagerCalendar);
+
+  RUN_TEST(testCalendarValid);
+  RUN_TEST(testCalendarInvalid);
+  RUN_TEST(testCalendarTooLong);
+  RUN_TEST(testCalendarSeek);
+  RUN_TEST(testCalendarSaveRestore);
+
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  // NOTE!!! Wait for >2 secs
+  // if board doesn't support software reset via Serial.DTR/RTS
+  delay(2000);
 
-  UNITY_END();
+  runTests();
 }
 
 void loop() {}
+#else
+int main() {
+  return runTests();
+}
+#endif
 
 #endif
\ No newline at end of file
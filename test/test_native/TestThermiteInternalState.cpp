@@ -0,0 +1,2321 @@
+#ifdef UNIT_TEST
+
+#include <unity.h>
+
+/*
+ * Profile the host heap, so that routes can be held to an allocation budget.
+ */
+#define ALLOC_PROFILER 1
+
+#include "Constants.h"
+#include "native/ThermiteFakeHal.cpp"
+#include "native/ThermiteHostHeap.cpp"
+#include "ThermiteAllocProfiler.cpp"
+#include "ThermiteCalendar.cpp"
+#include "ThermiteChunkedBody.cpp"
+#include "ThermiteHeaterRuntime.cpp"
+#include "ThermiteHistory.cpp"
+#include "ThermiteInternalState.cpp"
+#include "ThermitePowerManager.cpp"
+#include "ThermiteResponsePool.cpp"
+#include "ThermiteRollups.cpp"
+#include "ThermiteScheduleTimeline.cpp"
+#include "ThermiteTelemetry.cpp"
+#include "ThermiteThermalEstimator.cpp"
+#include "ThermiteUserSettingsManager.cpp"
+#include "ThermiteUserSettingsStore.cpp"
+#include "ThermiteWebController.cpp"
+#include "ThermiteWifiConnector.cpp"
+#include "ThermiteZones.cpp"
+
+/*
+ * 2021-02-02T05:00:00Z, i.e. midnight on Tuesday in Eastern Standard Time.
+ */
+#define T_EPOCH 1612242000l
+#define T_OFFSET -300
+
+void pinTargetTemperature(ThermiteUserSettingsStore& userSettingsStore, float tempTarget) {
+  ThermiteUserSettingsManager& userSettings = userSettingsStore.edit();
+  userSettings._tempOverride = tempTarget;
+  userSettings._overrideStart = 1l;
+  userSettings._overrideEnd = 0x7fffffffl;
+}
+
+/**
+ * Advances `clock` far enough for `internalState` to request and then read a new temperature.
+ */
+void sampleTemperature(ThermiteInternalState& internalState, ThermiteFakeClock& clock) {
+  clock.advance(TEMP_REQUEST_INTERVAL + 1);
+  internalState.update(clock.getMillis());
+  clock.advance(TEMP_REQUEST_DELAY + 1);
+  internalState.update(clock.getMillis());
+}
+
+/**
+ * Room that follows the first-order model exactly, heating at 4 degrees per hour at full duty
+ * and losing heat towards 10 degrees with a time constant of 5 hours, under a thermostat that
+ * holds it between 18 and 21 degrees.  Read once a minute.
+ */
+struct TestRoom {
+  unsigned long now;
+  float temp;
+  bool heater;
+  uint64_t runtime;
+
+  TestRoom() : now(0ul), temp(19.0f), heater(true), runtime(0ull) {}
+
+  void run(ThermiteThermalEstimator& thermalModel, int minutes) {
+    for (int i = 0; i < minutes; i++) {
+      float tempLimit = 10.0f + (heater ? 4.0f * 5.0f : 0.0f);
+      temp = tempLimit + (temp - tempLimit) * expf(-1.0f / 60.0f / 5.0f);
+      now += 60000ul;
+      if (heater) {
+        runtime += 60000ull;
+      }
+      thermalModel.addReading(now, T_EPOCH + now / 1000ul, temp, runtime);
+      if (temp >= 21.0f) {
+        heater = false;
+      } else if (temp <= 18.0f) {
+        heater = true;
+      }
+    }
+  }
+};
+
+void testInternalStateInitDisconnected() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+
+  TEST_ASSERT_TRUE(internalState.init());
+  thermometer.setConnected(false);
+  TEST_ASSERT_FALSE(internalState.init());
+}
+
+void testInternalStateTempRequestDelay() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer(18.5f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+
+  clock.advance(1);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(1, thermometer.getRequestCount());
+
+  StaticJsonDocument<CAPACITY_INTERNAL_STATE> doc;
+  JsonObject root = doc.to<JsonObject>();
+  internalState.toJSON(root);
+  TEST_ASSERT_EQUAL_FLOAT(TEMP_DISCONNECTED, root["temp"].as<float>());
+
+  clock.advance(TEMP_REQUEST_DELAY + 1);
+  internalState.update(clock.getMillis());
+  internalState.toJSON(root);
+  TEST_ASSERT_EQUAL_FLOAT(18.5f, root["temp"].as<float>());
+  TEST_ASSERT_EQUAL(1, thermometer.getRequestCount());
+
+  clock.advance(TEMP_REQUEST_INTERVAL);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(2, thermometer.getRequestCount());
+}
+
+void testInternalStateTempTargetSchedule() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+
+  StaticJsonDocument<CAPACITY_INTERNAL_STATE> doc;
+  JsonObject root = doc.to<JsonObject>();
+
+  // Tuesday 00:00 local: "Work from Home", sleep set point.
+  clock.advance(1);
+  internalState.update(clock.getMillis());
+  internalState.toJSON(root);
+  TEST_ASSERT_EQUAL_FLOAT(16.0f, root["tempTarget"].as<float>());
+
+  // Tuesday 09:00 local: "Work from Home", home office set point.
+  clock.advance(9ul * 3600ul * 1000ul);
+  internalState.update(clock.getMillis());
+  internalState.toJSON(root);
+  TEST_ASSERT_EQUAL_FLOAT(20.0f, root["tempTarget"].as<float>());
+}
+
+void testInternalStateHeaterHysteresis() {
+  ThermiteUserSettingsStore userSettingsStore;
+  pinTargetTemperature(userSettingsStore, 17.0f);
+  ThermiteFakeThermometer thermometer(15.0f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_TRUE(internalState.getHeater());
+
+  // Inside the hysteresis band: stay on.
+  thermometer.setTemperature(17.5f);
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_TRUE(internalState.getHeater());
+
+  thermometer.setTemperature(18.0f);
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_FALSE(internalState.getHeater());
+
+  // Inside the hysteresis band: stay off.
+  thermometer.setTemperature(16.5f);
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_FALSE(internalState.getHeater());
+}
+
+void testInternalStateMillisWraparound() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+
+  clock.advance(0xffffffffull - TEMP_REQUEST_DELAY);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(1, thermometer.getRequestCount());
+
+  clock.advance(2ul * TEMP_REQUEST_DELAY);
+  internalState.update(clock.getMillis());
+  clock.advance(TEMP_REQUEST_INTERVAL + 1);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(2, thermometer.getRequestCount());
+}
+
+void testInternalStateHeaterMinOnOffTime() {
+  ThermiteUserSettingsStore userSettingsStore;
+  pinTargetTemperature(userSettingsStore, 17.0f);
+  userSettingsStore.edit()._heaterSettings._minOnTime = 300;
+  userSettingsStore.edit()._heaterSettings._minOffTime = 600;
+  ThermiteFakeThermometer thermometer(15.0f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_TRUE(internalState.getHeater());
+
+  // Too warm, but the heater has to stay on for at least 5 minutes.
+  thermometer.setTemperature(19.0f);
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_TRUE(internalState.getHeater());
+  unsigned long delay = internalState.getUpdateDelay(clock.getMillis());
+  TEST_ASSERT_LESS_THAN(TEMP_REQUEST_INTERVAL, delay);
+  clock.advance(4ul * TEMP_REQUEST_INTERVAL);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_FALSE(internalState.getHeater());
+
+  // Too cold, but the heater has to stay off for at least 10 minutes.
+  thermometer.setTemperature(15.0f);
+  for (int i = 0; i < 8; i++) {
+    sampleTemperature(internalState, clock);
+    TEST_ASSERT_FALSE(internalState.getHeater());
+  }
+  clock.advance(2ul * TEMP_REQUEST_INTERVAL);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_TRUE(internalState.getHeater());
+  TEST_ASSERT_EQUAL(3, internalState.getHeaterRuntime().getSwitchCount());
+}
+
+void testInternalStateHeaterMaxCyclesPerHour() {
+  ThermiteUserSettingsStore userSettingsStore;
+  pinTargetTemperature(userSettingsStore, 17.0f);
+  userSettingsStore.edit()._heaterSettings._minOnTime = 0;
+  userSettingsStore.edit()._heaterSettings._minOffTime = 0;
+  userSettingsStore.edit()._heaterSettings._maxCyclesPerHour = 2;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+
+  for (int i = 0; i < 2; i++) {
+    thermometer.setTemperature(15.0f);
+    sampleTemperature(internalState, clock);
+    TEST_ASSERT_TRUE(internalState.getHeater());
+    thermometer.setTemperature(19.0f);
+    sampleTemperature(internalState, clock);
+    TEST_ASSERT_FALSE(internalState.getHeater());
+  }
+
+  // Third cycle within the hour: held off until the first one is an hour old.
+  thermometer.setTemperature(15.0f);
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_FALSE(internalState.getHeater());
+  for (int i = 0; i < 56; i++) {
+    sampleTemperature(internalState, clock);
+  }
+  TEST_ASSERT_TRUE(internalState.getHeater());
+}
+
+void testInternalStateHeaterRuntime() {
+  ThermiteUserSettingsStore userSettingsStore;
+  pinTargetTemperature(userSettingsStore, 17.0f);
+  ThermiteFakeThermometer thermometer(15.0f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+
+  /*
+   * Heater on from 00:01:00 local for 24 hours, then off.  Runtime is attributed to days at
+   * each update, so the first update after midnight still counts towards the day before.
+   */
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_TRUE(internalState.getHeater());
+  for (int i = 0; i < 24 * 60; i++) {
+    clock.advance(TEMP_REQUEST_INTERVAL);
+    internalState.update(clock.getMillis());
+  }
+  thermometer.setTemperature(19.0f);
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_FALSE(internalState.getHeater());
+
+  const ThermiteHeaterRuntime& heaterRuntime = internalState.getHeaterRuntime();
+  uint32_t runtimeLifetime = heaterRuntime.getRuntimeLifetime();
+  TEST_ASSERT_EQUAL(86460, runtimeLifetime);
+  TEST_ASSERT_EQUAL(86460, heaterRuntime.getRuntimeWeek());
+  TEST_ASSERT_EQUAL(120, heaterRuntime.getRuntimeToday());
+
+  // Runtime ages out of the 7-day window, but not out of the lifetime total.
+  for (int i = 0; i < 7; i++) {
+    clock.advance(86400000ul);
+    internalState.update(clock.getMillis());
+  }
+  TEST_ASSERT_EQUAL(0, heaterRuntime.getRuntimeToday());
+  TEST_ASSERT_EQUAL(0, heaterRuntime.getRuntimeWeek());
+  TEST_ASSERT_EQUAL(runtimeLifetime, heaterRuntime.getRuntimeLifetime());
+}
+
+void testInternalStateUpdateDelay() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  internalState.setTempRequestInterval(30000ul);
+
+  TEST_ASSERT_EQUAL(0, internalState.getUpdateDelay(clock.getMillis()));
+
+  clock.advance(1);
+  internalState.update(clock.getMillis());
+  unsigned long delay = internalState.getUpdateDelay(clock.getMillis());
+  TEST_ASSERT_EQUAL(TEMP_REQUEST_DELAY + 1, delay);
+
+  clock.advance(delay);
+  internalState.update(clock.getMillis());
+  delay = internalState.getUpdateDelay(clock.getMillis());
+  TEST_ASSERT_EQUAL(30000ul - TEMP_REQUEST_DELAY, delay);
+
+  clock.advance(delay);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(2, thermometer.getRequestCount());
+}
+
+void testInternalStateDateTimeIso() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+
+  StaticJsonDocument<CAPACITY_INTERNAL_STATE> doc;
+  JsonObject root = doc.to<JsonObject>();
+
+  internalState.updateDateTimeIso();
+  internalState.toJSON(root);
+  TEST_ASSERT_EQUAL_STRING("2021-02-02T00:00:00-05:00", root["dateTime"]);
+
+  clock.setEpochTime(951827696l);
+  clock.setOffset(330);
+  internalState.updateDateTimeIso();
+  internalState.toJSON(root);
+  TEST_ASSERT_EQUAL_STRING("2000-02-29T18:04:56+05:30", root["dateTime"]);
+}
+
+void testInternalStateSleepDelay() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  internalState.setTempRequestInterval(3600000ul);
+
+  clock.advance(1);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(TEMP_REQUEST_DELAY + 1, internalState.getSleepDelay(clock.getMillis()));
+  clock.advance(TEMP_REQUEST_DELAY + 1);
+  internalState.update(clock.getMillis());
+
+  // 00:29:30 local: the next schedule boundary comes before the next temperature request.
+  clock.advance(1770000ul - clock.getElapsedMillis());
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(30000ul, internalState.getSleepDelay(clock.getMillis()));
+}
+
+void testInternalStateCheckpoint() {
+  ThermiteUserSettingsStore userSettingsStore;
+  pinTargetTemperature(userSettingsStore, 17.0f);
+  userSettingsStore.edit()._heaterSettings._minOnTime = 600;
+  ThermiteFakeRtcMemory rtcMemory;
+  ThermiteFakeThermometer thermometer(15.0f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  internalState.setRtcMemory(&rtcMemory);
+
+  sampleTemperature(internalState, clock);
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_TRUE(internalState.getHeater());
+
+  // Soft reset: `millis()` starts over, and the thermometer has no reading yet.
+  ThermiteFakeThermometer thermometerReset(TEMP_DISCONNECTED);
+  ThermiteFakeClock clockReset;
+  ThermiteInternalState internalStateReset(userSettingsStore, thermometerReset, clockReset);
+  internalStateReset.setRtcMemory(&rtcMemory);
+  TEST_ASSERT_TRUE(internalStateReset.restoreCheckpoint(clockReset.getMillis()));
+  TEST_ASSERT_TRUE(internalStateReset.getHeater());
+  TEST_ASSERT_EQUAL_FLOAT(15.0f, internalStateReset.getTemp());
+  TEST_ASSERT_EQUAL_FLOAT(17.0f, internalStateReset.getTempTarget());
+  const ThermiteHeaterRuntime& heaterRuntime = internalStateReset.getHeaterRuntime();
+  TEST_ASSERT_EQUAL(1, heaterRuntime.getSwitchCount());
+  TEST_ASSERT_EQUAL(internalState.getHeaterRuntime().getRuntimeToday(), heaterRuntime.getRuntimeToday());
+
+  // Minimum on time still counts from the switch before the reset.
+  unsigned long delay = heaterRuntime.getSwitchDelay(
+    false,
+    clockReset.getMillis(),
+    userSettingsStore.read()._heaterSettings
+  );
+  TEST_ASSERT_EQUAL(600000ul - (TEMP_REQUEST_INTERVAL + TEMP_REQUEST_DELAY + 2), delay);
+
+  // Control continues from the restored state until a new reading arrives.
+  clockReset.advance(1);
+  internalStateReset.update(clockReset.getMillis());
+  TEST_ASSERT_TRUE(internalStateReset.getHeater());
+
+  // Anything corrupted, and there is nothing to restore.
+  rtcMemory.corrupt(RTC_OFFSET_CHECKPOINT + 12);
+  ThermiteInternalState internalStateCorrupt(userSettingsStore, thermometerReset, clockReset);
+  internalStateCorrupt.setRtcMemory(&rtcMemory);
+  TEST_ASSERT_FALSE(internalStateCorrupt.restoreCheckpoint(clockReset.getMillis()));
+  TEST_ASSERT_FALSE(internalStateCorrupt.getHeater());
+  TEST_ASSERT_EQUAL_FLOAT(TEMP_DISCONNECTED, internalStateCorrupt.getTemp());
+}
+
+void testInternalStateThermalModel() {
+  ThermiteUserSettingsStore userSettingsStore;
+  pinTargetTemperature(userSettingsStore, 17.0f);
+  ThermiteFakeEeprom eeprom;
+  ThermiteFakeThermometer thermometer(15.0f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  internalState.setEeprom(&eeprom);
+  TEST_ASSERT_FALSE(internalState.restoreThermalModel());
+
+  // written once every `THERMAL_MODEL_SAVE_SAMPLES` samples, and not in between
+  const ThermiteThermalEstimator& thermalModel = internalState.getThermalModel();
+  while (thermalModel.getSamples() < THERMAL_MODEL_SAVE_SAMPLES) {
+    TEST_ASSERT_EQUAL(0ul, eeprom.getCommitCount());
+    sampleTemperature(internalState, clock);
+  }
+  TEST_ASSERT_EQUAL(1ul, eeprom.getCommitCount());
+  uint32_t runtimeLifetime = internalState.getHeaterRuntime().getRuntimeLifetime();
+  TEST_ASSERT_TRUE(runtimeLifetime > 0);
+
+  // after a power cycle, the model is back, and so is the heater's lifetime runtime
+  eeprom.powerCycle();
+  ThermiteInternalState internalStateRestored(userSettingsStore, thermometer, clock);
+  internalStateRestored.setEeprom(&eeprom);
+  TEST_ASSERT_TRUE(internalStateRestored.restoreThermalModel());
+  TEST_ASSERT_EQUAL(
+    THERMAL_MODEL_SAVE_SAMPLES,
+    internalStateRestored.getThermalModel().getSamples()
+  );
+  TEST_ASSERT_EQUAL(
+    runtimeLifetime,
+    internalStateRestored.getHeaterRuntime().getRuntimeLifetime()
+  );
+}
+
+void testInternalStatePreheat() {
+  ThermiteThermalEstimator thermalModel;
+  TestRoom room;
+  room.run(thermalModel, 3 * 24 * 60);
+  ThermiteThermalRecord record;
+  thermalModel.save(record, 0ull);
+  ThermiteFakeEeprom eeprom;
+  eeprom.write(EEPROM_OFFSET_THERMAL_MODEL, &record, sizeof(record));
+
+  // 21 degrees from 03:00 local
+  ThermiteUserSettingsStore userSettingsStore;
+  time_t tLocal = T_EPOCH + T_OFFSET * 60;
+  ThermiteUserSettingsManager& userSettings = userSettingsStore.edit();
+  userSettings._tempOverride = 21.0f;
+  userSettings._overrideStart = tLocal + 10800l;
+  userSettings._overrideEnd = tLocal + 14400l;
+  float tempScheduled = userSettings.getTargetTemperature(tLocal);
+  TEST_ASSERT_TRUE(tempScheduled < 21.0f);
+
+  ThermiteFakeThermometer thermometer(17.0f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  internalState.setEeprom(&eeprom);
+  TEST_ASSERT_TRUE(internalState.restoreThermalModel());
+  long warmUp = thermalModel.getWarmUpTime(17.0f, 21.0f, tLocal);
+  TEST_ASSERT_TRUE(warmUp > 600l && warmUp < 10800l);
+
+  // off by default: the target follows the schedule
+  sampleTemperature(internalState, clock);
+  clock.advance((10800l - warmUp + 120l) * 1000ul - clock.getElapsedMillis());
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL_FLOAT(tempScheduled, internalState.getTempTarget());
+
+  // heating starts `warmUp` before the rise, scaled by the margin
+  internalState.setPreheatMargin(1.0f);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL_FLOAT(21.0f, internalState.getTempTarget());
+  TEST_ASSERT_TRUE(internalState.getHeater());
+  internalState.setPreheatMargin(0.5f);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL_FLOAT(tempScheduled, internalState.getTempTarget());
+
+  // without enough samples, there is no preheating
+  ThermiteInternalState internalStateUntrained(userSettingsStore, thermometer, clock);
+  internalStateUntrained.setPreheatMargin(1.0f);
+  internalStateUntrained.update(clock.getMillis());
+  TEST_ASSERT_EQUAL_FLOAT(tempScheduled, internalStateUntrained.getTempTarget());
+}
+
+ThermiteTelemetryPacket decodeTelemetryPacket(const std::string& datagram) {
+  ThermiteTelemetryPacket packet;
+  TEST_ASSERT_EQUAL(sizeof(packet), datagram.size());
+  memcpy(&packet, datagram.data(), sizeof(packet));
+  TEST_ASSERT_EQUAL(TELEMETRY_PACKET_MAGIC, packet.magic);
+  TEST_ASSERT_EQUAL(TELEMETRY_PACKET_VERSION, packet.version);
+  return packet;
+}
+
+void testInternalStateTelemetry() {
+  ThermiteUserSettingsStore userSettingsStore;
+  pinTargetTemperature(userSettingsStore, 20.0f);
+  ThermiteFakeThermometer thermometer(20.0f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteFakeDatagramSocket socket;
+  ThermiteFakeSystem system(0x00c0ffeeul);
+  ThermiteFakeWifi wifi;
+  ThermiteTelemetry telemetry(socket, system, wifi);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  internalState.setTelemetry(&telemetry, 1);
+  const std::vector<std::string>& datagrams = socket.getDatagrams();
+
+  // changes made while offline are held, without spending sequence numbers
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_EQUAL(0, datagrams.size());
+  wifi.setState(WIFI_STATE_CONNECTED);
+  clock.advance(1000ul);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(1, datagrams.size());
+  ThermiteTelemetryPacket packet = decodeTelemetryPacket(datagrams[0]);
+  TEST_ASSERT_EQUAL(1, packet.zone);
+  TEST_ASSERT_EQUAL(0x00c0ffeeul, packet.deviceId);
+  TEST_ASSERT_EQUAL(0ul, packet.sequence);
+  TEST_ASSERT_EQUAL(clock.getEpochTime(), packet.epoch);
+  TEST_ASSERT_EQUAL(2000, packet.temp);
+  TEST_ASSERT_EQUAL(2000, packet.tempTarget);
+  TEST_ASSERT_EQUAL(40000ul, packet.freeHeap);
+  TEST_ASSERT_EQUAL(0, packet.flags);
+  TEST_ASSERT_EQUAL(-60, packet.rssi);
+
+  // nothing new until the heartbeat, which the device wakes up for
+  internalState.setTempRequestInterval(3600000ul);
+  clock.advance(1000ul);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(1, datagrams.size());
+  TEST_ASSERT_EQUAL(
+    TELEMETRY_HEARTBEAT_INTERVAL - 1000ul,
+    internalState.getSleepDelay(clock.getMillis())
+  );
+  clock.advance(TELEMETRY_HEARTBEAT_INTERVAL - 1000ul);
+  internalState.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(2, datagrams.size());
+  packet = decodeTelemetryPacket(datagrams[1]);
+  TEST_ASSERT_EQUAL(1ul, packet.sequence);
+  TEST_ASSERT_EQUAL(TELEMETRY_FLAG_HEARTBEAT, packet.flags);
+  internalState.setTempRequestInterval(TEMP_REQUEST_INTERVAL);
+
+  // a change is sent as soon as it is read
+  thermometer.setTemperature(17.5f);
+  sampleTemperature(internalState, clock);
+  packet = decodeTelemetryPacket(datagrams.back());
+  TEST_ASSERT_TRUE(internalState.getHeater());
+  TEST_ASSERT_EQUAL(1750, packet.temp);
+  TEST_ASSERT_EQUAL(TELEMETRY_FLAG_HEATER, packet.flags);
+  for (size_t i = 0; i < datagrams.size(); i++) {
+    TEST_ASSERT_EQUAL(i, decodeTelemetryPacket(datagrams[i]).sequence);
+  }
+
+  // packets the socket fails on leave a gap in the sequence, for the receiver to count
+  uint32_t sequence = telemetry.getSequence(1);
+  socket.setFailing(true);
+  thermometer.setTemperature(22.0f);
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_GREATER_THAN(0ul, telemetry.getFailedCount());
+  socket.setFailing(false);
+  size_t count = datagrams.size();
+  thermometer.setTemperature(21.5f);
+  sampleTemperature(internalState, clock);
+  TEST_ASSERT_GREATER_THAN(count, datagrams.size());
+  packet = decodeTelemetryPacket(datagrams[count]);
+  TEST_ASSERT_EQUAL(sequence + telemetry.getFailedCount(), packet.sequence);
+}
+
+void testPowerManagerAwake() {
+  ThermiteFakeRadio radio;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermitePowerManager powerManager(radio, clock, POWER_MODE_AWAKE);
+
+  TEST_ASSERT_EQUAL(LOOP_INTERVAL, powerManager.update(1000ul, 60000ul));
+  powerManager.noteRequest();
+  TEST_ASSERT_EQUAL(LOOP_INTERVAL, powerManager.update(61000ul, 60000ul));
+  TEST_ASSERT_EQUAL(0, radio.getModeChangeCount());
+  TEST_ASSERT_EQUAL(0, powerManager.getWakeLatencyMax());
+  TEST_ASSERT_EQUAL_FLOAT(POWER_CURRENT_AWAKE, powerManager.getCurrentAverage());
+}
+
+void testPowerManagerLightSleep() {
+  ThermiteFakeRadio radio;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermitePowerManager powerManager(radio, clock, POWER_MODE_LIGHT_SLEEP, 3);
+
+  TEST_ASSERT_EQUAL(500ul, powerManager.update(0ul, 500ul));
+  TEST_ASSERT_EQUAL(POWER_MODE_LIGHT_SLEEP, radio.getMode());
+  TEST_ASSERT_EQUAL(3, radio.getListenInterval());
+  TEST_ASSERT_EQUAL(POWER_SLEEP_MAX, powerManager.update(500ul, 60000ul));
+  TEST_ASSERT_EQUAL(308ul, powerManager.getWakeLatencyMax());
+  TEST_ASSERT_EQUAL(8ul, powerManager.getWakeLatency(300ul));
+
+  // A request wakes the radio up until the session times out.
+  clock.advance(1000ul);
+  powerManager.noteRequest();
+  TEST_ASSERT_EQUAL(POWER_MODE_AWAKE, radio.getMode());
+  TEST_ASSERT_EQUAL(0ul, powerManager.getWakeLatency(1000ul));
+  TEST_ASSERT_EQUAL(LOOP_INTERVAL, powerManager.update(1000ul + POWER_SESSION_TIMEOUT - 1, 60000ul));
+  TEST_ASSERT_EQUAL(POWER_MODE_AWAKE, radio.getMode());
+  TEST_ASSERT_EQUAL(1ul, powerManager.getSessionDelay(1000ul + POWER_SESSION_TIMEOUT - 1));
+  powerManager.update(1000ul + POWER_SESSION_TIMEOUT, 60000ul);
+  TEST_ASSERT_EQUAL(POWER_MODE_LIGHT_SLEEP, radio.getMode());
+  TEST_ASSERT_EQUAL(3, radio.getModeChangeCount());
+
+  // An hour asleep, with `loop()` waking once a second.
+  unsigned long now = 1000ul + POWER_SESSION_TIMEOUT;
+  for (int i = 0; i < 3600; i++) {
+    now += POWER_SLEEP_MAX;
+    powerManager.update(now, 60000ul);
+  }
+  TEST_ASSERT_EQUAL(3590, powerManager.getTimeInMode(POWER_MODE_LIGHT_SLEEP));
+  TEST_ASSERT_EQUAL(20, powerManager.getTimeInMode(POWER_MODE_AWAKE));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 1.30f, powerManager.getCurrentAverage());
+}
+
+ThermiteWifiCache makeWifiCache(uint8_t channel) {
+  ThermiteWifiCache cache;
+  memset(&cache, 0, sizeof(cache));
+  for (uint8_t i = 0; i < 6; i++) {
+    cache.bssid[i] = 0x10 + i;
+  }
+  cache.channel = channel;
+  cache.ip = 0x0a01a8c0ul;
+  return cache;
+}
+
+void testWifiConnectorCache() {
+  ThermiteFakeRtcMemory rtcMemory;
+  ThermiteFakeWifi wifi;
+  wifi.setCache(makeWifiCache(6));
+
+  // Cold boot: nothing cached yet, so scan.
+  ThermiteWifiConnector wifiConnector(wifi, rtcMemory);
+  wifiConnector.init(0ul);
+  TEST_ASSERT_EQUAL(1, wifi.getBeginCount());
+  TEST_ASSERT_FALSE(wifi.getBeganWithCache());
+  TEST_ASSERT_EQUAL(WIFI_POLL_INTERVAL, wifiConnector.getUpdateDelay(0ul));
+  wifiConnector.update(1000ul);
+  TEST_ASSERT_FALSE(wifiConnector.isConnected());
+  wifi.setState(WIFI_STATE_CONNECTED);
+  wifiConnector.update(2500ul);
+  TEST_ASSERT_TRUE(wifiConnector.isConnected());
+  TEST_ASSERT_EQUAL(2500ul, wifiConnector.getConnectDuration());
+
+  // Dropped connection: reconnect straight away, with the cache.
+  wifi.setState(WIFI_STATE_CONNECTING);
+  wifiConnector.update(5000ul);
+  TEST_ASSERT_FALSE(wifiConnector.isConnected());
+  wifiConnector.update(5000ul);
+  TEST_ASSERT_EQUAL(2, wifi.getBeginCount());
+  TEST_ASSERT_TRUE(wifi.getBeganWithCache());
+
+  // After a reset, the cache is read back from RTC memory.
+  ThermiteFakeWifi wifiReset;
+  ThermiteWifiConnector wifiConnectorReset(wifiReset, rtcMemory);
+  wifiConnectorReset.init(0ul);
+  TEST_ASSERT_TRUE(wifiReset.getBeganWithCache());
+
+  // ...unless it was corrupted.
+  rtcMemory.corrupt(RTC_OFFSET_WIFI_CACHE + 4);
+  ThermiteFakeWifi wifiCorrupt;
+  ThermiteWifiConnector wifiConnectorCorrupt(wifiCorrupt, rtcMemory);
+  wifiConnectorCorrupt.init(0ul);
+  TEST_ASSERT_FALSE(wifiCorrupt.getBeganWithCache());
+  TEST_ASSERT_FALSE(wifiConnectorCorrupt.isCacheValid());
+}
+
+void testWifiConnectorBackoff() {
+  ThermiteFakeRtcMemory rtcMemory;
+  ThermiteFakeWifi wifi;
+  wifi.setCache(makeWifiCache(11));
+  ThermiteWifiConnector wifiConnector(wifi, rtcMemory);
+  wifiConnector.init(0ul);
+  wifi.setState(WIFI_STATE_CONNECTED);
+  wifiConnector.update(100ul);
+
+  // A failed cached attempt drops the cache, and scans straight away.
+  wifi.setState(WIFI_STATE_FAILED);
+  wifiConnector.update(200ul);
+  wifiConnector.update(200ul);
+  TEST_ASSERT_EQUAL(2, wifi.getBeginCount());
+  TEST_ASSERT_TRUE(wifi.getBeganWithCache());
+  wifi.setState(WIFI_STATE_FAILED);
+  wifiConnector.update(300ul);
+  TEST_ASSERT_FALSE(wifiConnector.isCacheValid());
+  wifiConnector.update(300ul);
+  TEST_ASSERT_EQUAL(3, wifi.getBeginCount());
+  TEST_ASSERT_FALSE(wifi.getBeganWithCache());
+
+  // Then back off exponentially, up to `WIFI_BACKOFF_MAX`.
+  unsigned long now = 300ul;
+  unsigned long backoff = WIFI_BACKOFF_MIN;
+  for (int i = 0; i < 10; i++) {
+    wifi.setState(WIFI_STATE_FAILED);
+    wifiConnector.update(now);
+    TEST_ASSERT_EQUAL(backoff, wifiConnector.getUpdateDelay(now));
+    wifiConnector.update(now + backoff - 1);
+    TEST_ASSERT_EQUAL(WIFI_STATE_IDLE, wifiConnector.getState());
+    now += backoff;
+    wifiConnector.update(now);
+    TEST_ASSERT_EQUAL(WIFI_STATE_CONNECTING, wifiConnector.getState());
+    backoff = backoff * 2 > WIFI_BACKOFF_MAX ? WIFI_BACKOFF_MAX : backoff * 2;
+  }
+
+  // Attempts that hang are given up on after `WIFI_CONNECT_TIMEOUT`.
+  wifiConnector.update(now + WIFI_CONNECT_TIMEOUT);
+  TEST_ASSERT_EQUAL(WIFI_STATE_IDLE, wifiConnector.getState());
+
+  // Success resets the backoff.
+  now += WIFI_CONNECT_TIMEOUT + WIFI_BACKOFF_MAX;
+  wifiConnector.update(now);
+  wifi.setState(WIFI_STATE_CONNECTED);
+  wifiConnector.update(now);
+  TEST_ASSERT_TRUE(wifiConnector.isConnected());
+  TEST_ASSERT_TRUE(wifiConnector.isCacheValid());
+  for (int i = 0; i < 2; i++) {
+    wifi.setState(WIFI_STATE_FAILED);
+    wifiConnector.update(now);
+    wifiConnector.update(now);
+  }
+  wifi.setState(WIFI_STATE_FAILED);
+  wifiConnector.update(now);
+  TEST_ASSERT_EQUAL(WIFI_BACKOFF_MIN, wifiConnector.getUpdateDelay(now));
+}
+
+void testRollupsBucketClose() {
+  ThermiteRollups rollups;
+  time_t tLocal = T_EPOCH + T_OFFSET * 60;
+  const ThermiteRollupTier* minutes = rollups.getTier("minute");
+  TEST_ASSERT_NOT_NULL(minutes);
+  TEST_ASSERT_NULL(rollups.getTier("week"));
+  TEST_ASSERT_NULL(rollups.getTier(nullptr));
+  TEST_ASSERT_EQUAL(0, minutes->getCount());
+
+  rollups.addSample(T_EPOCH + 10, tLocal + 10, 15.0f, 17.0f, true);
+  rollups.addSample(T_EPOCH + 40, tLocal + 40, 17.5f, 17.0f, false);
+  TEST_ASSERT_EQUAL(1, minutes->getCount());
+  rollups.addSample(T_EPOCH + 70, tLocal + 70, 16.0f, 18.0f, false);
+  TEST_ASSERT_EQUAL(2, minutes->getCount());
+
+  ThermiteRollupBucket bucket = minutes->getBucket(0);
+  TEST_ASSERT_EQUAL(T_EPOCH, bucket._t);
+  TEST_ASSERT_EQUAL(1500, bucket._tempMin);
+  TEST_ASSERT_EQUAL(1750, bucket._tempMax);
+  TEST_ASSERT_EQUAL(1625, bucket._tempMean);
+  TEST_ASSERT_EQUAL(1700, bucket._tempTargetMean);
+  TEST_ASSERT_EQUAL(50, bucket._heaterDuty);
+
+  bucket = minutes->getBucket(1);
+  TEST_ASSERT_EQUAL(T_EPOCH + 60, bucket._t);
+  TEST_ASSERT_EQUAL(1600, bucket._tempMean);
+  TEST_ASSERT_EQUAL(0, bucket._heaterDuty);
+
+  // All three samples are still in the open hour and day buckets.
+  bucket = rollups.getTier("day")->getBucket(0);
+  TEST_ASSERT_EQUAL(1, rollups.getTier("day")->getCount());
+  TEST_ASSERT_EQUAL(1500, bucket._tempMin);
+  TEST_ASSERT_EQUAL(33, bucket._heaterDuty);
+}
+
+void testRollupsRingWraparound() {
+  ThermiteRollups rollups;
+  time_t tLocal = T_EPOCH + T_OFFSET * 60;
+  for (int i = 0; i < ROLLUP_MINUTE_SIZE + 10; i++) {
+    rollups.addSample(T_EPOCH + 60 * i, tLocal + 60 * i, 10.0f + i, 17.0f, false);
+  }
+  const ThermiteRollupTier* minutes = rollups.getTier("minute");
+  TEST_ASSERT_EQUAL(ROLLUP_MINUTE_SIZE + 1, minutes->getCount());
+  TEST_ASSERT_EQUAL(T_EPOCH + 60 * 9, minutes->getBucket(0)._t);
+  TEST_ASSERT_EQUAL(1900, minutes->getBucket(0)._tempMean);
+  TEST_ASSERT_EQUAL(
+    T_EPOCH + 60 * (ROLLUP_MINUTE_SIZE + 9),
+    minutes->getBucket(ROLLUP_MINUTE_SIZE)._t
+  );
+
+  const ThermiteRollupTier* hours = rollups.getTier("hour");
+  TEST_ASSERT_EQUAL(2, hours->getCount());
+  TEST_ASSERT_EQUAL(1000, hours->getBucket(0)._tempMin);
+  TEST_ASSERT_EQUAL(6900, hours->getBucket(0)._tempMax);
+}
+
+/**
+ * Reads the rest of `body` after `prefix` into a string.
+ */
+std::string drainChunkedBody(ThermiteChunkedBody& body, const std::string& prefix) {
+  std::string out = prefix;
+  uint8_t buffer[64];
+  size_t len;
+  while ((len = body.fill(buffer, sizeof(buffer))) > 0) {
+    out.append(reinterpret_cast<const char*>(buffer), len);
+  }
+  return out;
+}
+
+void testRollupsBodyStreaming() {
+  ThermiteRollups rollups;
+  time_t tLocal = T_EPOCH + T_OFFSET * 60;
+  int minute = 0;
+  for (; minute < 6; minute++) {
+    rollups.addSample(T_EPOCH + 60 * minute, tLocal + 60 * minute, 10.0f + minute, 17.0f, false);
+  }
+  const ThermiteRollupTier* minutes = rollups.getTier("minute");
+  TEST_ASSERT_EQUAL(6, minutes->getCount());
+
+  // buckets that close partway through a response shift nothing
+  ThermiteRollupsBody body(*minutes);
+  uint8_t buffer[160];
+  size_t len = body.fill(buffer, sizeof(buffer));
+  std::string prefix(reinterpret_cast<const char*>(buffer), len);
+  for (int i = 0; i < 2; i++, minute++) {
+    rollups.addSample(T_EPOCH + 60 * minute, tLocal + 60 * minute, 10.0f + minute, 17.0f, false);
+  }
+  DynamicJsonDocument doc(8192);
+  TEST_ASSERT_FALSE(deserializeJson(doc, drainChunkedBody(body, prefix)));
+  JsonArray buckets = doc["buckets"].as<JsonArray>();
+  TEST_ASSERT_EQUAL(6, buckets.size());
+  for (int i = 0; i < 6; i++) {
+    TEST_ASSERT_EQUAL(T_EPOCH + 60 * i, buckets[i][0].as<long>());
+  }
+
+  // with the ring full, buckets overwritten before they are sent are skipped, not repeated
+  for (; minute < ROLLUP_MINUTE_SIZE + 20; minute++) {
+    rollups.addSample(T_EPOCH + 60 * minute, tLocal + 60 * minute, 10.0f, 17.0f, false);
+  }
+  ThermiteRollupsBody bodyFull(*minutes);
+  len = bodyFull.fill(buffer, sizeof(buffer));
+  prefix.assign(reinterpret_cast<const char*>(buffer), len);
+  for (int i = 0; i < 5; i++, minute++) {
+    rollups.addSample(T_EPOCH + 60 * minute, tLocal + 60 * minute, 10.0f, 17.0f, false);
+  }
+  TEST_ASSERT_FALSE(deserializeJson(doc, drainChunkedBody(bodyFull, prefix)));
+  buckets = doc["buckets"].as<JsonArray>();
+  TEST_ASSERT_LESS_OR_EQUAL(ROLLUP_MINUTE_SIZE + 1, buckets.size());
+  TEST_ASSERT_GREATER_THAN(ROLLUP_MINUTE_SIZE - 5, buckets.size());
+  for (size_t i = 1; i < buckets.size(); i++) {
+    TEST_ASSERT_GREATER_THAN(buckets[i - 1][0].as<long>(), buckets[i][0].as<long>());
+  }
+  TEST_ASSERT_EQUAL(
+    T_EPOCH + 60 * (ROLLUP_MINUTE_SIZE + 19),
+    buckets[buckets.size() - 1][0].as<long>()
+  );
+}
+
+/**
+ * Decodes every record of `block` into `records`, and returns how many there were.
+ */
+int decodeHistoryBlock(const ThermiteHistoryBlock& block, ThermiteHistoryRecord* records) {
+  ThermiteHistoryDecoder decoder;
+  decoder.reset(&block);
+  int count = 0;
+  while (decoder.next(records[count])) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * Adds a sample to `history` every minute from `t`, for `count` minutes, flushing after each
+ * as `ThermiteZones::update()` does.  Returns the time of the next sample.
+ */
+time_t fillHistory(ThermiteHistory& history, time_t t, int count) {
+  for (int i = 0; i < count; i++, t += 60) {
+    long minute = t / 60;
+    history.addSample(t, 20.0f + (minute % 8) * 0.125f, 20.0f, minute % 16 < 8);
+    history.flush();
+  }
+  return t;
+}
+
+/**
+ * Counts the rows of the `"samples"` and `"switches"` arrays of a `GET /history` body.
+ */
+void countHistoryRows(const std::string& body, int& samples, int& switches) {
+  DynamicJsonDocument doc(body.size() * 4 + 1024);
+  TEST_ASSERT_FALSE(deserializeJson(doc, body));
+  samples = doc["samples"]["rows"].size();
+  switches = doc["switches"]["rows"].size();
+}
+
+void testHistoryEncoding() {
+  ThermiteHistory history;
+  TEST_ASSERT_NULL(history.getBlock());
+
+  history.addSample(T_EPOCH, 19.5f, 20.0f, false);
+  history.addSwitch(T_EPOCH, true);
+  history.addSample(T_EPOCH + 60, 19.625f, 20.0f, true);
+  history.addSample(T_EPOCH + 121, 19.75f, 21.5f, true);
+  history.addSwitch(T_EPOCH + 150, false);
+  history.addSample(T_EPOCH + 181, -127.0f, 21.5f, false);
+
+  // time going backwards is dropped, so that blocks stay sorted
+  history.addSample(T_EPOCH + 100, 19.0f, 20.0f, false);
+  TEST_ASSERT_EQUAL(1ul, history.getRecordsDropped());
+
+  const ThermiteHistoryBlock* block = history.getBlock();
+  TEST_ASSERT_NOT_NULL(block);
+  TEST_ASSERT_EQUAL(T_EPOCH, block->t);
+  TEST_ASSERT_EQUAL(6, block->count);
+
+  ThermiteHistoryRecord records[128];
+  TEST_ASSERT_EQUAL(6, decodeHistoryBlock(*block, records));
+  TEST_ASSERT_EQUAL(HISTORY_RECORD_SAMPLE, records[0].kind);
+  TEST_ASSERT_EQUAL(T_EPOCH, records[0].t);
+  TEST_ASSERT_EQUAL(1950, records[0].temp);
+  TEST_ASSERT_EQUAL(2000, records[0].tempTarget);
+  TEST_ASSERT_FALSE(records[0].heater);
+  TEST_ASSERT_EQUAL(HISTORY_RECORD_SWITCH, records[1].kind);
+  TEST_ASSERT_EQUAL(T_EPOCH, records[1].t);
+  TEST_ASSERT_TRUE(records[1].heater);
+  TEST_ASSERT_EQUAL(T_EPOCH + 60, records[2].t);
+  TEST_ASSERT_EQUAL(1963, records[2].temp);
+  TEST_ASSERT_EQUAL(T_EPOCH + 121, records[3].t);
+  TEST_ASSERT_EQUAL(1975, records[3].temp);
+  TEST_ASSERT_EQUAL(2150, records[3].tempTarget);
+  TEST_ASSERT_EQUAL(T_EPOCH + 150, records[4].t);
+  TEST_ASSERT_FALSE(records[4].heater);
+  TEST_ASSERT_EQUAL(T_EPOCH + 181, records[5].t);
+  TEST_ASSERT_EQUAL(-12700, records[5].temp);
+
+  /*
+   * A sample a minute with small changes mostly takes 3 bytes, so a block holds over an hour.
+   * Without a file system, a full block just waits in RAM, and is replaced by the next one.
+   */
+  ThermiteHistory historySteady;
+  fillHistory(historySteady, T_EPOCH, 70);
+  TEST_ASSERT_NULL(historySteady.getPending());
+  fillHistory(historySteady, T_EPOCH + 70 * 60, 20);
+  const ThermiteHistoryBlock* pending = historySteady.getPending();
+  TEST_ASSERT_NOT_NULL(pending);
+  TEST_ASSERT_TRUE(pending->isValid());
+  TEST_ASSERT_GREATER_THAN(sizeof(pending->data) - HISTORY_RECORD_SIZE_MAX, pending->length);
+  TEST_ASSERT_EQUAL(pending->count, decodeHistoryBlock(*pending, records));
+  TEST_ASSERT_EQUAL(90, pending->count + historySteady.getBlock()->count);
+  for (int i = 0; i < pending->count; i++) {
+    TEST_ASSERT_EQUAL(T_EPOCH + 60 * i, records[i].t);
+    long minute = records[i].t / 60;
+    TEST_ASSERT_EQUAL(lroundf((20.0f + (minute % 8) * 0.125f) * 100.0f), records[i].temp);
+    TEST_ASSERT_EQUAL(minute % 16 < 8, records[i].heater);
+  }
+  TEST_ASSERT_EQUAL(0ul, historySteady.getBlocksDropped());
+  fillHistory(historySteady, T_EPOCH + 90 * 60, 90);
+  TEST_ASSERT_EQUAL(1ul, historySteady.getBlocksDropped());
+}
+
+void testHistorySegments() {
+  ThermiteFakeFileSystem fileSystem;
+  ThermiteHistory history;
+  history.setFileSystem(&fileSystem, 0);
+  TEST_ASSERT_FALSE(history.restore());
+
+  // flash is only written a whole block at a time
+  time_t t = fillHistory(history, T_EPOCH, 200);
+  TEST_ASSERT_EQUAL(2ul, history.getBlocksWritten());
+  TEST_ASSERT_EQUAL(2ul, fileSystem.getAppendCount());
+  TEST_ASSERT_EQUAL(2 * HISTORY_BLOCK_SIZE, fileSystem.getSize("/h0-00000000"));
+  TEST_ASSERT_TRUE(history.isSegmentOpen());
+
+  // full segments get an index, and the oldest are removed once there are too many
+  while (history.getBlocksWritten() < (HISTORY_SEGMENT_COUNT + 2) * HISTORY_SEGMENT_BLOCKS + 3) {
+    t = fillHistory(history, t, 1);
+  }
+  TEST_ASSERT_EQUAL(HISTORY_SEGMENT_COUNT, fileSystem.getFileCount());
+  TEST_ASSERT_EQUAL(3ul, history.getSegmentFirst());
+  TEST_ASSERT_EQUAL(HISTORY_SEGMENT_COUNT, history.getSegmentCount());
+  TEST_ASSERT_EQUAL(-1, fileSystem.getSize("/h0-00000002"));
+  TEST_ASSERT_EQUAL(
+    HISTORY_SEGMENT_BLOCKS * HISTORY_BLOCK_SIZE + sizeof(ThermiteHistoryIndex),
+    fileSystem.getSize("/h0-00000003")
+  );
+  TEST_ASSERT_EQUAL(3 * HISTORY_BLOCK_SIZE, fileSystem.getSize("/h0-0000000c"));
+  TEST_ASSERT_EQUAL(0ul, history.getBlocksDropped());
+
+  // a range in the middle of an older segment starts at the right block
+  ThermiteHistoryBlock block;
+  TEST_ASSERT_TRUE(history.readBlock(5, 7, block));
+  time_t from = block.t + 600;
+  TEST_ASSERT_EQUAL(5ul, history.seekSegment(from));
+  TEST_ASSERT_EQUAL(7, history.seekBlock(5, from));
+  TEST_ASSERT_EQUAL(2, history.seekBlock(12, 0xfffffffful));
+  ThermiteFakeHttpRequest request;
+  request.sendChunked(HTTP_OK, new ThermiteHistoryBody(history, from, from + 6 * 3600));
+  int samples;
+  int switches;
+  countHistoryRows(request.getBody(), samples, switches);
+  TEST_ASSERT_EQUAL(6 * 60 + 1, samples);
+  TEST_ASSERT_EQUAL(0, switches);
+
+  // corrupt blocks are skipped
+  fileSystem.corrupt("/h0-00000005", 8 * HISTORY_BLOCK_SIZE + 20);
+  ThermiteFakeHttpRequest requestCorrupt;
+  requestCorrupt.sendChunked(HTTP_OK, new ThermiteHistoryBody(history, from, from + 6 * 3600));
+  int samplesCorrupt;
+  countHistoryRows(requestCorrupt.getBody(), samplesCorrupt, switches);
+  TEST_ASSERT_LESS_THAN(samples, samplesCorrupt);
+  TEST_ASSERT_GREATER_THAN(samples - 100, samplesCorrupt);
+
+  /*
+   * After a reboot, appending picks up where it left off, with whatever was still in RAM
+   * lost, and records from before the newest one on flash dropped.
+   */
+  ThermiteHistory historyRestored;
+  historyRestored.setFileSystem(&fileSystem, 0);
+  TEST_ASSERT_TRUE(historyRestored.restore());
+  TEST_ASSERT_EQUAL(3ul, historyRestored.getSegmentFirst());
+  TEST_ASSERT_EQUAL(HISTORY_SEGMENT_COUNT, historyRestored.getSegmentCount());
+  TEST_ASSERT_TRUE(historyRestored.isSegmentOpen());
+  TEST_ASSERT_EQUAL(3, historyRestored.getSegmentOpenBlocks());
+  fillHistory(historyRestored, T_EPOCH, 1);
+  TEST_ASSERT_EQUAL(1ul, historyRestored.getRecordsDropped());
+  fillHistory(historyRestored, t, 100);
+  TEST_ASSERT_EQUAL(4 * HISTORY_BLOCK_SIZE, fileSystem.getSize("/h0-0000000c"));
+
+  // other zones keep their own segments
+  ThermiteHistory historyOther;
+  historyOther.setFileSystem(&fileSystem, 1);
+  TEST_ASSERT_FALSE(historyOther.restore());
+
+  // a full file system costs the oldest segment
+  fileSystem.setCapacity(fileSystem.getUsed());
+  fillHistory(historyRestored, t + 100 * 60, 100);
+  TEST_ASSERT_EQUAL(1ul, historyRestored.getBlocksDropped());
+  TEST_ASSERT_EQUAL(4ul, historyRestored.getSegmentFirst());
+  TEST_ASSERT_FALSE(historyRestored.isSegmentOpen());
+}
+
+/**
+ * Feeds `count` samples to `downsampler`, and collects what it chooses into `out`.  Returns
+ * how many it chose.
+ */
+int downsampleHistory(
+  ThermiteHistoryDownsampler& downsampler,
+  const ThermiteHistoryRecord* samples,
+  int count,
+  ThermiteHistoryRecord* out
+) {
+  int chosen = 0;
+  for (int i = 0; i <= count; i++) {
+    if (i < count) {
+      downsampler.add(samples[i]);
+    } else {
+      downsampler.finish();
+    }
+    while (downsampler.next(out[chosen])) {
+      chosen++;
+    }
+  }
+  return chosen;
+}
+
+void testHistoryDownsampling() {
+  // two buckets: the spike wins the first, and the trough the second
+  const int16_t temps[10] = { 0, 0, 0, 500, 0, 0, 0, -300, 0, 0 };
+  ThermiteHistoryRecord samples[10];
+  for (int i = 0; i < 10; i++) {
+    samples[i] = { static_cast<uint32_t>(i * 10), HISTORY_RECORD_SAMPLE, false, temps[i], 2000 };
+  }
+  ThermiteHistoryDownsampler downsampler;
+  downsampler.reset(0l, 99l, 4);
+  ThermiteHistoryRecord out[32];
+  TEST_ASSERT_EQUAL(4, downsampleHistory(downsampler, samples, 10, out));
+  const uint32_t expected[4] = { 0ul, 30ul, 70ul, 90ul };
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_EQUAL(expected[i], out[i].t);
+  }
+  TEST_ASSERT_EQUAL(500, out[1].temp);
+  TEST_ASSERT_EQUAL(-300, out[2].temp);
+
+  // the samples either side of each heater edge are kept, even within one bucket
+  for (int i = 0; i < 10; i++) {
+    samples[i].temp = 1900;
+    samples[i].heater = i >= 4 && i < 7;
+  }
+  downsampler.reset(0l, 99l, 3);
+  int chosen = downsampleHistory(downsampler, samples, 10, out);
+  TEST_ASSERT_LESS_OR_EQUAL(3 + 3 * 2, chosen);
+  const uint32_t edges[6] = { 0ul, 30ul, 40ul, 60ul, 70ul, 90ul };
+  int found = 0;
+  for (int i = 0; i < chosen; i++) {
+    if (i > 0) {
+      TEST_ASSERT_LESS_THAN(out[i].t, out[i - 1].t);
+    }
+    if (found < 6 && out[i].t == edges[found]) {
+      TEST_ASSERT_EQUAL(out[i].t >= 40ul && out[i].t < 70ul, out[i].heater);
+      found++;
+    }
+  }
+  TEST_ASSERT_EQUAL(6, found);
+
+  // a week at one sample a minute comes down to about the number of points asked for
+  ThermiteHistoryRecord sample = { 0ul, HISTORY_RECORD_SAMPLE, false, 0, 2000 };
+  downsampler.reset(T_EPOCH, T_EPOCH + HISTORY_RANGE_MAX, 500);
+  chosen = 0;
+  int heaterEdges = 0;
+  uint32_t tLast = 0ul;
+  for (long i = 0; i < HISTORY_RANGE_MAX / 60; i++) {
+    bool heater = (i / 97) % 2 == 1;
+    if (i > 0 && heater != sample.heater) {
+      heaterEdges++;
+    }
+    sample.t = T_EPOCH + i * 60;
+    sample.heater = heater;
+    sample.temp = static_cast<int16_t>(1900 + (i % 97) * (heater ? 3 : -3));
+    downsampler.add(sample);
+    ThermiteHistoryRecord next;
+    while (downsampler.next(next)) {
+      TEST_ASSERT_GREATER_THAN(tLast, next.t);
+      tLast = next.t;
+      chosen++;
+    }
+  }
+  downsampler.finish();
+  ThermiteHistoryRecord next;
+  while (downsampler.next(next)) {
+    tLast = next.t;
+    chosen++;
+  }
+  TEST_ASSERT_EQUAL(sample.t, tLast);
+  TEST_ASSERT_GREATER_THAN(400, chosen - 2 * heaterEdges);
+  TEST_ASSERT_LESS_OR_EQUAL(500 + 3 * heaterEdges, chosen);
+}
+
+void testThermalEstimatorFit() {
+  ThermiteThermalEstimator thermalModel;
+  TestRoom room;
+  TEST_ASSERT_EQUAL(0.0f, thermalModel.getTimeConstant());
+  TEST_ASSERT_EQUAL(-1, thermalModel.getWarmUpTime(17.0f, 20.0f, T_EPOCH));
+
+  // one sample per `THERMAL_MODEL_WINDOW`
+  room.run(thermalModel, 15);
+  TEST_ASSERT_EQUAL(0ul, thermalModel.getSamples());
+  room.run(thermalModel, 1);
+  TEST_ASSERT_EQUAL(1ul, thermalModel.getSamples());
+
+  room.run(thermalModel, 3 * 24 * 60);
+  TEST_ASSERT_EQUAL(3 * 24 * 4 + 1, thermalModel.getSamples());
+  TEST_ASSERT_FLOAT_WITHIN(0.2f, 4.0f, thermalModel.getHeatingRate());
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 5.0f, thermalModel.getTimeConstant());
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 10.0f, thermalModel.getTempEquilibrium());
+
+  // flat out, the room closes in on 30 degrees: 5 * ln(13 / 10) hours from 17 to 20
+  time_t tLocal = T_EPOCH + room.now / 1000ul;
+  TEST_ASSERT_INT_WITHIN(300, 4723, thermalModel.getWarmUpTime(17.0f, 20.0f, tLocal));
+  TEST_ASSERT_EQUAL(0, thermalModel.getWarmUpTime(20.0f, 17.0f, tLocal));
+  TEST_ASSERT_EQUAL(
+    THERMAL_WARM_UP_UNREACHABLE,
+    thermalModel.getWarmUpTime(17.0f, 35.0f, tLocal)
+  );
+
+  // a gap in readings starts a new window, rather than spanning the gap
+  room.now += 3ul * 3600000ul;
+  room.temp = 15.0f;
+  room.run(thermalModel, 14);
+  TEST_ASSERT_EQUAL(3 * 24 * 4 + 1, thermalModel.getSamples());
+  TEST_ASSERT_FLOAT_WITHIN(0.2f, 4.0f, thermalModel.getHeatingRate());
+}
+
+void testThermalEstimatorRecord() {
+  ThermiteThermalEstimator thermalModel;
+  TestRoom room;
+  room.run(thermalModel, 24 * 60);
+
+  ThermiteThermalRecord record;
+  thermalModel.save(record, 0ull);
+  ThermiteThermalEstimator thermalModelRestored;
+  TEST_ASSERT_TRUE(thermalModelRestored.restore(record));
+  TEST_ASSERT_EQUAL(thermalModel.getSamples(), thermalModelRestored.getSamples());
+  TEST_ASSERT_EQUAL_FLOAT(thermalModel.getHeatingRate(), thermalModelRestored.getHeatingRate());
+  TEST_ASSERT_EQUAL_FLOAT(thermalModel.getTimeConstant(), thermalModelRestored.getTimeConstant());
+
+  // anything corrupted, and there is nothing to restore
+  record.theta[1] += 1.0f;
+  ThermiteThermalEstimator thermalModelCorrupt;
+  TEST_ASSERT_FALSE(thermalModelCorrupt.restore(record));
+  TEST_ASSERT_EQUAL(0ul, thermalModelCorrupt.getSamples());
+}
+
+/**
+ * Body longer than any response buffer.
+ */
+struct OversizedBody : public JsonWrite<OversizedBody> {
+  bool toJSON(const JsonObject& root) const {
+    std::string padding(RESPONSE_BUFFER_SIZE, 'x');
+    return root["padding"].set(padding.c_str());
+  }
+};
+
+void testResponsePool() {
+  ThermiteResponsePool responsePool;
+
+  /*
+   * The longest body we send: a heater journal full of edges, with 10-digit timestamps.
+   */
+  ThermiteHeaterRuntime heaterRuntime;
+  for (uint8_t i = 0; i < HEATER_JOURNAL_SIZE + 1; i++) {
+    heaterRuntime.recordSwitch(i % 2 == 0, i * 600000ul, 2000000000l + i * 600l);
+  }
+  ThermiteResponseBuffer buffer = responsePool.serialize(heaterRuntime);
+  TEST_ASSERT_TRUE(buffer.isValid());
+  TEST_ASSERT_EQUAL(RESPONSE_POOL_SIZE - 1, responsePool.getAvailable());
+  TEST_ASSERT_EQUAL(strlen(buffer.getData()), buffer.getLength());
+  TEST_ASSERT_EQUAL_STRING_LEN("{\"switchCount\":33,", buffer.getData(), 18);
+
+  {
+    ThermiteResponseBuffer held[RESPONSE_POOL_SIZE - 1];
+    for (uint8_t i = 0; i < RESPONSE_POOL_SIZE - 1; i++) {
+      held[i] = responsePool.serialize(heaterRuntime);
+      TEST_ASSERT_TRUE(held[i].isValid());
+    }
+    TEST_ASSERT_EQUAL(0, responsePool.getAvailable());
+    TEST_ASSERT_FALSE(responsePool.serialize(heaterRuntime).isValid());
+    TEST_ASSERT_EQUAL(1, responsePool.getExhaustedCount());
+  }
+  TEST_ASSERT_EQUAL(RESPONSE_POOL_SIZE - 1, responsePool.getAvailable());
+
+  ThermiteResponseBuffer moved(std::move(buffer));
+  TEST_ASSERT_FALSE(buffer.isValid());
+  TEST_ASSERT_TRUE(moved.isValid());
+  TEST_ASSERT_EQUAL(RESPONSE_POOL_SIZE - 1, responsePool.getAvailable());
+
+  ThermiteResponseBuffer copy = moved;
+  TEST_ASSERT_EQUAL_PTR(moved.getData(), copy.getData());
+  moved.release();
+  TEST_ASSERT_TRUE(copy.isValid());
+  TEST_ASSERT_EQUAL(RESPONSE_POOL_SIZE - 1, responsePool.getAvailable());
+  copy.release();
+  TEST_ASSERT_EQUAL(RESPONSE_POOL_SIZE, responsePool.getAvailable());
+
+  OversizedBody oversized;
+  TEST_ASSERT_FALSE(responsePool.serialize(oversized).isValid());
+  TEST_ASSERT_EQUAL(1, responsePool.getOverflowCount());
+  TEST_ASSERT_EQUAL(RESPONSE_POOL_SIZE, responsePool.getAvailable());
+}
+
+void testUserSettingsStorePublish() {
+  ThermiteUserSettingsStore userSettingsStore;
+  const ThermiteUserSettingsManager& userSettingsBefore = userSettingsStore.read();
+  uint32_t version = userSettingsStore.getVersion();
+
+  DynamicJsonDocument doc(CAPACITY_USER_SETTINGS_MANAGER);
+  deserializeJson(doc, "{\"weeklySchedule\":4660}");
+  TEST_ASSERT_EQUAL(SETTINGS_UPDATE_OK, userSettingsStore.update(doc.as<JsonObject>()));
+  TEST_ASSERT_EQUAL(4660, userSettingsStore.read()._weeklySchedule);
+  TEST_ASSERT_EQUAL(version + 1, userSettingsStore.getVersion());
+
+  // a reader still holding the old image sees it unchanged
+  TEST_ASSERT_EQUAL(0x2002, userSettingsBefore._weeklySchedule);
+
+  // ...so until the reader passes a quiescent point, updates wait in the pending image, each
+  // on top of the last
+  TEST_ASSERT_FALSE(userSettingsStore.isPending());
+  deserializeJson(doc, "{\"weeklySchedule\":4661}");
+  TEST_ASSERT_EQUAL(SETTINGS_UPDATE_OK, userSettingsStore.update(doc.as<JsonObject>()));
+  deserializeJson(doc, "{\"weeklySchedule\":65535}");
+  TEST_ASSERT_EQUAL(SETTINGS_UPDATE_INVALID, userSettingsStore.update(doc.as<JsonObject>()));
+  deserializeJson(doc, "{\"tempOverride\":19.5}");
+  TEST_ASSERT_EQUAL(SETTINGS_UPDATE_OK, userSettingsStore.update(doc.as<JsonObject>()));
+  TEST_ASSERT_TRUE(userSettingsStore.isPending());
+  TEST_ASSERT_EQUAL(4661, userSettingsStore.readPending()._weeklySchedule);
+  TEST_ASSERT_EQUAL(4660, userSettingsStore.read()._weeklySchedule);
+  TEST_ASSERT_EQUAL(0x2002, userSettingsBefore._weeklySchedule);
+
+  userSettingsStore.quiescent();
+  TEST_ASSERT_FALSE(userSettingsStore.isPending());
+  TEST_ASSERT_EQUAL(4661, userSettingsStore.read()._weeklySchedule);
+  TEST_ASSERT_EQUAL_FLOAT(19.5f, userSettingsStore.read()._tempOverride);
+  TEST_ASSERT_EQUAL(&userSettingsBefore, &userSettingsStore.read());
+  TEST_ASSERT_EQUAL(version + 3, userSettingsStore.getVersion());
+
+  // published at a quiescent point, the reader held neither image, so the next is direct
+  userSettingsStore.quiescent();
+  deserializeJson(doc, "{\"weeklySchedule\":4662}");
+  TEST_ASSERT_EQUAL(SETTINGS_UPDATE_OK, userSettingsStore.update(doc.as<JsonObject>()));
+  TEST_ASSERT_FALSE(userSettingsStore.isPending());
+  TEST_ASSERT_EQUAL(4662, userSettingsStore.read()._weeklySchedule);
+
+  // an update that changes nothing publishes nothing
+  userSettingsStore.quiescent();
+  const ThermiteUserSettingsManager* userSettingsPublished = &userSettingsStore.read();
+  TEST_ASSERT_EQUAL(SETTINGS_UPDATE_OK, userSettingsStore.update(doc.as<JsonObject>()));
+  TEST_ASSERT_EQUAL(userSettingsPublished, &userSettingsStore.read());
+  TEST_ASSERT_EQUAL(version + 4, userSettingsStore.getVersion());
+}
+
+void testUserSettingsStoreCalendarPersist() {
+  ThermiteFakeEeprom eeprom;
+  ThermiteUserSettingsStore userSettingsStore;
+  userSettingsStore.setEeprom(&eeprom, EEPROM_OFFSET_CALENDAR + sizeof(ThermiteCalendarRecord));
+  TEST_ASSERT_FALSE(userSettingsStore.restoreCalendar());
+
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+
+  // nothing to write until the calendar changes
+  zones.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(0ul, eeprom.getCommitCount());
+
+  DynamicJsonDocument doc(CAPACITY_USER_SETTINGS_UPDATE);
+  deserializeJson(doc, "{\"weeklySchedule\":4660}");
+  TEST_ASSERT_EQUAL(SETTINGS_UPDATE_OK, userSettingsStore.update(doc.as<JsonObject>()));
+  zones.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(0ul, eeprom.getCommitCount());
+
+  deserializeJson(
+    doc,
+    "{\"calendar\":[{\"start\":1612224000,\"end\":1612310400,\"tempTarget\":12.5}]}"
+  );
+  TEST_ASSERT_EQUAL(SETTINGS_UPDATE_OK, userSettingsStore.update(doc.as<JsonObject>()));
+  zones.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(1ul, eeprom.getCommitCount());
+  TEST_ASSERT_EQUAL(12.5f, internalState.getTempTarget());
+  zones.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(1ul, eeprom.getCommitCount());
+
+  // after a power cycle, only the calendar is back
+  eeprom.powerCycle();
+  ThermiteUserSettingsStore userSettingsStoreRestored;
+  userSettingsStoreRestored.setEeprom(
+    &eeprom,
+    EEPROM_OFFSET_CALENDAR + sizeof(ThermiteCalendarRecord)
+  );
+  uint32_t version = userSettingsStoreRestored.getVersion();
+  TEST_ASSERT_TRUE(userSettingsStoreRestored.restoreCalendar());
+  TEST_ASSERT_EQUAL(version + 1, userSettingsStoreRestored.getVersion());
+  const ThermiteUserSettingsManager& userSettings = userSettingsStoreRestored.read();
+  TEST_ASSERT_EQUAL(0x2002, userSettings._weeklySchedule);
+  TEST_ASSERT_EQUAL(1, userSettings._calendar._count);
+  TEST_ASSERT_EQUAL(12.5f, userSettings.getTargetTemperature(1612224000l));
+
+  // restoring is not a change, so there is nothing to write back
+  userSettingsStoreRestored.persist();
+  TEST_ASSERT_EQUAL(1ul, eeprom.getCommitCount());
+}
+
+void testZonesRelayWrites() {
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteUserSettingsStore userSettingsStores[2];
+  pinTargetTemperature(userSettingsStores[0], 17.0f);
+  pinTargetTemperature(userSettingsStores[1], 17.0f);
+  ThermiteFakeThermometer thermometers[2] = { 20.0f, 20.0f };
+  ThermiteInternalState internalState0(userSettingsStores[0], thermometers[0], clock);
+  ThermiteInternalState internalState1(userSettingsStores[1], thermometers[1], clock);
+  ThermiteFakeRelay relays[2];
+  ThermiteZones zones;
+  TEST_ASSERT_EQUAL(0, zones.add(userSettingsStores[0], internalState0, relays[0]));
+  TEST_ASSERT_EQUAL(1, zones.add(userSettingsStores[1], internalState1, relays[1]));
+
+  // first update writes every relay
+  zones.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(1, relays[0].getWriteCount());
+  TEST_ASSERT_EQUAL(1, relays[1].getWriteCount());
+
+  // requesting a temperature falls on the periodic refresh, which rewrites everything
+  thermometers[1].setTemperature(15.0f);
+  clock.advance(TEMP_REQUEST_INTERVAL + 1);
+  zones.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(2, relays[0].getWriteCount());
+  TEST_ASSERT_EQUAL(2, relays[1].getWriteCount());
+
+  // only zone 1 gets cold, so only its relay is written
+  clock.advance(TEMP_REQUEST_DELAY + 1);
+  zones.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(0x2, zones.getHeaterMask());
+  TEST_ASSERT_FALSE(relays[0].isOn());
+  TEST_ASSERT_TRUE(relays[1].isOn());
+  TEST_ASSERT_EQUAL(2, relays[0].getWriteCount());
+  TEST_ASSERT_EQUAL(3, relays[1].getWriteCount());
+
+  // nothing changed, nothing written
+  clock.advance(LOOP_INTERVAL);
+  zones.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(2, relays[0].getWriteCount());
+  TEST_ASSERT_EQUAL(3, relays[1].getWriteCount());
+
+  ThermiteZones zonesFull;
+  for (uint8_t i = 0; i < ZONE_COUNT_MAX; i++) {
+    TEST_ASSERT_EQUAL(i, zonesFull.add(userSettingsStores[0], internalState0, relays[0]));
+  }
+  TEST_ASSERT_EQUAL(-1, zonesFull.add(userSettingsStores[0], internalState0, relays[0]));
+}
+
+void testZonesCheckpoint() {
+  ThermiteFakeRtcMemory rtcMemory;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteUserSettingsStore userSettingsStores[2];
+  pinTargetTemperature(userSettingsStores[0], 17.0f);
+  pinTargetTemperature(userSettingsStores[1], 17.0f);
+  ThermiteFakeThermometer thermometers[2] = { 20.0f, 15.0f };
+  ThermiteInternalState internalState0(userSettingsStores[0], thermometers[0], clock);
+  ThermiteInternalState internalState1(userSettingsStores[1], thermometers[1], clock);
+  internalState0.setRtcMemory(&rtcMemory, RTC_OFFSET_CHECKPOINT);
+  internalState1.setRtcMemory(&rtcMemory, RTC_OFFSET_CHECKPOINT + sizeof(ThermiteCheckpoint));
+  ThermiteFakeRelay relays[2];
+  ThermiteZones zones;
+  zones.add(userSettingsStores[0], internalState0, relays[0]);
+  zones.add(userSettingsStores[1], internalState1, relays[1]);
+  zones.setRtcMemory(&rtcMemory, &clock);
+
+  clock.advance(60000ul);
+  rtcMemory.advance(60000ul);
+  zones.update(clock.getMillis());
+  clock.advance(TEMP_REQUEST_DELAY + 1);
+  rtcMemory.advance(TEMP_REQUEST_DELAY + 1);
+  zones.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(0x2, zones.getHeaterMask());
+
+  // The clock was last checkpointed well before the reset, which itself takes a while.
+  clock.advance(30000ul);
+  rtcMemory.advance(30000ul + 5000ul);
+
+  // Soft reset: `millis()` starts over, and there are no readings yet.
+  ThermiteFakeClock clockReset;
+  ThermiteFakeThermometer thermometersReset[2] = { TEMP_DISCONNECTED, TEMP_DISCONNECTED };
+  ThermiteInternalState internalStateReset0(
+    userSettingsStores[0],
+    thermometersReset[0],
+    clockReset
+  );
+  ThermiteInternalState internalStateReset1(
+    userSettingsStores[1],
+    thermometersReset[1],
+    clockReset
+  );
+  internalStateReset0.setRtcMemory(&rtcMemory, RTC_OFFSET_CHECKPOINT);
+  internalStateReset1.setRtcMemory(
+    &rtcMemory,
+    RTC_OFFSET_CHECKPOINT + sizeof(ThermiteCheckpoint)
+  );
+  ThermiteFakeRelay relaysReset[2];
+  ThermiteZones zonesReset;
+  zonesReset.add(userSettingsStores[0], internalStateReset0, relaysReset[0]);
+  zonesReset.add(userSettingsStores[1], internalStateReset1, relaysReset[1]);
+  zonesReset.setRtcMemory(&rtcMemory, &clockReset);
+  TEST_ASSERT_TRUE(zonesReset.restoreCheckpoint(clockReset.getMillis()));
+  TEST_ASSERT_EQUAL(clock.getEpochTime() + 5l, clockReset.getEpochTime());
+
+  // The relays are driven straight away, without running the controllers.
+  zonesReset.writeRelays(clockReset.getMillis());
+  TEST_ASSERT_FALSE(relaysReset[0].isOn());
+  TEST_ASSERT_TRUE(relaysReset[1].isOn());
+  TEST_ASSERT_EQUAL(0ul, thermometersReset[1].getRequestCount());
+
+  // Anything corrupted, and the clock is left alone.
+  rtcMemory.corrupt(RTC_OFFSET_CLOCK + 8);
+  ThermiteFakeClock clockCorrupt;
+  ThermiteZones zonesCorrupt;
+  zonesCorrupt.setRtcMemory(&rtcMemory, &clockCorrupt);
+  TEST_ASSERT_FALSE(zonesCorrupt.restoreCheckpoint(clockCorrupt.getMillis()));
+  TEST_ASSERT_EQUAL(0l, clockCorrupt.getEpochTime());
+}
+
+void testWebControllerGetZones() {
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteUserSettingsStore userSettingsStore0;
+  ThermiteUserSettingsStore userSettingsStore1;
+  pinTargetTemperature(userSettingsStore0, 17.0f);
+  pinTargetTemperature(userSettingsStore1, 19.0f);
+  ThermiteFakeThermometer thermometer0(20.0f);
+  ThermiteFakeThermometer thermometer1(17.5f);
+  ThermiteInternalState internalState0(userSettingsStore0, thermometer0, clock);
+  ThermiteInternalState internalState1(userSettingsStore1, thermometer1, clock);
+  ThermiteFakeRelay relay0;
+  ThermiteFakeRelay relay1;
+  ThermiteZones zones;
+  zones.add(userSettingsStore0, internalState0, relay0);
+  zones.add(userSettingsStore1, internalState1, relay1);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock);
+  ThermiteWebController webController(zones, powerManager);
+
+  clock.advance(TEMP_REQUEST_INTERVAL + 1);
+  zones.update(clock.getMillis());
+  clock.advance(TEMP_REQUEST_DELAY + 1);
+  zones.update(clock.getMillis());
+
+  ThermiteFakeHttpRequest request;
+  request.setPath("/zones");
+  webController.getZones(request);
+  TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"count\":2,\"temp\":[20,17.5],\"tempTarget\":[17,19],\"heater\":[false,true]}",
+    request.getBody().c_str()
+  );
+
+  ThermiteFakeHttpRequest requestZone;
+  requestZone.setPath("/zones/1/internalState");
+  webController.getZones(requestZone);
+  TEST_ASSERT_EQUAL(HTTP_OK, requestZone.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"dateTime\":\"2021-02-02T00:01:00-05:00\",\"heater\":true,\"temp\":17.5,"
+    "\"tempTarget\":19}",
+    requestZone.getBody().c_str()
+  );
+
+  ThermiteFakeHttpRequest requestMissing;
+  requestMissing.setPath("/zones/2/internalState");
+  webController.getZones(requestMissing);
+  TEST_ASSERT_EQUAL(HTTP_NOT_FOUND, requestMissing.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"code\":404,\"message\":\"Zone not found\"}",
+    requestMissing.getBody().c_str()
+  );
+
+  ThermiteFakeHttpRequest requestResource;
+  requestResource.setPath("/zones/0/thermometer");
+  webController.getZones(requestResource);
+  TEST_ASSERT_EQUAL(HTTP_NOT_FOUND, requestResource.getCode());
+
+  DynamicJsonDocument doc(CAPACITY_USER_SETTINGS_MANAGER);
+  deserializeJson(doc, "{\"weeklySchedule\":4660}");
+  ThermiteFakeHttpRequest requestPut;
+  requestPut.setPath("/zones/1/userSettings");
+  webController.putZones(requestPut, doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(HTTP_OK, requestPut.getCode());
+  TEST_ASSERT_EQUAL(4660, userSettingsStore1.read()._weeklySchedule);
+  TEST_ASSERT_NOT_EQUAL(4660, userSettingsStore0.read()._weeklySchedule);
+}
+
+void testAllocProfiler() {
+  ThermiteFakeSystem system;
+  system.setFreeHeap(30000ul);
+  system.setMaxFreeBlock(20000ul);
+  ThermiteAllocProfiler profiler(system);
+
+  // nothing is recorded until the profiler is installed
+  ThermiteAllocProfiler::noteAllocation(64);
+  TEST_ASSERT_EQUAL(0ul, profiler.getAllocations());
+  profiler.install();
+
+  {
+    ThermiteAllocScope scope(&profiler, "GET /a");
+    ThermiteAllocProfiler::noteAllocation(100);
+    system.setFreeHeap(29000ul);
+    ThermiteAllocProfiler::noteAllocation(200);
+    system.setFreeHeap(29800ul);
+    system.setMaxFreeBlock(19500ul);
+
+    // nested scopes are folded into the running one
+    ThermiteAllocScope nested(&profiler, "GET /b");
+    ThermiteAllocProfiler::noteAllocation(50);
+  }
+  {
+    ThermiteAllocScope scope(&profiler, "GET /a");
+    ThermiteAllocProfiler::noteAllocation(10);
+  }
+  ThermiteAllocProfiler::noteAllocation(1000);
+
+  TEST_ASSERT_EQUAL(1, profiler.getCount());
+  TEST_ASSERT_NULL(profiler.getProfile("GET /b"));
+  const ThermiteAllocProfile* profile = profiler.getProfile("GET /a");
+  TEST_ASSERT_NOT_NULL(profile);
+  TEST_ASSERT_EQUAL(2ul, profile->calls);
+  TEST_ASSERT_EQUAL(4ul, profile->allocations);
+  TEST_ASSERT_EQUAL(360ul, profile->bytes);
+  TEST_ASSERT_EQUAL(1000ul, profile->peak);
+  TEST_ASSERT_EQUAL(-500l, profile->maxFreeBlockDelta);
+  TEST_ASSERT_EQUAL(5ul, profiler.getAllocations());
+  TEST_ASSERT_EQUAL(29000ul, profiler.getFreeHeapMin());
+
+  // once the names run out, further scopes record nothing
+  const char* names[ALLOC_PROFILE_SIZE] = {
+    "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15"
+  };
+  for (uint8_t i = 0; i < ALLOC_PROFILE_SIZE; i++) {
+    ThermiteAllocScope scope(&profiler, names[i]);
+  }
+  TEST_ASSERT_EQUAL(ALLOC_PROFILE_SIZE, profiler.getCount());
+  TEST_ASSERT_NULL(profiler.getProfile("15"));
+  profiler.uninstall();
+
+  // and against the real allocator, where the hooks can replace it
+  if (!thermiteHostHeapIsHooked()) {
+    return;
+  }
+  ThermiteHostSystem hostSystem;
+  ThermiteAllocProfiler hostProfiler(hostSystem);
+  hostProfiler.install();
+  {
+    ThermiteAllocScope scope(&hostProfiler, "malloc");
+    void* volatile blocks[4];
+    for (int i = 0; i < 4; i++) {
+      blocks[i] = malloc(1000);
+    }
+    for (int i = 0; i < 4; i++) {
+      free(blocks[i]);
+    }
+  }
+  profile = hostProfiler.getProfile("malloc");
+  TEST_ASSERT_NOT_NULL(profile);
+  TEST_ASSERT_EQUAL(4ul, profile->allocations);
+  TEST_ASSERT_EQUAL(4000ul, profile->bytes);
+  TEST_ASSERT_GREATER_OR_EQUAL(4000ul, profile->peak);
+  TEST_ASSERT_LESS_THAN(4200ul, profile->peak);
+}
+
+void testWebControllerGetInternalState() {
+  ThermiteUserSettingsStore userSettingsStore;
+  pinTargetTemperature(userSettingsStore, 17.0f);
+  ThermiteFakeThermometer thermometer(20.0f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+  ThermiteWebController webController(zones, powerManager);
+
+  sampleTemperature(internalState, clock);
+
+  ThermiteFakeHttpRequest request;
+  webController.getInternalState(request);
+  TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"dateTime\":\"2021-02-02T00:01:00-05:00\",\"heater\":false,\"temp\":20,\"tempTarget\":17}",
+    request.getBody().c_str()
+  );
+}
+
+void testWebControllerGetHeaterRuntime() {
+  ThermiteUserSettingsStore userSettingsStore;
+  pinTargetTemperature(userSettingsStore, 17.0f);
+  ThermiteFakeThermometer thermometer(15.0f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+  ThermiteWebController webController(zones, powerManager);
+
+  sampleTemperature(internalState, clock);
+  clock.advance(TEMP_REQUEST_INTERVAL - TEMP_REQUEST_DELAY);
+  internalState.update(clock.getMillis());
+
+  ThermiteFakeHttpRequest request;
+  webController.getHeaterRuntime(request);
+  TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"switchCount\":1,\"runtimeToday\":59,\"runtime7Days\":59,\"runtimeLifetime\":59,"
+    "\"journal\":[{\"t\":1612242060,\"on\":true}]}",
+    request.getBody().c_str()
+  );
+}
+
+void testWebControllerGetRollups() {
+  ThermiteUserSettingsStore userSettingsStore;
+  pinTargetTemperature(userSettingsStore, 17.0f);
+  ThermiteFakeThermometer thermometer(15.25f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+  ThermiteWebController webController(zones, powerManager);
+
+  sampleTemperature(internalState, clock);
+  thermometer.setTemperature(-0.5f);
+  sampleTemperature(internalState, clock);
+
+  ThermiteFakeHttpRequest request;
+  request.setParam("tier", "hour");
+  webController.getRollups(request);
+  TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"tier\":\"hour\",\"width\":3600,\"columns\":[\"t\",\"tempMin\",\"tempMax\","
+    "\"tempMean\",\"tempTargetMean\",\"heaterDuty\"],"
+    "\"buckets\":[[1612242000,-0.50,15.25,7.38,17.00,100]]}",
+    request.getBody().c_str()
+  );
+
+  ThermiteFakeHttpRequest requestEmpty;
+  requestEmpty.setParam("tier", "day");
+  ThermiteInternalState internalStateEmpty(userSettingsStore, thermometer, clock);
+  ThermiteZones zonesEmpty;
+  zonesEmpty.add(userSettingsStore, internalStateEmpty, relay);
+  ThermiteWebController webControllerEmpty(zonesEmpty, powerManager);
+  webControllerEmpty.getRollups(requestEmpty);
+  TEST_ASSERT_EQUAL(HTTP_OK, requestEmpty.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"tier\":\"day\",\"width\":86400,\"columns\":[\"t\",\"tempMin\",\"tempMax\","
+    "\"tempMean\",\"tempTargetMean\",\"heaterDuty\"],\"buckets\":[]}",
+    requestEmpty.getBody().c_str()
+  );
+
+  ThermiteFakeHttpRequest requestInvalid;
+  requestInvalid.setParam("tier", "week");
+  webController.getRollups(requestInvalid);
+  TEST_ASSERT_EQUAL(HTTP_BAD_REQUEST, requestInvalid.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"code\":400,\"message\":\"Invalid rollup tier\"}",
+    requestInvalid.getBody().c_str()
+  );
+
+  ThermiteFakeHttpRequest requestMissing;
+  webController.getRollups(requestMissing);
+  TEST_ASSERT_EQUAL(HTTP_BAD_REQUEST, requestMissing.getCode());
+
+  // While every chunked body slot is still being sent, there is no room for another.
+  const ThermiteRollupTier& tier = *internalState.getRollups().getTier("hour");
+  ThermiteChunkedBody* bodies[CHUNKED_BODY_SLOTS];
+  for (uint8_t i = 0; i < CHUNKED_BODY_SLOTS; i++) {
+    bodies[i] = new ThermiteRollupsBody(tier);
+    TEST_ASSERT_NOT_NULL(bodies[i]);
+  }
+  ThermiteFakeHttpRequest requestBusy;
+  requestBusy.setParam("tier", "hour");
+  webController.getRollups(requestBusy);
+  TEST_ASSERT_EQUAL(HTTP_SERVICE_UNAVAILABLE, requestBusy.getCode());
+  TEST_ASSERT_EQUAL_STRING("{\"code\":503,\"message\":\"Server busy\"}", requestBusy.getBody().c_str());
+
+  delete bodies[0];
+  ThermiteFakeHttpRequest requestFreed;
+  requestFreed.setParam("tier", "hour");
+  webController.getRollups(requestFreed);
+  TEST_ASSERT_EQUAL(HTTP_OK, requestFreed.getCode());
+  for (uint8_t i = 1; i < CHUNKED_BODY_SLOTS; i++) {
+    delete bodies[i];
+  }
+}
+
+void testWebControllerGetHistory() {
+  ThermiteUserSettingsStore userSettingsStore;
+  pinTargetTemperature(userSettingsStore, 17.0f);
+  ThermiteFakeThermometer thermometer(15.25f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeFileSystem fileSystem;
+  internalState.setFileSystem(&fileSystem);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+  ThermiteWebController webController(zones, powerManager);
+
+  sampleTemperature(internalState, clock);
+  thermometer.setTemperature(18.5f);
+  sampleTemperature(internalState, clock);
+
+  ThermiteFakeHttpRequest request;
+  request.setParam("from", "1612242000");
+  request.setParam("to", "1612245600");
+  webController.getHistory(request);
+  TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"from\":1612242000,\"to\":1612245600,"
+    "\"samples\":{\"columns\":[\"t\",\"temp\",\"tempTarget\",\"heater\"],\"rows\":["
+    "[1612242060,15.25,17.00,1],[1612242120,18.50,17.00,0]]},"
+    "\"switches\":{\"columns\":[\"t\",\"heater\"],\"rows\":[[1612242060,1],[1612242120,0]]}}",
+    request.getBody().c_str()
+  );
+
+  // a day later, most of it is on flash, written from `ThermiteZones::update()`
+  for (int i = 0; i < 24 * 60; i++) {
+    clock.advance(TEMP_REQUEST_INTERVAL + 1);
+    zones.update(clock.getMillis());
+    clock.advance(TEMP_REQUEST_DELAY + 1);
+    zones.update(clock.getMillis());
+  }
+  const ThermiteHistory& history = internalState.getHistory();
+  TEST_ASSERT_EQUAL(HISTORY_SEGMENT_BLOCKS + 3, history.getBlocksWritten());
+
+  // one append per block, plus the index of the full segment
+  TEST_ASSERT_EQUAL(history.getBlocksWritten() + 1, fileSystem.getAppendCount());
+
+  ThermiteFakeHttpRequest requestZone;
+  requestZone.setPath("/zones/0/history");
+  requestZone.setParam("from", "1612242000");
+  requestZone.setParam("to", "1612328400");
+  webController.getZones(requestZone);
+  TEST_ASSERT_EQUAL(HTTP_OK, requestZone.getCode());
+  int samples;
+  int switches;
+  countHistoryRows(requestZone.getBody(), samples, switches);
+  TEST_ASSERT_INT_WITHIN(10, 24 * 60, samples);
+  TEST_ASSERT_EQUAL(2, switches);
+
+  const char* invalid[][2] = {
+    { nullptr, "1612245600" },
+    { "1612242000", "later" },
+    { "1612245600", "1612242000" },
+    { "1612242000", "1612932000" },
+  };
+  for (const auto& range : invalid) {
+    ThermiteFakeHttpRequest requestInvalid;
+    if (range[0] != nullptr) {
+      requestInvalid.setParam("from", range[0]);
+    }
+    requestInvalid.setParam("to", range[1]);
+    webController.getHistory(requestInvalid);
+    TEST_ASSERT_EQUAL(HTTP_BAD_REQUEST, requestInvalid.getCode());
+    TEST_ASSERT_EQUAL_STRING(
+      "{\"code\":400,\"message\":\"Invalid time range\"}",
+      requestInvalid.getBody().c_str()
+    );
+  }
+
+  // downsampled, the day comes down to the points asked for, and every switch is still there
+  ThermiteFakeHttpRequest requestPoints;
+  requestPoints.setParam("from", "1612242000");
+  requestPoints.setParam("to", "1612328400");
+  requestPoints.setParam("points", "100");
+  webController.getHistory(requestPoints);
+  TEST_ASSERT_EQUAL(HTTP_OK, requestPoints.getCode());
+  const char* header = "{\"from\":1612242000,\"to\":1612328400,\"points\":100,\"samples\":";
+  TEST_ASSERT_EQUAL_STRING_LEN(header, requestPoints.getBody().c_str(), strlen(header));
+  countHistoryRows(requestPoints.getBody(), samples, switches);
+  TEST_ASSERT_GREATER_THAN(90, samples);
+  TEST_ASSERT_LESS_OR_EQUAL(100 + 3 * 2, samples);
+  TEST_ASSERT_EQUAL(2, switches);
+
+  const char* invalidPoints[] = { "2", "4001", "", "-5", "100px" };
+  for (const char* points : invalidPoints) {
+    ThermiteFakeHttpRequest requestInvalid;
+    requestInvalid.setParam("from", "1612242000");
+    requestInvalid.setParam("to", "1612245600");
+    requestInvalid.setParam("points", points);
+    webController.getHistory(requestInvalid);
+    TEST_ASSERT_EQUAL(HTTP_BAD_REQUEST, requestInvalid.getCode());
+    TEST_ASSERT_EQUAL_STRING(
+      "{\"code\":400,\"message\":\"Invalid points\"}",
+      requestInvalid.getBody().c_str()
+    );
+  }
+}
+
+void testWebControllerGetPower() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock, POWER_MODE_MODEM_SLEEP, 1);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+  ThermiteWebController webController(zones, powerManager);
+
+  powerManager.update(clock.getMillis(), 60000ul);
+  clock.advance(60000ul);
+  ThermiteFakeHttpRequest request;
+  webController.getPower(request);
+  TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  TEST_ASSERT_EQUAL(POWER_MODE_AWAKE, radio.getMode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"mode\":1,\"listenInterval\":1,\"timeAwake\":0,\"timeModemSleep\":59,"
+    "\"timeLightSleep\":0,\"currentAverage\":15.165,\"wakeLatencyMax\":103,"
+    "\"requests\":1,\"requestsAsleep\":1}",
+    request.getBody().c_str()
+  );
+}
+
+void testWebControllerGetAllocProfile() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+  ThermiteWebController webController(zones, powerManager);
+
+  // only builds that profile expose the route
+  ThermiteFakeHttpRequest requestMissing;
+  webController.getAllocProfile(requestMissing);
+  TEST_ASSERT_EQUAL(HTTP_NOT_FOUND, requestMissing.getCode());
+
+  ThermiteFakeSystem system;
+  system.setFreeHeap(30000ul);
+  ThermiteAllocProfiler profiler(system);
+  webController.setAllocProfiler(&profiler);
+  ThermiteFakeHttpRequest requestEmpty;
+  webController.getAllocProfile(requestEmpty);
+  TEST_ASSERT_EQUAL(HTTP_OK, requestEmpty.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"freeHeap\":30000,\"freeHeapMin\":30000,\"maxFreeBlock\":32000,\"allocations\":0,"
+    "\"columns\":[\"name\",\"calls\",\"allocations\",\"bytes\",\"peak\","
+    "\"maxFreeBlockDelta\"],\"rows\":[]}",
+    requestEmpty.getBody().c_str()
+  );
+
+  // each route is recorded under its own name, against the real heap where it is hooked
+  ThermiteHostSystem hostSystem;
+  ThermiteAllocProfiler hostProfiler(hostSystem);
+  hostProfiler.install();
+  webController.setAllocProfiler(&hostProfiler);
+  for (int i = 0; i < 3; i++) {
+    ThermiteFakeHttpRequest request;
+    webController.getInternalState(request);
+    TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  }
+  ThermiteFakeHttpRequest requestZone;
+  requestZone.setPath("/zones/0/userSettings");
+  webController.getZones(requestZone);
+  TEST_ASSERT_EQUAL(HTTP_OK, requestZone.getCode());
+  ThermiteFakeHttpRequest requestNotFound;
+  webController.notFound(requestNotFound);
+
+  const ThermiteAllocProfile* profile = hostProfiler.getProfile("GET /internalState");
+  TEST_ASSERT_NOT_NULL(profile);
+  TEST_ASSERT_EQUAL(3ul, profile->calls);
+  profile = hostProfiler.getProfile("GET /userSettings");
+  TEST_ASSERT_NOT_NULL(profile);
+  TEST_ASSERT_EQUAL(1ul, profile->calls);
+  profile = hostProfiler.getProfile("notFound");
+  TEST_ASSERT_NOT_NULL(profile);
+  TEST_ASSERT_EQUAL(1ul, profile->calls);
+
+  if (thermiteHostHeapIsHooked()) {
+    // `/internalState` fits its response in a pooled buffer, with no more than the JSON
+    // document on the heap
+    profile = hostProfiler.getProfile("GET /internalState");
+    TEST_ASSERT_GREATER_THAN(0ul, profile->allocations);
+    TEST_ASSERT_LESS_OR_EQUAL(CAPACITY_INTERNAL_STATE + 1024, profile->peak);
+  }
+
+  ThermiteFakeHttpRequest request;
+  webController.getAllocProfile(request);
+  TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  DynamicJsonDocument doc(4096);
+  TEST_ASSERT_FALSE(deserializeJson(doc, request.getBody().c_str()));
+  TEST_ASSERT_EQUAL_STRING("peak", doc["columns"][4].as<const char*>());
+  JsonArray rows = doc["rows"].as<JsonArray>();
+  TEST_ASSERT_EQUAL(3, rows.size());
+  TEST_ASSERT_EQUAL_STRING("GET /internalState", rows[0][0].as<const char*>());
+  TEST_ASSERT_EQUAL(3, rows[0][1].as<int>());
+  TEST_ASSERT_EQUAL_STRING("notFound", rows[2][0].as<const char*>());
+}
+
+void testWebControllerGetThermalModel() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+  ThermiteWebController webController(zones, powerManager);
+
+  // nothing learned yet, so no time constant to report
+  const char* body = "{\"samples\":0,\"heatingRate\":0,\"heatingRateError\":10,\"residual\":1}";
+  ThermiteFakeHttpRequest request;
+  webController.getThermalModel(request);
+  TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  TEST_ASSERT_EQUAL_STRING(body, request.getBody().c_str());
+
+  ThermiteFakeHttpRequest requestZone;
+  requestZone.setPath("/zones/0/thermalModel");
+  webController.getZones(requestZone);
+  TEST_ASSERT_EQUAL(HTTP_OK, requestZone.getCode());
+  TEST_ASSERT_EQUAL_STRING(body, requestZone.getBody().c_str());
+}
+
+void testWebControllerPutUserSettings() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+  ThermiteWebController webController(zones, powerManager);
+
+  DynamicJsonDocument doc(CAPACITY_USER_SETTINGS_MANAGER);
+  deserializeJson(doc, "{\"weeklySchedule\":4660}");
+  ThermiteFakeHttpRequest request;
+  webController.putUserSettings(request, doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  TEST_ASSERT_EQUAL(4660, userSettingsStore.read()._weeklySchedule);
+
+  deserializeJson(doc, "{\"weeklySchedule\":65535}");
+  ThermiteFakeHttpRequest requestInvalid;
+  webController.putUserSettings(requestInvalid, doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(HTTP_BAD_REQUEST, requestInvalid.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"code\":400,\"message\":\"Invalid user settings\"}",
+    requestInvalid.getBody().c_str()
+  );
+  TEST_ASSERT_EQUAL(4660, userSettingsStore.read()._weeklySchedule);
+
+  // a quick second edit, before the loop has run, is queued rather than refused, and the
+  // response already shows it
+  deserializeJson(doc, "{\"weeklySchedule\":4661}");
+  ThermiteFakeHttpRequest requestQueued;
+  webController.putUserSettings(requestQueued, doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(HTTP_OK, requestQueued.getCode());
+  TEST_ASSERT_NOT_EQUAL(
+    std::string::npos,
+    requestQueued.getBody().find("\"weeklySchedule\":4661")
+  );
+  TEST_ASSERT_EQUAL(4660, userSettingsStore.read()._weeklySchedule);
+
+  deserializeJson(doc, "{\"tempOverride\":19.5}");
+  ThermiteFakeHttpRequest requestQueuedAgain;
+  webController.putUserSettings(requestQueuedAgain, doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(HTTP_OK, requestQueuedAgain.getCode());
+
+  zones.update(clock.getMillis());
+  TEST_ASSERT_EQUAL(4661, userSettingsStore.read()._weeklySchedule);
+  TEST_ASSERT_EQUAL_FLOAT(19.5f, userSettingsStore.read()._tempOverride);
+  ThermiteFakeHttpRequest requestAfter;
+  webController.getUserSettings(requestAfter);
+  TEST_ASSERT_NOT_EQUAL(
+    std::string::npos,
+    requestAfter.getBody().find("\"weeklySchedule\":4661")
+  );
+}
+
+void testWebControllerCalendar() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+  ThermiteWebController webController(zones, powerManager);
+
+  ThermiteFakeHttpRequest requestEmpty;
+  webController.getCalendar(requestEmpty);
+  TEST_ASSERT_EQUAL(HTTP_OK, requestEmpty.getCode());
+  TEST_ASSERT_EQUAL_STRING("{\"calendar\":[]}", requestEmpty.getBody().c_str());
+
+  DynamicJsonDocument doc(CAPACITY_USER_SETTINGS_UPDATE);
+  deserializeJson(
+    doc,
+    "{\"calendar\":["
+      "{\"start\":1612310400,\"end\":1612396800,\"dailySchedule\":2},"
+      "{\"start\":1612224000,\"end\":1612227600,\"tempTarget\":12.5}"
+    "]}"
+  );
+  ThermiteFakeHttpRequest request;
+  request.setPath("/zones/0/calendar");
+  webController.putZones(request, doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"calendar\":["
+      "{\"start\":1612224000,\"end\":1612227600,\"tempTarget\":12.5},"
+      "{\"start\":1612310400,\"end\":1612396800,\"dailySchedule\":2}"
+    "]}",
+    request.getBody().c_str()
+  );
+  zones.update(clock.getMillis());
+
+  // other settings are not accepted here
+  deserializeJson(doc, "{\"calendar\":[],\"weeklySchedule\":4660}");
+  ThermiteFakeHttpRequest requestOther;
+  webController.putCalendar(requestOther, doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(HTTP_BAD_REQUEST, requestOther.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"code\":400,\"message\":\"Invalid calendar\"}",
+    requestOther.getBody().c_str()
+  );
+
+  deserializeJson(doc, "{\"calendar\":[{\"start\":1612224000,\"end\":1612224000,\"tempTarget\":12}]}");
+  ThermiteFakeHttpRequest requestInvalid;
+  webController.putCalendar(requestInvalid, doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(HTTP_BAD_REQUEST, requestInvalid.getCode());
+  TEST_ASSERT_EQUAL(2, userSettingsStore.read()._calendar._count);
+
+  // temperatures are not rounded to the 0.25 °C grid, but refused
+  deserializeJson(doc, "{\"calendar\":[{\"start\":1612224000,\"end\":1612227600,\"tempTarget\":17.1}]}");
+  ThermiteFakeHttpRequest requestOffGrid;
+  webController.putCalendar(requestOffGrid, doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(HTTP_BAD_REQUEST, requestOffGrid.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"code\":400,\"message\":\"Invalid calendar\"}",
+    requestOffGrid.getBody().c_str()
+  );
+  TEST_ASSERT_EQUAL(2, userSettingsStore.read()._calendar._count);
+
+  deserializeJson(doc, "{\"calendar\":[]}");
+  ThermiteFakeHttpRequest requestClear;
+  webController.putCalendar(requestClear, doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(HTTP_OK, requestClear.getCode());
+  TEST_ASSERT_EQUAL_STRING("{\"calendar\":[]}", requestClear.getBody().c_str());
+}
+
+void testWebControllerScheduleTimeline() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+  ThermiteWebController webController(zones, powerManager);
+
+  /*
+   * Tuesday 2021-02-02 follows "Work from Home"; the override runs 06:15-07:15, and
+   * Wednesday is a day off.
+   */
+  DynamicJsonDocument doc(CAPACITY_USER_SETTINGS_UPDATE);
+  deserializeJson(
+    doc,
+    "{\"tempOverride\":18.5,\"overrideStart\":1612246500,\"overrideEnd\":1612250100,"
+    "\"calendar\":[{\"start\":1612310400,\"end\":1612396800,\"dailySchedule\":2}]}"
+  );
+  TEST_ASSERT_EQUAL(SETTINGS_UPDATE_OK, userSettingsStore.update(doc.as<JsonObject>()));
+
+  ThermiteFakeHttpRequest request;
+  request.setParam("from", "1612224000");
+  request.setParam("to", "1612339200");
+  webController.getScheduleTimeline(request);
+  TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"from\":1612224000,\"to\":1612339200,"
+    "\"columns\":[\"start\",\"end\",\"setPoint\",\"tempTarget\",\"source\"],\"segments\":["
+    "[1612224000,1612246500,2,16.00,\"weekly\"],"
+    "[1612246500,1612250100,null,18.50,\"override\"],"
+    "[1612250100,1612252800,1,17.00,\"weekly\"],"
+    "[1612252800,1612285200,0,20.00,\"weekly\"],"
+    "[1612285200,1612299600,1,17.00,\"weekly\"],"
+    "[1612299600,1612310400,2,16.00,\"weekly\"],"
+    "[1612310400,1612339200,2,16.00,\"calendar\"]]}",
+    request.getBody().c_str()
+  );
+
+  ThermiteFakeHttpRequest requestZone;
+  requestZone.setPath("/zones/0/schedule/timeline");
+  requestZone.setParam("from", "1612224000");
+  requestZone.setParam("to", "1612225800");
+  webController.getZones(requestZone);
+  TEST_ASSERT_EQUAL(HTTP_OK, requestZone.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"from\":1612224000,\"to\":1612225800,"
+    "\"columns\":[\"start\",\"end\",\"setPoint\",\"tempTarget\",\"source\"],\"segments\":["
+    "[1612224000,1612225800,2,16.00,\"weekly\"]]}",
+    requestZone.getBody().c_str()
+  );
+
+  const char* invalid[][2] = {
+    { nullptr, "1612225800" },
+    { "1612224000", "tomorrow" },
+    { "1612225800", "1612224000" },
+    { "1612224000", "1614988800" },
+  };
+  for (const char** params : invalid) {
+    ThermiteFakeHttpRequest requestInvalid;
+    if (params[0] != nullptr) {
+      requestInvalid.setParam("from", params[0]);
+    }
+    requestInvalid.setParam("to", params[1]);
+    webController.getScheduleTimeline(requestInvalid);
+    TEST_ASSERT_EQUAL(HTTP_BAD_REQUEST, requestInvalid.getCode());
+    TEST_ASSERT_EQUAL_STRING(
+      "{\"code\":400,\"message\":\"Invalid time range\"}",
+      requestInvalid.getBody().c_str()
+    );
+  }
+}
+
+void testWebControllerSnapshots() {
+  ThermiteUserSettingsStore userSettingsStore;
+  pinTargetTemperature(userSettingsStore, 17.0f);
+  ThermiteFakeThermometer thermometer(20.0f);
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+  ThermiteWebController webController(zones, powerManager);
+  const ThermiteResponsePool& responsePool = webController.getResponsePool();
+
+  sampleTemperature(internalState, clock);
+  ThermiteFakeHttpRequest request;
+  webController.getInternalState(request);
+  webController.getInternalState(request);
+  TEST_ASSERT_EQUAL(HTTP_OK, request.getCode());
+  TEST_ASSERT_EQUAL(1, responsePool.getSerializeCount());
+
+  // a new second only moves dateTime, which is sent outside the snapshot
+  clock.advance(1000ul);
+  webController.getInternalState(request);
+  TEST_ASSERT_EQUAL(1, responsePool.getSerializeCount());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"dateTime\":\"2021-02-02T00:01:01-05:00\",\"heater\":false,\"temp\":20,"
+    "\"tempTarget\":17}",
+    request.getBody().c_str()
+  );
+
+  // a new reading makes the snapshot stale
+  thermometer.setTemperature(15.0f);
+  sampleTemperature(internalState, clock);
+  webController.getInternalState(request);
+  TEST_ASSERT_EQUAL(2, responsePool.getSerializeCount());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"dateTime\":\"2021-02-02T00:02:01-05:00\",\"heater\":true,\"temp\":15,"
+    "\"tempTarget\":17}",
+    request.getBody().c_str()
+  );
+
+  webController.getUserSettings(request);
+  webController.getUserSettings(request);
+  TEST_ASSERT_EQUAL(3, responsePool.getSerializeCount());
+  std::string body = request.getBody();
+
+  // a PUT that changes nothing keeps the snapshot
+  DynamicJsonDocument doc(CAPACITY_USER_SETTINGS_MANAGER);
+  deserializeJson(doc, "{\"weeklySchedule\":8194}");
+  ThermiteFakeHttpRequest requestPut;
+  webController.putUserSettings(requestPut, doc.as<JsonVariant>());
+  TEST_ASSERT_EQUAL(HTTP_OK, requestPut.getCode());
+  TEST_ASSERT_EQUAL(3, responsePool.getSerializeCount());
+  TEST_ASSERT_EQUAL_STRING(body.c_str(), requestPut.getBody().c_str());
+
+  deserializeJson(doc, "{\"weeklySchedule\":4660}");
+  webController.putUserSettings(requestPut, doc.as<JsonVariant>());
+  webController.getUserSettings(request);
+  TEST_ASSERT_EQUAL(4, responsePool.getSerializeCount());
+  TEST_ASSERT_EQUAL_STRING(requestPut.getBody().c_str(), request.getBody().c_str());
+
+  // snapshots hold one buffer each
+  TEST_ASSERT_EQUAL(RESPONSE_POOL_SIZE - 2, responsePool.getAvailable());
+}
+
+void testWebControllerNotFound() {
+  ThermiteUserSettingsStore userSettingsStore;
+  ThermiteFakeThermometer thermometer;
+  ThermiteFakeClock clock(T_EPOCH, T_OFFSET);
+  ThermiteInternalState internalState(userSettingsStore, thermometer, clock);
+  ThermiteFakeRadio radio;
+  ThermitePowerManager powerManager(radio, clock);
+  ThermiteFakeRelay relay;
+  ThermiteZones zones;
+  zones.add(userSettingsStore, internalState, relay);
+  ThermiteWebController webController(zones, powerManager);
+
+  ThermiteFakeHttpRequest request;
+  webController.notFound(request);
+  TEST_ASSERT_EQUAL(HTTP_NOT_FOUND, request.getCode());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"code\":404,\"message\":\"Not Found\"}",
+    request.getBody().c_str()
+  );
+
+  ThermiteFakeHttpRequest requestPreflight(true);
+  webController.notFound(requestPreflight);
+  TEST_ASSERT_EQUAL(HTTP_NO_CONTENT, requestPreflight.getCode());
+  TEST_ASSERT_EQUAL_STRING("", requestPreflight.getBody().c_str());
+}
+
+int main() {
+  UNITY_BEGIN();
+
+  RUN_TEST(testInternalStateInitDisconnected);
+  RUN_TEST(testInternalStateTempRequestDelay);
+  RUN_TEST(testInternalStateTempTargetSchedule);
+  RUN_TEST(testInternalStateHeaterHysteresis);
+  RUN_TEST(testInternalStateMillisWraparound);
+  RUN_TEST(testInternalStateHeaterMinOnOffTime);
+  RUN_TEST(testInternalStateHeaterMaxCyclesPerHour);
+  RUN_TEST(testInternalStateHeaterRuntime);
+  RUN_TEST(testInternalStateUpdateDelay);
+  RUN_TEST(testInternalStateDateTimeIso);
+  RUN_TEST(testInternalStateSleepDelay);
+  RUN_TEST(testInternalStateCheckpoint);
+  RUN_TEST(testInternalStateThermalModel);
+  RUN_TEST(testInternalStatePreheat);
+  RUN_TEST(testInternalStateTelemetry);
+
+  RUN_TEST(testPowerManagerAwake);
+  RUN_TEST(testPowerManagerLightSleep);
+
+  RUN_TEST(testWifiConnectorCache);
+  RUN_TEST(testWifiConnectorBackoff);
+
+  RUN_TEST(testRollupsBucketClose);
+  RUN_TEST(testRollupsRingWraparound);
+  RUN_TEST(testRollupsBodyStreaming);
+
+  RUN_TEST(testHistoryEncoding);
+  RUN_TEST(testHistorySegments);
+  RUN_TEST(testHistoryDownsampling);
+
+  RUN_TEST(testThermalEstimatorFit);
+  RUN_TEST(testThermalEstimatorRecord);
+
+  RUN_TEST(testResponsePool);
+
+  RUN_TEST(testUserSettingsStorePublish);
+  RUN_TEST(testUserSettingsStoreCalendarPersist);
+
+  RUN_TEST(testZonesRelayWrites);
+  RUN_TEST(testZonesCheckpoint);
+
+  RUN_TEST(testAllocProfiler);
+  RUN_TEST(testWebControllerGetInternalState);
+  RUN_TEST(testWebControllerGetHeaterRuntime);
+  RUN_TEST(testWebControllerGetPower);
+  RUN_TEST(testWebControllerGetAllocProfile);
+  RUN_TEST(testWebControllerGetRollups);
+  RUN_TEST(testWebControllerGetHistory);
+  RUN_TEST(testWebControllerGetThermalModel);
+  RUN_TEST(testWebControllerGetZones);
+  RUN_TEST(testWebControllerPutUserSettings);
+  RUN_TEST(testWebControllerCalendar);
+  RUN_TEST(testWebControllerScheduleTimeline);
+  RUN_TEST(testWebControllerSnapshots);
+  RUN_TEST(testWebControllerNotFound);
+
+  return UNITY_END();
+}
+
+#endif
\ No newline at end of file